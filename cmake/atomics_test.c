@@ -5,5 +5,9 @@ int main()
     int64_t x = 0;
     __atomic_add_fetch(&x, -1, __ATOMIC_RELAXED);
     __atomic_store_n(&x, 100, __ATOMIC_RELAXED);
+    int64_t expected = __atomic_load_n(&x, __ATOMIC_ACQUIRE);
+    __atomic_compare_exchange_n(
+        &x, &expected, 0, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    __atomic_exchange_n(&x, 1, __ATOMIC_ACQ_REL);
     return 0;
 }
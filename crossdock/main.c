@@ -58,8 +58,8 @@ static inline bool make_observed_span(observed_span* span,
     jaeger_trace_id_format(&ctx->trace_id, span->trace_id, trace_id_len);
     span->sampled =
         ((ctx->flags & ((uint8_t) jaeger_sampling_flag_sampled)) != 0);
-    const jaeger_key_value* kv =
-        jaeger_hashtable_find(&ctx->baggage, baggage_key);
+    const jaeger_key_value* kv = jaeger_hashtable_find(
+        (jaeger_hashtable*) jaeger_span_context_baggage(ctx), baggage_key);
     assert(kv != NULL);
     span->baggage = strdup(kv->value);
     jaeger_mutex_unlock(&ctx->mutex);
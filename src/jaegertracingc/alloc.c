@@ -134,9 +134,15 @@ void jaeger_free(void* ptr)
 
 char* jaeger_strdup(const char* str)
 {
+    return jaeger_allocator_strdup(jaeger_get_allocator(), str);
+}
+
+char* jaeger_allocator_strdup(jaeger_allocator* alloc, const char* str)
+{
+    assert(alloc != NULL);
     assert(str != NULL);
     const int size = strlen(str) + 1;
-    char* copy = (char*) jaeger_malloc(size);
+    char* copy = (char*) alloc->malloc(alloc, size);
     if (copy == NULL) {
         jaeger_log_error("Cannot allocate string copy, size = %d", size);
         return NULL;
@@ -144,3 +150,148 @@ char* jaeger_strdup(const char* str)
     memcpy(copy, str, size);
     return copy;
 }
+
+/* Alignment of arena allocations, enough for any scalar type. */
+#define ARENA_ALIGNMENT (2 * sizeof(void*))
+#define ARENA_ALIGN(sz) (((sz) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+struct jaeger_arena_block {
+    struct jaeger_arena_block* next;
+    /* Usable size, following the aligned header. */
+    size_t size;
+    size_t used;
+};
+
+#define ARENA_BLOCK_HEADER_SIZE ARENA_ALIGN(sizeof(struct jaeger_arena_block))
+
+static inline char* arena_block_data(struct jaeger_arena_block* block)
+{
+    return (char*) block + ARENA_BLOCK_HEADER_SIZE;
+}
+
+static inline bool arena_owns(const jaeger_arena* arena, const void* ptr)
+{
+    for (struct jaeger_arena_block* block = arena->blocks; block != NULL;
+         block = block->next) {
+        const char* data = arena_block_data(block);
+        if ((const char*) ptr >= data &&
+            (const char*) ptr < data + block->size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void* jaeger_arena_malloc(jaeger_allocator* alloc, size_t sz)
+{
+    assert(alloc != NULL);
+    jaeger_arena* arena = (jaeger_arena*) alloc;
+    sz = ARENA_ALIGN(sz > 0 ? sz : 1);
+    struct jaeger_arena_block* block = arena->blocks;
+    if (block == NULL || block->size - block->used < sz) {
+        const size_t block_size =
+            (sz > JAEGERTRACINGC_ARENA_BLOCK_SIZE)
+                ? sz
+                : JAEGERTRACINGC_ARENA_BLOCK_SIZE;
+        block = jaeger_malloc(ARENA_BLOCK_HEADER_SIZE + block_size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->size = block_size;
+        block->used = 0;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+    char* ptr = arena_block_data(block) + block->used;
+    block->used += sz;
+    arena->last = ptr;
+    return ptr;
+}
+
+void* jaeger_arena_realloc(jaeger_allocator* alloc, void* ptr, size_t sz)
+{
+    assert(alloc != NULL);
+    jaeger_arena* arena = (jaeger_arena*) alloc;
+    if (ptr == NULL) {
+        return jaeger_arena_malloc(alloc, sz);
+    }
+    if (!arena_owns(arena, ptr)) {
+        return jaeger_realloc(ptr, sz);
+    }
+
+    /* Only the latest allocation can grow in place. */
+    struct jaeger_arena_block* block = arena->blocks;
+    char* data = arena_block_data(block);
+    if (ptr == arena->last) {
+        const size_t offset = (char*) ptr - data;
+        const size_t aligned_sz = ARENA_ALIGN(sz > 0 ? sz : 1);
+        if (block->size - offset >= aligned_sz) {
+            block->used = offset + aligned_sz;
+            return ptr;
+        }
+    }
+
+    /* The old size is unknown, but everything up to the end of the used
+     * part of its block may be copied. */
+    size_t available = 0;
+    for (; block != NULL; block = block->next) {
+        data = arena_block_data(block);
+        if ((char*) ptr >= data && (char*) ptr < data + block->size) {
+            available = data + block->used - (char*) ptr;
+            break;
+        }
+    }
+    void* new_ptr = jaeger_arena_malloc(alloc, sz);
+    if (new_ptr == NULL) {
+        return NULL;
+    }
+    memcpy(new_ptr, ptr, (available < sz) ? available : sz);
+    return new_ptr;
+}
+
+void jaeger_arena_free(jaeger_allocator* alloc, void* ptr)
+{
+    assert(alloc != NULL);
+    if (ptr == NULL || arena_owns((jaeger_arena*) alloc, ptr)) {
+        return;
+    }
+    jaeger_free(ptr);
+}
+
+void jaeger_arena_reset(jaeger_arena* arena)
+{
+    assert(arena != NULL);
+    struct jaeger_arena_block* block = arena->blocks;
+    if (block == NULL) {
+        return;
+    }
+    while (block->next != NULL) {
+        struct jaeger_arena_block* next = block->next;
+        jaeger_free(block);
+        block = next;
+    }
+    /* Keep the oldest block only at the regular size, so that a pooled owner
+     * does not hold on to an oversized first allocation. */
+    if (block->size == JAEGERTRACINGC_ARENA_BLOCK_SIZE) {
+        block->used = 0;
+        arena->blocks = block;
+    }
+    else {
+        jaeger_free(block);
+        arena->blocks = NULL;
+    }
+    arena->last = NULL;
+}
+
+void jaeger_arena_destroy(jaeger_arena* arena)
+{
+    if (arena == NULL) {
+        return;
+    }
+    while (arena->blocks != NULL) {
+        struct jaeger_arena_block* block = arena->blocks;
+        arena->blocks = block->next;
+        jaeger_free(block);
+    }
+    arena->last = NULL;
+}
@@ -112,6 +112,69 @@ void jaeger_free(void* ptr);
  */
 char* jaeger_strdup(const char* str);
 
+/**
+ * Duplicates string using the given allocator, logging to logger on failure.
+ * @param alloc Allocator instance.
+ * @param str String to duplicate.
+ * @return New string copy on success, NULL on failure.
+ */
+char* jaeger_allocator_strdup(jaeger_allocator* alloc, const char* str);
+
+/** Minimum size of the blocks an arena allocates from. */
+#define JAEGERTRACINGC_ARENA_BLOCK_SIZE 512
+
+/* Forward declaration. */
+struct jaeger_arena_block;
+
+/**
+ * Bump-pointer allocator for many small, short-lived allocations. Memory is
+ * carved out of blocks obtained from the installed allocator and is only
+ * released all at once by jaeger_arena_reset or jaeger_arena_destroy.
+ * Freeing memory returned by the arena is a no-op, while other pointers are
+ * passed on to the installed allocator, so an object holding a mix of arena
+ * and ordinary allocations can be freed through the arena. Not thread-safe,
+ * and must not itself be installed with jaeger_set_allocator.
+ */
+typedef struct jaeger_arena {
+    /** Base class member. */
+    jaeger_allocator base;
+    /** Blocks owned by the arena, the one being allocated from first. */
+    struct jaeger_arena_block* blocks;
+    /** Start of the latest allocation, which realloc may grow in place. */
+    char* last;
+} jaeger_arena;
+
+/** Implements jaeger_allocator malloc method for jaeger_arena. */
+void* jaeger_arena_malloc(jaeger_allocator* alloc, size_t sz);
+
+/** Implements jaeger_allocator realloc method for jaeger_arena. */
+void* jaeger_arena_realloc(jaeger_allocator* alloc, void* ptr, size_t sz);
+
+/** Implements jaeger_allocator free method for jaeger_arena. */
+void jaeger_arena_free(jaeger_allocator* alloc, void* ptr);
+
+/** Static initializer for an empty arena. */
+#define JAEGERTRACINGC_ARENA_INIT                  \
+    {                                              \
+        .base = {.malloc = &jaeger_arena_malloc,   \
+                 .realloc = &jaeger_arena_realloc, \
+                 .free = &jaeger_arena_free},      \
+        .blocks = NULL, .last = NULL               \
+    }
+
+/**
+ * Release all memory allocated from the arena, keeping one regular size
+ * block to serve later allocations.
+ * @param arena Arena instance.
+ */
+void jaeger_arena_reset(jaeger_arena* arena);
+
+/**
+ * Release all memory allocated from the arena, including its blocks.
+ * @param arena Arena instance.
+ */
+void jaeger_arena_destroy(jaeger_arena* arena);
+
 #ifdef __cplusplus
 } /* extern C */
 #endif /* __cplusplus */
@@ -33,4 +33,53 @@ void test_alloc()
     /* Calling free even though null to improve coverage of null allocator. */
     jaeger_free(str);
     jaeger_set_allocator(jaeger_built_in_allocator());
+
+    jaeger_arena arena = JAEGERTRACINGC_ARENA_INIT;
+    jaeger_allocator* alloc = (jaeger_allocator*) &arena;
+    char* first = jaeger_allocator_strdup(alloc, "hello");
+    TEST_ASSERT_EQUAL_STRING("hello", first);
+    char* second = alloc->malloc(alloc, 1);
+    TEST_ASSERT_NOT_NULL(second);
+    TEST_ASSERT_TRUE(second > first);
+    TEST_ASSERT_EQUAL(0, (uintptr_t) second % (2 * sizeof(void*)));
+
+    /* Latest allocation grows in place, others are copied. */
+    TEST_ASSERT_EQUAL_PTR(second, alloc->realloc(alloc, second, 32));
+    char* moved = alloc->realloc(alloc, first, 64);
+    TEST_ASSERT_NOT_NULL(moved);
+    TEST_ASSERT_TRUE(moved != first);
+    TEST_ASSERT_EQUAL_STRING("hello", moved);
+    alloc->free(alloc, moved);
+
+    /* Allocations larger than a block get a block of their own. */
+    char* large = alloc->malloc(alloc, 4 * JAEGERTRACINGC_ARENA_BLOCK_SIZE);
+    TEST_ASSERT_NOT_NULL(large);
+    memset(large, 0, 4 * JAEGERTRACINGC_ARENA_BLOCK_SIZE);
+    TEST_ASSERT_NOT_NULL(arena.blocks);
+
+    /* Memory from the installed allocator is passed on. */
+    mem = jaeger_malloc(16);
+    TEST_ASSERT_NOT_NULL(mem);
+    mem = alloc->realloc(alloc, mem, 32);
+    TEST_ASSERT_NOT_NULL(mem);
+    alloc->free(alloc, mem);
+
+    /* Reset keeps the first block for reuse. */
+    jaeger_arena_reset(&arena);
+    TEST_ASSERT_EQUAL_PTR(first, alloc->malloc(alloc, 1));
+
+    /* An oversized first block does not survive reset. */
+    jaeger_arena_destroy(&arena);
+    large = alloc->malloc(alloc, 4 * JAEGERTRACINGC_ARENA_BLOCK_SIZE);
+    TEST_ASSERT_NOT_NULL(large);
+    TEST_ASSERT_NOT_NULL(alloc->malloc(alloc, 1));
+    jaeger_arena_reset(&arena);
+    TEST_ASSERT_NULL(arena.blocks);
+    TEST_ASSERT_NOT_NULL(alloc->malloc(alloc, 1));
+
+    jaeger_set_allocator(jaeger_null_allocator());
+    TEST_ASSERT_NULL(alloc->malloc(alloc, 2 * JAEGERTRACINGC_ARENA_BLOCK_SIZE));
+    jaeger_set_allocator(jaeger_built_in_allocator());
+    jaeger_arena_destroy(&arena);
+    TEST_ASSERT_NULL(arena.blocks);
 }
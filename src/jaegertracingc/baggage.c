@@ -78,8 +78,8 @@ void jaeger_baggage_setter_set_baggage(jaeger_baggage_setter* setter,
         }
     }
 
-    const jaeger_key_value* kv =
-        jaeger_hashtable_find(&span->context.baggage, key);
+    const jaeger_key_value* kv = jaeger_hashtable_find(
+        (jaeger_hashtable*) jaeger_span_context_baggage(&span->context), key);
     prev_item = (kv != NULL);
     if (truncated) {
         char* value_copy = jaeger_malloc(restriction.max_value_len + 1);
@@ -88,11 +88,11 @@ void jaeger_baggage_setter_set_baggage(jaeger_baggage_setter* setter,
         }
         strncpy(value_copy, value, restriction.max_value_len);
         value_copy[restriction.max_value_len] = '\0';
-        jaeger_hashtable_put(&span->context.baggage, key, value_copy);
+        jaeger_span_context_set_baggage_item(&span->context, key, value_copy);
         jaeger_free(value_copy);
     }
     else {
-        jaeger_hashtable_put(&span->context.baggage, key, value);
+        jaeger_span_context_set_baggage_item(&span->context, key, value);
     }
 
 log:
@@ -55,7 +55,7 @@ jaeger_key_value_node* jaeger_key_value_node_new(jaeger_key_value data)
 void jaeger_hashtable_clear(jaeger_hashtable* hashtable)
 {
     assert(hashtable != NULL);
-    const size_t bucket_count = (1u << hashtable->order);
+    const size_t bucket_count = jaeger_hashtable_bucket_count(hashtable);
     for (size_t i = 0; i < bucket_count; i++) {
         jaeger_list_clear(&hashtable->buckets[i]);
     }
@@ -69,27 +69,31 @@ void jaeger_hashtable_destroy(jaeger_hashtable* hashtable)
     }
     jaeger_hashtable_clear(hashtable);
     jaeger_free(hashtable->buckets);
-    hashtable->buckets = NULL;
+    *hashtable = (jaeger_hashtable) JAEGERTRACINGC_HASHTABLE_INIT;
 }
 
-bool jaeger_hashtable_init(jaeger_hashtable* hashtable)
+static bool alloc_buckets(jaeger_hashtable* hashtable, size_t order)
 {
-    assert(hashtable != NULL);
-    *hashtable = (jaeger_hashtable) JAEGERTRACINGC_HASHTABLE_INIT;
-    const size_t bucket_count = (1u << JAEGERTRACINGC_HASHTABLE_INIT_ORDER);
+    assert(hashtable->buckets == NULL);
+    const size_t bucket_count = (1u << order);
     hashtable->buckets = jaeger_malloc(bucket_count * sizeof(jaeger_list));
     if (hashtable->buckets == NULL) {
-        jaeger_hashtable_destroy(hashtable);
         return false;
     }
-    hashtable->size = 0;
-    hashtable->order = JAEGERTRACINGC_HASHTABLE_INIT_ORDER;
+    hashtable->order = order;
     for (size_t i = 0; i < bucket_count; i++) {
         hashtable->buckets[i] = (jaeger_list) JAEGERTRACINGC_LIST_INIT;
     }
     return true;
 }
 
+bool jaeger_hashtable_init(jaeger_hashtable* hashtable)
+{
+    assert(hashtable != NULL);
+    *hashtable = (jaeger_hashtable) JAEGERTRACINGC_HASHTABLE_INIT;
+    return alloc_buckets(hashtable, JAEGERTRACINGC_HASHTABLE_INIT_ORDER);
+}
+
 size_t jaeger_hashtable_hash(const char* key)
 {
     return jaeger_siphash((const uint8_t*) key, strlen(key), hash_seed());
@@ -137,6 +141,9 @@ jaeger_hashtable_internal_lookup(jaeger_hashtable* hashtable, const char* key)
     assert(key != NULL);
 
     jaeger_hashtable_lookup_result result = {.node = NULL, .bucket = NULL};
+    if (hashtable->buckets == NULL) {
+        return result;
+    }
     const size_t bucket_count = (1u << hashtable->order);
     const size_t hash_code = jaeger_hashtable_hash(key);
     const size_t index = hash_code & (bucket_count - 1);
@@ -169,6 +176,10 @@ bool jaeger_hashtable_put(jaeger_hashtable* hashtable,
     assert(hashtable != NULL);
     assert(key != NULL);
     assert(value != NULL);
+    if (hashtable->buckets == NULL &&
+        !alloc_buckets(hashtable, JAEGERTRACINGC_HASHTABLE_INIT_ORDER)) {
+        return false;
+    }
     const size_t bucket_count = (1u << hashtable->order);
     if (((double) hashtable->size + 1) / bucket_count >=
             JAEGERTRACINGC_HASHTABLE_THRESHOLD &&
@@ -230,23 +241,17 @@ uint32_t jaeger_hashtable_minimal_order(uint32_t size)
 bool jaeger_hashtable_copy(jaeger_hashtable* restrict dst,
                            const jaeger_hashtable* restrict src)
 {
-    /* Avoid malloc of zero size. */
+    *dst = (jaeger_hashtable) JAEGERTRACINGC_HASHTABLE_INIT;
+    /* Leave buckets of an empty copy to the first put. */
     if (src->size == 0) {
-        return jaeger_hashtable_init(dst);
+        return true;
     }
 
-    *dst = (jaeger_hashtable) JAEGERTRACINGC_HASHTABLE_INIT;
-    const size_t order = jaeger_hashtable_minimal_order(src->size);
-    const size_t bucket_count = (1u << order);
-    dst->buckets = jaeger_malloc(bucket_count * sizeof(jaeger_list));
-    if (dst->buckets == NULL) {
+    if (!alloc_buckets(dst, jaeger_hashtable_minimal_order(src->size))) {
         goto cleanup;
     }
-    dst->order = order;
-    for (size_t i = 0; i < bucket_count; i++) {
-        dst->buckets[i] = (jaeger_list) JAEGERTRACINGC_LIST_INIT;
-    }
-    for (size_t i = 0, len = (1u << src->order); i < len; i++) {
+    for (size_t i = 0, len = jaeger_hashtable_bucket_count(src); i < len;
+         i++) {
         for (jaeger_list_node* entry = src->buckets[i].head; entry != NULL;
              entry = entry->next) {
             const jaeger_key_value* kv =
@@ -42,7 +42,9 @@ extern "C" {
 #define JAEGERTRACINGC_HASHTABLE_THRESHOLD 1.0
 
 /**
- * Hashtable data structure.
+ * Hashtable data structure. Buckets are allocated on the first put, so an
+ * empty table initialized with JAEGERTRACINGC_HASHTABLE_INIT costs no
+ * allocation.
  */
 typedef struct jaeger_hashtable {
     size_t size;
@@ -79,10 +81,21 @@ void jaeger_hashtable_clear(jaeger_hashtable* hashtable);
 void jaeger_hashtable_destroy(jaeger_hashtable* hashtable);
 
 /**
- * Hashtable constructor.
+ * Hashtable constructor. Allocates buckets upfront, use
+ * JAEGERTRACINGC_HASHTABLE_INIT to defer allocation to the first put.
  */
 bool jaeger_hashtable_init(jaeger_hashtable* hashtable);
 
+/**
+ * Number of buckets to iterate over, zero if none have been allocated yet.
+ */
+static inline size_t
+jaeger_hashtable_bucket_count(const jaeger_hashtable* hashtable)
+{
+    assert(hashtable != NULL);
+    return (hashtable->buckets == NULL) ? 0 : ((size_t) 1 << hashtable->order);
+}
+
 size_t jaeger_hashtable_hash(const char* key);
 
 bool jaeger_hashtable_rehash(jaeger_hashtable* hashtable);
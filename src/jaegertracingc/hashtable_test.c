@@ -121,6 +121,22 @@ void test_hashtable()
     TEST_ASSERT_NULL(jaeger_key_value_node_new(key_value));
     jaeger_set_allocator(jaeger_built_in_allocator());
 
+    /* Test buckets allocated on first put. */
+    hashtable = (jaeger_hashtable) JAEGERTRACINGC_HASHTABLE_INIT;
+    TEST_ASSERT_EQUAL(0, jaeger_hashtable_bucket_count(&hashtable));
+    TEST_ASSERT_NULL(jaeger_hashtable_find(&hashtable, "key"));
+    jaeger_hashtable_remove(&hashtable, "key");
+    jaeger_hashtable_clear(&hashtable);
+    TEST_ASSERT_TRUE(jaeger_hashtable_copy(&hashtable_copy, &hashtable));
+    TEST_ASSERT_NULL(hashtable_copy.buckets);
+    TEST_ASSERT_TRUE(jaeger_hashtable_put(&hashtable, "key", "value"));
+    TEST_ASSERT_EQUAL(1 << JAEGERTRACINGC_HASHTABLE_INIT_ORDER,
+                      jaeger_hashtable_bucket_count(&hashtable));
+    TEST_ASSERT_NOT_NULL(jaeger_hashtable_find(&hashtable, "key"));
+    jaeger_hashtable_destroy(&hashtable);
+    TEST_ASSERT_EQUAL(0, jaeger_hashtable_bucket_count(&hashtable));
+    jaeger_hashtable_destroy(&hashtable);
+
     /* Test minimal size. */
     TEST_ASSERT_EQUAL_HEX(0x100, 1 << jaeger_hashtable_minimal_order(0xf0));
     TEST_ASSERT_EQUAL_HEX(0x10, 1 << jaeger_hashtable_minimal_order(0x8));
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2018 The Jaeger Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jaegertracingc/intern.h"
+
+#include "jaegertracingc/hashtable.h"
+
+bool jaeger_intern_table_init(jaeger_intern_table* table, int max_strings)
+{
+    assert(table != NULL);
+    assert(max_strings > 0);
+    size_t num_slots = 1;
+    while (num_slots < 2 * (size_t) max_strings) {
+        num_slots <<= 1;
+    }
+
+    table->slots = jaeger_malloc(sizeof(jaeger_interned_string*) * num_slots);
+    if (table->slots == NULL) {
+        jaeger_log_error("Cannot allocate intern table, number of slots = %zu",
+                         num_slots);
+        return false;
+    }
+    for (size_t i = 0; i < num_slots; i++) {
+        table->slots[i] = NULL;
+    }
+    table->mask = num_slots - 1;
+    table->max_strings = max_strings;
+    table->num_strings = 0;
+#ifndef JAEGERTRACINGC_HAVE_ATOMICS
+    table->mutex = (jaeger_mutex) JAEGERTRACINGC_MUTEX_INIT;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+    return true;
+}
+
+void jaeger_intern_table_destroy(jaeger_intern_table* table)
+{
+    if (table == NULL) {
+        return;
+    }
+    if (table->slots != NULL) {
+        for (size_t i = 0; i <= table->mask; i++) {
+            if (table->slots[i] != NULL) {
+                jaeger_free(table->slots[i]);
+            }
+        }
+        jaeger_free(table->slots);
+        table->slots = NULL;
+    }
+#ifndef JAEGERTRACINGC_HAVE_ATOMICS
+    jaeger_mutex_destroy(&table->mutex);
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+static inline jaeger_interned_string*
+load_slot(jaeger_interned_string* const* slot)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+#else
+    return *slot;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+static inline int load_num_strings(const jaeger_intern_table* table)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    return __atomic_load_n(&table->num_strings, __ATOMIC_RELAXED);
+#else
+    return table->num_strings;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+/* Adds delta to the number of strings and returns the previous number. */
+static inline int add_num_strings(jaeger_intern_table* table, int delta)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    return __atomic_fetch_add(&table->num_strings, delta, __ATOMIC_RELAXED);
+#else
+    const int num_strings = table->num_strings;
+    table->num_strings += delta;
+    return num_strings;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+/* Publishes str in an empty slot. Returns false if another thread filled the
+ * slot first, in which case *slot_value is set to the slot's string. */
+static inline bool fill_slot(jaeger_interned_string** slot,
+                             jaeger_interned_string** slot_value,
+                             jaeger_interned_string* str)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    return __atomic_compare_exchange_n(
+        slot, slot_value, str, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#else
+    (void) slot_value;
+    *slot = str;
+    return true;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+/* Allocates a new string with the next free ID, or returns NULL if the table
+ * is full. */
+static jaeger_interned_string*
+new_string(jaeger_intern_table* table, const char* str, size_t hash)
+{
+    if (load_num_strings(table) >= table->max_strings) {
+        return NULL;
+    }
+    const int id = add_num_strings(table, 1);
+    if (id >= table->max_strings) {
+        add_num_strings(table, -1);
+        return NULL;
+    }
+    const size_t len = strlen(str);
+    jaeger_interned_string* result =
+        jaeger_malloc(sizeof(jaeger_interned_string) + len + 1);
+    if (result == NULL) {
+        /* The ID is not reused, the table just accepts one string less. */
+        jaeger_log_error("Cannot allocate interned string, length = %zu", len);
+        return NULL;
+    }
+    result->hash = hash;
+    result->id = id;
+    result->len = len;
+    memcpy(result->str, str, len + 1);
+    return result;
+}
+
+static const jaeger_interned_string*
+intern_string(jaeger_intern_table* table, const char* str, size_t hash)
+{
+    jaeger_interned_string* new_str = NULL;
+    for (size_t i = hash & table->mask, n = 0; n <= table->mask;
+         i = (i + 1) & table->mask, n++) {
+        jaeger_interned_string** slot = &table->slots[i];
+        jaeger_interned_string* slot_value = load_slot(slot);
+        if (slot_value == NULL) {
+            if (new_str == NULL) {
+                new_str = new_string(table, str, hash);
+                if (new_str == NULL) {
+                    return NULL;
+                }
+            }
+            if (fill_slot(slot, &slot_value, new_str)) {
+                return new_str;
+            }
+        }
+        if (slot_value->hash == hash && strcmp(slot_value->str, str) == 0) {
+            if (new_str != NULL) {
+                /* Lost the race to intern the same string. */
+                jaeger_free(new_str);
+            }
+            return slot_value;
+        }
+    }
+    /* Unreachable as slots are filled at most halfway. */
+    if (new_str != NULL) {
+        jaeger_free(new_str);
+    }
+    return NULL;
+}
+
+const jaeger_interned_string*
+jaeger_intern_table_intern(jaeger_intern_table* table, const char* str)
+{
+    assert(table != NULL);
+    assert(str != NULL);
+    const size_t hash = jaeger_hashtable_hash(str);
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    return intern_string(table, str, hash);
+#else
+    jaeger_mutex_lock(&table->mutex);
+    const jaeger_interned_string* result = intern_string(table, str, hash);
+    jaeger_mutex_unlock(&table->mutex);
+    return result;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+static jaeger_intern_table operation_names;
+static bool operation_names_initialized = false;
+static jaeger_once operation_names_once = JAEGERTRACINGC_ONCE_INIT;
+
+static void init_operation_names()
+{
+    operation_names_initialized = jaeger_intern_table_init(
+        &operation_names, JAEGERTRACINGC_MAX_INTERNED_OPERATION_NAMES);
+}
+
+static void skip_operation_names() {}
+
+const jaeger_interned_string*
+jaeger_intern_operation_name(const char* operation_name)
+{
+    jaeger_do_once(&operation_names_once, &init_operation_names);
+    if (!operation_names_initialized) {
+        return NULL;
+    }
+    return jaeger_intern_table_intern(&operation_names, operation_name);
+}
+
+void jaeger_intern_operation_names_destroy(void)
+{
+    /* Keeps the table from being created after this if it was never used. */
+    jaeger_do_once(&operation_names_once, &skip_operation_names);
+    if (!operation_names_initialized) {
+        return;
+    }
+    operation_names_initialized = false;
+    jaeger_intern_table_destroy(&operation_names);
+}
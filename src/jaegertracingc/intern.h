@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2018 The Jaeger Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file
+ * Intern table mapping strings to stable handles. Interning a string that is
+ * already in the table neither allocates nor takes a lock if
+ * JAEGERTRACINGC_HAVE_ATOMICS is defined, otherwise it falls back to a mutex.
+ * Strings are never removed, so the number of strings a table accepts is
+ * bounded.
+ */
+
+#ifndef JAEGERTRACINGC_INTERN_H
+#define JAEGERTRACINGC_INTERN_H
+
+#include "jaegertracingc/common.h"
+#include "jaegertracingc/threading.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * Maximum number of operation names in the process-wide table. Once it is
+ * full, new operation names are not interned and spans and samplers keep a
+ * private copy of them instead.
+ */
+#define JAEGERTRACINGC_MAX_INTERNED_OPERATION_NAMES 4096
+
+/**
+ * Interned string. Handles stay valid until their table is destroyed, and
+ * two handles from the same table are equal if and only if their strings
+ * are.
+ */
+typedef struct jaeger_interned_string {
+    /** Hash of the string, computed once when it is interned. */
+    size_t hash;
+    /** Sequential ID, less than the maximum number of strings. */
+    int id;
+    /** Length of the string excluding the null byte. */
+    size_t len;
+    /** Null-terminated string. */
+    char str[];
+} jaeger_interned_string;
+
+typedef struct jaeger_intern_table {
+    /** Open addressing slots, filled at most halfway. */
+    jaeger_interned_string** slots;
+    /** Number of slots minus one, number of slots is a power of two. */
+    size_t mask;
+    int max_strings;
+    /** Number of IDs handed out. */
+    int num_strings;
+#ifndef JAEGERTRACINGC_HAVE_ATOMICS
+    jaeger_mutex mutex;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+} jaeger_intern_table;
+
+/**
+ * Initialize a new table.
+ * @param table Table to initialize.
+ * @param max_strings Maximum number of strings the table accepts. Must be
+ *                    positive.
+ * @return True on success, false otherwise.
+ */
+bool jaeger_intern_table_init(jaeger_intern_table* table, int max_strings);
+
+/**
+ * Free the table and all of its strings, invalidating their handles.
+ * @param table Table to destroy.
+ */
+void jaeger_intern_table_destroy(jaeger_intern_table* table);
+
+/**
+ * Find or add a string. Safe to call from multiple threads concurrently.
+ * @param table Table instance.
+ * @param str String to intern. May not be NULL.
+ * @return Handle of the string, or NULL if it is not in the table and the
+ *         table is full or out of memory.
+ */
+const jaeger_interned_string*
+jaeger_intern_table_intern(jaeger_intern_table* table, const char* str);
+
+/**
+ * Intern an operation name in the process-wide table shared by all tracers
+ * and samplers. The table is created on first use and, like every string
+ * added to it, is allocated with the allocator installed at that time, which
+ * must stay installed until jaeger_intern_operation_names_destroy() is
+ * called. Handles stay valid until then.
+ * @param operation_name Operation name to intern. May not be NULL.
+ * @return Handle of the operation name, or NULL if it could not be interned,
+ *         e.g. because JAEGERTRACINGC_MAX_INTERNED_OPERATION_NAMES names
+ *         already are, in which case the caller must keep its own copy.
+ */
+const jaeger_interned_string*
+jaeger_intern_operation_name(const char* operation_name);
+
+/**
+ * Free the process-wide operation name table, e.g. at shutdown so leak
+ * checkers see no outstanding allocations. Must only be called once every
+ * tracer, sampler and span is destroyed and no other thread interns
+ * operation names. Afterwards, operation names are no longer interned.
+ */
+void jaeger_intern_operation_names_destroy(void);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif /* __cplusplus */
+
+#endif /* JAEGERTRACINGC_INTERN_H */
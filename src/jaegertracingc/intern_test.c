@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2018 The Jaeger Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jaegertracingc/intern.h"
+
+#include "unity.h"
+
+#include "jaegertracingc/span.h"
+
+static void test_intern_table()
+{
+    enum { max_strings = 3 };
+
+    jaeger_intern_table table;
+    TEST_ASSERT_TRUE(jaeger_intern_table_init(&table, max_strings));
+
+    const jaeger_interned_string* foo =
+        jaeger_intern_table_intern(&table, "foo");
+    TEST_ASSERT_NOT_NULL(foo);
+    TEST_ASSERT_EQUAL_STRING("foo", foo->str);
+    TEST_ASSERT_EQUAL(strlen("foo"), foo->len);
+    TEST_ASSERT_EQUAL(0, foo->id);
+
+    char buffer[] = "foo";
+    TEST_ASSERT_EQUAL_PTR(foo, jaeger_intern_table_intern(&table, buffer));
+
+    const jaeger_interned_string* bar =
+        jaeger_intern_table_intern(&table, "bar");
+    TEST_ASSERT_NOT_NULL(bar);
+    TEST_ASSERT_NOT_EQUAL(foo, bar);
+    TEST_ASSERT_EQUAL_STRING("bar", bar->str);
+    TEST_ASSERT_EQUAL(1, bar->id);
+
+    jaeger_set_allocator(jaeger_null_allocator());
+    TEST_ASSERT_NULL(jaeger_intern_table_intern(&table, "baz"));
+    /* Strings already in the table do not allocate. */
+    TEST_ASSERT_EQUAL_PTR(bar, jaeger_intern_table_intern(&table, "bar"));
+    jaeger_set_allocator(jaeger_built_in_allocator());
+
+    /* The failed allocation used up an ID, so the table is full now. */
+    TEST_ASSERT_NULL(jaeger_intern_table_intern(&table, "baz"));
+    TEST_ASSERT_EQUAL_PTR(foo, jaeger_intern_table_intern(&table, "foo"));
+
+    jaeger_intern_table_destroy(&table);
+    jaeger_intern_table_destroy(NULL);
+
+    jaeger_set_allocator(jaeger_null_allocator());
+    TEST_ASSERT_FALSE(jaeger_intern_table_init(&table, max_strings));
+    jaeger_set_allocator(jaeger_built_in_allocator());
+}
+
+static void test_interned_operation_name()
+{
+    const jaeger_interned_string* name =
+        jaeger_intern_operation_name("test-operation");
+    TEST_ASSERT_NOT_NULL(name);
+    TEST_ASSERT_EQUAL_PTR(name, jaeger_intern_operation_name("test-operation"));
+
+    jaeger_span span = JAEGERTRACINGC_SPAN_INIT;
+    TEST_ASSERT_TRUE(jaeger_span_init(&span));
+    span.context.flags = jaeger_sampling_flag_sampled;
+    ((opentracing_span*) &span)
+        ->set_operation_name((opentracing_span*) &span, "test-operation");
+    TEST_ASSERT_EQUAL_PTR(name, span.interned_operation_name);
+    TEST_ASSERT_EQUAL_PTR(name->str, span.operation_name);
+
+    jaeger_span copy;
+    TEST_ASSERT_TRUE(jaeger_span_copy(&copy, &span));
+    TEST_ASSERT_EQUAL_PTR(name->str, copy.operation_name);
+    ((opentracing_destructible*) &copy)
+        ->destroy((opentracing_destructible*) &copy);
+    ((opentracing_destructible*) &span)
+        ->destroy((opentracing_destructible*) &span);
+
+    /* The handle outlives the spans that used it. */
+    TEST_ASSERT_EQUAL_STRING("test-operation", name->str);
+
+    /* Later tests in this process fall back to copies of operation names. */
+    jaeger_intern_operation_names_destroy();
+    TEST_ASSERT_NULL(jaeger_intern_operation_name("test-operation"));
+    jaeger_intern_operation_names_destroy();
+}
+
+void test_intern()
+{
+    test_intern_table();
+    test_interned_operation_name();
+}
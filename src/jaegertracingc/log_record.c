@@ -17,12 +17,22 @@
 #include "jaegertracingc/log_record.h"
 
 void jaeger_log_record_destroy(jaeger_log_record* log_record)
+{
+    jaeger_log_record_destroy_with_allocator(log_record,
+                                             jaeger_get_allocator());
+}
+
+void jaeger_log_record_destroy_with_allocator(jaeger_log_record* log_record,
+                                              jaeger_allocator* alloc)
 {
     if (log_record == NULL) {
         return;
     }
-    JAEGERTRACINGC_VECTOR_FOR_EACH(
-        &log_record->fields, jaeger_tag_destroy, jaeger_tag);
+    for (int i = 0, len = jaeger_vector_length(&log_record->fields); i < len;
+         i++) {
+        jaeger_tag_destroy_with_allocator(
+            jaeger_vector_offset(&log_record->fields, i), alloc);
+    }
     jaeger_vector_destroy(&log_record->fields);
 }
 
@@ -30,7 +40,11 @@ bool jaeger_log_record_init(jaeger_log_record* log_record)
 {
     assert(log_record != NULL);
     jaeger_timestamp_now(&log_record->timestamp);
-    return jaeger_vector_init(&log_record->fields, sizeof(jaeger_tag));
+    jaeger_vector_init_inline(&log_record->fields,
+                              sizeof(jaeger_tag),
+                              log_record->fields_storage,
+                              JAEGERTRACINGC_LOG_RECORD_INLINE_FIELDS);
+    return true;
 }
 
 bool jaeger_log_record_copy(jaeger_log_record* restrict dst,
@@ -50,6 +64,15 @@ bool jaeger_log_record_copy(jaeger_log_record* restrict dst,
 
 bool jaeger_log_record_from_opentracing(
     jaeger_log_record* restrict dst, const opentracing_log_record* restrict src)
+{
+    return jaeger_log_record_from_opentracing_with_allocator(
+        dst, src, jaeger_get_allocator());
+}
+
+bool jaeger_log_record_from_opentracing_with_allocator(
+    jaeger_log_record* restrict dst,
+    const opentracing_log_record* restrict src,
+    jaeger_allocator* alloc)
 {
     if (!jaeger_log_record_init(dst) ||
         !jaeger_vector_reserve(&dst->fields, src->num_fields)) {
@@ -58,8 +81,8 @@ bool jaeger_log_record_from_opentracing(
     for (int i = 0; i < src->num_fields; i++) {
         jaeger_tag* tag = jaeger_vector_append(&dst->fields);
         assert(tag != NULL);
-        if (!jaeger_tag_from_key_value(
-                tag, src->fields[i].key, &src->fields[i].value)) {
+        if (!jaeger_tag_from_key_value_with_allocator(
+                tag, src->fields[i].key, &src->fields[i].value, alloc)) {
             dst->fields.len--;
         }
     }
@@ -67,7 +90,7 @@ bool jaeger_log_record_from_opentracing(
     return true;
 
 cleanup:
-    jaeger_log_record_destroy(dst);
+    jaeger_log_record_destroy_with_allocator(dst, alloc);
     return false;
 }
 
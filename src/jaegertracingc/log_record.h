@@ -33,15 +33,27 @@
 extern "C" {
 #endif /* __cplusplus */
 
+/** Number of log fields stored inline in a log record. */
+#define JAEGERTRACINGC_LOG_RECORD_INLINE_FIELDS 2
+
 typedef struct jaeger_log_record {
     jaeger_timestamp timestamp;
-    jaeger_vector fields;
+    JAEGERTRACINGC_INLINE_VECTOR(jaeger_tag,
+                                 fields,
+                                 JAEGERTRACINGC_LOG_RECORD_INLINE_FIELDS);
 } jaeger_log_record;
 
 void jaeger_log_record_destroy(jaeger_log_record* log_record);
 
 JAEGERTRACINGC_WRAP_DESTROY(jaeger_log_record_destroy, jaeger_log_record)
 
+/**
+ * Destroy log record whose fields were allocated from alloc.
+ * @see jaeger_tag_destroy_with_allocator
+ */
+void jaeger_log_record_destroy_with_allocator(jaeger_log_record* log_record,
+                                              jaeger_allocator* alloc);
+
 #define JAEGERTRACINGC_LOG_RECORD_INIT              \
     {                                               \
         .timestamp = JAEGERTRACINGC_TIMESTAMP_INIT, \
@@ -57,6 +69,11 @@ bool jaeger_log_record_from_opentracing(jaeger_log_record* restrict dst,
                                         const opentracing_log_record* restrict
                                             src);
 
+bool jaeger_log_record_from_opentracing_with_allocator(
+    jaeger_log_record* restrict dst,
+    const opentracing_log_record* restrict src,
+    jaeger_allocator* alloc);
+
 JAEGERTRACINGC_WRAP_COPY(jaeger_log_record_copy,
                          jaeger_log_record,
                          jaeger_log_record)
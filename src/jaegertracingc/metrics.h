@@ -122,10 +122,14 @@ jaeger_gauge* jaeger_null_gauge();
     X(spans_finished)                      \
     X(spans_sampled)                       \
     X(spans_not_sampled)                   \
+    X(span_pool_hits)                      \
+    X(span_pool_misses)                    \
     X(decoding_errors)                     \
     X(reporter_success)                    \
     X(reporter_failure)                    \
     X(reporter_dropped)                    \
+    X(reporter_packets)                    \
+    X(reporter_packet_bytes)               \
     X(sampler_retrieved)                   \
     X(sampler_updated)                     \
     X(sampler_update_failure)              \
@@ -136,7 +140,10 @@ jaeger_gauge* jaeger_null_gauge();
     X(baggage_restrictions_update_success) \
     X(baggage_restrictions_update_failure)
 
-#define JAEGERTRACINGC_METRICS_GAUGES(X) X(reporter_queue_length)
+#define JAEGERTRACINGC_METRICS_GAUGES(X) \
+    X(reporter_queue_length)             \
+    X(reporter_max_packet_size)          \
+    X(reporter_packet_fill_percent)
 
 #define JAEGERTRACINGC_COUNTER_DECL(member) jaeger_counter* member;
 #define JAEGERTRACINGC_GAUGE_DECL(member) jaeger_gauge* member;
@@ -54,6 +54,10 @@ typedef struct mock_http_server {
     char url_buffer[MOCK_HTTP_MAX_URL];
     jaeger_vector responses;
     bool running;
+    /* Close each connection after responding, like a server with a short
+     * keep-alive timeout. */
+    bool close_after_response;
+    int num_connections;
 } mock_http_server;
 
 typedef struct mock_http_response {
@@ -67,7 +71,8 @@ typedef struct mock_http_response {
         .server_fd = -1, .addr = {}, .thread = 0,                      \
         .mutex = JAEGERTRACINGC_MUTEX_INIT, .url_len = 0,              \
         .url_buffer = {'\0'}, .responses = JAEGERTRACINGC_VECTOR_INIT, \
-        .running = false                                               \
+        .running = false, .close_after_response = false,               \
+        .num_connections = 0                                           \
     }
 
 static inline int
@@ -119,27 +124,25 @@ typedef struct mock_http_server_context {
         .server = NULL, .cv = JAEGERTRACINGC_COND_INIT \
     }
 
-static inline void* mock_http_server_run_loop(void* context)
+static inline bool mock_http_server_accept(mock_http_server* server)
 {
-    TEST_ASSERT_NOT_NULL(context);
-    mock_http_server_context* server_context =
-        (mock_http_server_context*) context;
-    mock_http_server* server = server_context->server;
-    TEST_ASSERT_NOT_NULL(server);
-    server->client_fd = -1;
-
-    jaeger_mutex_lock(&server->mutex);
-    server->running = true;
-    jaeger_mutex_unlock(&server->mutex);
-    jaeger_cond_signal(&server_context->cv);
-
     const int client_fd = accept(server->server_fd, NULL, 0);
+    if (server->num_connections > 0 && server->close_after_response &&
+        client_fd < 0) {
+        /* Server was shut down while waiting for the next connection. */
+        return false;
+    }
     TEST_ASSERT_GREATER_OR_EQUAL(0, client_fd);
 
     jaeger_mutex_lock(&server->mutex);
     server->client_fd = client_fd;
+    server->num_connections++;
     jaeger_mutex_unlock(&server->mutex);
+    return true;
+}
 
+static inline void mock_http_server_serve_client(mock_http_server* server)
+{
     while (true) {
         http_parser parser;
         http_parser_init(&parser, HTTP_REQUEST);
@@ -219,6 +222,37 @@ static inline void* mock_http_server_run_loop(void* context)
         const int num_written =
             write(server->client_fd, http_response, strlen(http_response));
         TEST_ASSERT_EQUAL(strlen(http_response), num_written);
+        if (server->close_after_response) {
+            break;
+        }
+    }
+}
+
+static inline void* mock_http_server_run_loop(void* context)
+{
+    TEST_ASSERT_NOT_NULL(context);
+    mock_http_server_context* server_context =
+        (mock_http_server_context*) context;
+    mock_http_server* server = server_context->server;
+    TEST_ASSERT_NOT_NULL(server);
+    server->client_fd = -1;
+
+    jaeger_mutex_lock(&server->mutex);
+    server->running = true;
+    jaeger_mutex_unlock(&server->mutex);
+    jaeger_cond_signal(&server_context->cv);
+
+    while (mock_http_server_accept(server)) {
+        mock_http_server_serve_client(server);
+        if (!server->close_after_response) {
+            break;
+        }
+        jaeger_mutex_lock(&server->mutex);
+        if (server->client_fd > -1) {
+            close(server->client_fd);
+            server->client_fd = -1;
+        }
+        jaeger_mutex_unlock(&server->mutex);
     }
     return NULL;
 }
@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2018 The Jaeger Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file
+ * Local HTTP collector accepting jaeger.model.PostSpansRequest messages, for
+ * use in tests and benchmarks of the HTTP reporter.
+ */
+
+#ifndef JAEGERTRACINGC_MOCK_COLLECTOR_H
+#define JAEGERTRACINGC_MOCK_COLLECTOR_H
+
+#include <errno.h>
+#include <http_parser.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "jaegertracingc/common.h"
+#include "jaegertracingc/protoc-gen/model.pb-c.h"
+#include "jaegertracingc/threading.h"
+#include "jaegertracingc/vector.h"
+#include "unity.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define MOCK_COLLECTOR_BACKLOG 1
+#define MOCK_COLLECTOR_READ_BUFFER_SIZE 4096
+#define MOCK_COLLECTOR_MAX_RESPONSE_LEN 128
+
+typedef struct mock_collector {
+    int server_fd;
+    int client_fd;
+    struct sockaddr_in addr;
+    jaeger_thread thread;
+    jaeger_mutex mutex;
+    jaeger_cond cv;
+    /** Request body being parsed. */
+    jaeger_vector body;
+    bool running;
+    /** Status code of every response. */
+    int status_code;
+    /** Whether to answer requests at all, or leave the client waiting. */
+    bool respond;
+    /**
+     * Close each connection after this many requests. Zero keeps connections
+     * open until the client closes them.
+     */
+    int max_requests_per_connection;
+    int num_connections;
+    int num_connection_requests;
+    int num_requests;
+    int num_spans;
+} mock_collector;
+
+#define MOCK_COLLECTOR_INIT                                                 \
+    {                                                                       \
+        .server_fd = -1, .client_fd = -1, .addr = {}, .thread = 0,          \
+        .mutex = JAEGERTRACINGC_MUTEX_INIT, .cv = JAEGERTRACINGC_COND_INIT, \
+        .body = JAEGERTRACINGC_VECTOR_INIT, .running = false,               \
+        .status_code = 200, .respond = true,                                \
+        .max_requests_per_connection = 0,                                   \
+        .num_connections = 0, .num_connection_requests = 0,                 \
+        .num_requests = 0, .num_spans = 0                                   \
+    }
+
+static inline int
+mock_collector_on_body(http_parser* parser, const char* at, size_t len)
+{
+    TEST_ASSERT_NOT_NULL(parser);
+    TEST_ASSERT_NOT_NULL(parser->data);
+    mock_collector* collector = (mock_collector*) parser->data;
+    char* body = jaeger_vector_extend(
+        &collector->body, jaeger_vector_length(&collector->body), len);
+    TEST_ASSERT_NOT_NULL(body);
+    memcpy(body, at, len);
+    return 0;
+}
+
+static inline int mock_collector_on_message_complete(http_parser* parser)
+{
+    TEST_ASSERT_NOT_NULL(parser);
+    TEST_ASSERT_NOT_NULL(parser->data);
+    mock_collector* collector = (mock_collector*) parser->data;
+    Jaeger__Model__PostSpansRequest* request =
+        jaeger__model__post_spans_request__unpack(
+            NULL,
+            jaeger_vector_length(&collector->body),
+            (const uint8_t*) collector->body.data);
+    TEST_ASSERT_NOT_NULL(request);
+    TEST_ASSERT_NOT_NULL(request->batch);
+    TEST_ASSERT_NOT_NULL(request->batch->process);
+
+    jaeger_mutex_lock(&collector->mutex);
+    collector->num_connection_requests++;
+    const bool close_connection =
+        (collector->max_requests_per_connection > 0 &&
+         collector->num_connection_requests >=
+             collector->max_requests_per_connection);
+    const int status_code = collector->status_code;
+    const bool respond = collector->respond;
+    if (status_code >= 200 && status_code < 300) {
+        collector->num_spans += request->batch->n_spans;
+    }
+    collector->num_requests++;
+    jaeger_cond_signal(&collector->cv);
+    jaeger_mutex_unlock(&collector->mutex);
+    jaeger__model__post_spans_request__free_unpacked(request, NULL);
+    jaeger_vector_clear(&collector->body);
+    if (!respond) {
+        return 0;
+    }
+
+    /* Empty PostSpansResponse. */
+    char response[MOCK_COLLECTOR_MAX_RESPONSE_LEN];
+    const int response_len =
+        snprintf(response,
+                 sizeof(response),
+                 "HTTP/1.1 %d Status\r\n"
+                 "Content-Type: application/x-protobuf\r\n"
+                 "Content-Length: 0\r\n"
+                 "%s\r\n",
+                 status_code,
+                 close_connection ? "Connection: close\r\n" : "");
+    TEST_ASSERT_LESS_THAN(sizeof(response), response_len);
+    TEST_ASSERT_EQUAL(response_len,
+                      write(collector->client_fd, response, response_len));
+    /* Stop parsing, the connection is closed without reading pipelined
+     * requests. */
+    return close_connection ? 1 : 0;
+}
+
+static inline void mock_collector_serve_connection(mock_collector* collector)
+{
+    http_parser parser;
+    http_parser_init(&parser, HTTP_REQUEST);
+    parser.data = collector;
+    http_parser_settings settings;
+    memset(&settings, 0, sizeof(settings));
+    settings.on_body = &mock_collector_on_body;
+    settings.on_message_complete = &mock_collector_on_message_complete;
+    collector->num_connection_requests = 0;
+    jaeger_vector_clear(&collector->body);
+
+    char buffer[MOCK_COLLECTOR_READ_BUFFER_SIZE];
+    int num_read;
+    while ((num_read = read(collector->client_fd, buffer, sizeof(buffer))) >
+           0) {
+        const int num_parsed =
+            http_parser_execute(&parser, &settings, buffer, num_read);
+        if (HTTP_PARSER_ERRNO(&parser) == HPE_CB_message_complete) {
+            break;
+        }
+        TEST_ASSERT_EQUAL(HPE_OK, HTTP_PARSER_ERRNO(&parser));
+        TEST_ASSERT_EQUAL(num_read, num_parsed);
+    }
+}
+
+static inline void* mock_collector_run_loop(void* context)
+{
+    TEST_ASSERT_NOT_NULL(context);
+    mock_collector* collector = (mock_collector*) context;
+
+    jaeger_mutex_lock(&collector->mutex);
+    collector->running = true;
+    jaeger_mutex_unlock(&collector->mutex);
+    jaeger_cond_signal(&collector->cv);
+
+    while (true) {
+        const int client_fd = accept(collector->server_fd, NULL, 0);
+        if (client_fd < 0) {
+            break;
+        }
+        jaeger_mutex_lock(&collector->mutex);
+        if (!collector->running) {
+            jaeger_mutex_unlock(&collector->mutex);
+            close(client_fd);
+            break;
+        }
+        collector->client_fd = client_fd;
+        collector->num_connections++;
+        jaeger_mutex_unlock(&collector->mutex);
+
+        mock_collector_serve_connection(collector);
+
+        jaeger_mutex_lock(&collector->mutex);
+        close(collector->client_fd);
+        collector->client_fd = -1;
+        jaeger_mutex_unlock(&collector->mutex);
+    }
+    return NULL;
+}
+
+/**
+ * Start collector on an ephemeral port of the loopback interface.
+ * @param collector Collector to start, initialized with MOCK_COLLECTOR_INIT.
+ */
+static inline void mock_collector_start(mock_collector* collector)
+{
+    TEST_ASSERT_NOT_NULL(collector);
+    TEST_ASSERT_TRUE(jaeger_vector_init(&collector->body, sizeof(char)));
+
+    collector->server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, collector->server_fd);
+    collector->addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    collector->addr.sin_family = AF_INET;
+    collector->addr.sin_port = 0;
+    TEST_ASSERT_EQUAL(0,
+                      bind(collector->server_fd,
+                           (struct sockaddr*) &collector->addr,
+                           sizeof(collector->addr)));
+    TEST_ASSERT_EQUAL(0,
+                      listen(collector->server_fd, MOCK_COLLECTOR_BACKLOG));
+    socklen_t addr_len = sizeof(collector->addr);
+    TEST_ASSERT_EQUAL(0,
+                      getsockname(collector->server_fd,
+                                  (struct sockaddr*) &collector->addr,
+                                  &addr_len));
+    TEST_ASSERT_EQUAL(sizeof(collector->addr), addr_len);
+
+    jaeger_mutex_lock(&collector->mutex);
+    TEST_ASSERT_EQUAL(0,
+                      jaeger_thread_init(&collector->thread,
+                                         &mock_collector_run_loop,
+                                         collector));
+    while (!collector->running) {
+        jaeger_cond_wait(&collector->cv, &collector->mutex);
+    }
+    jaeger_mutex_unlock(&collector->mutex);
+}
+
+/**
+ * Format collector endpoint URL.
+ * @param collector Started collector.
+ * @param buffer Output buffer.
+ * @param buffer_len Size of output buffer.
+ */
+static inline void mock_collector_format_url(const mock_collector* collector,
+                                             char* buffer,
+                                             size_t buffer_len)
+{
+    TEST_ASSERT_LESS_THAN(buffer_len,
+                          snprintf(buffer,
+                                   buffer_len,
+                                   "http://127.0.0.1:%d/api/v2/spans",
+                                   ntohs(collector->addr.sin_port)));
+}
+
+/**
+ * Wait until collector has received a number of requests.
+ * @param collector Started collector.
+ * @param num_requests Number of requests to wait for.
+ */
+static inline void mock_collector_wait_for_requests(mock_collector* collector,
+                                                    int num_requests)
+{
+    jaeger_mutex_lock(&collector->mutex);
+    while (collector->num_requests < num_requests) {
+        jaeger_cond_wait(&collector->cv, &collector->mutex);
+    }
+    jaeger_mutex_unlock(&collector->mutex);
+}
+
+static inline void mock_collector_destroy(mock_collector* collector)
+{
+    jaeger_mutex_lock(&collector->mutex);
+    collector->running = false;
+    if (collector->client_fd > -1) {
+        shutdown(collector->client_fd, SHUT_RDWR);
+    }
+    if (collector->server_fd > -1) {
+        shutdown(collector->server_fd, SHUT_RDWR);
+    }
+    jaeger_mutex_unlock(&collector->mutex);
+    if (collector->thread != 0) {
+        jaeger_thread_join(collector->thread, NULL);
+        collector->thread = 0;
+    }
+    if (collector->server_fd > -1) {
+        close(collector->server_fd);
+        collector->server_fd = -1;
+    }
+    jaeger_mutex_destroy(&collector->mutex);
+    jaeger_cond_destroy(&collector->cv);
+    memset(&collector->addr, 0, sizeof(collector->addr));
+    jaeger_vector_destroy(&collector->body);
+}
+
+#ifdef __cplusplus
+} /* extern C */
+#endif /* __cplusplus */
+
+#endif /* JAEGERTRACINGC_MOCK_COLLECTOR_H */
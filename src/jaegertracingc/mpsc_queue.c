@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2018 The Jaeger Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jaegertracingc/mpsc_queue.h"
+
+bool jaeger_mpsc_queue_init(jaeger_mpsc_queue* queue, size_t capacity)
+{
+    assert(queue != NULL);
+    assert(capacity > 0);
+    size_t rounded_capacity = 1;
+    while (rounded_capacity < capacity) {
+        rounded_capacity <<= 1;
+    }
+
+    queue->cells =
+        jaeger_malloc(sizeof(jaeger_mpsc_queue_cell) * rounded_capacity);
+    if (queue->cells == NULL) {
+        jaeger_log_error("Cannot allocate queue, capacity = %zu",
+                         rounded_capacity);
+        return false;
+    }
+    for (size_t i = 0; i < rounded_capacity; i++) {
+        queue->cells[i].sequence = 2 * i;
+        queue->cells[i].value = NULL;
+    }
+    queue->mask = rounded_capacity - 1;
+    queue->head = 0;
+    queue->tail = 0;
+#ifndef JAEGERTRACINGC_HAVE_ATOMICS
+    queue->mutex = (jaeger_mutex) JAEGERTRACINGC_MUTEX_INIT;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+    return true;
+}
+
+void jaeger_mpsc_queue_destroy(jaeger_mpsc_queue* queue)
+{
+    if (queue == NULL) {
+        return;
+    }
+    if (queue->cells != NULL) {
+        jaeger_free(queue->cells);
+        queue->cells = NULL;
+    }
+#ifndef JAEGERTRACINGC_HAVE_ATOMICS
+    jaeger_mutex_destroy(&queue->mutex);
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+
+bool jaeger_mpsc_queue_push(jaeger_mpsc_queue* queue, void* value)
+{
+    assert(queue != NULL);
+    size_t pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    jaeger_mpsc_queue_cell* cell;
+    while (true) {
+        cell = &queue->cells[pos & queue->mask];
+        const size_t sequence =
+            __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        const intptr_t diff = (intptr_t) sequence - (intptr_t)(2 * pos);
+        if (diff == 0) {
+            /* Slot is free, try to claim it. On failure, pos is updated to
+             * the current head. */
+            if (__atomic_compare_exchange_n(&queue->head,
+                                            &pos,
+                                            pos + 1,
+                                            true,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            /* Consumer has not released this slot yet, so queue is full. */
+            return false;
+        }
+        else {
+            /* Another producer claimed this slot first. */
+            pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+        }
+    }
+    cell->value = value;
+    __atomic_store_n(&cell->sequence, 2 * pos + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool jaeger_mpsc_queue_pop(jaeger_mpsc_queue* queue, void** value)
+{
+    assert(queue != NULL);
+    assert(value != NULL);
+    const size_t pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    jaeger_mpsc_queue_cell* cell = &queue->cells[pos & queue->mask];
+    const size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+    if ((intptr_t) sequence - (intptr_t)(2 * pos + 1) < 0) {
+        /* Empty, or producer has claimed the slot but not finished writing
+         * to it yet. */
+        return false;
+    }
+    *value = cell->value;
+    __atomic_store_n(
+        &cell->sequence, 2 * (pos + queue->mask + 1), __ATOMIC_RELEASE);
+    __atomic_store_n(&queue->tail, pos + 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+size_t jaeger_mpsc_queue_length(jaeger_mpsc_queue* queue)
+{
+    assert(queue != NULL);
+    const size_t tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    const size_t head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    /* Positions are read separately, so head may appear to lag tail. */
+    return (head > tail) ? head - tail : 0;
+}
+
+#else
+
+bool jaeger_mpsc_queue_push(jaeger_mpsc_queue* queue, void* value)
+{
+    assert(queue != NULL);
+    jaeger_mutex_lock(&queue->mutex);
+    const bool success = (queue->head - queue->tail <= queue->mask);
+    if (success) {
+        queue->cells[queue->head & queue->mask].value = value;
+        queue->head++;
+    }
+    jaeger_mutex_unlock(&queue->mutex);
+    return success;
+}
+
+bool jaeger_mpsc_queue_pop(jaeger_mpsc_queue* queue, void** value)
+{
+    assert(queue != NULL);
+    assert(value != NULL);
+    jaeger_mutex_lock(&queue->mutex);
+    const bool success = (queue->head != queue->tail);
+    if (success) {
+        *value = queue->cells[queue->tail & queue->mask].value;
+        queue->tail++;
+    }
+    jaeger_mutex_unlock(&queue->mutex);
+    return success;
+}
+
+size_t jaeger_mpsc_queue_length(jaeger_mpsc_queue* queue)
+{
+    assert(queue != NULL);
+    jaeger_mutex_lock(&queue->mutex);
+    const size_t length = queue->head - queue->tail;
+    jaeger_mutex_unlock(&queue->mutex);
+    return length;
+}
+
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
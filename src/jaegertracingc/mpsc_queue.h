@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2018 The Jaeger Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file
+ * Bounded multi-producer, single-consumer queue of pointers. Lock-free if
+ * JAEGERTRACINGC_HAVE_ATOMICS is defined, otherwise falls back to a mutex.
+ */
+
+#ifndef JAEGERTRACINGC_MPSC_QUEUE_H
+#define JAEGERTRACINGC_MPSC_QUEUE_H
+
+#include "jaegertracingc/common.h"
+#include "jaegertracingc/threading.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#define JAEGERTRACINGC_CACHE_LINE_SIZE 64
+
+/**
+ * Slot in the queue's ring buffer. The sequence number tells producers and
+ * the consumer whether the slot is ready for them, based on the algorithm in
+ * http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue.
+ * Sequence numbers advance by two per position so a filled slot cannot be
+ * mistaken for a free one when the capacity is one.
+ */
+typedef struct jaeger_mpsc_queue_cell {
+    size_t sequence;
+    void* value;
+} jaeger_mpsc_queue_cell;
+
+typedef struct jaeger_mpsc_queue {
+    jaeger_mpsc_queue_cell* cells;
+    /** Capacity minus one, capacity is always a power of two. */
+    size_t mask;
+    /** Next position producers write to. */
+    size_t head;
+    /* Keep producer and consumer positions on separate cache lines. */
+    char padding[JAEGERTRACINGC_CACHE_LINE_SIZE - sizeof(size_t)];
+    /** Next position consumer reads from. */
+    size_t tail;
+#ifndef JAEGERTRACINGC_HAVE_ATOMICS
+    jaeger_mutex mutex;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+} jaeger_mpsc_queue;
+
+/**
+ * Initialize a new queue.
+ * @param queue Queue to initialize.
+ * @param capacity Minimum number of elements the queue can hold, rounded up
+ *                 to the next power of two. Must be positive.
+ * @return True on success, false otherwise.
+ */
+bool jaeger_mpsc_queue_init(jaeger_mpsc_queue* queue, size_t capacity);
+
+/**
+ * Free resources associated with queue. Does not free elements left in the
+ * queue, caller must pop them first if needed.
+ * @param queue Queue to destroy.
+ */
+void jaeger_mpsc_queue_destroy(jaeger_mpsc_queue* queue);
+
+/**
+ * Push a new element. Safe to call from multiple threads concurrently.
+ * @param queue Queue instance.
+ * @param value Value to push.
+ * @return True on success, false if the queue is full.
+ */
+bool jaeger_mpsc_queue_push(jaeger_mpsc_queue* queue, void* value);
+
+/**
+ * Pop the oldest element. Must only be called by one thread at a time.
+ * @param queue Queue instance.
+ * @param value Output argument for popped value.
+ * @return True on success, false if the queue is empty.
+ */
+bool jaeger_mpsc_queue_pop(jaeger_mpsc_queue* queue, void** value);
+
+/**
+ * Approximate number of elements in the queue. Exact only when no other
+ * thread is accessing the queue.
+ * @param queue Queue instance.
+ * @return Number of elements in the queue.
+ */
+size_t jaeger_mpsc_queue_length(jaeger_mpsc_queue* queue);
+
+static inline size_t jaeger_mpsc_queue_capacity(const jaeger_mpsc_queue* queue)
+{
+    assert(queue != NULL);
+    return queue->mask + 1;
+}
+
+#ifdef __cplusplus
+} /* extern C */
+#endif /* __cplusplus */
+
+#endif /* JAEGERTRACINGC_MPSC_QUEUE_H */
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2018 The Jaeger Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jaegertracingc/mpsc_queue.h"
+#include "jaegertracingc/threading.h"
+#include "unity.h"
+
+#define NUM_PRODUCERS 4
+#define NUM_ELEMENTS_PER_PRODUCER 10000
+
+typedef struct producer_arg {
+    jaeger_mpsc_queue* queue;
+    uintptr_t first_value;
+} producer_arg;
+
+static void* push_values(void* arg)
+{
+    TEST_ASSERT_NOT_NULL(arg);
+    producer_arg* producer = (producer_arg*) arg;
+    for (uintptr_t i = 0; i < NUM_ELEMENTS_PER_PRODUCER; i++) {
+        while (!jaeger_mpsc_queue_push(producer->queue,
+                                       (void*) (producer->first_value + i))) {
+            jaeger_yield();
+        }
+    }
+    return NULL;
+}
+
+void test_mpsc_queue()
+{
+    jaeger_mpsc_queue queue;
+    jaeger_set_allocator(jaeger_null_allocator());
+    TEST_ASSERT_FALSE(jaeger_mpsc_queue_init(&queue, 1));
+    jaeger_set_allocator(jaeger_built_in_allocator());
+
+    TEST_ASSERT_TRUE(jaeger_mpsc_queue_init(&queue, 3));
+    TEST_ASSERT_EQUAL(4, jaeger_mpsc_queue_capacity(&queue));
+    void* value = NULL;
+    TEST_ASSERT_FALSE(jaeger_mpsc_queue_pop(&queue, &value));
+
+    /* Wrap around the ring buffer a few times. */
+    for (uintptr_t round = 0; round < 3; round++) {
+        for (uintptr_t i = 1; i <= 4; i++) {
+            TEST_ASSERT_TRUE(jaeger_mpsc_queue_push(&queue, (void*) i));
+        }
+        TEST_ASSERT_FALSE(jaeger_mpsc_queue_push(&queue, (void*) 5));
+        TEST_ASSERT_EQUAL(4, jaeger_mpsc_queue_length(&queue));
+        for (uintptr_t i = 1; i <= 4; i++) {
+            TEST_ASSERT_TRUE(jaeger_mpsc_queue_pop(&queue, &value));
+            TEST_ASSERT_EQUAL(i, (uintptr_t) value);
+        }
+        TEST_ASSERT_FALSE(jaeger_mpsc_queue_pop(&queue, &value));
+        TEST_ASSERT_EQUAL(0, jaeger_mpsc_queue_length(&queue));
+    }
+    jaeger_mpsc_queue_destroy(&queue);
+
+    /* Single slot must not accept a second element before it is popped. */
+    TEST_ASSERT_TRUE(jaeger_mpsc_queue_init(&queue, 1));
+    TEST_ASSERT_EQUAL(1, jaeger_mpsc_queue_capacity(&queue));
+    for (uintptr_t i = 1; i <= 3; i++) {
+        TEST_ASSERT_TRUE(jaeger_mpsc_queue_push(&queue, (void*) i));
+        TEST_ASSERT_FALSE(jaeger_mpsc_queue_push(&queue, (void*) i));
+        TEST_ASSERT_TRUE(jaeger_mpsc_queue_pop(&queue, &value));
+        TEST_ASSERT_EQUAL(i, (uintptr_t) value);
+        TEST_ASSERT_FALSE(jaeger_mpsc_queue_pop(&queue, &value));
+    }
+    jaeger_mpsc_queue_destroy(&queue);
+
+#ifdef JAEGERTRACINGC_MT
+    TEST_ASSERT_TRUE(jaeger_mpsc_queue_init(&queue, 64));
+    jaeger_thread threads[NUM_PRODUCERS];
+    producer_arg args[NUM_PRODUCERS];
+    for (int i = 0; i < NUM_PRODUCERS; i++) {
+        args[i] = (producer_arg){.queue = &queue,
+                                 .first_value =
+                                     i * NUM_ELEMENTS_PER_PRODUCER + 1};
+        TEST_ASSERT_EQUAL(
+            0, jaeger_thread_init(&threads[i], &push_values, &args[i]));
+    }
+
+    /* Each producer's values must arrive in the order they were pushed. */
+    uintptr_t next_expected[NUM_PRODUCERS];
+    for (int i = 0; i < NUM_PRODUCERS; i++) {
+        next_expected[i] = args[i].first_value;
+    }
+    for (int num_popped = 0;
+         num_popped < NUM_PRODUCERS * NUM_ELEMENTS_PER_PRODUCER;) {
+        if (!jaeger_mpsc_queue_pop(&queue, &value)) {
+            jaeger_yield();
+            continue;
+        }
+        const uintptr_t x = (uintptr_t) value;
+        const int producer = (x - 1) / NUM_ELEMENTS_PER_PRODUCER;
+        TEST_ASSERT_LESS_THAN(NUM_PRODUCERS, producer);
+        TEST_ASSERT_EQUAL(next_expected[producer], x);
+        next_expected[producer]++;
+        num_popped++;
+    }
+    for (int i = 0; i < NUM_PRODUCERS; i++) {
+        jaeger_thread_join(threads[i], NULL);
+    }
+    TEST_ASSERT_FALSE(jaeger_mpsc_queue_pop(&queue, &value));
+    jaeger_mpsc_queue_destroy(&queue);
+#endif /* JAEGERTRACINGC_MT */
+}
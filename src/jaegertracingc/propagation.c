@@ -86,7 +86,12 @@ extract_text_map_callback(void* arg, const char* key, const char* value)
     else if (strcmp(key_buffer, config->baggage_header) == 0) {
         value_buffer = jaeger_malloc(strlen(value) + 1);
         decode_value(value_buffer, value);
-        error_code = parse_comma_separated_map(&ctx->baggage, value_buffer);
+        jaeger_hashtable* baggage = jaeger_span_context_mutable_baggage(ctx);
+        if (baggage == NULL) {
+            error_code = opentracing_propagation_error_code_unknown;
+            goto cleanup;
+        }
+        error_code = parse_comma_separated_map(baggage, value_buffer);
         if (error_code != opentracing_propagation_error_code_success) {
             goto cleanup;
         }
@@ -112,7 +117,8 @@ extract_text_map_callback(void* arg, const char* key, const char* value)
             }
             decode_value(value_buffer, value);
 
-            if (!jaeger_hashtable_put(&ctx->baggage, suffix, value_buffer)) {
+            if (!jaeger_span_context_set_baggage_item(
+                    ctx, suffix, value_buffer)) {
                 error_code = opentracing_propagation_error_code_unknown;
                 goto cleanup;
             }
@@ -142,7 +148,8 @@ extract_from_text_map_helper(opentracing_text_map_reader* reader,
         goto cleanup;
     }
     if (arg->ctx->trace_id.high == 0 && arg->ctx->trace_id.low == 0 &&
-        arg->ctx->debug_id == NULL && arg->ctx->baggage.size == 0) {
+        arg->ctx->debug_id == NULL &&
+        jaeger_span_context_baggage(arg->ctx)->size == 0) {
         /* Successfully decoded an empty span context. */
         error_code = opentracing_propagation_error_code_success;
         goto cleanup;
@@ -234,7 +241,7 @@ static inline bool read_binary(int (*callback)(void*, char*, size_t),
 }
 
 static opentracing_propagation_error_code parse_baggage_binary(
-    int (*callback)(void*, char*, size_t), void* arg, jaeger_hashtable* baggage)
+    int (*callback)(void*, char*, size_t), void* arg, jaeger_span_context* ctx)
 {
 #define READ_BINARY(x)                                                     \
     do {                                                                   \
@@ -280,7 +287,8 @@ static opentracing_propagation_error_code parse_baggage_binary(
             goto cleanup;
         }
         READ_BUFFER(value_buffer, value_len);
-        if (!jaeger_hashtable_put(baggage, key_buffer, value_buffer)) {
+        if (!jaeger_span_context_set_baggage_item(
+                ctx, key_buffer, value_buffer)) {
             error_code = opentracing_propagation_error_code_unknown;
             goto cleanup;
         }
@@ -334,7 +342,7 @@ jaeger_extract_from_binary(int (*callback)(void*, char*, size_t),
 
 #undef READ_BINARY
 
-    error_code = parse_baggage_binary(callback, arg, &(*ctx)->baggage);
+    error_code = parse_baggage_binary(callback, arg, *ctx);
     if (error_code != opentracing_propagation_error_code_success) {
         goto cleanup;
     }
@@ -390,10 +398,11 @@ static inline opentracing_propagation_error_code inject_text_map_helper(
         writer->set(writer, config->trace_context_header, trace_context_buffer);
     /* Loop will not execute if error_code is not
      * opentracing_propagation_error_code_success. */
-    for (size_t i = 0; i < ((size_t) 1 << ctx->baggage.order) &&
+    const jaeger_hashtable* baggage = jaeger_span_context_baggage(ctx);
+    for (size_t i = 0; i < jaeger_hashtable_bucket_count(baggage) &&
                        error_code == opentracing_propagation_error_code_success;
          i++) {
-        for (const jaeger_list_node* node = ctx->baggage.buckets[i].head;
+        for (const jaeger_list_node* node = baggage->buckets[i].head;
              node != NULL;
              node = node->next) {
             const jaeger_key_value* kv =
@@ -481,11 +490,13 @@ jaeger_inject_into_binary(int (*callback)(void*, const char*, size_t),
         return opentracing_propagation_error_code_unknown;
     }
 
-    const uint32_t num_baggage_items = ctx->baggage.size;
+    const jaeger_hashtable* baggage = jaeger_span_context_baggage(ctx);
+    const uint32_t num_baggage_items = baggage->size;
     WRITE_BINARY(num_baggage_items, 32);
     uint32_t size = 0;
-    for (size_t i = 0, len = (1u << ctx->baggage.order); i < len; i++) {
-        for (const jaeger_list_node* node = ctx->baggage.buckets[i].head;
+    for (size_t i = 0, len = jaeger_hashtable_bucket_count(baggage); i < len;
+         i++) {
+        for (const jaeger_list_node* node = baggage->buckets[i].head;
              node != NULL;
              node = node->next) {
             size++;
@@ -503,7 +514,7 @@ jaeger_inject_into_binary(int (*callback)(void*, const char*, size_t),
             }
         }
     }
-    assert(ctx->baggage.size == size);
+    assert(baggage->size == size);
 
     return opentracing_propagation_error_code_success;
 
@@ -131,6 +131,13 @@ static inline void test_to_lowercase()
     }
 }
 
+static inline const jaeger_key_value*
+find_baggage_item(const jaeger_span_context* ctx, const char* key)
+{
+    return jaeger_hashtable_find(
+        (jaeger_hashtable*) jaeger_span_context_baggage(ctx), key);
+}
+
 static inline void set_up_standard_key_values(jaeger_vector* key_values)
 {
     JAEGERTRACINGC_VECTOR_FOR_EACH(
@@ -257,12 +264,12 @@ static inline void test_text_map()
     TEST_ASSERT_EQUAL(0xab, ctx->trace_id.low);
     TEST_ASSERT_EQUAL(0xcd, ctx->span_id);
     TEST_ASSERT_EQUAL(0, ctx->flags);
-    TEST_ASSERT_EQUAL(2, ctx->baggage.size);
-    const jaeger_key_value* kv = jaeger_hashtable_find(&ctx->baggage, "k1");
+    TEST_ASSERT_EQUAL(2, jaeger_span_context_baggage(ctx)->size);
+    const jaeger_key_value* kv = find_baggage_item(ctx, "k1");
     TEST_ASSERT_NOT_NULL(kv);
     TEST_ASSERT_EQUAL_STRING("k1", kv->key);
     TEST_ASSERT_EQUAL_STRING("v1", kv->value);
-    kv = jaeger_hashtable_find(&ctx->baggage, "k2");
+    kv = find_baggage_item(ctx, "k2");
     TEST_ASSERT_NOT_NULL(kv);
     TEST_ASSERT_EQUAL_STRING("k2", kv->key);
     TEST_ASSERT_EQUAL_STRING("v2", kv->value);
@@ -275,9 +282,9 @@ static inline void test_text_map()
     ctx->trace_id.low = 0xab;
     ctx->span_id = 0xcd;
     ctx->flags = jaeger_sampling_flag_sampled;
-    jaeger_hashtable_clear(&ctx->baggage);
-    TEST_ASSERT_TRUE(jaeger_hashtable_put(&ctx->baggage, "k1", "v1"));
-    TEST_ASSERT_EQUAL(1, ctx->baggage.size);
+    jaeger_hashtable_clear(jaeger_span_context_mutable_baggage(ctx));
+    TEST_ASSERT_TRUE(jaeger_span_context_set_baggage_item(ctx, "k1", "v1"));
+    TEST_ASSERT_EQUAL(1, jaeger_span_context_baggage(ctx)->size);
     mock_text_map_writer writer = {.base = {.set = &mock_writer_set},
                                    .key_values = &key_values};
     const jaeger_headers_config config = JAEGERTRACINGC_HEADERS_CONFIG_INIT;
@@ -296,11 +303,11 @@ static inline void test_text_map()
     TEST_ASSERT_EQUAL(ctx->trace_id.low, ctx_copy->trace_id.low);
     TEST_ASSERT_EQUAL(ctx->span_id, ctx_copy->span_id);
     TEST_ASSERT_EQUAL(ctx->flags, ctx_copy->flags);
-    TEST_ASSERT_EQUAL(ctx->baggage.size, ctx_copy->baggage.size);
-    kv = jaeger_hashtable_find(&ctx->baggage, "k1");
+    TEST_ASSERT_EQUAL(jaeger_span_context_baggage(ctx)->size,
+                      jaeger_span_context_baggage(ctx_copy)->size);
+    kv = find_baggage_item(ctx, "k1");
     TEST_ASSERT_NOT_NULL(kv);
-    const jaeger_key_value* kv_copy =
-        jaeger_hashtable_find(&ctx_copy->baggage, "k1");
+    const jaeger_key_value* kv_copy = find_baggage_item(ctx_copy, "k1");
     TEST_ASSERT_NOT_NULL(kv_copy);
     TEST_ASSERT_EQUAL_STRING(kv->value, kv_copy->value);
 
@@ -338,12 +345,12 @@ static inline void test_http_headers()
     TEST_ASSERT_EQUAL(0xab, ctx->trace_id.low);
     TEST_ASSERT_EQUAL(0xcd, ctx->span_id);
     TEST_ASSERT_EQUAL(0, ctx->flags);
-    TEST_ASSERT_EQUAL(2, ctx->baggage.size);
-    const jaeger_key_value* kv = jaeger_hashtable_find(&ctx->baggage, "k1");
+    TEST_ASSERT_EQUAL(2, jaeger_span_context_baggage(ctx)->size);
+    const jaeger_key_value* kv = find_baggage_item(ctx, "k1");
     TEST_ASSERT_NOT_NULL(kv);
     TEST_ASSERT_EQUAL_STRING("k1", kv->key);
     TEST_ASSERT_EQUAL_STRING("v1", kv->value);
-    kv = jaeger_hashtable_find(&ctx->baggage, "k2");
+    kv = find_baggage_item(ctx, "k2");
     TEST_ASSERT_NOT_NULL(kv);
     TEST_ASSERT_EQUAL_STRING("k2", kv->key);
     TEST_ASSERT_EQUAL_STRING("v2", kv->value);
@@ -362,12 +369,12 @@ static inline void test_http_headers()
     TEST_ASSERT_EQUAL(0xab, ctx->trace_id.low);
     TEST_ASSERT_EQUAL(0xcd, ctx->span_id);
     TEST_ASSERT_EQUAL(0, ctx->flags);
-    TEST_ASSERT_EQUAL(2, ctx->baggage.size);
-    kv = jaeger_hashtable_find(&ctx->baggage, "k3");
+    TEST_ASSERT_EQUAL(2, jaeger_span_context_baggage(ctx)->size);
+    kv = find_baggage_item(ctx, "k3");
     TEST_ASSERT_NOT_NULL(kv);
     TEST_ASSERT_EQUAL_STRING("k3", kv->key);
     TEST_ASSERT_EQUAL_STRING("value3", kv->value);
-    kv = jaeger_hashtable_find(&ctx->baggage, "key-4");
+    kv = find_baggage_item(ctx, "key-4");
     TEST_ASSERT_NOT_NULL(kv);
     TEST_ASSERT_EQUAL_STRING("key-4", kv->key);
     TEST_ASSERT_EQUAL_STRING("value-x", kv->value);
@@ -470,7 +477,8 @@ static inline void test_binary()
         random_string(key, sizeof(key));
         char value[rand() % max_baggage_str_len + 1];
         random_string(value, sizeof(value));
-        TEST_ASSERT_TRUE(jaeger_hashtable_put(&ctx.baggage, key, value));
+        TEST_ASSERT_TRUE(
+            jaeger_span_context_set_baggage_item(&ctx, key, value));
     }
 
     jaeger_vector binary_buffer;
@@ -486,7 +494,8 @@ static inline void test_binary()
     TEST_ASSERT_EQUAL(ctx.trace_id.high, ctx_copy->trace_id.high);
     TEST_ASSERT_EQUAL(ctx.trace_id.low, ctx_copy->trace_id.low);
     TEST_ASSERT_EQUAL(ctx.span_id, ctx_copy->span_id);
-    TEST_ASSERT_EQUAL(ctx.baggage.size, ctx_copy->baggage.size);
+    TEST_ASSERT_EQUAL(jaeger_span_context_baggage(&ctx)->size,
+                      jaeger_span_context_baggage(ctx_copy)->size);
 
     jaeger_span_context_destroy((jaeger_destructible*) &ctx);
     jaeger_span_context_destroy((jaeger_destructible*) ctx_copy);
@@ -0,0 +1,438 @@
+/*
+ * Copyright (c) 2018 The Jaeger Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jaegertracingc/protobuf.h"
+
+enum {
+    wire_type_varint = 0,
+    wire_type_fixed64 = 1,
+    wire_type_length_delimited = 2
+};
+
+/* Field numbers from model.proto. */
+enum {
+    key_value_key_field = 1,
+    key_value_v_type_field = 2,
+    key_value_v_str_field = 3,
+    key_value_v_bool_field = 4,
+    key_value_v_int64_field = 5,
+    key_value_v_float64_field = 6,
+    key_value_v_binary_field = 7
+};
+
+enum { log_timestamp_field = 1, log_fields_field = 2 };
+
+enum { timestamp_seconds_field = 1, timestamp_nanos_field = 2 };
+
+enum {
+    span_ref_trace_id_field = 1,
+    span_ref_span_id_field = 2,
+    span_ref_ref_type_field = 3
+};
+
+enum {
+    span_trace_id_field = 1,
+    span_span_id_field = 2,
+    span_operation_name_field = 3,
+    span_references_field = 4,
+    span_flags_field = 5,
+    span_start_time_field = 6,
+    span_duration_field = 7,
+    span_tags_field = 8,
+    span_logs_field = 9
+};
+
+#define TRACE_ID_SIZE (sizeof(uint64_t) * 2)
+#define SPAN_ID_SIZE sizeof(uint64_t)
+
+/* Every field number in jaeger.model is less than 16, so field tags always
+ * fit in a single byte. */
+#define FIELD_TAG_SIZE 1
+
+size_t jaeger_protobuf_varint_size(uint64_t value)
+{
+    size_t size = 1;
+    for (; value >= 0x80; value >>= 7) {
+        size++;
+    }
+    return size;
+}
+
+size_t jaeger_protobuf_message_field_size(size_t message_size)
+{
+    return FIELD_TAG_SIZE + jaeger_protobuf_varint_size(message_size) +
+           message_size;
+}
+
+static inline uint8_t* write_varint(uint8_t* out, uint64_t value)
+{
+    for (; value >= 0x80; value >>= 7) {
+        *out++ = (uint8_t)(value | 0x80);
+    }
+    *out++ = (uint8_t) value;
+    return out;
+}
+
+static inline uint8_t* write_field_tag(uint8_t* out, int field, int wire_type)
+{
+    assert(field > 0 && field < 16);
+    *out++ = (uint8_t)((field << 3) | wire_type);
+    return out;
+}
+
+static inline size_t varint_field_size(uint64_t value)
+{
+    return FIELD_TAG_SIZE + jaeger_protobuf_varint_size(value);
+}
+
+static inline uint8_t*
+write_varint_field(uint8_t* out, int field, uint64_t value)
+{
+    out = write_field_tag(out, field, wire_type_varint);
+    return write_varint(out, value);
+}
+
+static inline uint8_t* write_length_delimited_field(uint8_t* out,
+                                                    int field,
+                                                    const void* data,
+                                                    size_t len)
+{
+    out = write_field_tag(out, field, wire_type_length_delimited);
+    out = write_varint(out, len);
+    if (len > 0) {
+        memcpy(out, data, len);
+    }
+    return out + len;
+}
+
+static inline uint8_t*
+write_message_field_header(uint8_t* out, int field, size_t message_size)
+{
+    out = write_field_tag(out, field, wire_type_length_delimited);
+    return write_varint(out, message_size);
+}
+
+size_t jaeger_protobuf_pack_message_field_header(int field_number,
+                                                 size_t message_size,
+                                                 uint8_t* out)
+{
+    assert(out != NULL);
+    return write_message_field_header(out, field_number, message_size) - out;
+}
+
+void jaeger_protobuf_pack_padding_header(size_t padding_size, uint8_t* out)
+{
+    assert(out != NULL);
+    assert(padding_size >= JAEGERTRACINGC_PROTOBUF_PADDING_HEADER_SIZE);
+    const size_t len =
+        padding_size - JAEGERTRACINGC_PROTOBUF_PADDING_HEADER_SIZE;
+    assert(len < (1u << 21));
+    out = write_field_tag(
+        out, JAEGERTRACINGC_PROTOBUF_PADDING_FIELD, wire_type_length_delimited);
+    /* Decoders accept varints with redundant continuation bytes. */
+    out[0] = (uint8_t)(len | 0x80);
+    out[1] = (uint8_t)((len >> 7) | 0x80);
+    out[2] = (uint8_t)((len >> 14) & 0x7f);
+}
+
+/* Protobuf int32 and int64 fields encode negative values as ten byte
+ * varints of the sign-extended value. */
+static inline uint64_t signed_varint_value(int64_t value)
+{
+    return (uint64_t) value;
+}
+
+/* google.protobuf.Timestamp and google.protobuf.Duration share a layout. */
+static inline size_t
+time_value_packed_size(const opentracing_time_value* value)
+{
+    size_t size = 0;
+    if (value->tv_sec != 0) {
+        size += varint_field_size(signed_varint_value(value->tv_sec));
+    }
+    if (value->tv_nsec != 0) {
+        size += varint_field_size(signed_varint_value(value->tv_nsec));
+    }
+    return size;
+}
+
+static inline uint8_t* write_time_value_field(
+    uint8_t* out, int field, const opentracing_time_value* value)
+{
+    out =
+        write_message_field_header(out, field, time_value_packed_size(value));
+    if (value->tv_sec != 0) {
+        out = write_varint_field(
+            out, timestamp_seconds_field, signed_varint_value(value->tv_sec));
+    }
+    if (value->tv_nsec != 0) {
+        out = write_varint_field(
+            out, timestamp_nanos_field, signed_varint_value(value->tv_nsec));
+    }
+    return out;
+}
+
+/* Same byte order as jaeger_trace_id_to_protobuf. */
+static inline uint8_t* write_trace_id_field(uint8_t* out,
+                                            int field,
+                                            const jaeger_trace_id* trace_id)
+{
+    out = write_field_tag(out, field, wire_type_length_delimited);
+    out = write_varint(out, TRACE_ID_SIZE);
+    memcpy(out, &trace_id->high, sizeof(trace_id->high));
+    memcpy(out + sizeof(trace_id->high), &trace_id->low, sizeof(trace_id->low));
+    return out + TRACE_ID_SIZE;
+}
+
+static inline Jaeger__Model__SpanRefType
+span_ref_type_to_protobuf(jaeger_span_ref_type type)
+{
+    return (type == opentracing_span_reference_follows_from)
+               ? JAEGER__MODEL__SPAN_REF_TYPE__FOLLOWS_FROM
+               : JAEGER__MODEL__SPAN_REF_TYPE__CHILD_OF;
+}
+
+static inline bool has_string(const char* str)
+{
+    return str != NULL && str[0] != '\0';
+}
+
+size_t jaeger_tag_protobuf_packed_size(const jaeger_tag* tag)
+{
+    assert(tag != NULL);
+    size_t size = 0;
+    if (has_string(tag->key)) {
+        size += jaeger_protobuf_message_field_size(strlen(tag->key));
+    }
+    if (tag->v_type != JAEGER__MODEL__VALUE_TYPE__STRING) {
+        size += varint_field_size(tag->v_type);
+    }
+    if (has_string(tag->v_str)) {
+        size += jaeger_protobuf_message_field_size(strlen(tag->v_str));
+    }
+    if (tag->v_bool) {
+        size += varint_field_size(1);
+    }
+    if (tag->v_int64 != 0) {
+        size += varint_field_size(signed_varint_value(tag->v_int64));
+    }
+    if (tag->v_float64 != 0) {
+        size += FIELD_TAG_SIZE + sizeof(uint64_t);
+    }
+    if (tag->v_binary.len > 0) {
+        size += jaeger_protobuf_message_field_size(tag->v_binary.len);
+    }
+    return size;
+}
+
+size_t jaeger_tag_protobuf_pack(const jaeger_tag* tag, uint8_t* out)
+{
+    assert(tag != NULL);
+    assert(out != NULL);
+    uint8_t* const start = out;
+    if (has_string(tag->key)) {
+        out = write_length_delimited_field(
+            out, key_value_key_field, tag->key, strlen(tag->key));
+    }
+    if (tag->v_type != JAEGER__MODEL__VALUE_TYPE__STRING) {
+        out = write_varint_field(out, key_value_v_type_field, tag->v_type);
+    }
+    if (has_string(tag->v_str)) {
+        out = write_length_delimited_field(
+            out, key_value_v_str_field, tag->v_str, strlen(tag->v_str));
+    }
+    if (tag->v_bool) {
+        out = write_varint_field(out, key_value_v_bool_field, 1);
+    }
+    if (tag->v_int64 != 0) {
+        out = write_varint_field(
+            out, key_value_v_int64_field, signed_varint_value(tag->v_int64));
+    }
+    if (tag->v_float64 != 0) {
+        /* Doubles are always little-endian on the wire. */
+        uint64_t bits;
+        memcpy(&bits, &tag->v_float64, sizeof(bits));
+        out = write_field_tag(
+            out, key_value_v_float64_field, wire_type_fixed64);
+        for (int i = 0; i < (int) sizeof(bits); i++) {
+            *out++ = (uint8_t)(bits >> (i * 8));
+        }
+    }
+    if (tag->v_binary.len > 0) {
+        out = write_length_delimited_field(out,
+                                           key_value_v_binary_field,
+                                           tag->v_binary.data,
+                                           tag->v_binary.len);
+    }
+    return out - start;
+}
+
+size_t jaeger_log_record_protobuf_packed_size(
+    const jaeger_log_record* log_record)
+{
+    assert(log_record != NULL);
+    size_t size = jaeger_protobuf_message_field_size(
+        time_value_packed_size(&log_record->timestamp.value));
+    for (int i = 0, len = jaeger_vector_length(&log_record->fields); i < len;
+         i++) {
+        const jaeger_tag* field =
+            jaeger_vector_offset((jaeger_vector*) &log_record->fields, i);
+        size += jaeger_protobuf_message_field_size(
+            jaeger_tag_protobuf_packed_size(field));
+    }
+    return size;
+}
+
+size_t jaeger_log_record_protobuf_pack(const jaeger_log_record* log_record,
+                                       uint8_t* out)
+{
+    assert(log_record != NULL);
+    assert(out != NULL);
+    uint8_t* const start = out;
+    out = write_time_value_field(
+        out, log_timestamp_field, &log_record->timestamp.value);
+    for (int i = 0, len = jaeger_vector_length(&log_record->fields); i < len;
+         i++) {
+        const jaeger_tag* field =
+            jaeger_vector_offset((jaeger_vector*) &log_record->fields, i);
+        out = write_message_field_header(
+            out, log_fields_field, jaeger_tag_protobuf_packed_size(field));
+        out += jaeger_tag_protobuf_pack(field, out);
+    }
+    return out - start;
+}
+
+size_t jaeger_span_ref_protobuf_packed_size(const jaeger_span_ref* span_ref)
+{
+    assert(span_ref != NULL);
+    size_t size = jaeger_protobuf_message_field_size(TRACE_ID_SIZE) +
+                  jaeger_protobuf_message_field_size(SPAN_ID_SIZE);
+    const Jaeger__Model__SpanRefType type =
+        span_ref_type_to_protobuf(span_ref->type);
+    if (type != JAEGER__MODEL__SPAN_REF_TYPE__CHILD_OF) {
+        size += varint_field_size(type);
+    }
+    return size;
+}
+
+size_t jaeger_span_ref_protobuf_pack(const jaeger_span_ref* span_ref,
+                                     uint8_t* out)
+{
+    assert(span_ref != NULL);
+    assert(out != NULL);
+    uint8_t* const start = out;
+    /* Referenced context is copied when the span starts and never modified
+     * afterward, so no need to lock it here. */
+    out = write_trace_id_field(
+        out, span_ref_trace_id_field, &span_ref->context.trace_id);
+    out = write_length_delimited_field(out,
+                                       span_ref_span_id_field,
+                                       &span_ref->context.span_id,
+                                       SPAN_ID_SIZE);
+    const Jaeger__Model__SpanRefType type =
+        span_ref_type_to_protobuf(span_ref->type);
+    if (type != JAEGER__MODEL__SPAN_REF_TYPE__CHILD_OF) {
+        out = write_varint_field(out, span_ref_ref_type_field, type);
+    }
+    return out - start;
+}
+
+size_t jaeger_span_protobuf_packed_size(const jaeger_span* span)
+{
+    assert(span != NULL);
+    size_t size = jaeger_protobuf_message_field_size(TRACE_ID_SIZE) +
+                  jaeger_protobuf_message_field_size(SPAN_ID_SIZE);
+    if (has_string(span->operation_name)) {
+        size += jaeger_protobuf_message_field_size(
+            strlen(span->operation_name));
+    }
+    for (int i = 0, len = jaeger_vector_length(&span->refs); i < len; i++) {
+        const jaeger_span_ref* span_ref =
+            jaeger_vector_offset((jaeger_vector*) &span->refs, i);
+        size += jaeger_protobuf_message_field_size(
+            jaeger_span_ref_protobuf_packed_size(span_ref));
+    }
+    if (span->context.flags != 0) {
+        size += varint_field_size(span->context.flags);
+    }
+    size += jaeger_protobuf_message_field_size(
+        time_value_packed_size(&span->start_time_system.value));
+    size += jaeger_protobuf_message_field_size(
+        time_value_packed_size(&span->duration.value));
+    for (int i = 0, len = jaeger_vector_length(&span->tags); i < len; i++) {
+        const jaeger_tag* tag =
+            jaeger_vector_offset((jaeger_vector*) &span->tags, i);
+        size += jaeger_protobuf_message_field_size(
+            jaeger_tag_protobuf_packed_size(tag));
+    }
+    for (int i = 0, len = jaeger_vector_length(&span->logs); i < len; i++) {
+        const jaeger_log_record* log_record =
+            jaeger_vector_offset((jaeger_vector*) &span->logs, i);
+        size += jaeger_protobuf_message_field_size(
+            jaeger_log_record_protobuf_packed_size(log_record));
+    }
+    return size;
+}
+
+size_t jaeger_span_protobuf_pack(const jaeger_span* span, uint8_t* out)
+{
+    assert(span != NULL);
+    assert(out != NULL);
+    uint8_t* const start = out;
+    out = write_trace_id_field(
+        out, span_trace_id_field, &span->context.trace_id);
+    out = write_length_delimited_field(
+        out, span_span_id_field, &span->context.span_id, SPAN_ID_SIZE);
+    if (has_string(span->operation_name)) {
+        out = write_length_delimited_field(out,
+                                           span_operation_name_field,
+                                           span->operation_name,
+                                           strlen(span->operation_name));
+    }
+    for (int i = 0, len = jaeger_vector_length(&span->refs); i < len; i++) {
+        const jaeger_span_ref* span_ref =
+            jaeger_vector_offset((jaeger_vector*) &span->refs, i);
+        out = write_message_field_header(
+            out,
+            span_references_field,
+            jaeger_span_ref_protobuf_packed_size(span_ref));
+        out += jaeger_span_ref_protobuf_pack(span_ref, out);
+    }
+    if (span->context.flags != 0) {
+        out = write_varint_field(out, span_flags_field, span->context.flags);
+    }
+    out = write_time_value_field(
+        out, span_start_time_field, &span->start_time_system.value);
+    out = write_time_value_field(
+        out, span_duration_field, &span->duration.value);
+    for (int i = 0, len = jaeger_vector_length(&span->tags); i < len; i++) {
+        const jaeger_tag* tag =
+            jaeger_vector_offset((jaeger_vector*) &span->tags, i);
+        out = write_message_field_header(
+            out, span_tags_field, jaeger_tag_protobuf_packed_size(tag));
+        out += jaeger_tag_protobuf_pack(tag, out);
+    }
+    for (int i = 0, len = jaeger_vector_length(&span->logs); i < len; i++) {
+        const jaeger_log_record* log_record =
+            jaeger_vector_offset((jaeger_vector*) &span->logs, i);
+        out = write_message_field_header(
+            out,
+            span_logs_field,
+            jaeger_log_record_protobuf_packed_size(log_record));
+        out += jaeger_log_record_protobuf_pack(log_record, out);
+    }
+    return out - start;
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2018 The Jaeger Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file
+ * @internal
+ * Streaming encoder for the jaeger.model protobuf wire format. Writes spans
+ * directly into a caller-supplied buffer without building intermediate
+ * protobuf-c messages. Output is equivalent to packing the result of
+ * jaeger_span_to_protobuf, and can be decoded with the generated protobuf-c
+ * functions.
+ */
+
+#ifndef JAEGERTRACINGC_PROTOBUF_H
+#define JAEGERTRACINGC_PROTOBUF_H
+
+#include "jaegertracingc/common.h"
+#include "jaegertracingc/log_record.h"
+#include "jaegertracingc/span.h"
+#include "jaegertracingc/tag.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** Field number of jaeger.model.Batch.spans. */
+#define JAEGERTRACINGC_PROTOBUF_BATCH_SPANS_FIELD 1
+/** Field number of jaeger.model.Batch.process. */
+#define JAEGERTRACINGC_PROTOBUF_BATCH_PROCESS_FIELD 2
+/** Field number of jaeger.model.PostSpansRequest.batch. */
+#define JAEGERTRACINGC_PROTOBUF_POST_SPANS_REQUEST_BATCH_FIELD 1
+
+/**
+ * Field number not used by jaeger.model.Batch. Decoders skip unknown fields,
+ * so it can carry padding to grow a packet to a given size.
+ */
+#define JAEGERTRACINGC_PROTOBUF_PADDING_FIELD 15
+/** Size of the header written by jaeger_protobuf_pack_padding_header. */
+#define JAEGERTRACINGC_PROTOBUF_PADDING_HEADER_SIZE 4
+
+/**
+ * Number of bytes needed to encode a value as a varint.
+ * @param value Value to encode.
+ * @return Encoded size in bytes.
+ */
+size_t jaeger_protobuf_varint_size(uint64_t value);
+
+/**
+ * Number of bytes needed to embed a message as a field of another message,
+ * including field tag and length prefix. Assumes the field number is less
+ * than 16, which holds for every field in jaeger.model.
+ * @param message_size Size of the packed message.
+ * @return Encoded size of field in bytes.
+ */
+size_t jaeger_protobuf_message_field_size(size_t message_size);
+
+/**
+ * Write the field tag and length prefix of an embedded message field. The
+ * packed message must follow immediately after.
+ * @param field_number Field number, must be less than 16.
+ * @param message_size Size of the packed message.
+ * @param out Output buffer, must have room for
+ *            jaeger_protobuf_message_field_size(message_size) -
+ *            message_size bytes.
+ * @return Number of bytes written.
+ */
+size_t jaeger_protobuf_pack_message_field_header(int field_number,
+                                                 size_t message_size,
+                                                 uint8_t* out);
+
+/**
+ * Write the header of a padding field. The length prefix is always encoded
+ * with three bytes, so the header size does not depend on the padding size.
+ * @param padding_size Total size of the padding field including header. Must
+ *                     be at least JAEGERTRACINGC_PROTOBUF_PADDING_HEADER_SIZE
+ *                     and less than JAEGERTRACINGC_PROTOBUF_PADDING_HEADER_SIZE
+ *                     + 2^21.
+ * @param out Output buffer, must have room for
+ *            JAEGERTRACINGC_PROTOBUF_PADDING_HEADER_SIZE bytes. The header
+ *            must be followed by the remaining padding bytes, which may have
+ *            any value.
+ */
+void jaeger_protobuf_pack_padding_header(size_t padding_size, uint8_t* out);
+
+/**
+ * Size of tag encoded as jaeger.model.KeyValue.
+ * @param tag Tag to encode.
+ * @return Encoded size in bytes.
+ */
+size_t jaeger_tag_protobuf_packed_size(const jaeger_tag* tag);
+
+/**
+ * Encode tag as jaeger.model.KeyValue.
+ * @param tag Tag to encode.
+ * @param out Output buffer, must have room for
+ *            jaeger_tag_protobuf_packed_size(tag) bytes.
+ * @return Number of bytes written.
+ */
+size_t jaeger_tag_protobuf_pack(const jaeger_tag* tag, uint8_t* out);
+
+/**
+ * Size of log record encoded as jaeger.model.Log.
+ * @param log_record Log record to encode.
+ * @return Encoded size in bytes.
+ */
+size_t jaeger_log_record_protobuf_packed_size(
+    const jaeger_log_record* log_record);
+
+/**
+ * Encode log record as jaeger.model.Log.
+ * @param log_record Log record to encode.
+ * @param out Output buffer, must have room for
+ *            jaeger_log_record_protobuf_packed_size(log_record) bytes.
+ * @return Number of bytes written.
+ */
+size_t jaeger_log_record_protobuf_pack(const jaeger_log_record* log_record,
+                                       uint8_t* out);
+
+/**
+ * Size of span ref encoded as jaeger.model.SpanRef.
+ * @param span_ref Span ref to encode.
+ * @return Encoded size in bytes.
+ */
+size_t jaeger_span_ref_protobuf_packed_size(const jaeger_span_ref* span_ref);
+
+/**
+ * Encode span ref as jaeger.model.SpanRef.
+ * @param span_ref Span ref to encode.
+ * @param out Output buffer, must have room for
+ *            jaeger_span_ref_protobuf_packed_size(span_ref) bytes.
+ * @return Number of bytes written.
+ */
+size_t jaeger_span_ref_protobuf_pack(const jaeger_span_ref* span_ref,
+                                     uint8_t* out);
+
+/**
+ * Size of span encoded as jaeger.model.Span. Caller must hold span mutex and
+ * span context mutex, and must not modify the span between this call and
+ * jaeger_span_protobuf_pack.
+ * @param span Span to encode.
+ * @return Encoded size in bytes.
+ */
+size_t jaeger_span_protobuf_packed_size(const jaeger_span* span);
+
+/**
+ * Encode span as jaeger.model.Span. Caller must hold span mutex and span
+ * context mutex.
+ * @param span Span to encode.
+ * @param out Output buffer, must have room for
+ *            jaeger_span_protobuf_packed_size(span) bytes.
+ * @return Number of bytes written.
+ */
+size_t jaeger_span_protobuf_pack(const jaeger_span* span, uint8_t* out);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif /* __cplusplus */
+
+#endif /* JAEGERTRACINGC_PROTOBUF_H */
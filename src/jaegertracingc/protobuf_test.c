@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2018 The Jaeger Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jaegertracingc/protobuf.h"
+#include "jaegertracingc/span.h"
+#include "unity.h"
+
+static void build_span(jaeger_span* span)
+{
+    *span = (jaeger_span) JAEGERTRACINGC_SPAN_INIT;
+    TEST_ASSERT_TRUE(jaeger_span_init(span));
+    span->context.trace_id = (jaeger_trace_id){.high = 1, .low = 2};
+    span->context.span_id = 3;
+    span->context.flags = jaeger_sampling_flag_sampled;
+    span->operation_name = jaeger_strdup("test-operation");
+    TEST_ASSERT_NOT_NULL(span->operation_name);
+    span->start_time_system.value.tv_sec = 1500000000;
+    span->start_time_system.value.tv_nsec = 123;
+    span->duration.value.tv_sec = 2;
+    span->duration.value.tv_nsec = 456;
+
+    const opentracing_value values[] = {
+        {.type = opentracing_value_string,
+         .value = {.string_value = "test-value"}},
+        {.type = opentracing_value_bool, .value = {.bool_value = true}},
+        {.type = opentracing_value_int64, .value = {.int64_value = -1}},
+        {.type = opentracing_value_uint64, .value = {.uint64_value = 300}},
+        {.type = opentracing_value_double, .value = {.double_value = 0.5}},
+        {.type = opentracing_value_null}};
+    const char* keys[] = {
+        "string", "bool", "int64", "uint64", "double", "null"};
+    for (int i = 0, len = sizeof(values) / sizeof(values[0]); i < len; i++) {
+        jaeger_span_set_tag_no_locking(span, keys[i], &values[i]);
+    }
+    uint8_t binary_data[] = {0, 1, 2};
+    jaeger_tag binary_tag = JAEGERTRACINGC_TAG_INIT;
+    binary_tag.key = "binary";
+    binary_tag.v_type = JAEGERTRACINGC_TAG_TYPE(BINARY);
+    binary_tag.v_binary.data = binary_data;
+    binary_tag.v_binary.len = sizeof(binary_data);
+    TEST_ASSERT_TRUE(jaeger_tag_vector_append(&span->tags, &binary_tag));
+    TEST_ASSERT_EQUAL(7, jaeger_vector_length(&span->tags));
+
+    opentracing_log_field fields[] = {
+        {.key = "event",
+         .value = {.type = opentracing_value_string,
+                   .value = {.string_value = "test-event"}}}};
+    opentracing_log_record log_record = {
+        .fields = fields, .num_fields = sizeof(fields) / sizeof(fields[0])};
+    log_record.timestamp.value.tv_sec = 1500000001;
+    log_record.timestamp.value.tv_nsec = 789;
+    jaeger_span_log_no_locking(span, &log_record);
+    TEST_ASSERT_EQUAL(1, jaeger_vector_length(&span->logs));
+
+    const jaeger_span_ref_type ref_types[] = {
+        opentracing_span_reference_child_of,
+        opentracing_span_reference_follows_from};
+    for (int i = 0, len = sizeof(ref_types) / sizeof(ref_types[0]); i < len;
+         i++) {
+        jaeger_span_ref* span_ref = jaeger_vector_append(&span->refs);
+        TEST_ASSERT_NOT_NULL(span_ref);
+        TEST_ASSERT_TRUE(jaeger_span_ref_init(span_ref));
+        span_ref->context.trace_id = span->context.trace_id;
+        span_ref->context.span_id = 4 + i;
+        span_ref->type = ref_types[i];
+    }
+}
+
+static void assert_binary_equal(const ProtobufCBinaryData* expected,
+                                const ProtobufCBinaryData* actual)
+{
+    TEST_ASSERT_EQUAL(expected->len, actual->len);
+    if (expected->len > 0) {
+        TEST_ASSERT_EQUAL_MEMORY(expected->data, actual->data, expected->len);
+    }
+}
+
+static void assert_tag_equal(const Jaeger__Model__KeyValue* expected,
+                             const Jaeger__Model__KeyValue* actual)
+{
+    TEST_ASSERT_EQUAL_STRING(expected->key, actual->key);
+    TEST_ASSERT_EQUAL(expected->v_type, actual->v_type);
+    TEST_ASSERT_EQUAL_STRING(expected->v_str, actual->v_str);
+    TEST_ASSERT_EQUAL(expected->v_bool, actual->v_bool);
+    TEST_ASSERT_EQUAL(expected->v_int64, actual->v_int64);
+    TEST_ASSERT_EQUAL_MEMORY(
+        &expected->v_float64, &actual->v_float64, sizeof(double));
+    assert_binary_equal(&expected->v_binary, &actual->v_binary);
+}
+
+void test_protobuf()
+{
+    TEST_ASSERT_EQUAL(1, jaeger_protobuf_varint_size(0));
+    TEST_ASSERT_EQUAL(1, jaeger_protobuf_varint_size(127));
+    TEST_ASSERT_EQUAL(2, jaeger_protobuf_varint_size(128));
+    TEST_ASSERT_EQUAL(10, jaeger_protobuf_varint_size(UINT64_MAX));
+    TEST_ASSERT_EQUAL(1 + 2 + 200, jaeger_protobuf_message_field_size(200));
+
+    jaeger_span span;
+    build_span(&span);
+
+    /* Encode span as the only span in a batch, without process. */
+    const size_t span_size = jaeger_span_protobuf_packed_size(&span);
+    const size_t batch_size = jaeger_protobuf_message_field_size(span_size);
+    uint8_t* buffer = jaeger_malloc(batch_size);
+    TEST_ASSERT_NOT_NULL(buffer);
+    const size_t header_size = jaeger_protobuf_pack_message_field_header(
+        JAEGERTRACINGC_PROTOBUF_BATCH_SPANS_FIELD, span_size, buffer);
+    TEST_ASSERT_EQUAL(span_size,
+                      jaeger_span_protobuf_pack(&span, &buffer[header_size]));
+    TEST_ASSERT_EQUAL(batch_size, header_size + span_size);
+
+    Jaeger__Model__Batch* batch =
+        jaeger__model__batch__unpack(NULL, batch_size, buffer);
+    TEST_ASSERT_NOT_NULL(batch);
+    TEST_ASSERT_EQUAL(1, batch->n_spans);
+    const Jaeger__Model__Span* actual = batch->spans[0];
+
+    /* Compare against the protobuf-c conversion. */
+    Jaeger__Model__Span expected = JAEGER__MODEL__SPAN__INIT;
+    TEST_ASSERT_TRUE(jaeger_span_to_protobuf(&expected, &span));
+    assert_binary_equal(&expected.trace_id, &actual->trace_id);
+    assert_binary_equal(&expected.span_id, &actual->span_id);
+    TEST_ASSERT_EQUAL_STRING(expected.operation_name, actual->operation_name);
+
+    TEST_ASSERT_EQUAL(expected.n_tags, actual->n_tags);
+    for (int i = 0; i < (int) expected.n_tags; i++) {
+        assert_tag_equal(expected.tags[i], actual->tags[i]);
+    }
+
+    TEST_ASSERT_EQUAL(expected.n_logs, actual->n_logs);
+    for (int i = 0; i < (int) expected.n_logs; i++) {
+        const Jaeger__Model__Log* expected_log = expected.logs[i];
+        const Jaeger__Model__Log* actual_log = actual->logs[i];
+        TEST_ASSERT_NOT_NULL(actual_log->timestamp);
+        TEST_ASSERT_EQUAL(expected_log->timestamp->seconds,
+                          actual_log->timestamp->seconds);
+        TEST_ASSERT_EQUAL(expected_log->timestamp->nanos,
+                          actual_log->timestamp->nanos);
+        TEST_ASSERT_EQUAL(expected_log->n_fields, actual_log->n_fields);
+        for (int j = 0; j < (int) expected_log->n_fields; j++) {
+            assert_tag_equal(expected_log->fields[j], actual_log->fields[j]);
+        }
+    }
+
+    TEST_ASSERT_EQUAL(expected.n_references, actual->n_references);
+    for (int i = 0; i < (int) expected.n_references; i++) {
+        const Jaeger__Model__SpanRef* expected_ref = expected.references[i];
+        const Jaeger__Model__SpanRef* actual_ref = actual->references[i];
+        assert_binary_equal(&expected_ref->trace_id, &actual_ref->trace_id);
+        assert_binary_equal(&expected_ref->span_id, &actual_ref->span_id);
+        TEST_ASSERT_EQUAL(expected_ref->ref_type, actual_ref->ref_type);
+    }
+    TEST_ASSERT_EQUAL(JAEGER__MODEL__SPAN_REF_TYPE__CHILD_OF,
+                      actual->references[0]->ref_type);
+    TEST_ASSERT_EQUAL(JAEGER__MODEL__SPAN_REF_TYPE__FOLLOWS_FROM,
+                      actual->references[1]->ref_type);
+
+    /* Fields the protobuf-c conversion leaves to the caller. */
+    TEST_ASSERT_EQUAL(span.context.flags, actual->flags);
+    TEST_ASSERT_NOT_NULL(actual->start_time);
+    TEST_ASSERT_EQUAL(span.start_time_system.value.tv_sec,
+                      actual->start_time->seconds);
+    TEST_ASSERT_EQUAL(span.start_time_system.value.tv_nsec,
+                      actual->start_time->nanos);
+    TEST_ASSERT_NOT_NULL(actual->duration);
+    TEST_ASSERT_EQUAL(span.duration.value.tv_sec, actual->duration->seconds);
+    TEST_ASSERT_EQUAL(span.duration.value.tv_nsec, actual->duration->nanos);
+
+    jaeger_span_protobuf_destroy(&expected);
+    jaeger__model__batch__free_unpacked(batch, NULL);
+
+    /* Decoders must skip padding of any size. */
+    const size_t padding_sizes[] = {
+        JAEGERTRACINGC_PROTOBUF_PADDING_HEADER_SIZE, 200, 20000};
+    for (int i = 0, len = sizeof(padding_sizes) / sizeof(padding_sizes[0]);
+         i < len;
+         i++) {
+        uint8_t* padded = jaeger_malloc(batch_size + padding_sizes[i]);
+        TEST_ASSERT_NOT_NULL(padded);
+        memcpy(padded, buffer, batch_size);
+        uint8_t* padding = &padded[batch_size];
+        jaeger_protobuf_pack_padding_header(padding_sizes[i], padding);
+        memset(&padding[JAEGERTRACINGC_PROTOBUF_PADDING_HEADER_SIZE],
+               0,
+               padding_sizes[i] - JAEGERTRACINGC_PROTOBUF_PADDING_HEADER_SIZE);
+        batch = jaeger__model__batch__unpack(
+            NULL, batch_size + padding_sizes[i], padded);
+        TEST_ASSERT_NOT_NULL(batch);
+        TEST_ASSERT_EQUAL(1, batch->n_spans);
+        jaeger__model__batch__free_unpacked(batch, NULL);
+        jaeger_free(padded);
+    }
+    jaeger_free(buffer);
+    jaeger_span_destroy((jaeger_destructible*) &span);
+}
@@ -14,11 +14,22 @@
  * limitations under the License.
  */
 
+#if defined(HAVE_SENDMMSG) && !defined(_GNU_SOURCE)
+/* Required for sendmmsg. */
+#define _GNU_SOURCE
+#endif /* HAVE_SENDMMSG */
+
 #include "jaegertracingc/reporter.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <sys/uio.h>
 
+#include "jaegertracingc/protobuf.h"
 #include "jaegertracingc/threading.h"
+#include "jaegertracingc/thrift.h"
 #include "jaegertracingc/tracer.h"
 
 static jaeger_reporter null_reporter;
@@ -249,380 +260,2124 @@ static inline bool build_process(Jaeger__Model__Process* process,
 
 cleanup:
     process_destroy(process);
-    jaeger_free(process);
     return false;
 }
 
-static inline void large_batch_error(Jaeger__Model__Batch* batch,
-                                     jaeger_vector* spans,
-                                     int initial_num_spans,
-                                     int max_packet_size,
-                                     jaeger_metrics* metrics)
+/* Span as stored in the reporter queue, already encoded as a
+ * jaeger.model.Batch spans field or as a Thrift Span struct so flushing only
+ * needs to copy bytes into the batch. Allocated as a single block. */
+typedef struct queued_span {
+    int encoded_size;
+    uint8_t encoded[];
+} queued_span;
+
+/* Encodes process once so every batch can reuse the bytes. For Thrift, the
+ * process is part of the emitBatch message header. */
+static inline bool
+batch_reporter_encode_process(jaeger_batch_reporter* reporter)
 {
-    Jaeger__Model__Batch tmp = *batch;
-    memcpy(&tmp, batch, sizeof(tmp));
-    tmp.n_spans = 1;
-    jaeger_log_error("Message is too large to send in a single packet, "
-                     "minimum message size = %zu, "
-                     "maximum packet size = %d",
-                     jaeger__model__batch__get_packed_size(&tmp),
-                     max_packet_size);
-
-    const int batch_packed_size = jaeger__model__batch__get_packed_size(batch);
-    if (batch_packed_size > max_packet_size) {
-        jaeger_log_error("Detected batch with zero spans exceeds maximum "
-                         "packet size, "
-                         "batch size (zero spans) = %d, "
-                         "maximum packet size = %d",
-                         batch_packed_size,
-                         max_packet_size);
+    if (reporter->format == jaeger_reporter_format_thrift_compact) {
+        const size_t header_size =
+            jaeger_thrift_emit_batch_header_size(&reporter->process);
+        uint8_t* header = jaeger_malloc(header_size);
+        if (header == NULL) {
+            jaeger_log_error("Cannot allocate encoded process, size = %zu",
+                             header_size);
+            return false;
+        }
+        const size_t num_packed =
+            jaeger_thrift_pack_emit_batch_header(&reporter->process, header);
+        (void) num_packed;
+        assert(num_packed == header_size);
+        reporter->process_field = header;
+        reporter->process_field_size = header_size;
+        return true;
     }
 
-    jaeger_log_error("Dropping first span to avoid repeated failures");
+    const size_t process_size =
+        jaeger__model__process__get_packed_size(&reporter->process);
+    const size_t field_size =
+        jaeger_protobuf_message_field_size(process_size);
+    uint8_t* process_field = jaeger_malloc(field_size);
+    if (process_field == NULL) {
+        jaeger_log_error("Cannot allocate encoded process, size = %zu",
+                         field_size);
+        return false;
+    }
+    const size_t header_size = jaeger_protobuf_pack_message_field_header(
+        JAEGERTRACINGC_PROTOBUF_BATCH_PROCESS_FIELD,
+        process_size,
+        process_field);
+    const size_t num_packed = jaeger__model__process__pack(
+        &reporter->process, &process_field[header_size]);
+    (void) num_packed;
+    assert(header_size + num_packed == field_size);
+    reporter->process_field = process_field;
+    reporter->process_field_size = field_size;
+    return true;
+}
 
-    spans->data = (char*) batch->spans;
-    spans->len = initial_num_spans;
-    *batch = (Jaeger__Model__Batch) JAEGER__MODEL__BATCH__INIT;
-    Jaeger__Model__Span** span = jaeger_vector_get(spans, 0);
-    jaeger_span_protobuf_destroy(*span);
-    jaeger_free(*span);
-    jaeger_vector_remove(spans, 0);
+/* Caller must hold reporter mutex. */
+static inline void
+batch_reporter_build_process(jaeger_batch_reporter* reporter,
+                             const jaeger_tracer* tracer)
+{
+    if (reporter->process_built) {
+        return;
+    }
+    /* Building process will not affect the span being reported, so ignore
+     * failures here and retry on the next span. */
+    if (!build_process(&reporter->process, tracer)) {
+        return;
+    }
+    if (!batch_reporter_encode_process(reporter)) {
+        process_destroy(&reporter->process);
+        return;
+    }
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    __atomic_store_n(&reporter->process_built, true, __ATOMIC_RELEASE);
+#else
+    reporter->process_built = true;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
 
-    if (metrics != NULL) {
-        jaeger_counter* dropped = metrics->reporter_dropped;
-        assert(dropped != NULL);
-        dropped->inc(dropped, 1);
+static inline void
+batch_reporter_update_queue_length(jaeger_batch_reporter* reporter)
+{
+    assert(reporter != NULL);
+    if (reporter->metrics == NULL) {
+        return;
     }
+    jaeger_gauge* queue_length = reporter->metrics->reporter_queue_length;
+    assert(queue_length != NULL);
+    queue_length->update(queue_length,
+                         jaeger_mpsc_queue_length(&reporter->queue) +
+                             jaeger_vector_length(&reporter->spans));
 }
 
-static inline bool build_batch(Jaeger__Model__Batch* batch,
-                               Jaeger__Model__Process* process,
-                               jaeger_vector* spans,
-                               int max_packet_size,
-                               jaeger_metrics* metrics)
+static inline void batch_reporter_drop_spans(jaeger_batch_reporter* reporter,
+                                             int num_dropped)
 {
-    assert(batch != NULL);
-    assert(process != NULL);
-    assert(spans != NULL);
-    batch->process = process;
+    assert(reporter != NULL);
+    if (reporter->metrics == NULL) {
+        return;
+    }
+    jaeger_counter* dropped = reporter->metrics->reporter_dropped;
+    assert(dropped != NULL);
+    dropped->inc(dropped, num_dropped);
+}
 
-    const int num_spans = jaeger_vector_length(spans);
-    batch->n_spans = num_spans;
-    batch->spans = (Jaeger__Model__Span**) spans->data;
-    spans->len = 0;
-    spans->data = NULL;
+static inline void
+batch_reporter_count_successes(jaeger_batch_reporter* reporter, int num_sent)
+{
+    if (reporter->metrics == NULL) {
+        return;
+    }
+    jaeger_counter* success = reporter->metrics->reporter_success;
+    assert(success != NULL);
+    success->inc(success, num_sent);
+}
 
-    for (; batch->n_spans > 0 &&
-           (int) jaeger__model__batch__get_packed_size(batch) > max_packet_size;
-         batch->n_spans--) {
+static inline void
+batch_reporter_count_failures(jaeger_batch_reporter* reporter, int num_failed)
+{
+    if (reporter->metrics == NULL) {
+        return;
     }
-    if (batch->n_spans == 0) {
-        large_batch_error(batch, spans, num_spans, max_packet_size, metrics);
-        return false;
+    jaeger_counter* failed = reporter->metrics->reporter_failure;
+    assert(failed != NULL);
+    failed->inc(failed, num_failed);
+}
+
+/* Frees the first num_consumed spans in the buffer and shifts the rest to the
+ * front. */
+static inline void batch_reporter_consume_spans(jaeger_batch_reporter* reporter,
+                                                int num_consumed)
+{
+    queued_span** spans = (queued_span**) reporter->spans.data;
+    for (int i = 0; i < num_consumed; i++) {
+        jaeger_free(spans[i]);
     }
+    const int num_remaining =
+        jaeger_vector_length(&reporter->spans) - num_consumed;
+    memmove(spans, &spans[num_consumed], sizeof(*spans) * num_remaining);
+    reporter->spans.len = num_remaining;
+}
 
-    const int remaining_spans = num_spans - batch->n_spans;
-    if (remaining_spans > 0 &&
-        jaeger_vector_init(spans, sizeof(Jaeger__Model__Span*)) &&
-        jaeger_vector_reserve(spans, remaining_spans)) {
-        for (int i = 0; i < remaining_spans; i++) {
-            Jaeger__Model__Span** span = jaeger_vector_append(spans);
-            assert(span != NULL);
-            *span = batch->spans[batch->n_spans + i];
-        }
+/* Span must be finished, it is read without locking. */
+static queued_span* batch_reporter_encode_span(jaeger_batch_reporter* reporter,
+                                               const jaeger_span* span)
+{
+    const bool thrift =
+        (reporter->format == jaeger_reporter_format_thrift_compact);
+    const size_t message_size = thrift
+                                    ? jaeger_span_thrift_packed_size(span)
+                                    : jaeger_span_protobuf_packed_size(span);
+    const int span_size =
+        thrift ? (int) message_size
+               : (int) jaeger_protobuf_message_field_size(message_size);
+    queued_span* entry = jaeger_malloc(sizeof(queued_span) + span_size);
+    if (entry == NULL) {
+        jaeger_log_error("Cannot allocate span for reporter batch, size = %d",
+                         span_size);
+        return NULL;
     }
-    else if (remaining_spans > 0) {
-        jaeger_log_error("Cannot allocate space for span buffer, must "
-                         "drop remaining spans, num dropped spans = %d",
-                         remaining_spans);
-        for (int i = 0; i < remaining_spans; i++) {
-            jaeger_span_protobuf_destroy(batch->spans[batch->n_spans + i]);
-            jaeger_free(batch->spans[batch->n_spans + i]);
-        }
-        if (metrics != NULL) {
-            jaeger_counter* dropped = metrics->reporter_dropped;
-            assert(dropped != NULL);
-            dropped->inc(dropped, remaining_spans);
-        }
+    entry->encoded_size = span_size;
+    size_t num_packed = 0;
+    if (thrift) {
+        num_packed = jaeger_span_thrift_pack(span, entry->encoded);
     }
-    return true;
+    else {
+        const size_t header_size = jaeger_protobuf_pack_message_field_header(
+            JAEGERTRACINGC_PROTOBUF_BATCH_SPANS_FIELD,
+            message_size,
+            entry->encoded);
+        num_packed =
+            header_size +
+            jaeger_span_protobuf_pack(span, &entry->encoded[header_size]);
+    }
+    (void) num_packed;
+    assert((int) num_packed == span_size);
+    return entry;
 }
 
-static void remote_reporter_destroy(jaeger_destructible* destructible)
+#if defined(JAEGERTRACINGC_MT) && defined(JAEGERTRACINGC_HAVE_ATOMICS)
+#define HAVE_SPAN_STAGES
+#endif /* JAEGERTRACINGC_MT && JAEGERTRACINGC_HAVE_ATOMICS */
+
+/* Spans staged by a single thread. */
+typedef struct jaeger_staged_spans {
+    /* Array of queued_span pointers. */
+    jaeger_vector spans;
+    /* Encoded size of spans. */
+    int size;
+} staged_spans;
+
+/* Staging area of one application thread. The thread takes buffer out of the
+ * stage while appending to it, and the flush only swaps a full buffer for an
+ * empty one if it is in place, so the two never access a buffer at the same
+ * time. */
+typedef struct jaeger_span_stage {
+    /* Thread local value, destroyed when the thread exits. */
+    jaeger_destructible base;
+    staged_spans* buffer;
+    /* Set once the thread has exited, the flush frees the stage after taking
+     * its spans. */
+    bool orphaned;
+    /* Next stage in the reporter's list. */
+    struct jaeger_span_stage* next;
+} span_stage;
+
+static void staged_spans_free(staged_spans* buffer)
 {
-    if (destructible == NULL) {
+    if (buffer == NULL) {
         return;
     }
-    jaeger_remote_reporter* r = (jaeger_remote_reporter*) destructible;
+    for (int i = 0, len = jaeger_vector_length(&buffer->spans); i < len; i++) {
+        jaeger_free(*(queued_span**) jaeger_vector_offset(&buffer->spans, i));
+    }
+    jaeger_vector_destroy(&buffer->spans);
+    jaeger_free(buffer);
+}
 
-    /* Try to flush any spans we have not flushed yet. */
-    ((jaeger_reporter*) r)->flush((jaeger_reporter*) r);
+#ifdef HAVE_SPAN_STAGES
 
-    if (r->fd >= 0) {
-        close(r->fd);
-        r->fd = -1;
+static staged_spans* staged_spans_new(void)
+{
+    staged_spans* buffer = jaeger_malloc(sizeof(staged_spans));
+    if (buffer == NULL) {
+        return NULL;
     }
+    if (!jaeger_vector_init(&buffer->spans, sizeof(queued_span*))) {
+        jaeger_free(buffer);
+        return NULL;
+    }
+    buffer->size = 0;
+    return buffer;
+}
 
-    if (r->candidates != NULL) {
-        freeaddrinfo(r->candidates);
-        r->candidates = NULL;
+static void span_stage_orphan(jaeger_destructible* destructible)
+{
+    span_stage* stage = (span_stage*) destructible;
+    __atomic_store_n(&stage->orphaned, true, __ATOMIC_RELEASE);
+}
+
+/* Returns the stage of the calling thread, creating it on first use. */
+static span_stage* batch_reporter_thread_stage(jaeger_batch_reporter* reporter)
+{
+    span_stage* stage =
+        (span_stage*) jaeger_thread_local_get_value(&reporter->stage_key);
+    if (stage != NULL) {
+        return stage;
+    }
+    stage = jaeger_malloc(sizeof(span_stage));
+    if (stage == NULL) {
+        jaeger_log_error("Cannot allocate span stage");
+        return NULL;
+    }
+    stage->base.destroy = &span_stage_orphan;
+    stage->buffer = staged_spans_new();
+    stage->orphaned = false;
+    if (stage->buffer == NULL) {
+        jaeger_log_error("Cannot allocate span stage buffer");
+        jaeger_free(stage);
+        return NULL;
+    }
+    if (!jaeger_thread_local_set_value(&reporter->stage_key,
+                                       (jaeger_destructible*) stage)) {
+        staged_spans_free(stage->buffer);
+        jaeger_free(stage);
+        return NULL;
     }
 
-    process_destroy(&r->process);
+    /* Only ever push at the head, the flush unlinks stages further down. */
+    stage->next = __atomic_load_n(&reporter->stages, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&reporter->stages,
+                                        &stage->next,
+                                        stage,
+                                        true,
+                                        __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED)) {
+    }
+    return stage;
+}
 
-    for (int i = 0, len = jaeger_vector_length(&r->spans); i < len; i++) {
-        Jaeger__Model__Span** span = jaeger_vector_offset(&r->spans, i);
-        assert(span != NULL);
-        if (*span == NULL) {
-            continue;
+/* Appends span to the stage's buffer. Returns the encoded size of the staged
+ * spans, or -1 if the span could not be staged. */
+static int span_stage_push(span_stage* stage, queued_span* entry, int capacity)
+{
+    staged_spans* buffer =
+        __atomic_exchange_n(&stage->buffer, NULL, __ATOMIC_ACQUIRE);
+    assert(buffer != NULL);
+    int size = -1;
+    if (jaeger_vector_length(&buffer->spans) < capacity) {
+        queued_span** entry_ptr = jaeger_vector_append(&buffer->spans);
+        if (entry_ptr != NULL) {
+            *entry_ptr = entry;
+            buffer->size += entry->encoded_size;
+            size = buffer->size;
         }
-        jaeger_span_protobuf_destroy(*span);
-        jaeger_free(*span);
     }
-    jaeger_vector_destroy(&r->spans);
+    __atomic_store_n(&stage->buffer, buffer, __ATOMIC_RELEASE);
+    return size;
+}
 
-    jaeger_mutex_destroy(&r->mutex);
+/* Moves a stage's spans into the reporter's span buffer by swapping in the
+ * spare buffer. Returns false if the stage is busy and has to be collected
+ * on a later flush. Caller must hold reporter mutex. */
+static bool batch_reporter_collect_stage(jaeger_batch_reporter* reporter,
+                                         span_stage* stage)
+{
+    if (reporter->spare_stage_buffer == NULL) {
+        reporter->spare_stage_buffer = staged_spans_new();
+        if (reporter->spare_stage_buffer == NULL) {
+            jaeger_log_error("Cannot allocate span stage buffer");
+            return false;
+        }
+    }
+    staged_spans* buffer = __atomic_load_n(&stage->buffer, __ATOMIC_RELAXED);
+    if (buffer == NULL ||
+        !__atomic_compare_exchange_n(&stage->buffer,
+                                     &buffer,
+                                     reporter->spare_stage_buffer,
+                                     false,
+                                     __ATOMIC_ACQ_REL,
+                                     __ATOMIC_RELAXED)) {
+        return false;
+    }
+
+    const int num_staged = jaeger_vector_length(&buffer->spans);
+    if (num_staged > 0) {
+        queued_span** spans =
+            jaeger_vector_extend(&reporter->spans,
+                                 jaeger_vector_length(&reporter->spans),
+                                 num_staged);
+        if (spans == NULL) {
+            jaeger_log_error("Cannot move staged spans to reporter buffer, "
+                             "num spans = %d",
+                             num_staged);
+            for (int i = 0; i < num_staged; i++) {
+                jaeger_free(
+                    *(queued_span**) jaeger_vector_offset(&buffer->spans, i));
+            }
+            batch_reporter_drop_spans(reporter, num_staged);
+        }
+        else {
+            memcpy(spans, buffer->spans.data, sizeof(*spans) * num_staged);
+        }
+    }
+    buffer->spans.len = 0;
+    buffer->size = 0;
+    reporter->spare_stage_buffer = buffer;
+    return true;
 }
 
-static inline void
-remote_reporter_update_queue_length(jaeger_remote_reporter* reporter)
+/* Collects spans from every thread's stage and frees stages of threads that
+ * have exited. Stops once the span buffer reaches max_buffered, leaving the
+ * rest staged. Caller must hold reporter mutex. */
+static void batch_reporter_collect_stages(jaeger_batch_reporter* reporter,
+                                          int max_buffered)
 {
-    assert(reporter != NULL);
-    if (reporter->metrics == NULL) {
-        return;
+    span_stage* prev = NULL;
+    span_stage* stage = __atomic_load_n(&reporter->stages, __ATOMIC_ACQUIRE);
+    while (stage != NULL &&
+           jaeger_vector_length(&reporter->spans) < max_buffered) {
+        span_stage* next = stage->next;
+        /* Check before collecting, an orphaned stage is no longer
+         * appended to, so collecting it leaves it empty. */
+        const bool orphaned =
+            __atomic_load_n(&stage->orphaned, __ATOMIC_ACQUIRE);
+        if (!batch_reporter_collect_stage(reporter, stage) || !orphaned) {
+            prev = stage;
+            stage = next;
+            continue;
+        }
+        /* Threads only push at the head, so other links are only modified
+         * here. */
+        bool unlinked = true;
+        if (prev != NULL) {
+            prev->next = next;
+        }
+        else {
+            span_stage* head = stage;
+            unlinked = __atomic_compare_exchange_n(&reporter->stages,
+                                                   &head,
+                                                   next,
+                                                   false,
+                                                   __ATOMIC_ACQ_REL,
+                                                   __ATOMIC_ACQUIRE);
+        }
+        if (!unlinked) {
+            /* New stage was pushed, free this one next time. */
+            prev = stage;
+            stage = next;
+            continue;
+        }
+        staged_spans_free(stage->buffer);
+        jaeger_free(stage);
+        stage = next;
     }
-    jaeger_counter* dropped = reporter->metrics->reporter_dropped;
-    assert(dropped != NULL);
-    dropped->inc(dropped, 1);
 }
 
-static void remote_reporter_report(jaeger_reporter* reporter,
-                                   const jaeger_span* span)
+#endif /* HAVE_SPAN_STAGES */
+
+static void batch_reporter_report(jaeger_reporter* reporter,
+                                  const jaeger_span* span)
 {
     assert(reporter != NULL);
     if (span == NULL) {
         return;
     }
 
-    jaeger_remote_reporter* r = (jaeger_remote_reporter*) reporter;
-    jaeger_mutex_lock(&r->mutex);
+    jaeger_batch_reporter* r = (jaeger_batch_reporter*) reporter;
 
-    if (!jaeger_vector_reserve(&r->spans,
-                               jaeger_vector_length(&r->spans) + 1)) {
-        goto unlock;
+    /* Encode the span straight into the queued entry. Finished spans are not
+     * modified, so the size cannot change between measuring and packing. */
+    queued_span* entry = batch_reporter_encode_span(r, span);
+    if (entry == NULL) {
+        return;
     }
+    const int span_size = entry->encoded_size;
 
-    Jaeger__Model__Span* span_copy = jaeger_malloc(sizeof(Jaeger__Model__Span));
-    if (span_copy == NULL) {
-        jaeger_log_error("Cannot allocate span for reporter batch");
-        goto unlock;
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    if (!__atomic_load_n(&r->process_built, __ATOMIC_ACQUIRE)) {
+        jaeger_mutex_lock(&r->mutex);
+        batch_reporter_build_process(r, span->tracer);
+        jaeger_mutex_unlock(&r->mutex);
     }
 
-    *span_copy = (Jaeger__Model__Span) JAEGER__MODEL__SPAN__INIT;
-    if (!jaeger_span_to_protobuf(span_copy, span)) {
-        goto cleanup;
+    bool request_flush = false;
+#ifdef HAVE_SPAN_STAGES
+    span_stage* stage =
+        r->stage_per_thread ? batch_reporter_thread_stage(r) : NULL;
+    if (stage != NULL) {
+        const int staged_size = span_stage_push(
+            stage, entry, jaeger_mpsc_queue_capacity(&r->queue));
+        if (staged_size < 0) {
+            goto queue_full;
+        }
+        /* Check before the exchange, so a thread with a full stage does not
+         * keep writing the shared flag until the flush collects it. */
+        request_flush =
+            staged_size >= r->batch_size &&
+            !__atomic_load_n(&r->flush_requested, __ATOMIC_RELAXED) &&
+            !__atomic_exchange_n(&r->flush_requested, true, __ATOMIC_ACQ_REL);
+    }
+    else
+#endif /* HAVE_SPAN_STAGES */
+    {
+        if (!jaeger_mpsc_queue_push(&r->queue, entry)) {
+            goto queue_full;
+        }
+        request_flush =
+            __atomic_add_fetch(
+                &r->queued_bytes, span_size, __ATOMIC_RELAXED) >=
+                r->batch_size &&
+            !__atomic_exchange_n(&r->flush_requested, true, __ATOMIC_ACQ_REL);
     }
-    Jaeger__Model__Span** span_ptr = jaeger_vector_append(&r->spans);
-    assert(span_ptr != NULL);
-    *span_ptr = span_copy;
-    remote_reporter_update_queue_length(r);
+#else
+    /* Without atomics, serialize producers on the reporter mutex. */
+    jaeger_mutex_lock(&r->mutex);
+    batch_reporter_build_process(r, span->tracer);
+    const bool pushed = jaeger_mpsc_queue_push(&r->queue, entry);
+    bool request_flush = false;
+    if (pushed) {
+        r->queued_bytes += span_size;
+        request_flush =
+            (r->queued_bytes >= r->batch_size && !r->flush_requested);
+        r->flush_requested = r->flush_requested || request_flush;
+    }
+    jaeger_mutex_unlock(&r->mutex);
+    if (!pushed) {
+        goto queue_full;
+    }
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+
+    /* Leave the actual flush to the background thread, only wake it early
+     * once there is enough data to fill a batch. Signaling without the mutex
+     * may miss a thread that is just about to wait, which delays the flush
+     * until the next interval at worst. */
+    if (request_flush) {
+        jaeger_cond_signal(&r->cond);
+    }
+    return;
+
+queue_full:
+    batch_reporter_drop_spans(r, 1);
+    jaeger_free(entry);
+}
+
+/* Moves spans from the queue into the reporter's span buffer. Caller must
+ * hold reporter mutex, which makes it the queue's single consumer. */
+static void batch_reporter_drain_queue(jaeger_batch_reporter* reporter)
+{
+    /* Reset before popping. Spans pushed concurrently may end up counted
+     * after they are drained, which only causes an early flush. */
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    __atomic_store_n(&reporter->queued_bytes, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&reporter->flush_requested, false, __ATOMIC_RELAXED);
+#else
+    reporter->queued_bytes = 0;
+    reporter->flush_requested = false;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+
+    /* Bound the buffer to the queue capacity so a failing backend cannot
+     * make it grow indefinitely. Spans stay in queue until there is room and
+     * new spans are dropped once the queue fills up. */
+    const int max_buffered = jaeger_mpsc_queue_capacity(&reporter->queue);
+    queued_span* span = NULL;
+    while (jaeger_vector_length(&reporter->spans) < max_buffered &&
+           jaeger_mpsc_queue_pop(&reporter->queue, (void**) &span)) {
+        queued_span** span_ptr = jaeger_vector_append(&reporter->spans);
+        if (span_ptr == NULL) {
+            jaeger_free(span);
+            batch_reporter_drop_spans(reporter, 1);
+            continue;
+        }
+        *span_ptr = span;
+    }
+#ifdef HAVE_SPAN_STAGES
+    if (reporter->stage_per_thread) {
+        batch_reporter_collect_stages(reporter, max_buffered);
+    }
+#endif /* HAVE_SPAN_STAGES */
+}
 
-    if (r->process.service_name == NULL ||
-        strlen(r->process.service_name) == 0) {
-        /* Building process will not affect this span, so ignore return value.
-         */
-        build_process(&r->process, span->tracer);
+static bool batch_reporter_flush_no_locking(jaeger_batch_reporter* reporter)
+{
+    bool success = true;
+    batch_reporter_drain_queue(reporter);
+    while (jaeger_vector_length(&reporter->spans) > 0) {
+        if (!reporter->send_spans(reporter)) {
+            success = false;
+        }
+        if (jaeger_vector_length(&reporter->spans) > 0) {
+            /* Write failed, retry on next flush. */
+            break;
+        }
+        /* Pick up anything left in queue due to buffer bound. */
+        batch_reporter_drain_queue(reporter);
     }
+    batch_reporter_update_queue_length(reporter);
+    return success;
+}
 
-    goto unlock;
+static bool batch_reporter_flush(jaeger_reporter* r)
+{
+    assert(r != NULL);
 
-cleanup:
-    jaeger_span_protobuf_destroy(span_copy);
-    jaeger_free(span_copy);
-unlock:
-    jaeger_mutex_unlock(&r->mutex);
+    jaeger_batch_reporter* reporter = (jaeger_batch_reporter*) r;
+    jaeger_mutex_lock(&reporter->mutex);
+    const bool success = batch_reporter_flush_no_locking(reporter);
+    jaeger_mutex_unlock(&reporter->mutex);
+    return success;
 }
 
-static bool remote_reporter_write_to_socket(jaeger_remote_reporter* reporter,
-                                            const uint8_t* buffer,
-                                            int buf_len)
-{
-    /* Delay address resolution until the first write. */
-    if (reporter->candidates != NULL) {
-        bool success = false;
-        for (struct addrinfo* iter = reporter->candidates; iter != NULL;
-             iter = iter->ai_next) {
-            if (sendto(reporter->fd,
-                       buffer,
-                       buf_len,
-                       0,
-                       iter->ai_addr,
-                       iter->ai_addrlen) == buf_len &&
-                sizeof(reporter->addr) == iter->ai_addrlen) {
-                memcpy(&reporter->addr, iter->ai_addr, sizeof(reporter->addr));
-                success = true;
+static inline void next_flush_deadline(struct timespec* deadline,
+                                       const jaeger_duration* interval)
+{
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += interval->value.tv_sec;
+    deadline->tv_nsec += interval->value.tv_nsec;
+    if (deadline->tv_nsec >= JAEGERTRACINGC_NANOSECONDS_PER_SECOND) {
+        deadline->tv_sec +=
+            deadline->tv_nsec / JAEGERTRACINGC_NANOSECONDS_PER_SECOND;
+        deadline->tv_nsec %= JAEGERTRACINGC_NANOSECONDS_PER_SECOND;
+    }
+}
+
+static inline bool
+batch_reporter_flush_requested(jaeger_batch_reporter* reporter)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    return __atomic_load_n(&reporter->flush_requested, __ATOMIC_ACQUIRE);
+#else
+    return reporter->flush_requested;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+#ifdef JAEGERTRACINGC_MT
+
+static void* batch_reporter_flush_loop(void* arg)
+{
+    assert(arg != NULL);
+    jaeger_batch_reporter* reporter = (jaeger_batch_reporter*) arg;
+    jaeger_mutex_lock(&reporter->mutex);
+    while (reporter->running) {
+        struct timespec deadline;
+        next_flush_deadline(&deadline, &reporter->flush_interval);
+        while (reporter->running &&
+               !batch_reporter_flush_requested(reporter)) {
+            if (jaeger_cond_timed_wait(
+                    &reporter->cond, &reporter->mutex, &deadline) ==
+                ETIMEDOUT) {
                 break;
             }
         }
+        /* Failures are logged and counted in metrics, next iteration
+         * retries whatever is left. */
+        batch_reporter_flush_no_locking(reporter);
+    }
+    jaeger_mutex_unlock(&reporter->mutex);
+    return NULL;
+}
 
-        freeaddrinfo(reporter->candidates);
-        reporter->candidates = NULL;
-        if (!success) {
-            jaeger_log_error("Failed to resolve remote reporter host port");
-            if (reporter->metrics != NULL) {
-                jaeger_counter* failed = reporter->metrics->reporter_failure;
-                assert(failed != NULL);
-                failed->inc(failed, 1);
-            }
-        }
+#endif /* JAEGERTRACINGC_MT */
+
+/* Initializes members shared by batch reporters and sets up methods. Derived
+ * reporter must initialize its own members to safe defaults first, so its
+ * destroy method can clean up if a later step fails. Nothing needs to be
+ * cleaned up if this fails. */
+static bool
+batch_reporter_init(jaeger_batch_reporter* reporter,
+                    jaeger_metrics* metrics,
+                    const jaeger_duration* flush_interval,
+                    int queue_size,
+                    int batch_size,
+                    jaeger_reporter_format format,
+                    bool stage_per_thread,
+                    void (*destroy)(jaeger_destructible*),
+                    bool (*send_spans)(jaeger_batch_reporter*))
+{
+    reporter->mutex = (jaeger_mutex) JAEGERTRACINGC_MUTEX_INIT;
+    reporter->cond = (jaeger_cond) JAEGERTRACINGC_COND_INIT;
+    reporter->running = false;
+    reporter->flush_requested = false;
+    reporter->queued_bytes = 0;
+    reporter->batch_size = batch_size;
+    reporter->format = format;
+    reporter->flush_interval = *flush_interval;
+    reporter->process_built = false;
+    reporter->process = (Jaeger__Model__Process) JAEGER__MODEL__PROCESS__INIT;
+    reporter->process_field = NULL;
+    reporter->process_field_size = 0;
+    reporter->spans = (jaeger_vector) JAEGERTRACINGC_VECTOR_INIT;
+    reporter->stage_per_thread = false;
+    reporter->stages = NULL;
+    reporter->spare_stage_buffer = NULL;
+    reporter->metrics = metrics;
+    ((jaeger_destructible*) reporter)->destroy = destroy;
+    ((jaeger_reporter*) reporter)->report = &batch_reporter_report;
+    ((jaeger_reporter*) reporter)->flush = &batch_reporter_flush;
+    reporter->send_spans = send_spans;
 
-        return success;
+    if (queue_size <= 0) {
+        queue_size = JAEGERTRACINGC_DEFAULT_REPORTER_QUEUE_SIZE;
+    }
+    if (!jaeger_mpsc_queue_init(&reporter->queue, queue_size)) {
+        return false;
+    }
+    if (!jaeger_vector_init(&reporter->spans, sizeof(queued_span*))) {
+        jaeger_mpsc_queue_destroy(&reporter->queue);
+        return false;
+    }
+#ifdef HAVE_SPAN_STAGES
+    if (stage_per_thread) {
+        if (!jaeger_thread_local_init(&reporter->stage_key)) {
+            jaeger_vector_destroy(&reporter->spans);
+            jaeger_mpsc_queue_destroy(&reporter->queue);
+            return false;
+        }
+        reporter->stage_per_thread = true;
     }
+#else
+    (void) stage_per_thread;
+#endif /* HAVE_SPAN_STAGES */
+    return true;
+}
 
-    const int num_written = sendto(reporter->fd,
-                                   buffer,
-                                   buf_len,
-                                   0,
-                                   (struct sockaddr*) &reporter->addr,
-                                   sizeof(reporter->addr));
-    const bool success = (num_written == buf_len);
-    if (!success) {
-        jaeger_log_error("Cannot write entire message to UDP socket, "
-                         "num written = %d, errno = %d",
-                         num_written,
-                         errno);
-        if (reporter->metrics != NULL) {
-            jaeger_counter* failed = reporter->metrics->reporter_failure;
-            assert(failed != NULL);
-            failed->inc(failed, 1);
+/* Starts the background flush thread unless the flush interval is zero. */
+static bool batch_reporter_start(jaeger_batch_reporter* reporter)
+{
+#ifdef JAEGERTRACINGC_MT
+    /* Single-threaded builds have no way to run the loop concurrently, so
+     * they must flush explicitly. */
+    if (reporter->flush_interval.value.tv_sec > 0 ||
+        reporter->flush_interval.value.tv_nsec > 0) {
+        reporter->running = true;
+        const int return_code = jaeger_thread_init(
+            &reporter->thread, &batch_reporter_flush_loop, reporter);
+        if (return_code != 0) {
+            jaeger_log_error("Cannot start reporter flush thread, "
+                             "return code = %d",
+                             return_code);
+            reporter->running = false;
+            return false;
         }
     }
+#else
+    (void) reporter;
+#endif /* JAEGERTRACINGC_MT */
+    return true;
+}
 
-    return success;
+/* Stops the background thread, waiting for a flush in progress. */
+static void batch_reporter_stop_thread(jaeger_batch_reporter* reporter)
+{
+    jaeger_mutex_lock(&reporter->mutex);
+    const bool running = reporter->running;
+    reporter->running = false;
+    jaeger_cond_signal(&reporter->cond);
+    jaeger_mutex_unlock(&reporter->mutex);
+    if (running) {
+        jaeger_thread_join(reporter->thread, NULL);
+    }
 }
 
-static bool remote_reporter_flush_batch(jaeger_remote_reporter* reporter)
+/* Stops the background thread and flushes remaining spans. Must be called
+ * before derived reporter releases anything used to send spans. */
+static void batch_reporter_stop(jaeger_batch_reporter* reporter)
 {
-    const int num_spans = jaeger_vector_length(&reporter->spans);
-    assert(num_spans > 0);
+    /* Stop the background thread before the final flush so the two do not
+     * race for the connection. */
+    batch_reporter_stop_thread(reporter);
 
-    Jaeger__Model__Batch batch = JAEGER__MODEL__BATCH__INIT;
-    if (!build_batch(&batch,
-                     &reporter->process,
-                     &reporter->spans,
-                     reporter->max_packet_size,
-                     reporter->metrics)) {
-        return false;
-    }
+    /* Try to flush any spans we have not flushed yet. */
+    ((jaeger_reporter*) reporter)->flush((jaeger_reporter*) reporter);
+}
 
-#define INIT_PACKET_SIZE 1024
-    uint8_t buffer[INIT_PACKET_SIZE];
-    ProtobufCBufferSimple simple = PROTOBUF_C_BUFFER_SIMPLE_INIT(buffer);
-    jaeger__model__batch__pack_to_buffer(&batch, (ProtobufCBuffer*) &simple);
-    assert((int) simple.len <= reporter->max_packet_size);
-    const bool write_succeeded =
-        remote_reporter_write_to_socket(reporter, simple.data, simple.len);
-    PROTOBUF_C_BUFFER_SIMPLE_CLEAR(&simple);
-    if (!write_succeeded) {
-        goto cleanup;
+static void batch_reporter_destroy(jaeger_batch_reporter* reporter)
+{
+    process_destroy(&reporter->process);
+    if (reporter->process_field != NULL) {
+        jaeger_free(reporter->process_field);
+        reporter->process_field = NULL;
     }
-    const int num_flushed = batch.n_spans;
-    for (int i = 0; i < num_flushed; i++) {
-        if (batch.spans[i] == NULL) {
+
+    for (int i = 0, len = jaeger_vector_length(&reporter->spans); i < len;
+         i++) {
+        void** span = jaeger_vector_offset(&reporter->spans, i);
+        assert(span != NULL);
+        if (*span == NULL) {
             continue;
         }
-        jaeger_span_protobuf_destroy(batch.spans[i]);
-        jaeger_free(batch.spans[i]);
+        jaeger_free(*span);
+    }
+    jaeger_vector_destroy(&reporter->spans);
+
+    void* span = NULL;
+    while (jaeger_mpsc_queue_pop(&reporter->queue, &span)) {
+        jaeger_free(span);
+    }
+    jaeger_mpsc_queue_destroy(&reporter->queue);
+
+    if (reporter->stage_per_thread) {
+        /* Threads that have not exited still point at their stage, but
+         * deleting the key means it is never destroyed on their exit. */
+        jaeger_thread_local_destroy(&reporter->stage_key);
+        reporter->stage_per_thread = false;
     }
-    jaeger_free(batch.spans);
-    if (reporter->metrics != NULL) {
-        jaeger_counter* num_success = reporter->metrics->reporter_success;
-        assert(num_success != NULL);
-        num_success->inc(num_success, num_flushed);
+    while (reporter->stages != NULL) {
+        span_stage* stage = reporter->stages;
+        reporter->stages = stage->next;
+        staged_spans_free(stage->buffer);
+        jaeger_free(stage);
     }
-    remote_reporter_update_queue_length(reporter);
-    return true;
+    staged_spans_free(reporter->spare_stage_buffer);
+    reporter->spare_stage_buffer = NULL;
 
-cleanup:
-    if (reporter->spans.data != NULL) {
-        /* No need to delete the span pointers because they are still valid
-         * and in batch's buffer. */
-        jaeger_free(reporter->spans.data);
-        reporter->spans.data = NULL;
-    }
-    reporter->spans.data = (char*) batch.spans;
-    reporter->spans.len = num_spans;
-    remote_reporter_update_queue_length(reporter);
-    return false;
+    jaeger_cond_destroy(&reporter->cond);
+    jaeger_mutex_destroy(&reporter->mutex);
 }
 
-static bool remote_reporter_flush(jaeger_reporter* r)
+#ifdef IOV_MAX
+#define MAX_IOVECS_PER_PACKET IOV_MAX
+#else
+#define MAX_IOVECS_PER_PACKET 1024
+#endif /* IOV_MAX */
+
+/* Kernel limits on a single UDP_SEGMENT send. */
+#define MAX_SEGMENTS_PER_SEND 64
+#define MAX_UDP_PAYLOAD_SIZE 65507
+
+#ifdef HAVE_SENDMMSG
+typedef struct mmsghdr packet_message;
+#else
+/* Same layout as struct mmsghdr, which is only available with sendmmsg. */
+typedef struct packet_message {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+} packet_message;
+#endif /* HAVE_SENDMMSG */
+
+/* Protobuf and Thrift padding headers have the same size. */
+#define PADDING_HEADER_SIZE JAEGERTRACINGC_PROTOBUF_PADDING_HEADER_SIZE
+
+/* Describes one packet of a flush. For protobuf, its iovecs hold the spans
+ * followed by the process. For Thrift, they hold the message header, the
+ * spans header, the spans and the message trailer. With segmentation
+ * offload, two more iovecs for the padding header and padding bytes follow
+ * the spans and process, but come before the Thrift trailer. */
+typedef struct packet_layout {
+    int first_iovec;
+    /* Number of iovecs including padding. */
+    int num_iovecs;
+    /* Index of padding header iovec, -1 if packet is not padded. */
+    int padding_iovec;
+    /* Index of Thrift spans header iovec, -1 for protobuf. */
+    int spans_header_iovec;
+    int num_spans;
+    /* Size excluding padding. */
+    int size;
+    /* Size of padding including header, zero if packet is not padded. */
+    int padding_size;
+    uint8_t padding_header[PADDING_HEADER_SIZE];
+    uint8_t spans_header[JAEGERTRACINGC_THRIFT_MAX_SPANS_HEADER_SIZE];
+    /* Index of message that sends this packet. */
+    int message;
+} packet_layout;
+
+/* Sends as many messages as possible in a single system call if sendmmsg is
+ * available, otherwise one at a time. Sets msg_len of each sent message to
+ * the number of bytes written. Returns number of messages sent, or -1 if the
+ * first message could not be sent. */
+static int send_packets(int fd, packet_message* messages, int num_messages)
 {
-    assert(r != NULL);
-
-    jaeger_remote_reporter* reporter = (jaeger_remote_reporter*) r;
-    bool success = true;
-    jaeger_mutex_lock(&reporter->mutex);
-    for (int num_spans = jaeger_vector_length(&reporter->spans); num_spans > 0;
-         num_spans = jaeger_vector_length(&reporter->spans)) {
-        if (!remote_reporter_flush_batch(reporter)) {
-            success = false;
-            break;
+#ifdef HAVE_SENDMMSG
+    return sendmmsg(fd, messages, num_messages, 0);
+#else
+    for (int i = 0; i < num_messages; i++) {
+        const ssize_t num_written = sendmsg(fd, &messages[i].msg_hdr, 0);
+        if (num_written < 0) {
+            return (i > 0) ? i : -1;
         }
+        messages[i].msg_len = num_written;
     }
-    jaeger_mutex_unlock(&reporter->mutex);
-    return success;
+    return num_messages;
+#endif /* HAVE_SENDMMSG */
 }
 
-bool jaeger_remote_reporter_init(jaeger_remote_reporter* reporter,
-                                 const char* host_port_str,
-                                 int max_packet_size,
-                                 jaeger_metrics* metrics)
+static inline int packet_message_size(const packet_message* message)
 {
-    assert(reporter != NULL);
+    int size = 0;
+    for (int i = 0; i < (int) message->msg_hdr.msg_iovlen; i++) {
+        size += message->msg_hdr.msg_iov[i].iov_len;
+    }
+    return size;
+}
 
-    const int fd = open_socket(AF_INET, SOCK_DGRAM);
-    if (fd < 0) {
-        return false;
+/* Delay address resolution until the first write. Tries sending the packet
+ * to each candidate address and keeps the first one that works. */
+static bool remote_reporter_resolve_addr(jaeger_remote_reporter* reporter,
+                                         struct msghdr* message,
+                                         int packet_size)
+{
+    bool success = false;
+    for (struct addrinfo* iter = reporter->candidates; iter != NULL;
+         iter = iter->ai_next) {
+        message->msg_name = iter->ai_addr;
+        message->msg_namelen = iter->ai_addrlen;
+        if (sendmsg(reporter->fd, message, 0) == packet_size &&
+            sizeof(reporter->addr) == iter->ai_addrlen) {
+            memcpy(&reporter->addr, iter->ai_addr, sizeof(reporter->addr));
+            success = true;
+            break;
+        }
     }
-    reporter->fd = fd;
+    message->msg_name = &reporter->addr;
+    message->msg_namelen = sizeof(reporter->addr);
 
-    reporter->process = (Jaeger__Model__Process) JAEGER__MODEL__PROCESS__INIT;
-    reporter->max_packet_size = (max_packet_size > 0)
-                                    ? max_packet_size
-                                    : JAEGERTRACINGC_DEFAULT_UDP_BUFFER_SIZE;
-    if (!jaeger_vector_init(&reporter->spans, sizeof(Jaeger__Model__Span*))) {
-        goto cleanup;
+    freeaddrinfo(reporter->candidates);
+    reporter->candidates = NULL;
+    if (!success) {
+        jaeger_log_error("Failed to resolve remote reporter host port");
+        batch_reporter_count_failures(&reporter->base, 1);
     }
+    return success;
+}
 
-    jaeger_host_port host_port =
-        (jaeger_host_port) JAEGERTRACINGC_HOST_PORT_INIT;
-    if (host_port_str == NULL || strlen(host_port_str) == 0) {
-        host_port_str = JAEGERTRACINGC_DEFAULT_UDP_SPAN_SERVER_HOST_PORT;
+/* Turns on UDP_SEGMENT for the socket if the kernel supports it. Every
+ * segment but the last must have exactly the segment size, so also allocates
+ * the zero bytes used to pad packets. */
+static void
+remote_reporter_enable_segmentation_offload(jaeger_remote_reporter* reporter)
+{
+#ifdef UDP_SEGMENT
+    const int segment_size = reporter->max_packet_size;
+    if (!reporter->segmentation_offload ||
+        2 * segment_size > MAX_UDP_PAYLOAD_SIZE) {
+        return;
     }
-    if (!jaeger_host_port_scan(&host_port, host_port_str)) {
-        goto cleanup_host_port;
+    if (setsockopt(reporter->fd,
+                   SOL_UDP,
+                   UDP_SEGMENT,
+                   &segment_size,
+                   sizeof(segment_size)) != 0) {
+        jaeger_log_info("UDP segmentation offload not supported, errno = %d",
+                        errno);
+        return;
+    }
+    uint8_t* padding = jaeger_malloc(segment_size);
+    if (padding == NULL) {
+        jaeger_log_error("Cannot allocate packet padding, size = %d",
+                         segment_size);
+        const int no_segment_size = 0;
+        setsockopt(reporter->fd,
+                   SOL_UDP,
+                   UDP_SEGMENT,
+                   &no_segment_size,
+                   sizeof(no_segment_size));
+        return;
     }
+    memset(padding, 0, segment_size);
+    reporter->padding = padding;
+    reporter->segment_size = segment_size;
+#else
+    (void) reporter;
+#endif /* UDP_SEGMENT */
+}
 
-    reporter->candidates = NULL;
-    struct addrinfo* candidates = NULL;
-    memset(&reporter->addr, 0, sizeof(reporter->addr));
-    if (!jaeger_host_port_resolve(&host_port, SOCK_DGRAM, &candidates)) {
-        goto cleanup_host_port;
+static void
+remote_reporter_disable_segmentation_offload(jaeger_remote_reporter* reporter)
+{
+#ifdef UDP_SEGMENT
+    const int segment_size = 0;
+    setsockopt(reporter->fd,
+               SOL_UDP,
+               UDP_SEGMENT,
+               &segment_size,
+               sizeof(segment_size));
+#endif /* UDP_SEGMENT */
+    reporter->segment_size = 0;
+    if (reporter->padding != NULL) {
+        jaeger_free(reporter->padding);
+        reporter->padding = NULL;
     }
-    reporter->candidates = candidates;
+}
 
-    jaeger_host_port_destroy(&host_port);
-    reporter->metrics = metrics;
-    ((jaeger_destructible*) reporter)->destroy = &remote_reporter_destroy;
-    ((jaeger_reporter*) reporter)->report = &remote_reporter_report;
-    ((jaeger_reporter*) reporter)->flush = &remote_reporter_flush;
-    reporter->mutex = (jaeger_mutex) JAEGERTRACINGC_MUTEX_INIT;
-    return true;
+/* IPv4 and UDP header sizes, which come out of the MTU. */
+#define UDP_IPV4_HEADERS_SIZE 28
+/* Ethernet MTU, assumed if the path MTU cannot be read. */
+#define DEFAULT_PATH_MTU 1500
+
+/* Largest payload that reaches the address a socket is connected to without
+ * IP fragmentation. */
+static int path_max_payload_size(int fd, const struct sockaddr_in* addr)
+{
+#ifdef IP_MTU
+    int mtu = 0;
+    socklen_t mtu_len = sizeof(mtu);
+    if (getsockopt(fd, IPPROTO_IP, IP_MTU, &mtu, &mtu_len) == 0 &&
+        mtu > UDP_IPV4_HEADERS_SIZE) {
+        return JAEGERTRACINGC_MIN(mtu - UDP_IPV4_HEADERS_SIZE,
+                                  MAX_UDP_PAYLOAD_SIZE);
+    }
+    jaeger_log_warn("Cannot read path MTU, errno = %d", errno);
+#else
+    (void) fd;
+#endif /* IP_MTU */
+    /* Loopback never fragments. */
+    if ((ntohl(addr->sin_addr.s_addr) >> 24) == IN_LOOPBACKNET) {
+        return MAX_UDP_PAYLOAD_SIZE;
+    }
+    return DEFAULT_PATH_MTU - UDP_IPV4_HEADERS_SIZE;
+}
+
+/* Sets the maximum packet size to fit the path to addr. The path MTU can grow
+ * back, so the size given at init is the only upper bound. */
+static void remote_reporter_fit_path_mtu(jaeger_remote_reporter* reporter,
+                                         int fd,
+                                         const struct sockaddr_in* addr)
+{
+    const int max_packet_size = JAEGERTRACINGC_MIN(
+        reporter->packet_size_limit, path_max_payload_size(fd, addr));
+    if (max_packet_size != reporter->max_packet_size) {
+        jaeger_log_info("Fitting UDP packets to path MTU, "
+                        "maximum packet size = %d",
+                        max_packet_size);
+        reporter->max_packet_size = max_packet_size;
+    }
+    if (reporter->base.metrics != NULL) {
+        jaeger_gauge* gauge = reporter->base.metrics->reporter_max_packet_size;
+        assert(gauge != NULL);
+        gauge->update(gauge, max_packet_size);
+    }
+}
+
+/* Without a connected socket, reads the path MTU through a temporary socket
+ * connected to the first candidate address. Connecting a UDP socket sends
+ * nothing. */
+static void remote_reporter_probe_path_mtu(jaeger_remote_reporter* reporter)
+{
+    for (const struct addrinfo* iter = reporter->candidates; iter != NULL;
+         iter = iter->ai_next) {
+        if (sizeof(reporter->addr) != iter->ai_addrlen) {
+            continue;
+        }
+        const int fd = open_socket(AF_INET, SOCK_DGRAM);
+        if (fd < 0) {
+            return;
+        }
+        if (connect(fd, iter->ai_addr, iter->ai_addrlen) == 0) {
+            remote_reporter_fit_path_mtu(
+                reporter, fd, (const struct sockaddr_in*) iter->ai_addr);
+        }
+        close(fd);
+        return;
+    }
+}
+
+/* Connects the socket to the first candidate address that accepts it, so
+ * messages can be sent without a destination address. */
+static bool remote_reporter_connect(jaeger_remote_reporter* reporter)
+{
+    bool success = false;
+    for (struct addrinfo* iter = reporter->candidates; iter != NULL;
+         iter = iter->ai_next) {
+        if (sizeof(reporter->addr) == iter->ai_addrlen &&
+            connect(reporter->fd, iter->ai_addr, iter->ai_addrlen) == 0) {
+            memcpy(&reporter->addr, iter->ai_addr, sizeof(reporter->addr));
+            success = true;
+            break;
+        }
+    }
+
+    freeaddrinfo(reporter->candidates);
+    reporter->candidates = NULL;
+    if (!success) {
+        jaeger_log_error("Failed to connect to remote reporter host port, "
+                         "errno = %d",
+                         errno);
+        batch_reporter_count_failures(&reporter->base, 1);
+        return false;
+    }
+    if (reporter->path_mtu_discovery) {
+#ifdef IP_PMTUDISC_DO
+        /* Set don't fragment, so sends larger than the path MTU fail with
+         * EMSGSIZE instead of being fragmented. */
+        const int mtu_discover = IP_PMTUDISC_DO;
+        setsockopt(reporter->fd,
+                   IPPROTO_IP,
+                   IP_MTU_DISCOVER,
+                   &mtu_discover,
+                   sizeof(mtu_discover));
+#endif /* IP_PMTUDISC_DO */
+        remote_reporter_fit_path_mtu(reporter, reporter->fd, &reporter->addr);
+    }
+    remote_reporter_enable_segmentation_offload(reporter);
+    return true;
+}
+
+static inline void remote_reporter_count_packets(
+    jaeger_remote_reporter* reporter, int num_packets, int64_t num_bytes)
+{
+    jaeger_metrics* metrics = reporter->base.metrics;
+    if (metrics == NULL || num_packets == 0) {
+        return;
+    }
+    jaeger_counter* packets = metrics->reporter_packets;
+    jaeger_counter* packet_bytes = metrics->reporter_packet_bytes;
+    jaeger_gauge* fill_percent = metrics->reporter_packet_fill_percent;
+    assert(packets != NULL);
+    assert(packet_bytes != NULL);
+    assert(fill_percent != NULL);
+    packets->inc(packets, num_packets);
+    packet_bytes->inc(packet_bytes, num_bytes);
+    const int64_t capacity = (int64_t) num_packets * reporter->max_packet_size;
+    fill_percent->update(fill_percent, num_bytes * 100 / capacity);
+}
+
+/* Bytes a packet needs besides the encoded process and spans. */
+static inline int
+remote_reporter_framing_size(const jaeger_remote_reporter* reporter,
+                             int num_spans)
+{
+    if (reporter->base.format != jaeger_reporter_format_thrift_compact) {
+        return 0;
+    }
+    return jaeger_thrift_spans_header_size(num_spans) +
+           JAEGERTRACINGC_THRIFT_EMIT_BATCH_TRAILER_SIZE;
+}
+
+static inline bool append_iovec(jaeger_vector* iovecs,
+                                packet_layout* packet,
+                                const void* data,
+                                int len)
+{
+    struct iovec* iov = jaeger_vector_append(iovecs);
+    if (iov == NULL) {
+        return false;
+    }
+    *iov = (struct iovec){.iov_base = (void*) data, .iov_len = len};
+    packet->num_iovecs++;
+    return true;
+}
+
+/* Describes a packet made of the given spans and the encoded process. Packet
+ * data is not copied, the iovecs point at the encoded spans. With
+ * segmentation offload, the packet is padded up to the segment size if there
+ * is room for a padding field. */
+static bool remote_reporter_append_packet(jaeger_remote_reporter* reporter,
+                                          queued_span** spans,
+                                          int num_spans,
+                                          int packet_size)
+{
+    const bool thrift =
+        (reporter->base.format == jaeger_reporter_format_thrift_compact);
+    jaeger_vector* iovecs = &reporter->iovecs;
+    const int first_iovec = jaeger_vector_length(iovecs);
+    packet_layout* packet = jaeger_vector_append(&reporter->packets);
+    if (packet == NULL) {
+        return false;
+    }
+    *packet = (packet_layout){.first_iovec = first_iovec,
+                              .num_iovecs = 0,
+                              .padding_iovec = -1,
+                              .spans_header_iovec = -1,
+                              .num_spans = num_spans,
+                              .size = packet_size,
+                              .padding_size = 0,
+                              .message = -1};
+    /* Headers are in packet layout, which may still move, so their iov_base
+     * is set once all packets are known. */
+    if (thrift) {
+        if (!append_iovec(iovecs,
+                          packet,
+                          reporter->base.process_field,
+                          reporter->base.process_field_size)) {
+            goto cleanup;
+        }
+        packet->spans_header_iovec = jaeger_vector_length(iovecs);
+        if (!append_iovec(
+                iovecs,
+                packet,
+                NULL,
+                jaeger_thrift_pack_spans_header(num_spans,
+                                                packet->spans_header))) {
+            goto cleanup;
+        }
+    }
+    for (int i = 0; i < num_spans; i++) {
+        if (!append_iovec(
+                iovecs, packet, spans[i]->encoded, spans[i]->encoded_size)) {
+            goto cleanup;
+        }
+    }
+    /* Protobuf allows fields in any order, so append process after the
+     * spans. */
+    if (!thrift && reporter->base.process_field_size > 0 &&
+        !append_iovec(iovecs,
+                      packet,
+                      reporter->base.process_field,
+                      reporter->base.process_field_size)) {
+        goto cleanup;
+    }
+
+    const int padding_size = reporter->segment_size - packet_size;
+    if (padding_size >= PADDING_HEADER_SIZE) {
+        packet->padding_iovec = jaeger_vector_length(iovecs);
+        if (!append_iovec(iovecs, packet, NULL, PADDING_HEADER_SIZE) ||
+            !append_iovec(iovecs,
+                          packet,
+                          reporter->padding,
+                          padding_size - PADDING_HEADER_SIZE)) {
+            goto cleanup;
+        }
+        if (thrift) {
+            assert(JAEGERTRACINGC_THRIFT_PADDING_HEADER_SIZE ==
+                   PADDING_HEADER_SIZE);
+            jaeger_thrift_pack_padding_header(padding_size,
+                                              packet->padding_header);
+        }
+        else {
+            jaeger_protobuf_pack_padding_header(padding_size,
+                                                packet->padding_header);
+        }
+        packet->padding_size = padding_size;
+    }
+    if (thrift &&
+        !append_iovec(iovecs,
+                      packet,
+                      jaeger_thrift_emit_batch_trailer,
+                      JAEGERTRACINGC_THRIFT_EMIT_BATCH_TRAILER_SIZE)) {
+        goto cleanup;
+    }
+    return true;
 
-cleanup_host_port:
-    jaeger_host_port_destroy(&host_port);
+cleanup:
+    reporter->iovecs.len = first_iovec;
+    reporter->packets.len--;
+    return false;
+}
+
+/* Builds the message headers for the packets. Without segmentation offload
+ * each packet is its own message. With it, runs of packets padded to the
+ * segment size are sent as one message that the kernel splits back into
+ * datagrams. */
+static bool remote_reporter_build_messages(jaeger_remote_reporter* reporter)
+{
+    struct iovec* iovecs = (struct iovec*) reporter->iovecs.data;
+    packet_layout* packets = (packet_layout*) reporter->packets.data;
+    const int num_packets = jaeger_vector_length(&reporter->packets);
+    const int segment_size = reporter->segment_size;
+    const int max_segments =
+        (segment_size > 0) ? MAX_UDP_PAYLOAD_SIZE / segment_size : 1;
+    reporter->messages.len = 0;
+    for (int i = 0; i < num_packets;) {
+        int end = i + 1;
+        while (end < num_packets && end - i < MAX_SEGMENTS_PER_SEND &&
+               end - i < max_segments &&
+               packets[end - 1].size + packets[end - 1].padding_size ==
+                   segment_size &&
+               packets[end].first_iovec + packets[end].num_iovecs -
+                       packets[i].first_iovec <=
+                   MAX_IOVECS_PER_PACKET) {
+            end++;
+        }
+
+        packet_message* message = jaeger_vector_append(&reporter->messages);
+        if (message == NULL) {
+            return false;
+        }
+        memset(message, 0, sizeof(*message));
+        if (!reporter->connect_socket) {
+            message->msg_hdr.msg_name = &reporter->addr;
+            message->msg_hdr.msg_namelen = sizeof(reporter->addr);
+        }
+        const packet_layout* last = &packets[end - 1];
+        message->msg_hdr.msg_iov = &iovecs[packets[i].first_iovec];
+        message->msg_hdr.msg_iovlen =
+            last->first_iovec + last->num_iovecs - packets[i].first_iovec;
+        for (; i < end; i++) {
+            packet_layout* packet = &packets[i];
+            if (packet->spans_header_iovec >= 0) {
+                iovecs[packet->spans_header_iovec].iov_base =
+                    packet->spans_header;
+            }
+            if (packet->padding_iovec >= 0) {
+                struct iovec* padding = &iovecs[packet->padding_iovec];
+                if (i == end - 1) {
+                    /* The kernel allows the last segment to be shorter, so
+                     * leave out its padding. */
+                    padding[0].iov_len = 0;
+                    padding[1].iov_len = 0;
+                }
+                else {
+                    padding[0].iov_base = packet->padding_header;
+                }
+            }
+            packet->message = jaeger_vector_length(&reporter->messages) - 1;
+        }
+    }
+    return true;
+}
+
+/* Sends buffered spans in as few packets as possible, packing greedily in a
+ * single pass. Spans were encoded when reported, so every packet is described
+ * up front as a list of iovecs into the encoded spans and all packets are
+ * submitted together. Spans that could not be sent remain at the front of
+ * the buffer. Caller must hold reporter mutex. */
+static bool remote_reporter_send_spans(jaeger_batch_reporter* r)
+{
+    jaeger_remote_reporter* reporter = (jaeger_remote_reporter*) r;
+    bool success = true;
+    if (reporter->connect_socket && reporter->candidates != NULL &&
+        !remote_reporter_connect(reporter)) {
+        success = false;
+    }
+
+    queued_span** spans = (queued_span**) r->spans.data;
+    const int num_spans = jaeger_vector_length(&r->spans);
+    const int process_size = reporter->base.process_field_size;
+    const bool thrift = (r->format == jaeger_reporter_format_thrift_compact);
+    if (thrift && process_size == 0) {
+        /* Thrift message header holds the process, keep spans until it can
+         * be built. */
+        jaeger_log_error("Cannot send Thrift batch without process");
+        return false;
+    }
+    const int max_spans_per_packet =
+        MAX_IOVECS_PER_PACKET - ((process_size > 0) ? 1 : 0) -
+        ((reporter->segment_size > 0) ? 2 : 0) - (thrift ? 2 : 0);
+    int num_dropped = 0;
+
+    /* Assign spans to packets. Spans that go into a packet are compacted to
+     * the front of the buffer in packet order, dropped spans are removed. */
+    reporter->iovecs.len = 0;
+    reporter->packets.len = 0;
+    int num_packed = 0;
+    int next = 0;
+    while (next < num_spans) {
+        int spans_size = 0;
+        int num_packet_spans = 0;
+        for (; next + num_packet_spans < num_spans &&
+               num_packet_spans < max_spans_per_packet;
+             num_packet_spans++) {
+            const int span_size = spans[next + num_packet_spans]->encoded_size;
+            if (process_size + spans_size + span_size +
+                    remote_reporter_framing_size(reporter,
+                                                 num_packet_spans + 1) >
+                reporter->max_packet_size) {
+                break;
+            }
+            spans_size += span_size;
+        }
+        const int packet_size =
+            process_size + spans_size +
+            remote_reporter_framing_size(reporter, num_packet_spans);
+
+        if (num_packet_spans == 0) {
+            jaeger_log_error("Span is too large to send in a single packet, "
+                             "dropping span, "
+                             "span size = %d, "
+                             "process size = %d, "
+                             "maximum packet size = %d",
+                             spans[next]->encoded_size,
+                             process_size,
+                             reporter->max_packet_size);
+            jaeger_free(spans[next]);
+            next++;
+            num_dropped++;
+            success = false;
+            continue;
+        }
+
+        if (!remote_reporter_append_packet(
+                reporter, &spans[next], num_packet_spans, packet_size)) {
+            jaeger_log_error("Cannot allocate packet description, "
+                             "number of packets = %d",
+                             jaeger_vector_length(&reporter->packets));
+            success = false;
+            break;
+        }
+        memmove(&spans[num_packed],
+                &spans[next],
+                sizeof(*spans) * num_packet_spans);
+        num_packed += num_packet_spans;
+        next += num_packet_spans;
+    }
+    memmove(&spans[num_packed],
+            &spans[next],
+            sizeof(*spans) * (num_spans - next));
+    const int num_buffered = num_packed + num_spans - next;
+
+    /* Describe the messages now that the iovec buffer is no longer
+     * growing. */
+    bool can_send = true;
+    if (!remote_reporter_build_messages(reporter)) {
+        jaeger_log_error("Cannot allocate message headers, "
+                         "number of packets = %d",
+                         jaeger_vector_length(&reporter->packets));
+        success = false;
+        can_send = false;
+    }
+    packet_message* messages = (packet_message*) reporter->messages.data;
+    const int num_messages =
+        can_send ? jaeger_vector_length(&reporter->messages) : 0;
+
+    /* Resolution failure leaves the address unset, so do not bother sending
+     * the rest. */
+    int num_sent_messages = 0;
+    if (num_messages > 0 && reporter->candidates != NULL) {
+        const int message_size = packet_message_size(&messages[0]);
+        can_send = remote_reporter_resolve_addr(
+            reporter, &messages[0].msg_hdr, message_size);
+        if (can_send) {
+            messages[0].msg_len = message_size;
+            num_sent_messages = 1;
+        }
+        else {
+            success = false;
+        }
+    }
+    while (can_send && num_sent_messages < num_messages) {
+        const int num_written =
+            send_packets(reporter->fd,
+                         &messages[num_sent_messages],
+                         num_messages - num_sent_messages);
+        if (num_written < 0) {
+            /* Leave unsent packets' spans buffered for the next flush. */
+            jaeger_log_error("Cannot write packets to UDP socket, "
+                             "num messages = %d, errno = %d",
+                             num_messages - num_sent_messages,
+                             errno);
+            if (errno == EIO && reporter->segment_size > 0) {
+                /* Device cannot segment, next flush sends packets one by
+                 * one. */
+                jaeger_log_warn("Disabling UDP segmentation offload");
+                remote_reporter_disable_segmentation_offload(reporter);
+            }
+            else if (errno == EMSGSIZE && reporter->connect_socket &&
+                     reporter->path_mtu_discovery) {
+                /* Path MTU dropped, next flush packs spans to fit. */
+                remote_reporter_fit_path_mtu(
+                    reporter, reporter->fd, &reporter->addr);
+                if (reporter->segment_size > 0) {
+                    remote_reporter_disable_segmentation_offload(reporter);
+                    remote_reporter_enable_segmentation_offload(reporter);
+                }
+            }
+            batch_reporter_count_failures(r, 1);
+            success = false;
+            break;
+        }
+        num_sent_messages += num_written;
+    }
+
+    /* Sent spans are at the front of the buffer in packet order. */
+    const packet_layout* packets = (packet_layout*) reporter->packets.data;
+    const int num_packets = jaeger_vector_length(&reporter->packets);
+    int num_sent = 0;
+    int num_truncated = 0;
+    int num_sent_packets = 0;
+    int64_t num_sent_bytes = 0;
+    for (int i = 0, packet = 0; i < num_sent_messages; i++) {
+        const int first_packet = packet;
+        int num_message_spans = 0;
+        int64_t num_message_bytes = 0;
+        for (; packet < num_packets && packets[packet].message == i;
+             packet++) {
+            num_message_spans += packets[packet].num_spans;
+            num_message_bytes += packets[packet].size;
+        }
+        const int message_size = packet_message_size(&messages[i]);
+        if ((int) messages[i].msg_len == message_size) {
+            num_sent += num_message_spans;
+            num_sent_packets += packet - first_packet;
+            num_sent_bytes += num_message_bytes;
+            continue;
+        }
+        jaeger_log_error("Cannot write entire message to UDP socket, "
+                         "num written = %u, message size = %d",
+                         messages[i].msg_len,
+                         message_size);
+        batch_reporter_count_failures(r, 1);
+        num_truncated += num_message_spans;
+        success = false;
+    }
+    r->spans.len = num_buffered;
+    batch_reporter_consume_spans(r, num_sent + num_truncated);
+
+    if (num_sent > 0) {
+        batch_reporter_count_successes(r, num_sent);
+    }
+    if (num_dropped + num_truncated > 0) {
+        batch_reporter_drop_spans(r, num_dropped + num_truncated);
+    }
+    remote_reporter_count_packets(reporter, num_sent_packets, num_sent_bytes);
+    return success;
+}
+
+static void remote_reporter_destroy(jaeger_destructible* destructible)
+{
+    if (destructible == NULL) {
+        return;
+    }
+    jaeger_remote_reporter* r = (jaeger_remote_reporter*) destructible;
+    batch_reporter_stop(&r->base);
+
+    if (r->fd >= 0) {
+        close(r->fd);
+        r->fd = -1;
+    }
+
+    if (r->candidates != NULL) {
+        freeaddrinfo(r->candidates);
+        r->candidates = NULL;
+    }
+
+    jaeger_vector_destroy(&r->iovecs);
+    jaeger_vector_destroy(&r->packets);
+    jaeger_vector_destroy(&r->messages);
+    if (r->padding != NULL) {
+        jaeger_free(r->padding);
+        r->padding = NULL;
+    }
+
+    batch_reporter_destroy(&r->base);
+}
+
+bool jaeger_remote_reporter_init(jaeger_remote_reporter* reporter,
+                                 const char* host_port_str,
+                                 int max_packet_size,
+                                 jaeger_metrics* metrics,
+                                 const jaeger_remote_reporter_options* options)
+{
+    assert(reporter != NULL);
+
+    const jaeger_remote_reporter_options default_options =
+        JAEGERTRACINGC_REMOTE_REPORTER_OPTIONS_INIT;
+    if (options == NULL) {
+        options = &default_options;
+    }
+    reporter->fd = -1;
+    reporter->max_packet_size = (max_packet_size > 0)
+                                    ? max_packet_size
+                                    : JAEGERTRACINGC_DEFAULT_UDP_BUFFER_SIZE;
+    reporter->packet_size_limit = reporter->max_packet_size;
+    reporter->iovecs = (jaeger_vector) JAEGERTRACINGC_VECTOR_INIT;
+    reporter->packets = (jaeger_vector) JAEGERTRACINGC_VECTOR_INIT;
+    reporter->messages = (jaeger_vector) JAEGERTRACINGC_VECTOR_INIT;
+    reporter->connect_socket = options->connect_socket;
+    reporter->segmentation_offload = options->segmentation_offload;
+    reporter->path_mtu_discovery = options->path_mtu_discovery;
+    reporter->segment_size = 0;
+    reporter->padding = NULL;
+    reporter->candidates = NULL;
+    memset(&reporter->addr, 0, sizeof(reporter->addr));
+    if (!batch_reporter_init(&reporter->base,
+                             metrics,
+                             &options->flush_interval,
+                             options->queue_size,
+                             reporter->max_packet_size,
+                             options->format,
+                             options->stage_per_thread,
+                             &remote_reporter_destroy,
+                             &remote_reporter_send_spans)) {
+        return false;
+    }
+
+    const int fd = open_socket(AF_INET, SOCK_DGRAM);
+    if (fd < 0) {
+        goto cleanup;
+    }
+    reporter->fd = fd;
+
+    if (!jaeger_vector_init(&reporter->iovecs, sizeof(struct iovec)) ||
+        !jaeger_vector_init(&reporter->packets, sizeof(packet_layout)) ||
+        !jaeger_vector_init(&reporter->messages, sizeof(packet_message))) {
+        goto cleanup;
+    }
+
+    jaeger_host_port host_port =
+        (jaeger_host_port) JAEGERTRACINGC_HOST_PORT_INIT;
+    if (host_port_str == NULL || strlen(host_port_str) == 0) {
+        host_port_str = JAEGERTRACINGC_DEFAULT_UDP_SPAN_SERVER_HOST_PORT;
+    }
+    if (!jaeger_host_port_scan(&host_port, host_port_str)) {
+        goto cleanup_host_port;
+    }
+
+    struct addrinfo* candidates = NULL;
+    if (!jaeger_host_port_resolve(&host_port, SOCK_DGRAM, &candidates)) {
+        goto cleanup_host_port;
+    }
+    reporter->candidates = candidates;
+
+    jaeger_host_port_destroy(&host_port);
+
+    /* A connected socket reads its own path MTU once connected. */
+    if (reporter->path_mtu_discovery && !reporter->connect_socket) {
+        remote_reporter_probe_path_mtu(reporter);
+    }
+
+    if (!batch_reporter_start(&reporter->base)) {
+        goto cleanup;
+    }
+    return true;
+
+cleanup_host_port:
+    jaeger_host_port_destroy(&host_port);
 cleanup:
     remote_reporter_destroy((jaeger_destructible*) reporter);
     return false;
 }
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif /* MSG_NOSIGNAL */
+
+#define HTTP_REPORTER_READ_BUFFER_SIZE 4096
+
+#define MILLISECONDS_PER_SECOND 1000
+#define NANOSECONDS_PER_MILLISECOND 1000000
+
+/* Longest Content-Length value and end of headers. */
+#define HTTP_REPORTER_MAX_CONTENT_LENGTH_LEN 16
+
+/* Progress of the responses to requests written in a single flush. */
+typedef struct http_reporter_exchange {
+    const int* request_spans;
+    int num_requests;
+    int num_responses;
+    int num_accepted;
+    int num_rejected;
+    int num_failed_requests;
+    bool keep_alive;
+} http_reporter_exchange;
+
+static int http_reporter_on_message_complete(http_parser* parser)
+{
+    assert(parser != NULL);
+    assert(parser->data != NULL);
+    http_reporter_exchange* exchange = parser->data;
+    if (exchange->num_responses >= exchange->num_requests) {
+        jaeger_log_error("Received unexpected HTTP response from collector");
+        return 1;
+    }
+    const int num_spans = exchange->request_spans[exchange->num_responses];
+    exchange->num_responses++;
+    if (parser->status_code >= 200 && parser->status_code < 300) {
+        exchange->num_accepted += num_spans;
+    }
+    else {
+        jaeger_log_error("Collector rejected spans, "
+                         "HTTP status code = %d, num spans = %d",
+                         parser->status_code,
+                         num_spans);
+        exchange->num_rejected += num_spans;
+        exchange->num_failed_requests++;
+    }
+    if (!http_should_keep_alive(parser)) {
+        exchange->keep_alive = false;
+    }
+    return 0;
+}
+
+static inline int64_t duration_milliseconds(const jaeger_duration* duration)
+{
+    return (int64_t) duration->value.tv_sec * MILLISECONDS_PER_SECOND +
+           duration->value.tv_nsec / NANOSECONDS_PER_MILLISECOND;
+}
+
+static inline int64_t monotonic_milliseconds(void)
+{
+    jaeger_duration now;
+    jaeger_duration_now(&now);
+    return duration_milliseconds(&now);
+}
+
+/* Waits until the connection is ready for any of events. Returns the events
+ * that are ready, or zero if the deadline passes or the reporter is stopped
+ * first. */
+static short http_reporter_wait(jaeger_http_reporter* reporter,
+                                short events,
+                                int64_t deadline)
+{
+    struct pollfd fds[] = {
+        {.fd = reporter->fd, .events = events, .revents = 0},
+        {.fd = reporter->stop_fds[0], .events = POLLIN, .revents = 0}};
+    while (true) {
+        const int64_t timeout = deadline - monotonic_milliseconds();
+        if (timeout <= 0) {
+            jaeger_log_error("Timed out waiting for collector, URL = \"%s\"",
+                             reporter->collector_url.str);
+            return 0;
+        }
+        const int result = poll(&fds[0],
+                                sizeof(fds) / sizeof(fds[0]),
+                                (int) JAEGERTRACINGC_MIN(timeout, INT_MAX));
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            jaeger_log_error("Cannot poll collector connection, errno = %d",
+                             errno);
+            return 0;
+        }
+        if (fds[1].revents != 0) {
+            reporter->interrupted = true;
+            return 0;
+        }
+        if (fds[0].revents != 0) {
+            return fds[0].revents;
+        }
+    }
+}
+
+static void http_reporter_close(jaeger_http_reporter* reporter)
+{
+    if (reporter->fd >= 0) {
+        close(reporter->fd);
+        reporter->fd = -1;
+    }
+}
+
+static bool http_reporter_connect(jaeger_http_reporter* reporter,
+                                  int64_t deadline)
+{
+    assert(reporter->fd < 0);
+    jaeger_host_port host_port =
+        (jaeger_host_port) JAEGERTRACINGC_HOST_PORT_INIT;
+    struct addrinfo* host_addrs = NULL;
+    if (!jaeger_host_port_from_url(&host_port, &reporter->collector_url) ||
+        !jaeger_host_port_resolve(&host_port, SOCK_STREAM, &host_addrs)) {
+        jaeger_host_port_destroy(&host_port);
+        return false;
+    }
+    jaeger_host_port_destroy(&host_port);
+
+    bool success = false;
+    for (struct addrinfo* addr_iter = host_addrs; addr_iter != NULL;
+         addr_iter = addr_iter->ai_next) {
+        const int fd = open_socket(addr_iter->ai_family, SOCK_STREAM);
+        if (fd < 0) {
+            continue;
+        }
+        const int flags = fcntl(fd, F_GETFL, 0);
+        if (flags < 0 ||
+            fcntl(fd, F_SETFL, (unsigned) flags | (unsigned) O_NONBLOCK) < 0) {
+            close(fd);
+            continue;
+        }
+
+        reporter->fd = fd;
+        if (connect(fd, addr_iter->ai_addr, addr_iter->ai_addrlen) == 0) {
+            success = true;
+            break;
+        }
+        if (errno == EINPROGRESS &&
+            http_reporter_wait(reporter, POLLOUT, deadline) != 0) {
+            int error = 0;
+            socklen_t error_len = sizeof(error);
+            if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_len) ==
+                    0 &&
+                error == 0) {
+                success = true;
+                break;
+            }
+        }
+        http_reporter_close(reporter);
+        if (reporter->interrupted) {
+            break;
+        }
+    }
+    freeaddrinfo(host_addrs);
+    if (!success) {
+        jaeger_log_error("Cannot connect to collector URL, URL = \"%s\"",
+                         reporter->collector_url.str);
+        return false;
+    }
+    http_parser_init(&reporter->parser, HTTP_RESPONSE);
+    return true;
+}
+
+/* Formats everything in a request before the Content-Length value, which is
+ * the same for every request. */
+static bool
+http_reporter_format_request_header(jaeger_http_reporter* reporter)
+{
+    const jaeger_url* url = &reporter->collector_url;
+    const char* path = "/";
+    int path_len = 1;
+    if ((url->parts.field_set & (1 << UF_PATH)) != 0) {
+        path = &url->str[url->parts.field_data[UF_PATH].off];
+        path_len = url->parts.field_data[UF_PATH].len;
+    }
+
+    jaeger_host_port host_port =
+        (jaeger_host_port) JAEGERTRACINGC_HOST_PORT_INIT;
+    if (!jaeger_host_port_from_url(&host_port, url)) {
+        return false;
+    }
+    char host_port_buffer[HOST_NAME_MAX + JAEGERTRACINGC_MAX_PORT_STR_LEN + 1];
+    const int host_port_len = jaeger_host_port_format(
+        &host_port, &host_port_buffer[0], sizeof(host_port_buffer));
+    jaeger_host_port_destroy(&host_port);
+    if (host_port_len >= (int) sizeof(host_port_buffer)) {
+        jaeger_log_error("Cannot write entire collector host port to buffer, "
+                         "buffer size = %zu, host port string length = %d",
+                         sizeof(host_port_buffer),
+                         host_port_len);
+        return false;
+    }
+
+    static const char header_format[] =
+        "POST %.*s HTTP/1.1\r\n"
+        "Host: %s\r\n"
+        "User-Agent: jaegertracing/%s\r\n"
+        "Content-Type: application/x-protobuf\r\n"
+        "Content-Length: ";
+    const int header_len = snprintf(NULL,
+                                    0,
+                                    header_format,
+                                    path_len,
+                                    path,
+                                    &host_port_buffer[0],
+                                    JAEGERTRACINGC_CLIENT_VERSION);
+    reporter->request_header = jaeger_malloc(header_len + 1);
+    if (reporter->request_header == NULL) {
+        jaeger_log_error("Cannot allocate HTTP request header, size = %d",
+                         header_len + 1);
+        return false;
+    }
+    snprintf(reporter->request_header,
+             header_len + 1,
+             header_format,
+             path_len,
+             path,
+             &host_port_buffer[0],
+             JAEGERTRACINGC_CLIENT_VERSION);
+    reporter->request_header_len = header_len;
+    return true;
+}
+
+/* Serializes requests for spans at the front of the buffer, packing each
+ * PostSpansRequest up to the batch size. Returns number of requests. */
+static int http_reporter_build_requests(jaeger_http_reporter* reporter)
+{
+    jaeger_batch_reporter* base = &reporter->base;
+    queued_span** spans = (queued_span**) base->spans.data;
+    const int num_spans = jaeger_vector_length(&base->spans);
+    reporter->requests.len = 0;
+    reporter->request_spans.len = 0;
+    int num_requests = 0;
+    for (int next = 0; next < num_spans &&
+                       num_requests < reporter->max_pipelined_requests;) {
+        /* A span larger than the batch size is still sent on its own, the
+         * collector has no hard limit. */
+        int batch_size = base->process_field_size;
+        int num_request_spans = 0;
+        while (next + num_request_spans < num_spans &&
+               (num_request_spans == 0 ||
+                batch_size + spans[next + num_request_spans]->encoded_size <=
+                    base->batch_size)) {
+            batch_size += spans[next + num_request_spans]->encoded_size;
+            num_request_spans++;
+        }
+
+        const size_t body_size = jaeger_protobuf_message_field_size(batch_size);
+        char content_length[HTTP_REPORTER_MAX_CONTENT_LENGTH_LEN];
+        const int content_length_len = snprintf(content_length,
+                                                sizeof(content_length),
+                                                "%zu\r\n\r\n",
+                                                body_size);
+        assert(content_length_len < (int) sizeof(content_length));
+        const int request_size =
+            reporter->request_header_len + content_length_len + body_size;
+        const int request_offset = jaeger_vector_length(&reporter->requests);
+        char* request = jaeger_vector_extend(
+            &reporter->requests, request_offset, request_size);
+        if (request == NULL) {
+            break;
+        }
+        int* request_spans = jaeger_vector_append(&reporter->request_spans);
+        if (request_spans == NULL) {
+            reporter->requests.len = request_offset;
+            break;
+        }
+        *request_spans = num_request_spans;
+
+        memcpy(request, reporter->request_header, reporter->request_header_len);
+        request += reporter->request_header_len;
+        memcpy(request, content_length, content_length_len);
+        uint8_t* body = (uint8_t*) &request[content_length_len];
+        body += jaeger_protobuf_pack_message_field_header(
+            JAEGERTRACINGC_PROTOBUF_POST_SPANS_REQUEST_BATCH_FIELD,
+            batch_size,
+            body);
+        for (int i = 0; i < num_request_spans; i++) {
+            const queued_span* span = spans[next + i];
+            memcpy(body, span->encoded, span->encoded_size);
+            body += span->encoded_size;
+        }
+        /* Protobuf allows fields in any order, so append process after the
+         * spans. */
+        memcpy(body, base->process_field, base->process_field_size);
+
+        next += num_request_spans;
+        num_requests++;
+    }
+    if (num_requests == 0 && num_spans > 0) {
+        jaeger_log_error("Cannot allocate HTTP requests, num spans = %d",
+                         num_spans);
+    }
+    return num_requests;
+}
+
+/* Writes requests as the connection accepts them and reads responses as they
+ * arrive, so a collector that answers before reading further requests cannot
+ * deadlock the exchange. Returns false if the connection failed, the deadline
+ * passed or the reporter was stopped before every response was read. */
+static bool http_reporter_exchange_requests(jaeger_http_reporter* reporter,
+                                            http_reporter_exchange* exchange,
+                                            int64_t deadline)
+{
+    const char* data = reporter->requests.data;
+    int num_remaining = jaeger_vector_length(&reporter->requests);
+    reporter->parser.data = exchange;
+    char buffer[HTTP_REPORTER_READ_BUFFER_SIZE];
+    while (exchange->num_responses < exchange->num_requests) {
+        const short events =
+            (num_remaining > 0) ? (POLLIN | POLLOUT) : POLLIN;
+        const short revents = http_reporter_wait(reporter, events, deadline);
+        if (revents == 0) {
+            return false;
+        }
+
+        if (num_remaining > 0 && (revents & POLLOUT) != 0) {
+            const ssize_t num_written =
+                send(reporter->fd, data, num_remaining, MSG_NOSIGNAL);
+            if (num_written >= 0) {
+                data += num_written;
+                num_remaining -= num_written;
+            }
+            else if (errno != EINTR && errno != EAGAIN &&
+                     errno != EWOULDBLOCK) {
+                jaeger_log_error("Cannot write HTTP requests to collector, "
+                                 "num remaining = %d, errno = %d",
+                                 num_remaining,
+                                 errno);
+                return false;
+            }
+        }
+
+        /* Errors and hang ups are reported by the read. */
+        if ((revents & (POLLIN | POLLERR | POLLHUP)) == 0) {
+            continue;
+        }
+        const ssize_t num_read = read(reporter->fd, buffer, sizeof(buffer));
+        if (num_read < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+                continue;
+            }
+            jaeger_log_error("Cannot read HTTP response from collector, "
+                             "errno = %d",
+                             errno);
+            return false;
+        }
+        /* Zero length tells the parser the connection was closed, which
+         * completes a response without Content-Length. */
+        const size_t num_parsed = http_parser_execute(
+            &reporter->parser, &reporter->settings, buffer, num_read);
+        if (num_parsed != (size_t) num_read ||
+            HTTP_PARSER_ERRNO(&reporter->parser) != HPE_OK) {
+            jaeger_log_error(
+                "Cannot parse HTTP response from collector, error = %s",
+                http_errno_name(HTTP_PARSER_ERRNO(&reporter->parser)));
+            return false;
+        }
+        if (num_read == 0) {
+            if (exchange->num_responses < exchange->num_requests) {
+                jaeger_log_error("Collector closed connection, "
+                                 "num responses = %d, num requests = %d",
+                                 exchange->num_responses,
+                                 exchange->num_requests);
+                return false;
+            }
+            exchange->keep_alive = false;
+        }
+    }
+    return true;
+}
+
+/* Posts buffered spans to the collector, pipelining up to the maximum number
+ * of requests on a persistent connection. Spans answered with an error status
+ * are dropped, spans without a response stay buffered for the next flush.
+ * Caller must hold reporter mutex. */
+static bool http_reporter_send_spans(jaeger_batch_reporter* r)
+{
+    jaeger_http_reporter* reporter = (jaeger_http_reporter*) r;
+    const int num_requests = http_reporter_build_requests(reporter);
+    if (num_requests == 0) {
+        return false;
+    }
+
+    http_reporter_exchange exchange = {
+        .request_spans = (const int*) reporter->request_spans.data,
+        .num_requests = num_requests,
+        .num_responses = 0,
+        .num_accepted = 0,
+        .num_rejected = 0,
+        .num_failed_requests = 0,
+        .keep_alive = true};
+    const int64_t deadline = monotonic_milliseconds() +
+                             duration_milliseconds(&reporter->request_timeout);
+    /* Collector may have closed a kept alive connection since the last
+     * flush, so retry once on a new connection if nothing was received. */
+    bool reused_connection = (reporter->fd >= 0);
+    bool completed = false;
+    while (reporter->fd >= 0 || http_reporter_connect(reporter, deadline)) {
+        completed =
+            http_reporter_exchange_requests(reporter, &exchange, deadline);
+        if (completed || !reused_connection || exchange.num_responses > 0 ||
+            reporter->interrupted) {
+            break;
+        }
+        http_reporter_close(reporter);
+        reused_connection = false;
+    }
+    if (!completed || !exchange.keep_alive) {
+        http_reporter_close(reporter);
+    }
+
+    /* Requests are answered in order, so responded spans are at the front of
+     * the buffer. */
+    batch_reporter_consume_spans(
+        r, exchange.num_accepted + exchange.num_rejected);
+    if (exchange.num_accepted > 0) {
+        batch_reporter_count_successes(r, exchange.num_accepted);
+    }
+    if (exchange.num_rejected > 0) {
+        batch_reporter_drop_spans(r, exchange.num_rejected);
+    }
+    const int num_failures = exchange.num_failed_requests + (completed ? 0 : 1);
+    if (num_failures > 0) {
+        batch_reporter_count_failures(r, num_failures);
+    }
+    return num_failures == 0;
+}
+
+/* Stops the background thread without waiting on a collector that does not
+ * answer, then flushes remaining spans. */
+static void http_reporter_stop(jaeger_http_reporter* reporter)
+{
+#ifdef JAEGERTRACINGC_MT
+    if (reporter->stop_fds[1] >= 0) {
+        const char byte = 0;
+        while (write(reporter->stop_fds[1], &byte, 1) < 0 && errno == EINTR) {
+        }
+    }
+    batch_reporter_stop_thread(&reporter->base);
+    /* Once the collector kept a flush waiting until the reporter was
+     * destroyed, the final flush gives up on it at once. Otherwise the stop
+     * pipe is drained so the final flush gets the whole request timeout. */
+    if (reporter->stop_fds[0] >= 0 && !reporter->interrupted) {
+        char byte;
+        while (read(reporter->stop_fds[0], &byte, 1) < 0 && errno == EINTR) {
+        }
+    }
+#endif /* JAEGERTRACINGC_MT */
+    batch_reporter_stop(&reporter->base);
+}
+
+static void http_reporter_destroy(jaeger_destructible* destructible)
+{
+    if (destructible == NULL) {
+        return;
+    }
+    jaeger_http_reporter* r = (jaeger_http_reporter*) destructible;
+    http_reporter_stop(r);
+
+    http_reporter_close(r);
+    jaeger_url_destroy(&r->collector_url);
+    if (r->request_header != NULL) {
+        jaeger_free(r->request_header);
+        r->request_header = NULL;
+    }
+    jaeger_vector_destroy(&r->requests);
+    jaeger_vector_destroy(&r->request_spans);
+    for (int i = 0; i < 2; i++) {
+        if (r->stop_fds[i] >= 0) {
+            close(r->stop_fds[i]);
+            r->stop_fds[i] = -1;
+        }
+    }
+
+    batch_reporter_destroy(&r->base);
+}
+
+bool jaeger_http_reporter_init(jaeger_http_reporter* reporter,
+                               const char* collector_url,
+                               jaeger_metrics* metrics,
+                               const jaeger_http_reporter_options* options)
+{
+    assert(reporter != NULL);
+    if (collector_url == NULL || strlen(collector_url) == 0) {
+        jaeger_log_error("HTTP reporter requires a collector URL");
+        return false;
+    }
+
+    const jaeger_http_reporter_options default_options =
+        JAEGERTRACINGC_HTTP_REPORTER_OPTIONS_INIT;
+    if (options == NULL) {
+        options = &default_options;
+    }
+    reporter->collector_url = (jaeger_url) JAEGERTRACINGC_URL_INIT;
+    reporter->fd = -1;
+    reporter->max_pipelined_requests =
+        (options->max_pipelined_requests > 0)
+            ? options->max_pipelined_requests
+            : JAEGERTRACINGC_DEFAULT_HTTP_REPORTER_MAX_PIPELINED_REQUESTS;
+    reporter->request_timeout = options->request_timeout;
+    if (reporter->request_timeout.value.tv_sec <= 0 &&
+        reporter->request_timeout.value.tv_nsec <= 0) {
+        reporter->request_timeout = (jaeger_duration)
+            JAEGERTRACINGC_DEFAULT_HTTP_REPORTER_REQUEST_TIMEOUT;
+    }
+    reporter->stop_fds[0] = -1;
+    reporter->stop_fds[1] = -1;
+    reporter->interrupted = false;
+    reporter->request_header = NULL;
+    reporter->request_header_len = 0;
+    reporter->requests = (jaeger_vector) JAEGERTRACINGC_VECTOR_INIT;
+    reporter->request_spans = (jaeger_vector) JAEGERTRACINGC_VECTOR_INIT;
+    memset(&reporter->settings, 0, sizeof(reporter->settings));
+    reporter->settings.on_message_complete =
+        &http_reporter_on_message_complete;
+    const int batch_size =
+        (options->batch_size > 0)
+            ? options->batch_size
+            : JAEGERTRACINGC_DEFAULT_HTTP_REPORTER_BATCH_SIZE;
+    if (!batch_reporter_init(&reporter->base,
+                             metrics,
+                             &options->flush_interval,
+                             options->queue_size,
+                             batch_size,
+                             jaeger_reporter_format_protobuf,
+                             false,
+                             &http_reporter_destroy,
+                             &http_reporter_send_spans)) {
+        return false;
+    }
+
+    if (!jaeger_url_init(&reporter->collector_url, collector_url) ||
+        !http_reporter_format_request_header(reporter)) {
+        goto cleanup;
+    }
+    if (!jaeger_vector_init(&reporter->requests, sizeof(char)) ||
+        !jaeger_vector_init(&reporter->request_spans, sizeof(int))) {
+        goto cleanup;
+    }
+#ifdef JAEGERTRACINGC_MT
+    if (pipe(reporter->stop_fds) != 0) {
+        jaeger_log_error("Cannot create HTTP reporter stop pipe, errno = %d",
+                         errno);
+        reporter->stop_fds[0] = -1;
+        reporter->stop_fds[1] = -1;
+        goto cleanup;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(reporter->stop_fds[i], F_SETFD, FD_CLOEXEC);
+    }
+#endif /* JAEGERTRACINGC_MT */
+
+    if (!batch_reporter_start(&reporter->base)) {
+        goto cleanup;
+    }
+    return true;
+
+cleanup:
+    http_reporter_destroy((jaeger_destructible*) reporter);
+    return false;
+}
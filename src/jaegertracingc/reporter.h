@@ -22,9 +22,11 @@
 #ifndef JAEGERTRACINGC_REPORTER_H
 #define JAEGERTRACINGC_REPORTER_H
 
+#include "jaegertracingc/clock.h"
 #include "jaegertracingc/common.h"
 #include "jaegertracingc/logging.h"
 #include "jaegertracingc/metrics.h"
+#include "jaegertracingc/mpsc_queue.h"
 #include "jaegertracingc/net.h"
 #include "jaegertracingc/span.h"
 #include "jaegertracingc/threading.h"
@@ -38,6 +40,13 @@ extern "C" {
 
 #define JAEGERTRACINGC_DEFAULT_UDP_BUFFER_SIZE USHRT_MAX
 
+#define JAEGERTRACINGC_DEFAULT_REPORTER_FLUSH_INTERVAL \
+    {                                                  \
+        .value = {.tv_sec = 1, .tv_nsec = 0 }          \
+    }
+
+#define JAEGERTRACINGC_DEFAULT_REPORTER_QUEUE_SIZE 1024
+
 typedef struct jaeger_reporter {
     jaeger_destructible base;
 
@@ -78,22 +87,289 @@ bool jaeger_composite_reporter_init(jaeger_composite_reporter* reporter);
 bool jaeger_composite_reporter_add(jaeger_composite_reporter* reporter,
                                    jaeger_reporter* new_reporter);
 
-typedef struct jaeger_remote_reporter {
+/** Wire format of encoded spans. */
+typedef enum jaeger_reporter_format {
+    /** jaeger.model.Batch protobuf message. */
+    jaeger_reporter_format_protobuf,
+    /**
+     * Agent.emitBatch call in the Thrift compact protocol, as accepted by
+     * jaeger-agent on its default UDP port.
+     */
+    jaeger_reporter_format_thrift_compact
+} jaeger_reporter_format;
+
+/**
+ * Base for reporters that encode spans as they are reported and send them in
+ * batches. Application threads only encode and queue spans, sending happens
+ * on a background thread or on explicit flush.
+ */
+typedef struct jaeger_batch_reporter {
     jaeger_reporter base;
-    int max_packet_size;
-    int fd;
+
+    /**
+     * Send spans waiting in spans. Spans that were sent or dropped must be
+     * freed and removed, any others must be left at the front of spans to be
+     * retried on the next flush. Called with mutex held.
+     * @param reporter Reporter instance.
+     * @return True on success, false otherwise.
+     */
+    bool (*send_spans)(struct jaeger_batch_reporter* reporter);
+
+    /** Queued size in bytes that wakes the background thread early. */
+    int batch_size;
+    jaeger_reporter_format format;
     jaeger_metrics* metrics;
     Jaeger__Model__Process process;
+    /**
+     * Process encoded as a protobuf batch field, or as the emitBatch message
+     * header for Thrift. Built along with process.
+     */
+    uint8_t* process_field;
+    int process_field_size;
+    /** Spans taken off the queue that are waiting to be sent. */
     jaeger_vector spans;
+    /** Guards everything except queue, queued_bytes and flush_requested. */
+    jaeger_mutex mutex;
+
+    /**
+     * Spans reported by application threads. Consumer side is only accessed
+     * while holding mutex.
+     */
+    jaeger_mpsc_queue queue;
+    /** Approximate encoded size of the spans waiting in queue. */
+    int queued_bytes;
+    /** Set once process has been built from the tracer. */
+    bool process_built;
+    jaeger_duration flush_interval;
+    /** Background flush thread, only valid if running is true. */
+    jaeger_thread thread;
+    /** Signaled to wake the background thread early. */
+    jaeger_cond cond;
+    bool running;
+    bool flush_requested;
+
+    /**
+     * Stage spans in per-thread buffers instead of queue. Only supported in
+     * multithreaded builds with atomics.
+     */
+    bool stage_per_thread;
+    /** Stage of each application thread. */
+    jaeger_thread_local stage_key;
+    /** Stages of all threads, newest first. */
+    struct jaeger_span_stage* stages;
+    /** Empty buffer swapped into the next stage collected. */
+    struct jaeger_staged_spans* spare_stage_buffer;
+} jaeger_batch_reporter;
+
+/**
+ * Options that can be used to customize the remote reporter.
+ */
+typedef struct jaeger_remote_reporter_options {
+    /**
+     * Interval between background flushes. A zero interval disables the
+     * background flush thread, in which case spans are only sent when the
+     * reporter is flushed explicitly.
+     */
+    jaeger_duration flush_interval;
+    /**
+     * Maximum number of spans waiting to be flushed. Spans reported while the
+     * queue is full are dropped. Uses default if not positive.
+     */
+    int queue_size;
+    /**
+     * Connect the socket to the agent once its address is resolved, so
+     * packets are sent without a destination address. The kernel then also
+     * reports errors such as an unreachable agent on later sends.
+     */
+    bool connect_socket;
+    /**
+     * With a connected socket, send many packets in one system call using
+     * UDP generic segmentation offload (UDP_SEGMENT) if the kernel supports
+     * it, falling back to regular sends otherwise. Packets are padded to the
+     * same size, which costs some bandwidth.
+     */
+    bool segmentation_offload;
+    /**
+     * Lower the packet size to the largest payload that reaches the agent
+     * without IP fragmentation, since losing one fragment loses the whole
+     * packet. Reads the path MTU from the kernel (IP_MTU), keeping large
+     * packets on loopback. With a connected socket, also forbids
+     * fragmentation so packets shrink when the path MTU drops.
+     */
+    bool path_mtu_discovery;
+    /**
+     * Have each thread stage reported spans in a buffer of its own, which
+     * the flush swaps out as a whole. Reporting then writes no memory shared
+     * with other threads. Each thread buffers up to queue_size spans.
+     * Ignored in single-threaded builds and without atomics.
+     */
+    bool stage_per_thread;
+    /**
+     * Wire format of packets. Thrift compact is what a stock jaeger-agent
+     * expects on port 6831, and is also smaller per span.
+     */
+    jaeger_reporter_format format;
+} jaeger_remote_reporter_options;
+
+#define JAEGERTRACINGC_REMOTE_REPORTER_OPTIONS_INIT                       \
+    {                                                                     \
+        .flush_interval = JAEGERTRACINGC_DEFAULT_REPORTER_FLUSH_INTERVAL, \
+        .queue_size = JAEGERTRACINGC_DEFAULT_REPORTER_QUEUE_SIZE,         \
+        .connect_socket = false, .segmentation_offload = true,            \
+        .path_mtu_discovery = true, .stage_per_thread = false,            \
+        .format = jaeger_reporter_format_protobuf                         \
+    }
+
+typedef struct jaeger_remote_reporter {
+    jaeger_batch_reporter base;
+    /**
+     * Largest packet to send. The size given at init, lowered to fit the
+     * path MTU if discovery is enabled.
+     */
+    int max_packet_size;
+    /** Maximum packet size given at init. */
+    int packet_size_limit;
+    int fd;
+    /**
+     * Scratch space to describe packets for a single send: iovecs pointing
+     * into encoded spans, layout of each packet, and one message header per
+     * system call.
+     */
+    jaeger_vector iovecs;
+    jaeger_vector packets;
+    jaeger_vector messages;
+    bool connect_socket;
+    bool segmentation_offload;
+    bool path_mtu_discovery;
+    /** Segment size for UDP_SEGMENT, zero if not in use. */
+    int segment_size;
+    /** Zero bytes used to pad packets to segment_size. */
+    uint8_t* padding;
     struct addrinfo* candidates;
     struct sockaddr_in addr;
-    jaeger_mutex mutex;
 } jaeger_remote_reporter;
 
+/**
+ * Initialize a new remote reporter. Unless disabled in options, starts a
+ * background thread that flushes spans periodically and whenever enough spans
+ * are queued to fill a packet.
+ * @param reporter Reporter to initialize.
+ * @param host_port_str Agent host port. May be NULL to use default.
+ * @param max_packet_size Maximum UDP packet size. Uses default if not
+ *                        positive. May be lowered to fit the path MTU, see
+ *                        jaeger_remote_reporter_options.
+ * @param metrics Metrics object to use. May be NULL.
+ * @param options Options for reporter to use. May be NULL.
+ * @return True on success, false otherwise.
+ */
 bool jaeger_remote_reporter_init(jaeger_remote_reporter* reporter,
                                  const char* host_port_str,
                                  int max_packet_size,
-                                 jaeger_metrics* metrics);
+                                 jaeger_metrics* metrics,
+                                 const jaeger_remote_reporter_options* options);
+
+#define JAEGERTRACINGC_DEFAULT_HTTP_REPORTER_BATCH_SIZE (1024 * 1024)
+
+#define JAEGERTRACINGC_DEFAULT_HTTP_REPORTER_MAX_PIPELINED_REQUESTS 8
+
+#define JAEGERTRACINGC_DEFAULT_HTTP_REPORTER_REQUEST_TIMEOUT \
+    {                                                        \
+        .value = {.tv_sec = 5, .tv_nsec = 0 }                \
+    }
+
+/**
+ * Options that can be used to customize the HTTP reporter.
+ */
+typedef struct jaeger_http_reporter_options {
+    /**
+     * Interval between background flushes. A zero interval disables the
+     * background flush thread, in which case spans are only sent when the
+     * reporter is flushed explicitly.
+     */
+    jaeger_duration flush_interval;
+    /**
+     * Maximum number of spans waiting to be flushed. Spans reported while the
+     * queue is full are dropped. Uses default if not positive.
+     */
+    int queue_size;
+    /**
+     * Target size of a single request body. Spans are packed into requests up
+     * to this size, a span that is larger on its own is sent in a request by
+     * itself. Uses default if not positive.
+     */
+    int batch_size;
+    /**
+     * Maximum number of requests written to the connection before reading
+     * their responses. Uses default if not positive.
+     */
+    int max_pipelined_requests;
+    /**
+     * Time allowed for a single flush to connect, write its requests and read
+     * their responses. Uses default if zero.
+     */
+    jaeger_duration request_timeout;
+} jaeger_http_reporter_options;
+
+#define JAEGERTRACINGC_HTTP_REPORTER_OPTIONS_INIT                         \
+    {                                                                     \
+        .flush_interval = JAEGERTRACINGC_DEFAULT_REPORTER_FLUSH_INTERVAL, \
+        .queue_size = JAEGERTRACINGC_DEFAULT_REPORTER_QUEUE_SIZE,         \
+        .batch_size = JAEGERTRACINGC_DEFAULT_HTTP_REPORTER_BATCH_SIZE,    \
+        .max_pipelined_requests =                                         \
+            JAEGERTRACINGC_DEFAULT_HTTP_REPORTER_MAX_PIPELINED_REQUESTS,  \
+        .request_timeout =                                                \
+            JAEGERTRACINGC_DEFAULT_HTTP_REPORTER_REQUEST_TIMEOUT          \
+    }
+
+/**
+ * Reporter that posts spans to a collector as jaeger.model.PostSpansRequest
+ * messages over HTTP/1.1. The connection is kept alive between flushes and
+ * requests of a single flush are pipelined. The socket is non-blocking, so a
+ * flush gives up once its request timeout passes, and destroying the reporter
+ * interrupts a flush in progress.
+ */
+typedef struct jaeger_http_reporter {
+    jaeger_batch_reporter base;
+    jaeger_url collector_url;
+    int fd;
+    int max_pipelined_requests;
+    jaeger_duration request_timeout;
+    /**
+     * Pipe written to when the reporter is destroyed, which interrupts a
+     * flush waiting on the collector. Only used in multithreaded builds.
+     */
+    int stop_fds[2];
+    /** Whether a flush was interrupted by the stop pipe. */
+    bool interrupted;
+    /** Request line and headers, up to the Content-Length value. */
+    char* request_header;
+    int request_header_len;
+    /** Serialized requests of a single flush. */
+    jaeger_vector requests;
+    /** Number of spans in each request of a single flush. */
+    jaeger_vector request_spans;
+    http_parser parser;
+    http_parser_settings settings;
+} jaeger_http_reporter;
+
+/**
+ * Initialize a new HTTP reporter. The collector is not contacted until the
+ * first flush. Unless disabled in options, starts a background thread that
+ * flushes spans periodically and whenever enough spans are queued to fill a
+ * request.
+ * @param reporter Reporter to initialize.
+ * @param collector_url Collector endpoint URL. Required. The endpoint must
+ *                      accept the body of each POST as a raw protobuf
+ *                      jaeger.model.PostSpansRequest sent with Content-Type
+ *                      application/x-protobuf.
+ * @param metrics Metrics object to use. May be NULL.
+ * @param options Options for reporter to use. May be NULL.
+ * @return True on success, false otherwise.
+ */
+bool jaeger_http_reporter_init(jaeger_http_reporter* reporter,
+                               const char* collector_url,
+                               jaeger_metrics* metrics,
+                               const jaeger_http_reporter_options* options);
 
 #ifdef __cplusplus
 } /* extern C */
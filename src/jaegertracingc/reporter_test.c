@@ -20,6 +20,7 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 
+#include "jaegertracingc/mock_collector.h"
 #include "jaegertracingc/span.h"
 #include "jaegertracingc/threading.h"
 #include "jaegertracingc/tracer.h"
@@ -38,6 +39,52 @@ static inline int start_udp_server()
     return fd;
 }
 
+/* Checks the framing of a Thrift emitBatch packet and returns the number of
+ * spans it holds. */
+static int thrift_packet_num_spans(const jaeger_remote_reporter* reporter,
+                                   const uint8_t* buffer,
+                                   int len)
+{
+    const int header_size = reporter->base.process_field_size;
+    TEST_ASSERT_GREATER_THAN(header_size + 2, len);
+    TEST_ASSERT_EQUAL_MEMORY(reporter->base.process_field, buffer, header_size);
+    TEST_ASSERT_EQUAL(0, buffer[len - 2]);
+    TEST_ASSERT_EQUAL(0, buffer[len - 1]);
+    /* Batch.spans list of structs. */
+    const uint8_t* pos = &buffer[header_size];
+    TEST_ASSERT_EQUAL(0x19, *pos++);
+    TEST_ASSERT_EQUAL(0x0c, *pos & 0x0f);
+    int num_spans = *pos++ >> 4;
+    if (num_spans == 15) {
+        num_spans = 0;
+        for (int shift = 0;; shift += 7) {
+            num_spans |= (*pos & 0x7f) << shift;
+            if ((*pos++ & 0x80) == 0) {
+                break;
+            }
+        }
+    }
+    return num_spans;
+}
+
+#define NUM_STAGING_THREADS 4
+#define NUM_STAGED_SPANS 25
+
+typedef struct staging_context {
+    jaeger_reporter* reporter;
+    jaeger_span* span;
+} staging_context;
+
+static void* report_staged_spans(void* arg)
+{
+    TEST_ASSERT_NOT_NULL(arg);
+    staging_context* context = (staging_context*) arg;
+    for (int i = 0; i < NUM_STAGED_SPANS; i++) {
+        context->reporter->report(context->reporter, context->span);
+    }
+    return NULL;
+}
+
 static void* flush_reporter(void* arg)
 {
     TEST_ASSERT_NOT_NULL(arg);
@@ -49,6 +96,119 @@ static void* flush_reporter(void* arg)
     return return_value;
 }
 
+static void test_http_reporter(jaeger_span* span)
+{
+    mock_collector collector = MOCK_COLLECTOR_INIT;
+    mock_collector_start(&collector);
+    char collector_url[64];
+    mock_collector_format_url(&collector, collector_url, sizeof(collector_url));
+
+    jaeger_metrics metrics;
+    TEST_ASSERT_TRUE(jaeger_default_metrics_init(&metrics));
+    jaeger_default_counter* succeeded =
+        (jaeger_default_counter*) metrics.reporter_success;
+    jaeger_default_counter* failed =
+        (jaeger_default_counter*) metrics.reporter_failure;
+    jaeger_default_counter* dropped =
+        (jaeger_default_counter*) metrics.reporter_dropped;
+
+    /* Every span fits in one request, and later flushes reuse the
+     * connection. */
+    jaeger_http_reporter_options options =
+        JAEGERTRACINGC_HTTP_REPORTER_OPTIONS_INIT;
+    options.flush_interval = (jaeger_duration) JAEGERTRACINGC_DURATION_INIT;
+    jaeger_http_reporter http_reporter;
+    TEST_ASSERT_FALSE(
+        jaeger_http_reporter_init(&http_reporter, NULL, &metrics, &options));
+    TEST_ASSERT_FALSE(
+        jaeger_http_reporter_init(&http_reporter, "", &metrics, &options));
+    TEST_ASSERT_TRUE(jaeger_http_reporter_init(
+        &http_reporter, collector_url, &metrics, &options));
+    jaeger_reporter* r = (jaeger_reporter*) &http_reporter;
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 100; j++) {
+            r->report(r, span);
+        }
+        TEST_ASSERT_TRUE(r->flush(r));
+    }
+    TEST_ASSERT_EQUAL(2, collector.num_requests);
+    TEST_ASSERT_EQUAL(1, collector.num_connections);
+    TEST_ASSERT_EQUAL(200, collector.num_spans);
+    TEST_ASSERT_EQUAL(200, succeeded->total);
+    TEST_ASSERT_EQUAL(0, failed->total);
+    ((jaeger_destructible*) r)->destroy((jaeger_destructible*) r);
+
+    /* Small batches are pipelined, and spans whose requests were not answered
+     * before the collector closed the connection are sent again on a new
+     * one. */
+    collector.max_requests_per_connection = 3;
+    options.batch_size = 1;
+    options.max_pipelined_requests = 8;
+    TEST_ASSERT_TRUE(jaeger_http_reporter_init(
+        &http_reporter, collector_url, &metrics, &options));
+    for (int i = 0; i < 20; i++) {
+        r->report(r, span);
+    }
+    for (int i = 0; i < 20 && succeeded->total < 220; i++) {
+        r->flush(r);
+    }
+    mock_collector_wait_for_requests(&collector, 22);
+    TEST_ASSERT_EQUAL(22, collector.num_requests);
+    TEST_ASSERT_GREATER_THAN(2, collector.num_connections);
+    TEST_ASSERT_EQUAL(220, collector.num_spans);
+    TEST_ASSERT_EQUAL(220, succeeded->total);
+    TEST_ASSERT_EQUAL(0, dropped->total);
+    ((jaeger_destructible*) r)->destroy((jaeger_destructible*) r);
+
+    /* Rejected spans are dropped rather than retried. */
+    collector.max_requests_per_connection = 0;
+    collector.status_code = 400;
+    TEST_ASSERT_TRUE(jaeger_http_reporter_init(
+        &http_reporter, collector_url, &metrics, &options));
+    r->report(r, span);
+    TEST_ASSERT_FALSE(r->flush(r));
+    TEST_ASSERT_TRUE(r->flush(r));
+    TEST_ASSERT_EQUAL(1, dropped->total);
+    TEST_ASSERT_EQUAL(220, collector.num_spans);
+    ((jaeger_destructible*) r)->destroy((jaeger_destructible*) r);
+
+#ifdef JAEGERTRACINGC_MT
+    /* Destroy interrupts a background flush waiting on a collector that
+     * accepts requests but never answers them. */
+    collector.respond = false;
+    options.flush_interval.value.tv_sec = 0;
+    options.flush_interval.value.tv_nsec =
+        0.01 * JAEGERTRACINGC_NANOSECONDS_PER_SECOND;
+    options.request_timeout.value.tv_sec = 60;
+    TEST_ASSERT_TRUE(jaeger_http_reporter_init(
+        &http_reporter, collector_url, &metrics, &options));
+    const int num_requests = collector.num_requests;
+    r->report(r, span);
+    mock_collector_wait_for_requests(&collector, num_requests + 1);
+    jaeger_duration start;
+    jaeger_duration_now(&start);
+    ((jaeger_destructible*) r)->destroy((jaeger_destructible*) r);
+    jaeger_duration end;
+    jaeger_duration_now(&end);
+    opentracing_time_value elapsed;
+    TEST_ASSERT_TRUE(jaeger_time_subtract(end.value, start.value, &elapsed));
+    TEST_ASSERT_EQUAL(0, elapsed.tv_sec);
+    collector.respond = true;
+    options.flush_interval = (jaeger_duration) JAEGERTRACINGC_DURATION_INIT;
+    options.request_timeout = (jaeger_duration) JAEGERTRACINGC_DURATION_INIT;
+#endif /* JAEGERTRACINGC_MT */
+
+    /* Spans stay buffered while the collector is unreachable. */
+    mock_collector_destroy(&collector);
+    TEST_ASSERT_TRUE(jaeger_http_reporter_init(
+        &http_reporter, collector_url, &metrics, &options));
+    r->report(r, span);
+    TEST_ASSERT_FALSE(r->flush(r));
+    TEST_ASSERT_EQUAL(1, dropped->total);
+    ((jaeger_destructible*) r)->destroy((jaeger_destructible*) r);
+    jaeger_metrics_destroy(&metrics);
+}
+
 void test_reporter()
 {
     jaeger_const_sampler const_sampler;
@@ -98,7 +258,7 @@ void test_reporter()
     span_ref_ptr->type = opentracing_span_reference_child_of;
 
     TEST_ASSERT_TRUE(
-        jaeger_hashtable_put(&span.context.baggage, "key", "value"));
+        jaeger_span_context_set_baggage_item(&span.context, "key", "value"));
     jaeger_reporter* r = jaeger_null_reporter();
     r->report(r, &span);
     TEST_ASSERT_TRUE(r->flush(r));
@@ -162,9 +322,24 @@ void test_reporter()
     jaeger_remote_reporter remote_reporter;
     char buffer[1024];
     jaeger_metrics* metrics = jaeger_null_metrics();
+    jaeger_metrics default_metrics;
+    TEST_ASSERT_TRUE(jaeger_default_metrics_init(&default_metrics));
+    jaeger_default_counter* succeeded =
+        (jaeger_default_counter*) default_metrics.reporter_success;
+    jaeger_default_counter* failed =
+        (jaeger_default_counter*) default_metrics.reporter_failure;
+    jaeger_default_counter* dropped =
+        (jaeger_default_counter*) default_metrics.reporter_dropped;
+    /* Disable background flushing so the explicit flushes below observe
+     * every span. */
+    jaeger_remote_reporter_options manual_flush_options = {
+        .flush_interval = JAEGERTRACINGC_DURATION_INIT};
     r = (jaeger_reporter*) &remote_reporter;
-    TEST_ASSERT_TRUE(jaeger_remote_reporter_init(
-        &remote_reporter, host_port, sizeof(buffer), metrics));
+    TEST_ASSERT_TRUE(jaeger_remote_reporter_init(&remote_reporter,
+                                                 host_port,
+                                                 sizeof(buffer),
+                                                 &default_metrics,
+                                                 &manual_flush_options));
     r = (jaeger_reporter*) &remote_reporter;
     for (int i = 0; i < 100; i++) {
         r->report(r, &span);
@@ -172,7 +347,7 @@ void test_reporter()
     jaeger_thread thread;
     TEST_ASSERT_EQUAL(
         0, jaeger_thread_init(&thread, &flush_reporter, &remote_reporter));
-    const int num_read = recv(server_fd, buffer, sizeof(buffer), 0);
+    int num_read = recv(server_fd, buffer, sizeof(buffer), 0);
     Jaeger__Model__Batch* batch =
         jaeger__model__batch__unpack(NULL, num_read, (const uint8_t*) buffer);
     TEST_ASSERT_NOT_NULL(batch);
@@ -180,13 +355,36 @@ void test_reporter()
     jaeger_thread_join(thread, &success);
     TEST_ASSERT_NOT_NULL(success);
     TEST_ASSERT_EQUAL(true, *(bool*) success);
+    /* Spans do not fit in a single packet, so the flush must split them
+     * across several packets without losing any. */
+    int num_packets = 1;
+    int num_spans_received = batch->n_spans;
     jaeger__model__batch__free_unpacked(batch, NULL);
+    while ((num_read = recv(
+                server_fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+        batch = jaeger__model__batch__unpack(
+            NULL, num_read, (const uint8_t*) buffer);
+        TEST_ASSERT_NOT_NULL(batch);
+        TEST_ASSERT_NOT_NULL(batch->process);
+        num_spans_received += batch->n_spans;
+        num_packets++;
+        jaeger__model__batch__free_unpacked(batch, NULL);
+    }
+    TEST_ASSERT_GREATER_THAN(1, num_packets);
+    TEST_ASSERT_EQUAL(100, num_spans_received);
+    TEST_ASSERT_EQUAL(100, succeeded->total);
+    TEST_ASSERT_EQUAL(0, failed->total);
+    TEST_ASSERT_EQUAL(0, dropped->total);
     ((jaeger_destructible*) r)->destroy((jaeger_destructible*) r);
     jaeger_free(success);
+    jaeger_metrics_destroy(&default_metrics);
 
     const int small_packet_size = 1;
-    TEST_ASSERT_TRUE(jaeger_remote_reporter_init(
-        &remote_reporter, host_port, small_packet_size, metrics));
+    TEST_ASSERT_TRUE(jaeger_remote_reporter_init(&remote_reporter,
+                                                 host_port,
+                                                 small_packet_size,
+                                                 metrics,
+                                                 &manual_flush_options));
     r->report(r, &span);
     TEST_ASSERT_EQUAL(
         0, jaeger_thread_init(&thread, &flush_reporter, &remote_reporter));
@@ -197,7 +395,218 @@ void test_reporter()
     jaeger_free(success);
     ((jaeger_destructible*) r)->destroy((jaeger_destructible*) r);
 
+    /* Spans reported while the queue is full should be dropped. */
+    TEST_ASSERT_TRUE(jaeger_default_metrics_init(&default_metrics));
+    succeeded = (jaeger_default_counter*) default_metrics.reporter_success;
+    dropped = (jaeger_default_counter*) default_metrics.reporter_dropped;
+    manual_flush_options.queue_size = 1;
+    TEST_ASSERT_TRUE(jaeger_remote_reporter_init(&remote_reporter,
+                                                 host_port,
+                                                 sizeof(buffer),
+                                                 &default_metrics,
+                                                 &manual_flush_options));
+    r->report(r, &span);
+    r->report(r, &span);
+    TEST_ASSERT_EQUAL(1, dropped->total);
+    TEST_ASSERT_TRUE(r->flush(r));
+    TEST_ASSERT_EQUAL(1, succeeded->total);
+    ((jaeger_destructible*) r)->destroy((jaeger_destructible*) r);
+    jaeger_metrics_destroy(&default_metrics);
+    num_read = recv(server_fd, buffer, sizeof(buffer), 0);
+    batch =
+        jaeger__model__batch__unpack(NULL, num_read, (const uint8_t*) buffer);
+    TEST_ASSERT_NOT_NULL(batch);
+    TEST_ASSERT_EQUAL(1, batch->n_spans);
+    jaeger__model__batch__free_unpacked(batch, NULL);
+
+    /* Connected socket should deliver every span with and without
+     * segmentation offload, in both formats. Padding added for offload must
+     * not affect decoding. */
+    manual_flush_options.queue_size = 0;
+    manual_flush_options.connect_socket = true;
+    for (int i = 0; i < 4; i++) {
+        const bool thrift = (i >= 2);
+        manual_flush_options.segmentation_offload = (i % 2 == 1);
+        manual_flush_options.format =
+            thrift ? jaeger_reporter_format_thrift_compact
+                   : jaeger_reporter_format_protobuf;
+        TEST_ASSERT_TRUE(jaeger_default_metrics_init(&default_metrics));
+        succeeded = (jaeger_default_counter*) default_metrics.reporter_success;
+        TEST_ASSERT_TRUE(jaeger_remote_reporter_init(&remote_reporter,
+                                                     host_port,
+                                                     sizeof(buffer),
+                                                     &default_metrics,
+                                                     &manual_flush_options));
+        for (int j = 0; j < 100; j++) {
+            r->report(r, &span);
+        }
+        TEST_ASSERT_TRUE(r->flush(r));
+        TEST_ASSERT_EQUAL(100, succeeded->total);
+        num_spans_received = 0;
+        while ((num_read = recv(
+                    server_fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+            if (thrift) {
+                num_spans_received += thrift_packet_num_spans(
+                    &remote_reporter, (const uint8_t*) buffer, num_read);
+                continue;
+            }
+            batch = jaeger__model__batch__unpack(
+                NULL, num_read, (const uint8_t*) buffer);
+            TEST_ASSERT_NOT_NULL(batch);
+            TEST_ASSERT_NOT_NULL(batch->process);
+            num_spans_received += batch->n_spans;
+            jaeger__model__batch__free_unpacked(batch, NULL);
+        }
+        TEST_ASSERT_EQUAL(100, num_spans_received);
+        ((jaeger_destructible*) r)->destroy((jaeger_destructible*) r);
+        jaeger_metrics_destroy(&default_metrics);
+    }
+    manual_flush_options.format = jaeger_reporter_format_protobuf;
+
+    /* Path MTU discovery never raises the packet size above the one given,
+     * and packet metrics should account for every byte received. */
+    manual_flush_options.segmentation_offload = false;
+    manual_flush_options.path_mtu_discovery = true;
+    for (int i = 0; i < 2; i++) {
+        manual_flush_options.connect_socket = (i == 1);
+        TEST_ASSERT_TRUE(jaeger_default_metrics_init(&default_metrics));
+        TEST_ASSERT_TRUE(jaeger_remote_reporter_init(&remote_reporter,
+                                                     host_port,
+                                                     sizeof(buffer),
+                                                     &default_metrics,
+                                                     &manual_flush_options));
+        for (int j = 0; j < 100; j++) {
+            r->report(r, &span);
+        }
+        TEST_ASSERT_TRUE(r->flush(r));
+        TEST_ASSERT_EQUAL(sizeof(buffer), remote_reporter.max_packet_size);
+        int num_packets_received = 0;
+        int num_bytes_received = 0;
+        while ((num_read = recv(
+                    server_fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+            num_packets_received++;
+            num_bytes_received += num_read;
+        }
+        TEST_ASSERT_GREATER_THAN(1, num_packets_received);
+        TEST_ASSERT_EQUAL(
+            num_packets_received,
+            ((jaeger_default_counter*) default_metrics.reporter_packets)
+                ->total);
+        TEST_ASSERT_EQUAL(
+            num_bytes_received,
+            ((jaeger_default_counter*) default_metrics.reporter_packet_bytes)
+                ->total);
+        TEST_ASSERT_EQUAL(
+            sizeof(buffer),
+            ((jaeger_default_gauge*) default_metrics.reporter_max_packet_size)
+                ->amount);
+        TEST_ASSERT_EQUAL(
+            num_bytes_received * 100 /
+                (num_packets_received * (int) sizeof(buffer)),
+            ((jaeger_default_gauge*)
+                 default_metrics.reporter_packet_fill_percent)
+                ->amount);
+        ((jaeger_destructible*) r)->destroy((jaeger_destructible*) r);
+        jaeger_metrics_destroy(&default_metrics);
+    }
+
+    /* Default packet size is lowered to a payload that is never
+     * fragmented. */
+    manual_flush_options.connect_socket = false;
+    TEST_ASSERT_TRUE(jaeger_remote_reporter_init(
+        &remote_reporter, host_port, 0, metrics, &manual_flush_options));
+    TEST_ASSERT_LESS_THAN(JAEGERTRACINGC_DEFAULT_UDP_BUFFER_SIZE,
+                          remote_reporter.max_packet_size);
+    ((jaeger_destructible*) r)->destroy((jaeger_destructible*) r);
+    manual_flush_options.path_mtu_discovery = false;
+
+#ifdef JAEGERTRACINGC_MT
+    /* Spans staged by threads should be collected by the flush, including
+     * those of threads that have already exited. */
+    manual_flush_options.stage_per_thread = true;
+    TEST_ASSERT_TRUE(jaeger_default_metrics_init(&default_metrics));
+    succeeded = (jaeger_default_counter*) default_metrics.reporter_success;
+    TEST_ASSERT_TRUE(jaeger_remote_reporter_init(&remote_reporter,
+                                                 host_port,
+                                                 sizeof(buffer),
+                                                 &default_metrics,
+                                                 &manual_flush_options));
+    staging_context staging = {.reporter = r, .span = &span};
+    jaeger_thread staging_threads[NUM_STAGING_THREADS];
+    for (int i = 0; i < NUM_STAGING_THREADS; i++) {
+        TEST_ASSERT_EQUAL(0,
+                          jaeger_thread_init(&staging_threads[i],
+                                             &report_staged_spans,
+                                             &staging));
+    }
+    for (int i = 0; i < NUM_STAGING_THREADS; i++) {
+        TEST_ASSERT_EQUAL(0, jaeger_thread_join(staging_threads[i], NULL));
+    }
+    r->report(r, &span);
+    TEST_ASSERT_TRUE(r->flush(r));
+    const int num_staged = NUM_STAGING_THREADS * NUM_STAGED_SPANS + 1;
+    TEST_ASSERT_EQUAL(num_staged, succeeded->total);
+    num_spans_received = 0;
+    while ((num_read = recv(
+                server_fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+        batch = jaeger__model__batch__unpack(
+            NULL, num_read, (const uint8_t*) buffer);
+        TEST_ASSERT_NOT_NULL(batch);
+        num_spans_received += batch->n_spans;
+        jaeger__model__batch__free_unpacked(batch, NULL);
+    }
+    TEST_ASSERT_EQUAL(num_staged, num_spans_received);
+    /* Stage of the current thread is freed along with the reporter. */
+    r->report(r, &span);
+    ((jaeger_destructible*) r)->destroy((jaeger_destructible*) r);
+    TEST_ASSERT_EQUAL(num_staged + 1, succeeded->total);
+    jaeger_metrics_destroy(&default_metrics);
+    while (recv(server_fd, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+    }
+    manual_flush_options.stage_per_thread = false;
+
+    /* Background thread should send spans without an explicit flush, first
+     * because the batch fills a packet, then because the interval elapses. */
+    jaeger_remote_reporter_options background_flush_options = {
+        .flush_interval = JAEGERTRACINGC_DURATION_INIT};
+    background_flush_options.flush_interval.value.tv_nsec =
+        0.01 * JAEGERTRACINGC_NANOSECONDS_PER_SECOND;
+    TEST_ASSERT_TRUE(jaeger_remote_reporter_init(&remote_reporter,
+                                                 host_port,
+                                                 sizeof(buffer),
+                                                 metrics,
+                                                 &background_flush_options));
+    for (int i = 0; i < 100; i++) {
+        r->report(r, &span);
+    }
+    int num_read_background = recv(server_fd, buffer, sizeof(buffer), 0);
+    batch = jaeger__model__batch__unpack(
+        NULL, num_read_background, (const uint8_t*) buffer);
+    TEST_ASSERT_NOT_NULL(batch);
+    jaeger__model__batch__free_unpacked(batch, NULL);
+    ((jaeger_destructible*) r)->destroy((jaeger_destructible*) r);
+    /* Drain remaining packets from the final flush. */
+    while (recv(server_fd, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+    }
+
+    TEST_ASSERT_TRUE(jaeger_remote_reporter_init(&remote_reporter,
+                                                 host_port,
+                                                 sizeof(buffer),
+                                                 metrics,
+                                                 &background_flush_options));
+    r->report(r, &span);
+    num_read_background = recv(server_fd, buffer, sizeof(buffer), 0);
+    batch = jaeger__model__batch__unpack(
+        NULL, num_read_background, (const uint8_t*) buffer);
+    TEST_ASSERT_NOT_NULL(batch);
+    TEST_ASSERT_EQUAL(1, batch->n_spans);
+    jaeger__model__batch__free_unpacked(batch, NULL);
+    ((jaeger_destructible*) r)->destroy((jaeger_destructible*) r);
+#endif /* JAEGERTRACINGC_MT */
+
     close(server_fd);
+
+    test_http_reporter(&span);
     jaeger_span_destroy((jaeger_destructible*) &span);
 
     jaeger_tracer_destroy((jaeger_destructible*) &tracer);
@@ -18,14 +18,28 @@
 
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <jansson.h>
+#include <limits.h>
+#include <poll.h>
 
+#include "jaegertracingc/hashtable.h"
 #include "jaegertracingc/random.h"
 
 #define HTTP_OK 200
 #define SAMPLER_GROWTH_FACTOR 2
 #define DEFAULT_MAX_OPERATIONS 2000
 #define DEFAULT_SAMPLING_RATE 0.001
+#define OP_SAMPLER_INDEX_MIN_SLOTS 16
+#define MILLISECONDS_PER_SECOND 1000
+#define NANOSECONDS_PER_MILLISECOND 1000000
+
+#ifdef MSG_NOSIGNAL
+/* A closed connection must not raise SIGPIPE in the application. */
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif /* MSG_NOSIGNAL */
 
 static bool jaeger_const_sampler_is_sampled(jaeger_sampler* sampler,
                                             const jaeger_trace_id* trace_id,
@@ -66,18 +80,63 @@ void jaeger_const_sampler_init(jaeger_const_sampler* sampler, bool decision)
     ((jaeger_destructible*) sampler)->destroy = &jaeger_sampler_noop_destroy;
 }
 
+/* Bits of the trace ID compared with the sampling boundary. Like other Jaeger
+ * clients, only the low 63 bits are used. */
+#define PROBABILISTIC_SAMPLER_ID_MASK (UINT64_MAX >> 1u)
+
+/* The sampling rate of a guaranteed throughput sampler's probabilistic sampler
+ * changes while other threads sample. The rate is only reported in tags, so
+ * reading the boundary and rate of different updates is harmless. */
+static inline double
+probabilistic_sampler_load_rate(const jaeger_probabilistic_sampler* sampler)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    double sampling_rate;
+    __atomic_load(&sampler->sampling_rate, &sampling_rate, __ATOMIC_RELAXED);
+    return sampling_rate;
+#else
+    return sampler->sampling_rate;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+static inline uint64_t
+probabilistic_sampler_load_boundary(const jaeger_probabilistic_sampler* sampler)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    return __atomic_load_n(&sampler->sampling_boundary, __ATOMIC_RELAXED);
+#else
+    return sampler->sampling_boundary;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+static inline void
+probabilistic_sampler_store_rate(jaeger_probabilistic_sampler* sampler,
+                                 double sampling_rate)
+{
+    sampling_rate = JAEGERTRACINGC_CLAMP(sampling_rate, 0, 1);
+    const uint64_t sampling_boundary = (uint64_t)(
+        sampling_rate * ((double) PROBABILISTIC_SAMPLER_ID_MASK + 1));
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    __atomic_store(&sampler->sampling_rate, &sampling_rate, __ATOMIC_RELAXED);
+    __atomic_store_n(
+        &sampler->sampling_boundary, sampling_boundary, __ATOMIC_RELAXED);
+#else
+    sampler->sampling_rate = sampling_rate;
+    sampler->sampling_boundary = sampling_boundary;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
 static bool
 jaeger_probabilistic_sampler_is_sampled(jaeger_sampler* sampler,
                                         const jaeger_trace_id* trace_id,
                                         const char* operation_name,
                                         jaeger_vector* tags)
 {
-    (void) trace_id;
+    assert(trace_id != NULL);
     (void) operation_name;
     jaeger_probabilistic_sampler* s = (jaeger_probabilistic_sampler*) sampler;
-    const long double random_value =
-        ((long double) jaeger_random64()) / UINT64_MAX;
-    const bool decision = (s->sampling_rate >= random_value);
+    const bool decision = (trace_id->low & PROBABILISTIC_SAMPLER_ID_MASK) <
+                          probabilistic_sampler_load_boundary(s);
     if (tags != NULL &&
         jaeger_vector_reserve(tags, jaeger_vector_length(tags) + 2)) {
         jaeger_tag tag = JAEGERTRACINGC_TAG_INIT;
@@ -90,7 +149,7 @@ jaeger_probabilistic_sampler_is_sampled(jaeger_sampler* sampler,
 
         tag.key = JAEGERTRACINGC_SAMPLER_PARAM_TAG_KEY;
         tag.v_type = JAEGER__MODEL__VALUE_TYPE__FLOAT64;
-        tag.v_float64 = s->sampling_rate;
+        tag.v_float64 = probabilistic_sampler_load_rate(s);
         jaeger_tag_vector_append(tags, &tag);
     }
     return decision;
@@ -103,9 +162,40 @@ void jaeger_probabilistic_sampler_init(jaeger_probabilistic_sampler* sampler,
     ((jaeger_sampler*) sampler)->is_sampled =
         &jaeger_probabilistic_sampler_is_sampled;
     ((jaeger_destructible*) sampler)->destroy = &jaeger_sampler_noop_destroy;
-    sampler->sampling_rate = JAEGERTRACINGC_CLAMP(sampling_rate, 0, 1);
-    jaeger_duration duration;
-    jaeger_duration_now(&duration);
+    probabilistic_sampler_store_rate(sampler, sampling_rate);
+}
+
+/* Like the probabilistic sampling rate, the maximum traces per second of a
+ * guaranteed throughput sampler's lower bound sampler changes while other
+ * threads sample. */
+static inline double rate_limiting_sampler_load_max_traces_per_second(
+    const jaeger_rate_limiting_sampler* sampler)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    double max_traces_per_second;
+    __atomic_load(&sampler->max_traces_per_second,
+                  &max_traces_per_second,
+                  __ATOMIC_RELAXED);
+    return max_traces_per_second;
+#else
+    return sampler->max_traces_per_second;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+static inline void
+rate_limiting_sampler_update(jaeger_rate_limiting_sampler* sampler,
+                             double max_traces_per_second)
+{
+    jaeger_token_bucket_update(&sampler->tok,
+                               max_traces_per_second,
+                               JAEGERTRACINGC_MAX(max_traces_per_second, 1));
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    __atomic_store(&sampler->max_traces_per_second,
+                   &max_traces_per_second,
+                   __ATOMIC_RELAXED);
+#else
+    sampler->max_traces_per_second = max_traces_per_second;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
 }
 
 static bool
@@ -129,22 +219,32 @@ jaeger_rate_limiting_sampler_is_sampled(jaeger_sampler* sampler,
 
         tag.key = JAEGERTRACINGC_SAMPLER_PARAM_TAG_KEY;
         tag.v_type = JAEGER__MODEL__VALUE_TYPE__FLOAT64;
-        tag.v_float64 = s->max_traces_per_second;
+        tag.v_float64 = rate_limiting_sampler_load_max_traces_per_second(s);
         jaeger_tag_vector_append(tags, &tag);
     }
     return decision;
 }
 
+static void jaeger_rate_limiting_sampler_destroy(jaeger_destructible* sampler)
+{
+    assert(sampler != NULL);
+    jaeger_rate_limiting_sampler* s = (jaeger_rate_limiting_sampler*) sampler;
+    jaeger_token_bucket_destroy(&s->tok);
+}
+
 void jaeger_rate_limiting_sampler_init(jaeger_rate_limiting_sampler* sampler,
                                        double max_traces_per_second)
 {
     assert(sampler != NULL);
     ((jaeger_sampler*) sampler)->is_sampled =
         jaeger_rate_limiting_sampler_is_sampled;
-    ((jaeger_destructible*) sampler)->destroy = &jaeger_sampler_noop_destroy;
+    ((jaeger_destructible*) sampler)->destroy =
+        &jaeger_rate_limiting_sampler_destroy;
+    /* Sampled traces per second are low enough for a coarse clock. */
     jaeger_token_bucket_init(&sampler->tok,
                              max_traces_per_second,
-                             JAEGERTRACINGC_MAX(max_traces_per_second, 1));
+                             JAEGERTRACINGC_MAX(max_traces_per_second, 1),
+                             true);
     sampler->max_traces_per_second = max_traces_per_second;
 }
 
@@ -159,18 +259,21 @@ static bool jaeger_guaranteed_throughput_probabilistic_sampler_is_sampled(
     assert(sampler != NULL);
     jaeger_guaranteed_throughput_probabilistic_sampler* s =
         (jaeger_guaranteed_throughput_probabilistic_sampler*) sampler;
-    bool decision =
+    const bool decision =
         ((jaeger_sampler*) &s->probabilistic_sampler)
             ->is_sampled((jaeger_sampler*) &s->probabilistic_sampler,
                          trace_id,
                          operation_name,
                          NULL);
-    if (decision) {
+    /* The lower bound sampler is checked either way, so its token bucket
+     * counts the traces sampled probabilistically too. */
+    const bool lower_bound_decision =
         ((jaeger_sampler*) &s->lower_bound_sampler)
             ->is_sampled((jaeger_sampler*) &s->lower_bound_sampler,
                          trace_id,
                          operation_name,
                          NULL);
+    if (decision) {
         if (tags != NULL &&
             jaeger_vector_reserve(tags, jaeger_vector_length(tags) + 2)) {
             jaeger_tag tag = JAEGERTRACINGC_TAG_INIT;
@@ -181,16 +284,12 @@ static bool jaeger_guaranteed_throughput_probabilistic_sampler_is_sampled(
 
             tag.key = JAEGERTRACINGC_SAMPLER_PARAM_TAG_KEY;
             tag.v_type = JAEGER__MODEL__VALUE_TYPE__FLOAT64;
-            tag.v_float64 = s->probabilistic_sampler.sampling_rate;
+            tag.v_float64 =
+                probabilistic_sampler_load_rate(&s->probabilistic_sampler);
             jaeger_tag_vector_append(tags, &tag);
         }
         return true;
     }
-    decision = ((jaeger_sampler*) &s->lower_bound_sampler)
-                   ->is_sampled((jaeger_sampler*) &s->lower_bound_sampler,
-                                trace_id,
-                                operation_name,
-                                NULL);
     if (tags != NULL &&
         jaeger_vector_reserve(tags, jaeger_vector_length(tags) + 2)) {
         jaeger_tag tag = JAEGERTRACINGC_TAG_INIT;
@@ -201,10 +300,11 @@ static bool jaeger_guaranteed_throughput_probabilistic_sampler_is_sampled(
 
         tag.key = JAEGERTRACINGC_SAMPLER_PARAM_TAG_KEY;
         tag.v_type = JAEGER__MODEL__VALUE_TYPE__FLOAT64;
-        tag.v_float64 = s->lower_bound_sampler.max_traces_per_second;
+        tag.v_float64 = rate_limiting_sampler_load_max_traces_per_second(
+            &s->lower_bound_sampler);
         jaeger_tag_vector_append(tags, &tag);
     }
-    return decision;
+    return lower_bound_decision;
 }
 
 static void jaeger_guaranteed_throughput_probabilistic_sampler_destroy(
@@ -241,17 +341,13 @@ void jaeger_guaranteed_throughput_probabilistic_sampler_update(
     double sampling_rate)
 {
     assert(sampler != NULL);
-    if (sampler->probabilistic_sampler.sampling_rate != sampling_rate) {
-        ((jaeger_destructible*) &sampler->probabilistic_sampler)
-            ->destroy((jaeger_destructible*) &sampler->probabilistic_sampler);
-        jaeger_probabilistic_sampler_init(&sampler->probabilistic_sampler,
-                                          sampling_rate);
-    }
-    if (sampler->lower_bound_sampler.max_traces_per_second != lower_bound) {
-        ((jaeger_destructible*) &sampler->lower_bound_sampler)
-            ->destroy((jaeger_destructible*) &sampler->lower_bound_sampler);
-        jaeger_rate_limiting_sampler_init(&sampler->lower_bound_sampler,
-                                          lower_bound);
+    probabilistic_sampler_store_rate(&sampler->probabilistic_sampler,
+                                     sampling_rate);
+    /* Updates are serialized by the adaptive sampler's mutex. */
+    if (rate_limiting_sampler_load_max_traces_per_second(
+            &sampler->lower_bound_sampler) != lower_bound) {
+        rate_limiting_sampler_update(&sampler->lower_bound_sampler,
+                                     lower_bound);
     }
 }
 
@@ -265,6 +361,59 @@ void jaeger_operation_sampler_destroy(jaeger_operation_sampler* op_sampler)
         jaeger_free(op_sampler->operation_name);
         op_sampler->operation_name = NULL;
     }
+    ((jaeger_destructible*) &op_sampler->sampler)
+        ->destroy((jaeger_destructible*) &op_sampler->sampler);
+}
+
+static inline size_t
+operation_name_hash(const char* operation_name,
+                    const jaeger_interned_string* interned_operation_name)
+{
+    return (interned_operation_name != NULL)
+               ? interned_operation_name->hash
+               : jaeger_hashtable_hash(operation_name);
+}
+
+static jaeger_operation_sampler*
+operation_sampler_new(const char* operation_name,
+                      const jaeger_interned_string* interned_operation_name,
+                      double lower_bound,
+                      double sampling_rate)
+{
+    jaeger_operation_sampler* op_sampler =
+        jaeger_malloc(sizeof(jaeger_operation_sampler));
+    if (op_sampler == NULL) {
+        jaeger_log_error("Cannot allocate operation sampler");
+        return NULL;
+    }
+    op_sampler->operation_name = jaeger_strdup(operation_name);
+    if (op_sampler->operation_name == NULL) {
+        jaeger_free(op_sampler);
+        return NULL;
+    }
+    op_sampler->interned_operation_name = interned_operation_name;
+    op_sampler->hash =
+        operation_name_hash(operation_name, interned_operation_name);
+    jaeger_guaranteed_throughput_probabilistic_sampler_init(
+        &op_sampler->sampler, lower_bound, sampling_rate);
+    return op_sampler;
+}
+
+static inline jaeger_operation_sampler*
+op_samplers_get(jaeger_vector* op_samplers, int index)
+{
+    return *(jaeger_operation_sampler**) jaeger_vector_offset(op_samplers,
+                                                              index);
+}
+
+static void free_op_samplers(jaeger_vector* op_samplers)
+{
+    for (int i = 0, len = jaeger_vector_length(op_samplers); i < len; i++) {
+        jaeger_operation_sampler* op_sampler = op_samplers_get(op_samplers, i);
+        jaeger_operation_sampler_destroy(op_sampler);
+        jaeger_free(op_sampler);
+    }
+    jaeger_vector_clear(op_samplers);
 }
 
 static int op_name_cmp(const void* lhs, const void* rhs)
@@ -272,9 +421,9 @@ static int op_name_cmp(const void* lhs, const void* rhs)
     assert(lhs != NULL);
     assert(rhs != NULL);
     const jaeger_operation_sampler* lhs_op_sampler =
-        (const jaeger_operation_sampler*) lhs;
+        *(const jaeger_operation_sampler* const*) lhs;
     const jaeger_operation_sampler* rhs_op_sampler =
-        (const jaeger_operation_sampler*) rhs;
+        *(const jaeger_operation_sampler* const*) rhs;
     return strcmp(lhs_op_sampler->operation_name,
                   rhs_op_sampler->operation_name);
 }
@@ -290,55 +439,197 @@ samplers_from_strategies(const jaeger_per_operation_strategy* strategies,
         return false;
     }
 
-    bool success = true;
-    int index = 0;
     for (size_t i = 0; i < strategies->n_per_operation_strategy; i++) {
         const jaeger_operation_strategy* strategy =
             &strategies->per_operation_strategy[i];
         if (strategy == NULL) {
             continue;
         }
-        jaeger_operation_sampler* op_sampler = jaeger_vector_append(vec);
-        assert(op_sampler != NULL);
-        op_sampler->operation_name = jaeger_strdup(strategy->operation);
-        if (op_sampler->operation_name == NULL) {
-            success = false;
-            break;
-        }
-
-        jaeger_guaranteed_throughput_probabilistic_sampler_init(
-            &op_sampler->sampler,
+        jaeger_operation_sampler* op_sampler = operation_sampler_new(
+            strategy->operation,
+            jaeger_intern_operation_name(strategy->operation),
             strategies->default_lower_bound_traces_per_second,
             strategy->probabilistic.sampling_rate);
-        index++;
-    }
-
-    if (!success) {
-        for (int i = 0; i < index; i++) {
-            jaeger_operation_sampler_destroy(jaeger_vector_get(vec, index));
+        if (op_sampler == NULL) {
+            free_op_samplers(vec);
+            return false;
         }
-        jaeger_vector_clear(vec);
-        return false;
+        jaeger_operation_sampler** op_sampler_ptr = jaeger_vector_append(vec);
+        assert(op_sampler_ptr != NULL);
+        *op_sampler_ptr = op_sampler;
     }
 
     jaeger_vector_sort(vec, &op_name_cmp);
     return true;
 }
 
+/* Slots are filled at most halfway, so probing always ends at an empty slot.
+ * Filled slots never change. Once half full, the index is replaced by one
+ * twice the size and retired, but only freed with the adaptive sampler as
+ * lookups may still be probing it. */
+typedef struct jaeger_operation_sampler_index {
+    struct jaeger_operation_sampler_index* retired;
+    size_t mask;
+    size_t num_op_samplers;
+    jaeger_operation_sampler* slots[];
+} jaeger_operation_sampler_index;
+
+static jaeger_operation_sampler_index*
+op_sampler_index_new(size_t num_slots, jaeger_operation_sampler_index* retired)
+{
+    jaeger_operation_sampler_index* index =
+        jaeger_malloc(sizeof(jaeger_operation_sampler_index) +
+                      sizeof(jaeger_operation_sampler*) * num_slots);
+    if (index == NULL) {
+        jaeger_log_error(
+            "Cannot allocate operation sampler index, number of slots = %zu",
+            num_slots);
+        return NULL;
+    }
+    index->retired = retired;
+    index->mask = num_slots - 1;
+    index->num_op_samplers = 0;
+    for (size_t i = 0; i < num_slots; i++) {
+        index->slots[i] = NULL;
+    }
+    return index;
+}
+
+static void op_sampler_index_destroy(jaeger_operation_sampler_index* index)
+{
+    while (index != NULL) {
+        jaeger_operation_sampler_index* retired = index->retired;
+        jaeger_free(index);
+        index = retired;
+    }
+}
+
 static inline jaeger_operation_sampler*
-jaeger_adaptive_sampler_find_sampler(jaeger_adaptive_sampler* sampler,
-                                     const char* operation_name)
+load_op_sampler(jaeger_operation_sampler* const* slot)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+#else
+    return *slot;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+static inline jaeger_operation_sampler_index*
+load_op_sampler_index(const jaeger_adaptive_sampler* sampler)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    return __atomic_load_n(&sampler->op_sampler_index, __ATOMIC_ACQUIRE);
+#else
+    return sampler->op_sampler_index;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+static inline void
+store_op_sampler_index(jaeger_adaptive_sampler* sampler,
+                       jaeger_operation_sampler_index* index)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    __atomic_store_n(&sampler->op_sampler_index, index, __ATOMIC_RELEASE);
+#else
+    sampler->op_sampler_index = index;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+static jaeger_operation_sampler*
+op_sampler_index_find(const jaeger_operation_sampler_index* index,
+                      const char* operation_name,
+                      const jaeger_interned_string* interned_operation_name,
+                      size_t hash)
 {
-    char* operation_name_copy = jaeger_strdup(operation_name);
-    if (operation_name_copy == NULL) {
+    for (size_t i = hash & index->mask;; i = (i + 1) & index->mask) {
+        jaeger_operation_sampler* op_sampler =
+            load_op_sampler(&index->slots[i]);
+        if (op_sampler == NULL) {
+            return NULL;
+        }
+        if (interned_operation_name != NULL &&
+            op_sampler->interned_operation_name != NULL) {
+            /* Interned names are equal if and only if they are the same. */
+            if (op_sampler->interned_operation_name ==
+                interned_operation_name) {
+                return op_sampler;
+            }
+            continue;
+        }
+        if (op_sampler->hash == hash &&
+            strcmp(op_sampler->operation_name, operation_name) == 0) {
+            return op_sampler;
+        }
+    }
+}
+
+/* Must only be called with the adaptive sampler's mutex locked and while the
+ * index is less than half full. */
+static void op_sampler_index_insert(jaeger_operation_sampler_index* index,
+                                    jaeger_operation_sampler* op_sampler)
+{
+    size_t i = op_sampler->hash & index->mask;
+    while (index->slots[i] != NULL) {
+        i = (i + 1) & index->mask;
+    }
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    __atomic_store_n(&index->slots[i], op_sampler, __ATOMIC_RELEASE);
+#else
+    index->slots[i] = op_sampler;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+    index->num_op_samplers++;
+}
+
+static inline jaeger_operation_sampler* jaeger_adaptive_sampler_find_sampler(
+    const jaeger_adaptive_sampler* sampler,
+    const char* operation_name,
+    const jaeger_interned_string* interned_operation_name,
+    size_t hash)
+{
+    return op_sampler_index_find(load_op_sampler_index(sampler),
+                                 operation_name,
+                                 interned_operation_name,
+                                 hash);
+}
+
+/* Must only be called with the sampler's mutex locked. */
+static jaeger_operation_sampler* jaeger_adaptive_sampler_add_sampler(
+    jaeger_adaptive_sampler* sampler,
+    const char* operation_name,
+    const jaeger_interned_string* interned_operation_name,
+    double lower_bound,
+    double sampling_rate)
+{
+    jaeger_operation_sampler_index* index = sampler->op_sampler_index;
+    if (2 * (index->num_op_samplers + 1) > index->mask + 1) {
+        index = op_sampler_index_new(2 * (index->mask + 1), index);
+        if (index == NULL) {
+            return NULL;
+        }
+        for (int i = 0, len = jaeger_vector_length(&sampler->op_samplers);
+             i < len;
+             i++) {
+            op_sampler_index_insert(index,
+                                    op_samplers_get(&sampler->op_samplers, i));
+        }
+        store_op_sampler_index(sampler, index);
+    }
+    if (!jaeger_vector_reserve(&sampler->op_samplers,
+                               jaeger_vector_length(&sampler->op_samplers) +
+                                   1)) {
         return NULL;
     }
-    const jaeger_operation_sampler key = {.operation_name =
-                                              operation_name_copy};
-    jaeger_operation_sampler* result =
-        jaeger_vector_bsearch(&sampler->op_samplers, &key, &op_name_cmp);
-    jaeger_free(operation_name_copy);
-    return result;
+    jaeger_operation_sampler* op_sampler = operation_sampler_new(
+        operation_name, interned_operation_name, lower_bound, sampling_rate);
+    if (op_sampler == NULL) {
+        return NULL;
+    }
+    jaeger_operation_sampler** op_sampler_ptr =
+        jaeger_vector_append(&sampler->op_samplers);
+    assert(op_sampler_ptr != NULL);
+    *op_sampler_ptr = op_sampler;
+    op_sampler_index_insert(index, op_sampler);
+    return op_sampler;
 }
 
 static bool jaeger_adaptive_sampler_is_sampled(jaeger_sampler* sampler,
@@ -346,77 +637,57 @@ static bool jaeger_adaptive_sampler_is_sampled(jaeger_sampler* sampler,
                                                const char* operation_name,
                                                jaeger_vector* tags)
 {
-    (void) trace_id;
-    (void) operation_name;
     assert(sampler != NULL);
     jaeger_adaptive_sampler* s = (jaeger_adaptive_sampler*) sampler;
+    const jaeger_interned_string* interned_operation_name =
+        jaeger_intern_operation_name(operation_name);
+    const size_t hash =
+        operation_name_hash(operation_name, interned_operation_name);
+#ifndef JAEGERTRACINGC_HAVE_ATOMICS
     jaeger_mutex_lock(&s->mutex);
-    jaeger_operation_sampler* op_sampler =
-        jaeger_adaptive_sampler_find_sampler(s, operation_name);
-    if (op_sampler != NULL) {
-        assert(strcmp(op_sampler->operation_name, operation_name) == 0);
-        jaeger_guaranteed_throughput_probabilistic_sampler* g =
-            &op_sampler->sampler;
-        const bool decision =
-            ((jaeger_sampler*) g)
-                ->is_sampled(
-                    (jaeger_sampler*) g, trace_id, operation_name, tags);
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+    jaeger_operation_sampler* op_sampler = jaeger_adaptive_sampler_find_sampler(
+        s, operation_name, interned_operation_name, hash);
+    if (op_sampler == NULL) {
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+        jaeger_mutex_lock(&s->mutex);
+        /* Another thread may have added the operation since the lookup. */
+        op_sampler = jaeger_adaptive_sampler_find_sampler(
+            s, operation_name, interned_operation_name, hash);
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+        if (op_sampler == NULL &&
+            jaeger_vector_length(&s->op_samplers) < s->max_operations) {
+            op_sampler = jaeger_adaptive_sampler_add_sampler(
+                s,
+                operation_name,
+                interned_operation_name,
+                s->lower_bound,
+                probabilistic_sampler_load_rate(&s->default_sampler));
+        }
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
         jaeger_mutex_unlock(&s->mutex);
-        return decision;
-    }
-
-    if (jaeger_vector_length(&s->op_samplers) >= s->max_operations) {
-        goto use_default_sampler;
-    }
-
-    char* operation_name_copy = jaeger_strdup(operation_name);
-    if (operation_name_copy == NULL) {
-        goto use_default_sampler;
-    }
-    const jaeger_operation_sampler key = {.operation_name =
-                                              operation_name_copy};
-    const int pos =
-        jaeger_vector_lower_bound(&s->op_samplers, &key, &op_name_cmp);
-    jaeger_operation_sampler* op_sampler_ptr =
-        jaeger_vector_insert(&s->op_samplers, pos);
-    if (op_sampler_ptr == NULL) {
-        goto use_default_sampler;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
     }
-    op_sampler_ptr->operation_name = operation_name_copy;
-    jaeger_guaranteed_throughput_probabilistic_sampler_init(
-        &op_sampler_ptr->sampler,
-        s->lower_bound,
-        s->default_sampler.sampling_rate);
 
+    jaeger_sampler* decider = (op_sampler != NULL)
+                                  ? (jaeger_sampler*) &op_sampler->sampler
+                                  : (jaeger_sampler*) &s->default_sampler;
     const bool decision =
-        ((jaeger_sampler*) &op_sampler_ptr->sampler)
-            ->is_sampled((jaeger_sampler*) &op_sampler_ptr->sampler,
-                         trace_id,
-                         operation_name,
-                         tags);
-    jaeger_mutex_unlock(&s->mutex);
-    return decision;
-
-use_default_sampler : {
-    const bool decision =
-        ((jaeger_sampler*) &s->default_sampler)
-            ->is_sampled((jaeger_sampler*) &s->default_sampler,
-                         trace_id,
-                         operation_name,
-                         tags);
+        decider->is_sampled(decider, trace_id, operation_name, tags);
+#ifndef JAEGERTRACINGC_HAVE_ATOMICS
     jaeger_mutex_unlock(&s->mutex);
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
     return decision;
 }
-}
 
 static void jaeger_adaptive_sampler_destroy(jaeger_destructible* sampler)
 {
     assert(sampler != NULL);
     jaeger_adaptive_sampler* s = (jaeger_adaptive_sampler*) sampler;
-    JAEGERTRACINGC_VECTOR_FOR_EACH(&s->op_samplers,
-                                   jaeger_operation_sampler_destroy,
-                                   jaeger_operation_sampler);
+    free_op_samplers(&s->op_samplers);
     jaeger_vector_destroy(&s->op_samplers);
+    op_sampler_index_destroy(s->op_sampler_index);
+    s->op_sampler_index = NULL;
     jaeger_mutex_destroy(&s->mutex);
 }
 
@@ -427,13 +698,28 @@ bool jaeger_adaptive_sampler_init(
 {
     assert(sampler != NULL);
     if (!jaeger_vector_init(&sampler->op_samplers,
-                            sizeof(jaeger_operation_sampler))) {
+                            sizeof(jaeger_operation_sampler*))) {
         return false;
     }
     if (!samplers_from_strategies(strategies, &sampler->op_samplers)) {
         jaeger_vector_destroy(&sampler->op_samplers);
         return false;
     }
+    const int num_op_samplers = jaeger_vector_length(&sampler->op_samplers);
+    size_t num_slots = OP_SAMPLER_INDEX_MIN_SLOTS;
+    while (num_slots < 2 * (size_t) num_op_samplers) {
+        num_slots <<= 1;
+    }
+    sampler->op_sampler_index = op_sampler_index_new(num_slots, NULL);
+    if (sampler->op_sampler_index == NULL) {
+        free_op_samplers(&sampler->op_samplers);
+        jaeger_vector_destroy(&sampler->op_samplers);
+        return false;
+    }
+    for (int i = 0; i < num_op_samplers; i++) {
+        op_sampler_index_insert(sampler->op_sampler_index,
+                                op_samplers_get(&sampler->op_samplers, i));
+    }
     jaeger_probabilistic_sampler_init(&sampler->default_sampler,
                                       strategies->default_sampling_probability);
     sampler->lower_bound = strategies->default_lower_bound_traces_per_second;
@@ -459,48 +745,40 @@ jaeger_adaptive_sampler_update(jaeger_adaptive_sampler* sampler,
     for (int i = 0; i < (int) strategies->n_per_operation_strategy; i++) {
         const jaeger_operation_strategy* strategy =
             &strategies->per_operation_strategy[i];
-        bool found_match = false;
         if (strategy == NULL) {
             jaeger_log_warn("Encountered null operation strategy");
             continue;
         }
 
+        const jaeger_interned_string* interned_operation_name =
+            jaeger_intern_operation_name(strategy->operation);
         jaeger_operation_sampler* op_sampler =
-            jaeger_adaptive_sampler_find_sampler(sampler, strategy->operation);
+            jaeger_adaptive_sampler_find_sampler(
+                sampler,
+                strategy->operation,
+                interned_operation_name,
+                operation_name_hash(strategy->operation,
+                                    interned_operation_name));
         if (op_sampler != NULL) {
             jaeger_guaranteed_throughput_probabilistic_sampler_update(
                 &op_sampler->sampler,
                 lower_bound,
                 strategy->probabilistic.sampling_rate);
-            found_match = true;
+            continue;
         }
 
         /* Only consider allocating new samplers if we have not had issues with
          * memory. Otherwise, success will be false and we will skip this part
-         * entirely.
+         * entirely. Existing samplers are still updated despite memory issues.
          */
-        if (!found_match && success) {
-            char* operation_name = jaeger_strdup(strategy->operation);
-            if (operation_name == NULL) {
-                success = false;
-                /* Continue with loop so we can update existing samplers despite
-                 * memory issues. */
-                continue;
-            }
-            const jaeger_operation_sampler key = {.operation_name =
-                                                      operation_name};
-            const int pos = jaeger_vector_lower_bound(
-                &sampler->op_samplers, &key, &op_name_cmp);
-            jaeger_operation_sampler* op_sampler_ptr =
-                jaeger_vector_insert(&sampler->op_samplers, pos);
-            if (op_sampler_ptr == NULL) {
-                success = false;
-                continue;
-            }
-            jaeger_guaranteed_throughput_probabilistic_sampler_init(
-                &op_sampler_ptr->sampler,
+        if (success &&
+            jaeger_adaptive_sampler_add_sampler(
+                sampler,
+                strategy->operation,
+                interned_operation_name,
                 lower_bound,
-                strategy->probabilistic.sampling_rate);
+                strategy->probabilistic.sampling_rate) == NULL) {
+            success = false;
         }
     }
     jaeger_mutex_unlock(&sampler->mutex);
@@ -577,6 +855,7 @@ enum { http_parsing_state_write, http_parsing_state_read };
 typedef struct parsing_context {
     jaeger_http_sampling_manager* manager;
     int state;
+    bool received;
 } parsing_context;
 
 static int
@@ -619,14 +898,75 @@ jaeger_http_sampling_manager_parser_on_message_complete(http_parser* parser)
     return 0;
 }
 
+static inline int64_t duration_milliseconds(const jaeger_duration* duration)
+{
+    return (int64_t) duration->value.tv_sec * MILLISECONDS_PER_SECOND +
+           duration->value.tv_nsec / NANOSECONDS_PER_MILLISECOND;
+}
+
+static inline int64_t monotonic_milliseconds(void)
+{
+    jaeger_duration now;
+    jaeger_duration_now(&now);
+    return duration_milliseconds(&now);
+}
+
+/* Waits until the connection is ready for events. Returns false if the
+ * deadline passes or the request is interrupted first. */
+static bool
+jaeger_http_sampling_manager_wait(jaeger_http_sampling_manager* manager,
+                                  short events,
+                                  int64_t deadline)
+{
+    struct pollfd fds[] = {
+        {.fd = manager->fd, .events = events, .revents = 0},
+        {.fd = manager->interrupt_fd, .events = POLLIN, .revents = 0}};
+    while (true) {
+        const int64_t timeout = deadline - monotonic_milliseconds();
+        if (timeout <= 0) {
+            jaeger_log_error("Timed out waiting for sampling server, "
+                             "URL = \"%s\"",
+                             manager->sampling_server_url.str);
+            return false;
+        }
+        const int result = poll(&fds[0],
+                                sizeof(fds) / sizeof(fds[0]),
+                                (int) JAEGERTRACINGC_MIN(timeout, INT_MAX));
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            jaeger_log_error(
+                "Cannot poll sampling server connection, errno = %d", errno);
+            return false;
+        }
+        if (fds[1].revents != 0) {
+            return false;
+        }
+        if (fds[0].revents != 0) {
+            return true;
+        }
+    }
+}
+
+static inline void
+jaeger_http_sampling_manager_disconnect(jaeger_http_sampling_manager* manager)
+{
+    if (manager->fd >= 0) {
+        close(manager->fd);
+        manager->fd = -1;
+    }
+}
+
 static inline bool
 jaeger_http_sampling_manager_connect(jaeger_http_sampling_manager* manager,
-                                     const jaeger_host_port* sampling_host_port)
+                                     int64_t deadline)
 {
     assert(manager != NULL);
+    assert(manager->fd < 0);
     struct addrinfo* host_addrs = NULL;
     if (!jaeger_host_port_resolve(
-            sampling_host_port, SOCK_STREAM, &host_addrs)) {
+            &manager->sampling_host_port, SOCK_STREAM, &host_addrs)) {
         return false;
     }
 
@@ -637,16 +977,35 @@ jaeger_http_sampling_manager_connect(jaeger_http_sampling_manager* manager,
         if (fd < 0) {
             continue;
         }
+        const int flags = fcntl(fd, F_GETFL, 0);
+        if (flags < 0 ||
+            fcntl(fd, F_SETFL, (unsigned) flags | (unsigned) O_NONBLOCK) < 0) {
+            close(fd);
+            continue;
+        }
 
+        manager->fd = fd;
         if (connect(fd, addr_iter->ai_addr, addr_iter->ai_addrlen) == 0) {
-            manager->fd = fd;
             success = true;
             break;
         }
-
-        close(fd);
+        if (errno == EINPROGRESS &&
+            jaeger_http_sampling_manager_wait(manager, POLLOUT, deadline)) {
+            int error = 0;
+            socklen_t error_len = sizeof(error);
+            if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &error_len) ==
+                    0 &&
+                error == 0) {
+                success = true;
+                break;
+            }
+        }
+        jaeger_http_sampling_manager_disconnect(manager);
+    }
+    if (success) {
+        http_parser_init(&manager->parser, HTTP_RESPONSE);
     }
-    if (!success) {
+    else {
         jaeger_log_error("Cannot connect to sampling server URL, URL = \"%s\"",
                          manager->sampling_server_url.str);
     }
@@ -658,10 +1017,9 @@ static inline void
 jaeger_http_sampling_manager_destroy(jaeger_http_sampling_manager* manager)
 {
     if (manager != NULL) {
-        if (manager->fd >= 0) {
-            close(manager->fd);
-        }
+        jaeger_http_sampling_manager_disconnect(manager);
         jaeger_url_destroy(&manager->sampling_server_url);
+        jaeger_host_port_destroy(&manager->sampling_host_port);
         if (manager->service_name != NULL) {
             jaeger_free(manager->service_name);
             manager->service_name = NULL;
@@ -674,6 +1032,7 @@ jaeger_http_sampling_manager_destroy(jaeger_http_sampling_manager* manager)
     }
 }
 
+/* Does not connect, the first request does. */
 static inline bool
 jaeger_http_sampling_manager_init(jaeger_http_sampling_manager* manager,
                                   const char* sampling_server_url,
@@ -691,21 +1050,17 @@ jaeger_http_sampling_manager_init(jaeger_http_sampling_manager* manager,
         (sampling_server_url != NULL && strlen(sampling_server_url) > 0)
             ? sampling_server_url
             : "http://localhost:5778/sampling";
-    jaeger_host_port sampling_host_port = {.host = NULL, .port = 0};
     if (!jaeger_url_init(&manager->sampling_server_url, sampling_server_url) ||
-        !jaeger_host_port_from_url(&sampling_host_port,
+        !jaeger_host_port_from_url(&manager->sampling_host_port,
                                    &manager->sampling_server_url)) {
-        goto cleanup_manager;
-    }
-    if (!jaeger_http_sampling_manager_connect(manager, &sampling_host_port)) {
-        goto cleanup_host_port;
+        goto cleanup;
     }
 
     http_parser_init(&manager->parser, HTTP_RESPONSE);
     parsing_context* ctx = jaeger_malloc(sizeof(parsing_context));
     if (ctx == NULL) {
         jaeger_log_error("Cannot allocate parsing context");
-        goto cleanup_host_port;
+        goto cleanup;
     }
     memset(ctx, 0, sizeof(*ctx));
     manager->parser.data = ctx;
@@ -715,27 +1070,22 @@ jaeger_http_sampling_manager_init(jaeger_http_sampling_manager* manager,
     manager->settings.on_message_complete =
         &jaeger_http_sampling_manager_parser_on_message_complete;
 
-    if (!jaeger_vector_init(&manager->response, sizeof(char))) {
-        goto cleanup_ctx;
-    }
-    if (!jaeger_vector_reserve(
+    if (!jaeger_vector_init(&manager->response, sizeof(char)) ||
+        !jaeger_vector_reserve(
             &manager->response,
             JAEGERTRACINGC_HTTP_SAMPLING_MANAGER_REQUEST_MAX_LEN)) {
-        goto cleanup_vec;
+        goto cleanup;
     }
 
-    const bool decision = jaeger_http_sampling_manager_format_request(
-        manager, &manager->sampling_server_url, &sampling_host_port);
-    jaeger_host_port_destroy(&sampling_host_port);
-    return decision;
+    if (!jaeger_http_sampling_manager_format_request(
+            manager,
+            &manager->sampling_server_url,
+            &manager->sampling_host_port)) {
+        goto cleanup;
+    }
+    return true;
 
-cleanup_vec:
-    jaeger_vector_destroy(&manager->response);
-cleanup_ctx:
-    jaeger_free(ctx);
-cleanup_host_port:
-    jaeger_host_port_destroy(&sampling_host_port);
-cleanup_manager:
+cleanup:
     jaeger_http_sampling_manager_destroy(manager);
     return false;
 }
@@ -962,19 +1312,30 @@ cleanup:
 #undef ERR_ARGS
 #undef ERR_FMT
 
-static inline bool jaeger_http_sampling_manager_get_sampling_strategies(
-    jaeger_http_sampling_manager* manager, jaeger_strategy_response* response)
+static inline bool
+jaeger_http_sampling_manager_send_request(jaeger_http_sampling_manager* manager,
+                                          int64_t deadline)
 {
-    assert(manager != NULL);
-    assert(response != NULL);
-    parsing_context* ctx = manager->parser.data;
-    assert(ctx != NULL);
-    *ctx = (parsing_context){.manager = manager,
-                             .state = http_parsing_state_write};
-    jaeger_vector_clear(&manager->response);
-    const int num_written = write(
-        manager->fd, &manager->request_buffer[0], manager->request_length);
-    if (num_written != manager->request_length) {
+    int num_written = 0;
+    while (num_written < manager->request_length) {
+        const ssize_t result = send(manager->fd,
+                                    &manager->request_buffer[num_written],
+                                    manager->request_length - num_written,
+                                    SEND_FLAGS);
+        if (result >= 0) {
+            num_written += result;
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            if (!jaeger_http_sampling_manager_wait(
+                    manager, POLLOUT, deadline)) {
+                return false;
+            }
+            continue;
+        }
         jaeger_log_error("Cannot write entire HTTP sampling request, "
                          "num written = %d, request length = %d, errno = %d",
                          num_written,
@@ -982,22 +1343,89 @@ static inline bool jaeger_http_sampling_manager_get_sampling_strategies(
                          errno);
         return false;
     }
+    return true;
+}
 
+static inline bool jaeger_http_sampling_manager_read_response(
+    jaeger_http_sampling_manager* manager, int64_t deadline)
+{
+    parsing_context* ctx = manager->parser.data;
+    assert(ctx != NULL);
     ctx->state = http_parsing_state_read;
     char chunk_buffer[JAEGERTRACINGC_HTTP_SAMPLING_MANAGER_REQUEST_MAX_LEN];
-    int num_read = read(manager->fd, &chunk_buffer[0], sizeof(chunk_buffer));
-    while (num_read > 0) {
-        const int num_parsed = http_parser_execute(
+    while (ctx->state == http_parsing_state_read) {
+        const ssize_t num_read =
+            read(manager->fd, &chunk_buffer[0], sizeof(chunk_buffer));
+        if (num_read < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (!jaeger_http_sampling_manager_wait(
+                        manager, POLLIN, deadline)) {
+                    return false;
+                }
+                continue;
+            }
+            jaeger_log_error(
+                "Cannot read HTTP sampling response, errno = %d", errno);
+            return false;
+        }
+        ctx->received |= (num_read > 0);
+        /* Parsing zero bytes tells the parser the server closed the
+         * connection, which may complete the response. */
+        const size_t num_parsed = http_parser_execute(
             &manager->parser, &manager->settings, &chunk_buffer[0], num_read);
-        if (num_parsed != num_read) {
+        if (num_parsed != (size_t) num_read) {
             return false;
         }
-        parsing_context* ctx = manager->parser.data;
-        assert(ctx != NULL);
-        if (ctx->state != http_parsing_state_read) {
+        if (num_read == 0) {
+            jaeger_http_sampling_manager_disconnect(manager);
             break;
         }
-        num_read = read(manager->fd, &chunk_buffer[0], sizeof(chunk_buffer));
+    }
+    return ctx->state != http_parsing_state_read;
+}
+
+static inline bool jaeger_http_sampling_manager_get_sampling_strategies(
+    jaeger_http_sampling_manager* manager,
+    jaeger_strategy_response* response,
+    const jaeger_duration* timeout)
+{
+    assert(manager != NULL);
+    assert(response != NULL);
+    assert(timeout != NULL);
+    const int64_t deadline =
+        monotonic_milliseconds() + duration_milliseconds(timeout);
+    bool reused = (manager->fd >= 0);
+    parsing_context* ctx = manager->parser.data;
+    assert(ctx != NULL);
+    while (true) {
+        if (manager->fd < 0 &&
+            !jaeger_http_sampling_manager_connect(manager, deadline)) {
+            return false;
+        }
+        *ctx = (parsing_context){.manager = manager,
+                                 .state = http_parsing_state_write,
+                                 .received = false};
+        jaeger_vector_clear(&manager->response);
+        if (jaeger_http_sampling_manager_send_request(manager, deadline) &&
+            jaeger_http_sampling_manager_read_response(manager, deadline)) {
+            break;
+        }
+        /* Part of the exchange may still be in flight, so the connection
+         * cannot be reused. */
+        jaeger_http_sampling_manager_disconnect(manager);
+        /* The server may have closed the kept-alive connection while it was
+         * idle, which only shows up on the next request. Retry once on a new
+         * connection unless the server already started responding. */
+        if (!reused || ctx->received) {
+            return false;
+        }
+        reused = false;
+    }
+    if (!http_should_keep_alive(&manager->parser)) {
+        jaeger_http_sampling_manager_disconnect(manager);
     }
 
     char* null_byte_ptr = jaeger_vector_append(&manager->response);
@@ -1047,51 +1475,176 @@ jaeger_remotely_controlled_sampler_is_sampled(jaeger_sampler* sampler,
     assert(sampler != NULL);
     jaeger_remotely_controlled_sampler* s =
         (jaeger_remotely_controlled_sampler*) sampler;
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    int* readers =
+        &s->readers[__atomic_load_n(&s->epoch, __ATOMIC_SEQ_CST) & 1u];
+    __atomic_fetch_add(readers, 1, __ATOMIC_SEQ_CST);
+    jaeger_sampler* inner_sampler = jaeger_sampler_choice_get_sampler(
+        __atomic_load_n(&s->sampler, __ATOMIC_SEQ_CST));
+    assert(inner_sampler != NULL);
+    const bool result = inner_sampler->is_sampled(
+        inner_sampler, trace_id, operation_name, tags);
+    __atomic_fetch_sub(readers, 1, __ATOMIC_RELEASE);
+#else
     jaeger_mutex_lock(&s->mutex);
     jaeger_sampler* inner_sampler =
-        jaeger_sampler_choice_get_sampler(&s->sampler);
+        jaeger_sampler_choice_get_sampler(s->sampler);
     assert(inner_sampler != NULL);
     const bool result = inner_sampler->is_sampled(
         inner_sampler, trace_id, operation_name, tags);
     jaeger_mutex_unlock(&s->mutex);
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
     return result;
 }
 
+/* Replaces the active sampler and destroys the old one once no thread samples
+ * with it. Must only be called with the sampler's mutex locked. */
+static void jaeger_remotely_controlled_sampler_publish(
+    jaeger_remotely_controlled_sampler* sampler,
+    jaeger_sampler_choice* sampler_choice)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    jaeger_sampler_choice* old_sampler_choice = __atomic_exchange_n(
+        &sampler->sampler, sampler_choice, __ATOMIC_SEQ_CST);
+    /* A thread counted in either epoch may still use the old sampler, but
+     * threads entering an epoch after its count dropped to zero see the new
+     * one. */
+    for (int i = 0; i < 2; i++) {
+        const unsigned int epoch =
+            __atomic_fetch_add(&sampler->epoch, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&sampler->readers[epoch & 1u],
+                               __ATOMIC_SEQ_CST) != 0) {
+            jaeger_yield();
+        }
+    }
+#else
+    jaeger_sampler_choice* old_sampler_choice = sampler->sampler;
+    sampler->sampler = sampler_choice;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+    jaeger_sampler_choice_destroy(old_sampler_choice);
+    jaeger_free(old_sampler_choice);
+}
+
+/* Wakes the background thread and waits for it to exit. */
+static void jaeger_remotely_controlled_sampler_stop(
+    jaeger_remotely_controlled_sampler* sampler)
+{
+#ifdef JAEGERTRACINGC_MT
+    if (sampler->running) {
+        /* The byte is never read, so the pipe stays readable and interrupts
+         * whatever the thread waits for next. */
+        const char byte = 0;
+        while (write(sampler->stop_fds[1], &byte, 1) < 0 && errno == EINTR) {
+        }
+        jaeger_thread_join(sampler->thread, NULL);
+        sampler->running = false;
+    }
+#endif /* JAEGERTRACINGC_MT */
+    for (int i = 0; i < 2; i++) {
+        if (sampler->stop_fds[i] >= 0) {
+            close(sampler->stop_fds[i]);
+            sampler->stop_fds[i] = -1;
+        }
+    }
+    sampler->manager.interrupt_fd = -1;
+}
+
 static void
 jaeger_remotely_controlled_sampler_destroy(jaeger_destructible* sampler)
 {
     jaeger_remotely_controlled_sampler* s =
         (jaeger_remotely_controlled_sampler*) sampler;
-    jaeger_sampler_choice* sampler_choice = &s->sampler;
-    jaeger_sampler_choice_destroy(sampler_choice);
+    jaeger_remotely_controlled_sampler_stop(s);
+    if (s->sampler != NULL) {
+        jaeger_sampler_choice_destroy(s->sampler);
+        jaeger_free(s->sampler);
+        s->sampler = NULL;
+    }
     jaeger_http_sampling_manager_destroy(&s->manager);
+    jaeger_mutex_destroy(&s->update_mutex);
     jaeger_mutex_destroy(&s->mutex);
 }
 
-static inline bool jaeger_remotely_controlled_sampler_update_adaptive_sampler(
+/* Builds the sampler for a strategy response, returns NULL on failure or if
+ * the active adaptive sampler was updated in place. */
+static inline jaeger_sampler_choice*
+jaeger_remotely_controlled_sampler_from_response(
     jaeger_remotely_controlled_sampler* sampler,
-    const jaeger_per_operation_strategy* strategies)
+    const jaeger_strategy_response* response,
+    bool* success)
 {
     assert(sampler != NULL);
-    assert(strategies != NULL);
-    if (sampler->sampler.type == jaeger_adaptive_sampler_type) {
-        return jaeger_adaptive_sampler_update(
-            &sampler->sampler.adaptive_sampler, strategies);
+    assert(response != NULL);
+    assert(success != NULL);
+    if (response->strategy_case == jaeger_per_operation_strategy_type &&
+        sampler->sampler->type == jaeger_adaptive_sampler_type) {
+        *success = jaeger_adaptive_sampler_update(
+            &sampler->sampler->adaptive_sampler,
+            &response->strategy.per_operation);
+        if (!*success) {
+            jaeger_log_error("Cannot update adaptive sampler in remotely "
+                             "controlled sampler");
+        }
+        return NULL;
+    }
+    if (response->strategy_case != jaeger_per_operation_strategy_type &&
+        response->strategy_case != jaeger_probabilistic_strategy_type &&
+        response->strategy_case != jaeger_rate_limiting_strategy_type) {
+        jaeger_log_error("Invalid strategy type in response, type = %d",
+                         response->strategy_case);
+        *success = false;
+        return NULL;
     }
-    jaeger_sampler_choice_destroy(&sampler->sampler);
-    sampler->sampler.type = jaeger_adaptive_sampler_type;
-    return jaeger_adaptive_sampler_init(&sampler->sampler.adaptive_sampler,
-                                        strategies,
-                                        sampler->max_operations);
+
+    jaeger_sampler_choice* sampler_choice =
+        jaeger_malloc(sizeof(jaeger_sampler_choice));
+    if (sampler_choice == NULL) {
+        jaeger_log_error("Cannot allocate sampler in remotely controlled "
+                         "sampler");
+        *success = false;
+        return NULL;
+    }
+    *sampler_choice =
+        (jaeger_sampler_choice) JAEGERTRACINGC_SAMPLER_CHOICE_INIT;
+    switch (response->strategy_case) {
+    case jaeger_per_operation_strategy_type: {
+        sampler_choice->type = jaeger_adaptive_sampler_type;
+        if (!jaeger_adaptive_sampler_init(&sampler_choice->adaptive_sampler,
+                                          &response->strategy.per_operation,
+                                          sampler->max_operations)) {
+            jaeger_log_error("Cannot update adaptive sampler in remotely "
+                             "controlled sampler");
+            jaeger_free(sampler_choice);
+            *success = false;
+            return NULL;
+        }
+    } break;
+    case jaeger_probabilistic_strategy_type: {
+        sampler_choice->type = jaeger_probabilistic_sampler_type;
+        jaeger_probabilistic_sampler_init(
+            &sampler_choice->probabilistic_sampler,
+            JAEGERTRACINGC_CLAMP(
+                response->strategy.probabilistic.sampling_rate, 0, 1));
+    } break;
+    default: {
+        sampler_choice->type = jaeger_rate_limiting_sampler_type;
+        jaeger_rate_limiting_sampler_init(
+            &sampler_choice->rate_limiting_sampler,
+            response->strategy.rate_limiting.max_traces_per_second);
+    } break;
+    }
+    *success = true;
+    return sampler_choice;
 }
 
 bool jaeger_remotely_controlled_sampler_update(
     jaeger_remotely_controlled_sampler* sampler)
 {
     assert(sampler != NULL);
+    jaeger_mutex_lock(&sampler->update_mutex);
     jaeger_strategy_response response = {.strategy = {}};
     const bool result = jaeger_http_sampling_manager_get_sampling_strategies(
-        &sampler->manager, &response);
+        &sampler->manager, &response, &sampler->options.request_timeout);
     if (!result) {
         jaeger_log_error("Cannot get sampling strategies, will retry later");
         if (sampler->metrics != NULL) {
@@ -1100,6 +1653,7 @@ bool jaeger_remotely_controlled_sampler_update(
             assert(query_failure != NULL);
             query_failure->inc(query_failure, 1);
         }
+        jaeger_mutex_unlock(&sampler->update_mutex);
         return false;
     }
 
@@ -1112,40 +1666,11 @@ bool jaeger_remotely_controlled_sampler_update(
         retrieved->inc(retrieved, 1);
     }
 
-    switch (response.strategy_case) {
-    case jaeger_per_operation_strategy_type: {
-        if (!jaeger_remotely_controlled_sampler_update_adaptive_sampler(
-                sampler, &response.strategy.per_operation)) {
-            jaeger_log_error("Cannot update adaptive sampler in remotely "
-                             "controlled "
-                             "sampler");
-            success = false;
-        }
-    } break;
-    case jaeger_probabilistic_strategy_type: {
-        jaeger_sampler_choice_destroy(&sampler->sampler);
-        sampler->sampler.type = jaeger_probabilistic_sampler_type;
-        jaeger_probabilistic_sampler_init(
-            &sampler->sampler.probabilistic_sampler,
-            JAEGERTRACINGC_CLAMP(
-                response.strategy.probabilistic.sampling_rate, 0, 1));
-    } break;
-    default: {
-        success =
-            (response.strategy_case == jaeger_rate_limiting_strategy_type);
-        if (response.strategy_case != jaeger_rate_limiting_strategy_type) {
-            jaeger_log_error("Invalid strategy type in response, type = %d",
-                             response.strategy_case);
-        }
-        else {
-            jaeger_sampler_choice_destroy(&sampler->sampler);
-            const double max_traces_per_second =
-                response.strategy.rate_limiting.max_traces_per_second;
-            sampler->sampler.type = jaeger_rate_limiting_sampler_type;
-            jaeger_rate_limiting_sampler_init(
-                &sampler->sampler.rate_limiting_sampler, max_traces_per_second);
-        }
-    } break;
+    jaeger_sampler_choice* sampler_choice =
+        jaeger_remotely_controlled_sampler_from_response(
+            sampler, &response, &success);
+    if (sampler_choice != NULL) {
+        jaeger_remotely_controlled_sampler_publish(sampler, sampler_choice);
     }
 
     if (sampler->metrics != NULL) {
@@ -1158,45 +1683,175 @@ bool jaeger_remotely_controlled_sampler_update(
 
     jaeger_mutex_unlock(&sampler->mutex);
     jaeger_strategy_response_destroy(&response);
+    jaeger_mutex_unlock(&sampler->update_mutex);
     return success;
 }
 
+#ifdef JAEGERTRACINGC_MT
+
+/* Returns true if the sampler is stopped before timeout milliseconds pass. */
+static bool jaeger_remotely_controlled_sampler_wait(
+    jaeger_remotely_controlled_sampler* sampler, int64_t timeout)
+{
+    struct pollfd fd = {
+        .fd = sampler->stop_fds[0], .events = POLLIN, .revents = 0};
+    const int64_t deadline = monotonic_milliseconds() + timeout;
+    while (true) {
+        timeout = JAEGERTRACINGC_MAX(deadline - monotonic_milliseconds(), 0);
+        const int result =
+            poll(&fd, 1, (int) JAEGERTRACINGC_MIN(timeout, INT_MAX));
+        if (result >= 0) {
+            return result > 0;
+        }
+        if (errno != EINTR) {
+            jaeger_log_error("Cannot wait for next sampling strategy update, "
+                             "stopping updates, errno = %d",
+                             errno);
+            return true;
+        }
+    }
+}
+
+/* Randomly shortens or lengthens wait by up to the given fraction. */
+static inline int64_t jitter_milliseconds(int64_t wait, double jitter)
+{
+    const double factor =
+        2 * ((double) jaeger_random64() / (double) UINT64_MAX) - 1;
+    return wait + (int64_t)(wait * JAEGERTRACINGC_CLAMP(jitter, 0, 1) * factor);
+}
+
+static void* jaeger_remotely_controlled_sampler_update_loop(void* arg)
+{
+    assert(arg != NULL);
+    jaeger_remotely_controlled_sampler* sampler =
+        (jaeger_remotely_controlled_sampler*) arg;
+    const jaeger_remotely_controlled_sampler_options* options =
+        &sampler->options;
+    const int64_t refresh_interval = JAEGERTRACINGC_MAX(
+        duration_milliseconds(&options->refresh_interval), 1);
+    const int64_t initial_backoff = JAEGERTRACINGC_MAX(
+        duration_milliseconds(&options->initial_backoff), 1);
+    const int64_t max_backoff = JAEGERTRACINGC_MAX(
+        duration_milliseconds(&options->max_backoff), initial_backoff);
+    int64_t backoff = initial_backoff;
+    /* Fetch the strategy right away rather than a full interval later. */
+    int64_t wait = 0;
+    while (!jaeger_remotely_controlled_sampler_wait(sampler, wait)) {
+        if (jaeger_remotely_controlled_sampler_update(sampler)) {
+            backoff = initial_backoff;
+            wait = jitter_milliseconds(refresh_interval,
+                                       options->refresh_jitter);
+        }
+        else {
+            wait = jitter_milliseconds(backoff, options->refresh_jitter);
+            backoff = JAEGERTRACINGC_MIN(2 * backoff, max_backoff);
+        }
+    }
+    return NULL;
+}
+
+#endif /* JAEGERTRACINGC_MT */
+
+/* Starts the background update thread unless the refresh interval is zero. */
+static bool jaeger_remotely_controlled_sampler_start(
+    jaeger_remotely_controlled_sampler* sampler)
+{
+#ifdef JAEGERTRACINGC_MT
+    /* Single-threaded builds have no way to run the loop concurrently, so
+     * they must update explicitly. */
+    if (sampler->options.refresh_interval.value.tv_sec <= 0 &&
+        sampler->options.refresh_interval.value.tv_nsec <= 0) {
+        return true;
+    }
+    if (pipe(sampler->stop_fds) != 0) {
+        jaeger_log_error("Cannot create pipe to stop sampling strategy "
+                         "updates, errno = %d",
+                         errno);
+        sampler->stop_fds[0] = -1;
+        sampler->stop_fds[1] = -1;
+        return false;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(sampler->stop_fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    sampler->manager.interrupt_fd = sampler->stop_fds[0];
+    const int return_code =
+        jaeger_thread_init(&sampler->thread,
+                           &jaeger_remotely_controlled_sampler_update_loop,
+                           sampler);
+    if (return_code != 0) {
+        jaeger_log_error("Cannot start sampling strategy update thread, "
+                         "return code = %d",
+                         return_code);
+        return false;
+    }
+    sampler->running = true;
+#else
+    (void) sampler;
+#endif /* JAEGERTRACINGC_MT */
+    return true;
+}
+
 bool jaeger_remotely_controlled_sampler_init(
     jaeger_remotely_controlled_sampler* sampler,
     const char* service_name,
     const char* sampling_server_url,
     const jaeger_sampler_choice* initial_sampler,
     int max_operations,
-    jaeger_metrics* metrics)
+    jaeger_metrics* metrics,
+    const jaeger_remotely_controlled_sampler_options* options)
 {
     assert(sampler != NULL);
     assert(service_name != NULL && strlen(service_name) > 0);
     max_operations =
         (max_operations <= 0) ? DEFAULT_MAX_OPERATIONS : max_operations;
     *sampler = (jaeger_remotely_controlled_sampler){
-        {{&jaeger_remotely_controlled_sampler_destroy},
-         &jaeger_remotely_controlled_sampler_is_sampled},
-        JAEGERTRACINGC_SAMPLER_CHOICE_INIT,
-        max_operations,
-        metrics,
-        JAEGERTRACINGC_HTTP_SAMPLING_MANAGER_INIT,
-        JAEGERTRACINGC_MUTEX_INIT};
-
-    if (initial_sampler != NULL) {
-        sampler->sampler = *initial_sampler;
-    }
-    else {
-        sampler->sampler.type = jaeger_probabilistic_sampler_type;
-        jaeger_probabilistic_sampler_init(
-            &sampler->sampler.probabilistic_sampler, DEFAULT_SAMPLING_RATE);
+        .base = {.base = {.destroy =
+                              &jaeger_remotely_controlled_sampler_destroy},
+                 .is_sampled = &jaeger_remotely_controlled_sampler_is_sampled},
+        .sampler = NULL,
+        .readers = {0, 0},
+        .epoch = 0,
+        .max_operations = max_operations,
+        .metrics = metrics,
+        .manager = JAEGERTRACINGC_HTTP_SAMPLING_MANAGER_INIT,
+        .options = JAEGERTRACINGC_REMOTELY_CONTROLLED_SAMPLER_OPTIONS_INIT,
+        .update_mutex = JAEGERTRACINGC_MUTEX_INIT,
+        .mutex = JAEGERTRACINGC_MUTEX_INIT,
+        .running = false,
+        .stop_fds = {-1, -1}};
+    if (options != NULL) {
+        sampler->options = *options;
     }
 
     if (!jaeger_http_sampling_manager_init(
             &sampler->manager, sampling_server_url, service_name)) {
         jaeger_log_error("Cannot initialize HTTP manager for remotely "
                          "controlled sampler");
-        return false;
+        goto cleanup;
+    }
+
+    sampler->sampler = jaeger_malloc(sizeof(jaeger_sampler_choice));
+    if (sampler->sampler == NULL) {
+        jaeger_log_error("Cannot allocate sampler in remotely controlled "
+                         "sampler");
+        goto cleanup;
+    }
+    if (initial_sampler != NULL) {
+        *sampler->sampler = *initial_sampler;
+    }
+    else {
+        sampler->sampler->type = jaeger_probabilistic_sampler_type;
+        jaeger_probabilistic_sampler_init(
+            &sampler->sampler->probabilistic_sampler, DEFAULT_SAMPLING_RATE);
     }
 
+    if (!jaeger_remotely_controlled_sampler_start(sampler)) {
+        goto cleanup;
+    }
     return true;
+
+cleanup:
+    jaeger_remotely_controlled_sampler_destroy((jaeger_destructible*) sampler);
+    return false;
 }
@@ -25,6 +25,7 @@
 #include "jaegertracingc/clock.h"
 #include "jaegertracingc/common.h"
 #include "jaegertracingc/constants.h"
+#include "jaegertracingc/intern.h"
 #include "jaegertracingc/metrics.h"
 #include "jaegertracingc/net.h"
 #include "jaegertracingc/sampling_strategy.h"
@@ -53,14 +54,25 @@ typedef struct jaeger_const_sampler {
 
 void jaeger_const_sampler_init(jaeger_const_sampler* sampler, bool decision);
 
+/**
+ * Samples a fraction of traces. The decision only depends on the trace ID, so
+ * every process sampling at the same rate makes the same decision for a
+ * trace.
+ */
 typedef struct jaeger_probabilistic_sampler {
     jaeger_sampler base;
     double sampling_rate;
+    /** Traces are sampled if the low 63 bits of their ID are below this. */
+    uint64_t sampling_boundary;
 } jaeger_probabilistic_sampler;
 
 void jaeger_probabilistic_sampler_init(jaeger_probabilistic_sampler* sampler,
                                        double sampling_rate);
 
+/**
+ * Samples up to a maximum number of traces per second. May be shared between
+ * threads without locking.
+ */
 typedef struct jaeger_rate_limiting_sampler {
     jaeger_sampler base;
     jaeger_token_bucket tok;
@@ -70,6 +82,10 @@ typedef struct jaeger_rate_limiting_sampler {
 void jaeger_rate_limiting_sampler_init(jaeger_rate_limiting_sampler* sampler,
                                        double max_traces_per_second);
 
+/**
+ * Samples probabilistically, but at least at the lower bound rate. May be
+ * shared between threads without locking, the rates are updated atomically.
+ */
 typedef struct jaeger_guaranteed_throughput_probabilistic_sampler {
     jaeger_sampler base;
     jaeger_probabilistic_sampler probabilistic_sampler;
@@ -89,14 +105,31 @@ void jaeger_guaranteed_throughput_probabilistic_sampler_update(
 /* Used in jaeger_adaptive_sampler, not a new sampler type. */
 typedef struct jaeger_operation_sampler {
     char* operation_name;
+    /** Interned operation name, NULL if it could not be interned. */
+    const jaeger_interned_string* interned_operation_name;
+    /** Hash of operation_name, see jaeger_hashtable_hash. */
+    size_t hash;
     jaeger_guaranteed_throughput_probabilistic_sampler sampler;
 } jaeger_operation_sampler;
 
 void jaeger_operation_sampler_destroy(jaeger_operation_sampler* op_sampler);
 
+/* Open addressing index of operation samplers, defined in sampler.c. */
+struct jaeger_operation_sampler_index;
+
+/**
+ * Samples each operation with its own guaranteed throughput sampler.
+ * Operation samplers are never removed, so lookups go through op_sampler_index
+ * without locking. Adding an operation sampler locks mutex.
+ */
 typedef struct jaeger_adaptive_sampler {
     jaeger_sampler base;
+    /**
+     * Pointers to operation samplers. Operation samplers from the initial
+     * strategies are sorted by operation name, later ones are appended.
+     */
     jaeger_vector op_samplers;
+    struct jaeger_operation_sampler_index* op_sampler_index;
     jaeger_probabilistic_sampler default_sampler;
     double lower_bound;
     int max_operations;
@@ -146,7 +179,11 @@ void jaeger_sampler_choice_destroy(jaeger_sampler_choice* sampler);
 typedef struct jaeger_http_sampling_manager {
     char* service_name;
     jaeger_url sampling_server_url;
+    jaeger_host_port sampling_host_port;
+    /** Connection to the sampling server, -1 until the first request. */
     int fd;
+    /** Requests give up once this becomes readable, ignored if negative. */
+    int interrupt_fd;
     http_parser parser;
     http_parser_settings settings;
     int request_length;
@@ -157,26 +194,128 @@ typedef struct jaeger_http_sampling_manager {
 #define JAEGERTRACINGC_HTTP_SAMPLING_MANAGER_INIT                             \
     {                                                                         \
         .service_name = NULL, .sampling_server_url = JAEGERTRACINGC_URL_INIT, \
-        .fd = -1, .parser = {}, .settings = {}, .request_length = 0,          \
-        .request_buffer = {'\0'}, .response = JAEGERTRACINGC_VECTOR_INIT      \
+        .sampling_host_port = JAEGERTRACINGC_HOST_PORT_INIT, .fd = -1,        \
+        .interrupt_fd = -1, .parser = {}, .settings = {},                     \
+        .request_length = 0, .request_buffer = {'\0'},                        \
+        .response = JAEGERTRACINGC_VECTOR_INIT                                \
+    }
+
+#define JAEGERTRACINGC_DEFAULT_SAMPLING_REFRESH_INTERVAL \
+    {                                                    \
+        .value = {.tv_sec = 60, .tv_nsec = 0 }           \
+    }
+
+#define JAEGERTRACINGC_DEFAULT_SAMPLING_REFRESH_JITTER 0.1
+
+#define JAEGERTRACINGC_DEFAULT_SAMPLING_INITIAL_BACKOFF \
+    {                                                   \
+        .value = {.tv_sec = 1, .tv_nsec = 0 }           \
     }
 
+#define JAEGERTRACINGC_DEFAULT_SAMPLING_MAX_BACKOFF \
+    {                                               \
+        .value = {.tv_sec = 300, .tv_nsec = 0 }     \
+    }
+
+#define JAEGERTRACINGC_DEFAULT_SAMPLING_REQUEST_TIMEOUT \
+    {                                                   \
+        .value = {.tv_sec = 5, .tv_nsec = 0 }           \
+    }
+
+/**
+ * Options that can be used to customize the remotely controlled sampler.
+ */
+typedef struct jaeger_remotely_controlled_sampler_options {
+    /**
+     * Interval between background updates of the sampling strategy. A zero
+     * interval disables the background thread, in which case the strategy is
+     * only updated by calling jaeger_remotely_controlled_sampler_update.
+     */
+    jaeger_duration refresh_interval;
+    /**
+     * Fraction of each wait by which it is randomly shortened or lengthened,
+     * so processes started together do not query the server in lockstep.
+     */
+    double refresh_jitter;
+    /**
+     * Wait before retrying after a failed update, doubled with each further
+     * failure up to max_backoff.
+     */
+    jaeger_duration initial_backoff;
+    jaeger_duration max_backoff;
+    /**
+     * Time allowed for a single update to connect, send its request and
+     * receive the response.
+     */
+    jaeger_duration request_timeout;
+} jaeger_remotely_controlled_sampler_options;
+
+#define JAEGERTRACINGC_REMOTELY_CONTROLLED_SAMPLER_OPTIONS_INIT               \
+    {                                                                         \
+        .refresh_interval = JAEGERTRACINGC_DEFAULT_SAMPLING_REFRESH_INTERVAL, \
+        .refresh_jitter = JAEGERTRACINGC_DEFAULT_SAMPLING_REFRESH_JITTER,     \
+        .initial_backoff = JAEGERTRACINGC_DEFAULT_SAMPLING_INITIAL_BACKOFF,   \
+        .max_backoff = JAEGERTRACINGC_DEFAULT_SAMPLING_MAX_BACKOFF,           \
+        .request_timeout = JAEGERTRACINGC_DEFAULT_SAMPLING_REQUEST_TIMEOUT    \
+    }
+
+/**
+ * Samples with the strategy fetched from the sampling server. Each update
+ * builds a new sampler and swaps it in, so sampling does not lock. An adaptive
+ * sampler is updated in place instead, as it already allows that.
+ */
 typedef struct jaeger_remotely_controlled_sampler {
     jaeger_sampler base;
-    jaeger_sampler_choice sampler;
+    /** Active sampler, only replaced as a whole. */
+    jaeger_sampler_choice* sampler;
+    /**
+     * Number of threads sampling in each epoch. Before a replaced sampler is
+     * destroyed, an update advances the epoch twice and waits for the threads
+     * of the epoch it left behind each time.
+     */
+    int readers[2];
+    unsigned int epoch;
     int max_operations;
     jaeger_metrics* metrics;
     jaeger_http_sampling_manager manager;
+    jaeger_remotely_controlled_sampler_options options;
+    /** Serializes updates, which may take up to the request timeout. */
+    jaeger_mutex update_mutex;
+    /** Guards replacing the sampler. Without atomics, sampling locks it too. */
     jaeger_mutex mutex;
+    /** Background thread updating the strategy. */
+    jaeger_thread thread;
+    bool running;
+    /**
+     * Pipe written to once on destroy, which wakes the background thread and
+     * interrupts its request.
+     */
+    int stop_fds[2];
 } jaeger_remotely_controlled_sampler;
 
+/**
+ * Initialize a new remotely controlled sampler. Unless disabled in options,
+ * starts a background thread that updates the sampling strategy
+ * periodically. The sampling server is not contacted before the first update.
+ * @param sampler Sampler to initialize.
+ * @param service_name Name of the service to query strategies for.
+ * @param sampling_server_url Sampling server URL. May be NULL to use default.
+ * @param initial_sampler Sampler used until the first successful update. May
+ *                        be NULL to use a probabilistic sampler.
+ * @param max_operations Maximum number of operations sampled separately by an
+ *                       adaptive sampler. Uses default if not positive.
+ * @param metrics Metrics object to use. May be NULL.
+ * @param options Options for sampler to use. May be NULL.
+ * @return True on success, false otherwise.
+ */
 bool jaeger_remotely_controlled_sampler_init(
     jaeger_remotely_controlled_sampler* sampler,
     const char* service_name,
     const char* sampling_server_url,
     const jaeger_sampler_choice* initial_sampler,
     int max_operations,
-    jaeger_metrics* metrics);
+    jaeger_metrics* metrics,
+    const jaeger_remotely_controlled_sampler_options* options);
 
 bool jaeger_remotely_controlled_sampler_update(
     jaeger_remotely_controlled_sampler* sampler);
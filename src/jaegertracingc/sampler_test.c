@@ -125,6 +125,27 @@ static inline void test_probabilistic_sampler()
             ->is_sampled(
                 (jaeger_sampler*) &p, &trace_id, operation_name, &tags));
     CHECK_PROBABILISTIC_TAGS(p, tags);
+    ((jaeger_destructible*) &p)->destroy((jaeger_destructible*) &p);
+
+    /* Decisions only depend on the low 63 bits of the trace ID. */
+    sampling_rate = 0.5;
+    jaeger_probabilistic_sampler_init(&p, sampling_rate);
+    jaeger_trace_id sampled_trace_id = {.high = 0, .low = (1ull << 62) - 1};
+    jaeger_trace_id unsampled_trace_id = {.high = 0, .low = 1ull << 62};
+    for (int i = 0; i < 2; i++) {
+        TEST_ASSERT_TRUE(((jaeger_sampler*) &p)
+                             ->is_sampled((jaeger_sampler*) &p,
+                                          &sampled_trace_id,
+                                          operation_name,
+                                          NULL));
+        TEST_ASSERT_FALSE(((jaeger_sampler*) &p)
+                              ->is_sampled((jaeger_sampler*) &p,
+                                           &unsampled_trace_id,
+                                           operation_name,
+                                           NULL));
+        sampled_trace_id.low |= 1ull << 63;
+        unsampled_trace_id.low |= 1ull << 63;
+    }
 
     TEAR_DOWN_SAMPLER_TEST(p);
 }
@@ -240,17 +261,30 @@ static inline void test_adaptive_sampler()
     }
     TEST_ASSERT_EQUAL(TEST_DEFAULT_MAX_OPERATIONS,
                       jaeger_vector_length(&a.op_samplers));
-    jaeger_operation_sampler* op_sampler_lhs =
-        jaeger_vector_get(&a.op_samplers, 0);
-    TEST_ASSERT_NOT_NULL(op_sampler_lhs);
-    TEST_ASSERT_NOT_NULL(op_sampler_lhs->operation_name);
-    jaeger_operation_sampler* op_sampler_rhs =
-        jaeger_vector_get(&a.op_samplers, 1);
-    TEST_ASSERT_NOT_NULL(op_sampler_rhs);
-    TEST_ASSERT_NOT_NULL(op_sampler_rhs->operation_name);
-    TEST_ASSERT_LESS_THAN(
-        0,
-        strcmp(op_sampler_lhs->operation_name, op_sampler_rhs->operation_name));
+    /* Operations are appended after the ones from the strategies. */
+    jaeger_operation_sampler* op_sampler =
+        *(jaeger_operation_sampler**) jaeger_vector_get(&a.op_samplers, 0);
+    TEST_ASSERT_NOT_NULL(op_sampler);
+    TEST_ASSERT_EQUAL_STRING(operation_name, op_sampler->operation_name);
+    op_sampler =
+        *(jaeger_operation_sampler**) jaeger_vector_get(&a.op_samplers, 1);
+    TEST_ASSERT_NOT_NULL(op_sampler);
+    TEST_ASSERT_EQUAL_STRING("new-operation-0", op_sampler->operation_name);
+
+    /* Known operations are found again after the index grew. */
+    JAEGERTRACINGC_VECTOR_FOR_EACH(&tags, jaeger_tag_destroy, jaeger_tag);
+    jaeger_vector_clear(&tags);
+    for (int i = 0; i < TEST_DEFAULT_MAX_OPERATIONS; i++) {
+        op_sampler =
+            *(jaeger_operation_sampler**) jaeger_vector_get(&a.op_samplers, i);
+        ((jaeger_sampler*) &a)
+            ->is_sampled((jaeger_sampler*) &a,
+                         &trace_id,
+                         op_sampler->operation_name,
+                         &tags);
+    }
+    TEST_ASSERT_EQUAL(TEST_DEFAULT_MAX_OPERATIONS,
+                      jaeger_vector_length(&a.op_samplers));
 
     jaeger_per_operation_strategy_destroy(&strategies);
     TEAR_DOWN_SAMPLER_TEST(a);
@@ -268,6 +302,10 @@ static inline void test_remotely_controlled_sampler()
     char buffer[sizeof(URL_PREFIX) + PORT_LEN];
     const int result = snprintf(buffer, sizeof(buffer), URL_PREFIX "%d", port);
     TEST_ASSERT_LESS_OR_EQUAL(sizeof(buffer) - 1, result);
+    /* Update explicitly to control which response each update gets. */
+    jaeger_remotely_controlled_sampler_options options =
+        JAEGERTRACINGC_REMOTELY_CONTROLLED_SAMPLER_OPTIONS_INIT;
+    options.refresh_interval = (jaeger_duration) JAEGERTRACINGC_DURATION_INIT;
     jaeger_remotely_controlled_sampler r;
     TEST_ASSERT_TRUE(
         jaeger_remotely_controlled_sampler_init(&r,
@@ -275,7 +313,8 @@ static inline void test_remotely_controlled_sampler()
                                                 buffer,
                                                 NULL,
                                                 TEST_DEFAULT_MAX_OPERATIONS,
-                                                metrics));
+                                                metrics,
+                                                &options));
 
     const mock_http_response responses[] = {
         {.service_name = "test-service",
@@ -325,44 +364,46 @@ static inline void test_remotely_controlled_sampler()
     mock_http_server_set_response(&server, &responses[index]);
     index++;
     TEST_ASSERT_TRUE(jaeger_remotely_controlled_sampler_update(&r));
-    TEST_ASSERT_EQUAL(jaeger_probabilistic_sampler_type, r.sampler.type);
+    TEST_ASSERT_EQUAL(jaeger_probabilistic_sampler_type, r.sampler->type);
     TEST_ASSERT_EQUAL(TEST_DEFAULT_SAMPLING_PROBABILITY,
-                      r.sampler.probabilistic_sampler.sampling_rate);
+                      r.sampler->probabilistic_sampler.sampling_rate);
 
     mock_http_server_set_response(&server, &responses[index]);
     index++;
     TEST_ASSERT_TRUE(jaeger_remotely_controlled_sampler_update(&r));
-    TEST_ASSERT_EQUAL(jaeger_rate_limiting_sampler_type, r.sampler.type);
+    TEST_ASSERT_EQUAL(jaeger_rate_limiting_sampler_type, r.sampler->type);
     TEST_ASSERT_EQUAL(TEST_DEFAULT_MAX_TRACES_PER_SECOND,
-                      r.sampler.rate_limiting_sampler.max_traces_per_second);
+                      r.sampler->rate_limiting_sampler.max_traces_per_second);
 
     mock_http_server_set_response(&server, &responses[index]);
     index++;
     TEST_ASSERT_TRUE(jaeger_remotely_controlled_sampler_update(&r));
-    TEST_ASSERT_EQUAL(jaeger_adaptive_sampler_type, r.sampler.type);
+    TEST_ASSERT_EQUAL(jaeger_adaptive_sampler_type, r.sampler->type);
     TEST_ASSERT_EQUAL(
-        1, jaeger_vector_length(&r.sampler.adaptive_sampler.op_samplers));
-    jaeger_operation_sampler* op_sampler =
-        jaeger_vector_get(&r.sampler.adaptive_sampler.op_samplers, 0);
+        1, jaeger_vector_length(&r.sampler->adaptive_sampler.op_samplers));
+    jaeger_operation_sampler* op_sampler = *(jaeger_operation_sampler**)
+        jaeger_vector_get(&r.sampler->adaptive_sampler.op_samplers, 0);
     TEST_ASSERT_NOT_NULL(op_sampler);
     TEST_ASSERT_EQUAL_STRING("test-operation", op_sampler->operation_name);
 
     mock_http_server_set_response(&server, &responses[index]);
     index++;
     TEST_ASSERT_TRUE(jaeger_remotely_controlled_sampler_update(&r));
-    TEST_ASSERT_EQUAL(jaeger_adaptive_sampler_type, r.sampler.type);
+    TEST_ASSERT_EQUAL(jaeger_adaptive_sampler_type, r.sampler->type);
     TEST_ASSERT_EQUAL(
-        1, jaeger_vector_length(&r.sampler.adaptive_sampler.op_samplers));
-    op_sampler = jaeger_vector_get(&r.sampler.adaptive_sampler.op_samplers, 0);
+        1, jaeger_vector_length(&r.sampler->adaptive_sampler.op_samplers));
+    op_sampler = *(jaeger_operation_sampler**) jaeger_vector_get(
+        &r.sampler->adaptive_sampler.op_samplers, 0);
     TEST_ASSERT_NOT_NULL(op_sampler);
     TEST_ASSERT_EQUAL_STRING("test-operation", op_sampler->operation_name);
 
     mock_http_server_destroy(&server);
     TEST_ASSERT_FALSE(jaeger_remotely_controlled_sampler_update(&r));
-    TEST_ASSERT_EQUAL(jaeger_adaptive_sampler_type, r.sampler.type);
+    TEST_ASSERT_EQUAL(jaeger_adaptive_sampler_type, r.sampler->type);
     TEST_ASSERT_EQUAL(
-        1, jaeger_vector_length(&r.sampler.adaptive_sampler.op_samplers));
-    op_sampler = jaeger_vector_get(&r.sampler.adaptive_sampler.op_samplers, 0);
+        1, jaeger_vector_length(&r.sampler->adaptive_sampler.op_samplers));
+    op_sampler = *(jaeger_operation_sampler**) jaeger_vector_get(
+        &r.sampler->adaptive_sampler.op_samplers, 0);
     TEST_ASSERT_NOT_NULL(op_sampler);
     TEST_ASSERT_EQUAL_STRING("test-operation", op_sampler->operation_name);
 
@@ -377,6 +418,173 @@ static inline void test_remotely_controlled_sampler()
     ((jaeger_destructible*) &r)->destroy((jaeger_destructible*) &r);
 }
 
+static inline void test_remotely_controlled_sampler_idle_close()
+{
+    /* Server drops every connection after responding, so each kept-alive
+     * connection is stale by the time of the next update. */
+    mock_http_server server = MOCK_HTTP_SERVER_INIT;
+    server.close_after_response = true;
+    mock_http_server_start(&server);
+    const mock_http_response response = {
+        .service_name = "test-service",
+        .json_format = "{\n"
+                       "  \"rateLimitingSampling\": {\n"
+                       "      \"maxTracesPerSecond\": %f\n"
+                       "    }\n"
+                       "}\n",
+        .arg_value = TEST_DEFAULT_MAX_TRACES_PER_SECOND};
+    mock_http_server_set_response(&server, &response);
+    char url[sizeof(URL_PREFIX) + PORT_LEN];
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(url) - 1,
+                              snprintf(url,
+                                       sizeof(url),
+                                       URL_PREFIX "%d",
+                                       ntohs(server.addr.sin_port)));
+
+    jaeger_remotely_controlled_sampler_options options =
+        JAEGERTRACINGC_REMOTELY_CONTROLLED_SAMPLER_OPTIONS_INIT;
+    options.refresh_interval = (jaeger_duration) JAEGERTRACINGC_DURATION_INIT;
+    jaeger_remotely_controlled_sampler r;
+    TEST_ASSERT_TRUE(
+        jaeger_remotely_controlled_sampler_init(&r,
+                                                "test-service",
+                                                url,
+                                                NULL,
+                                                TEST_DEFAULT_MAX_OPERATIONS,
+                                                jaeger_null_metrics(),
+                                                &options));
+
+    const int num_updates = 3;
+    for (int i = 0; i < num_updates; i++) {
+        TEST_ASSERT_TRUE(jaeger_remotely_controlled_sampler_update(&r));
+        TEST_ASSERT_EQUAL(jaeger_rate_limiting_sampler_type, r.sampler->type);
+    }
+
+    ((jaeger_destructible*) &r)->destroy((jaeger_destructible*) &r);
+    mock_http_server_destroy(&server);
+    TEST_ASSERT_EQUAL(num_updates, server.num_connections);
+}
+
+#ifdef JAEGERTRACINGC_MT
+
+static inline void test_remotely_controlled_sampler_update_thread()
+{
+    mock_http_server server = MOCK_HTTP_SERVER_INIT;
+    mock_http_server_start(&server);
+    const mock_http_response response = {
+        .service_name = "test-service",
+        .json_format = "{\n"
+                       "  \"rateLimitingSampling\": {\n"
+                       "      \"maxTracesPerSecond\": %f\n"
+                       "    }\n"
+                       "}\n",
+        .arg_value = TEST_DEFAULT_MAX_TRACES_PER_SECOND};
+    mock_http_server_set_response(&server, &response);
+    char url[sizeof(URL_PREFIX) + PORT_LEN];
+    TEST_ASSERT_LESS_OR_EQUAL(sizeof(url) - 1,
+                              snprintf(url,
+                                       sizeof(url),
+                                       URL_PREFIX "%d",
+                                       ntohs(server.addr.sin_port)));
+
+    jaeger_remotely_controlled_sampler_options options =
+        JAEGERTRACINGC_REMOTELY_CONTROLLED_SAMPLER_OPTIONS_INIT;
+    options.refresh_interval.value.tv_sec = 0;
+    options.refresh_interval.value.tv_nsec =
+        0.01 * JAEGERTRACINGC_NANOSECONDS_PER_SECOND;
+    jaeger_remotely_controlled_sampler r;
+    TEST_ASSERT_TRUE(
+        jaeger_remotely_controlled_sampler_init(&r,
+                                                "test-service",
+                                                url,
+                                                NULL,
+                                                TEST_DEFAULT_MAX_OPERATIONS,
+                                                jaeger_null_metrics(),
+                                                &options));
+
+    /* Wait for the update thread to switch to rate limiting. */
+    const jaeger_trace_id trace_id = {.high = 0, .low = 0};
+    jaeger_vector tags;
+    jaeger_vector_init(&tags, sizeof(jaeger_tag));
+    bool updated = false;
+    for (int i = 0; i < 500 && !updated; i++) {
+        ((jaeger_sampler*) &r)
+            ->is_sampled(
+                (jaeger_sampler*) &r, &trace_id, "test-operation", &tags);
+        const jaeger_tag* tag = jaeger_vector_get(&tags, 0);
+        TEST_ASSERT_NOT_NULL(tag);
+        updated =
+            (strcmp(tag->v_str, JAEGERTRACINGC_SAMPLER_TYPE_RATE_LIMITING) ==
+             0);
+        JAEGERTRACINGC_VECTOR_FOR_EACH(&tags, jaeger_tag_destroy, jaeger_tag);
+        jaeger_vector_clear(&tags);
+        const struct timespec sleep_duration = {
+            .tv_sec = 0,
+            .tv_nsec = 0.01 * JAEGERTRACINGC_NANOSECONDS_PER_SECOND};
+        nanosleep(&sleep_duration, NULL);
+    }
+    TEST_ASSERT_TRUE(updated);
+
+    jaeger_vector_destroy(&tags);
+    ((jaeger_destructible*) &r)->destroy((jaeger_destructible*) &r);
+    mock_http_server_destroy(&server);
+}
+
+static inline void test_remotely_controlled_sampler_hung_server()
+{
+    /* Accepts connections in its backlog, but never responds. */
+    const int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, server_fd);
+    struct sockaddr_in addr = {.sin_family = AF_INET,
+                               .sin_port = 0,
+                               .sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)}};
+    TEST_ASSERT_EQUAL(
+        0, bind(server_fd, (struct sockaddr*) &addr, sizeof(addr)));
+    TEST_ASSERT_EQUAL(0, listen(server_fd, 1));
+    socklen_t addr_len = sizeof(addr);
+    TEST_ASSERT_EQUAL(
+        0, getsockname(server_fd, (struct sockaddr*) &addr, &addr_len));
+    char url[sizeof(URL_PREFIX) + PORT_LEN];
+    TEST_ASSERT_LESS_OR_EQUAL(
+        sizeof(url) - 1,
+        snprintf(url, sizeof(url), URL_PREFIX "%d", ntohs(addr.sin_port)));
+
+    jaeger_remotely_controlled_sampler_options options =
+        JAEGERTRACINGC_REMOTELY_CONTROLLED_SAMPLER_OPTIONS_INIT;
+    options.request_timeout.value.tv_sec = 60;
+    jaeger_remotely_controlled_sampler r;
+    TEST_ASSERT_TRUE(
+        jaeger_remotely_controlled_sampler_init(&r,
+                                                "test-service",
+                                                url,
+                                                NULL,
+                                                TEST_DEFAULT_MAX_OPERATIONS,
+                                                jaeger_null_metrics(),
+                                                &options));
+
+    /* Let the update thread send its request. */
+    const struct timespec sleep_duration = {
+        .tv_sec = 0, .tv_nsec = 0.1 * JAEGERTRACINGC_NANOSECONDS_PER_SECOND};
+    nanosleep(&sleep_duration, NULL);
+
+    /* Sampling does not wait for the request and neither does destroy. */
+    const jaeger_trace_id trace_id = {.high = 0, .low = 0};
+    ((jaeger_sampler*) &r)
+        ->is_sampled((jaeger_sampler*) &r, &trace_id, "test-operation", NULL);
+    jaeger_duration start;
+    jaeger_duration_now(&start);
+    ((jaeger_destructible*) &r)->destroy((jaeger_destructible*) &r);
+    jaeger_duration end;
+    jaeger_duration_now(&end);
+    opentracing_time_value elapsed;
+    jaeger_time_subtract(end.value, start.value, &elapsed);
+    TEST_ASSERT_EQUAL(0, elapsed.tv_sec);
+
+    close(server_fd);
+}
+
+#endif /* JAEGERTRACINGC_MT */
+
 static inline void test_sampler_choice()
 {
     jaeger_sampler_choice choice;
@@ -406,5 +614,10 @@ void test_sampler()
     RUN_TEST(test_guaranteed_throughput_probabilistic_sampler);
     RUN_TEST(test_adaptive_sampler);
     RUN_TEST(test_remotely_controlled_sampler);
+    RUN_TEST(test_remotely_controlled_sampler_idle_close);
+#ifdef JAEGERTRACINGC_MT
+    RUN_TEST(test_remotely_controlled_sampler_update_thread);
+    RUN_TEST(test_remotely_controlled_sampler_hung_server);
+#endif /* JAEGERTRACINGC_MT */
     RUN_TEST(test_sampler_choice);
 }
@@ -16,13 +16,77 @@
 
 #include "jaegertracingc/span.h"
 
+static jaeger_shared_baggage* shared_baggage_new()
+{
+    jaeger_shared_baggage* baggage = jaeger_malloc(sizeof(*baggage));
+    if (baggage == NULL) {
+        jaeger_log_error("Cannot allocate baggage");
+        return NULL;
+    }
+    baggage->items = (jaeger_hashtable) JAEGERTRACINGC_HASHTABLE_INIT;
+    baggage->ref_count = 1;
+#ifndef JAEGERTRACINGC_HAVE_ATOMICS
+    baggage->mutex = (jaeger_mutex) JAEGERTRACINGC_MUTEX_INIT;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+    return baggage;
+}
+
+static inline void shared_baggage_ref(jaeger_shared_baggage* baggage)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    __atomic_fetch_add(&baggage->ref_count, 1, __ATOMIC_RELAXED);
+#else
+    jaeger_mutex_lock(&baggage->mutex);
+    baggage->ref_count++;
+    jaeger_mutex_unlock(&baggage->mutex);
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+/* Whether the caller holds the only reference. References are only added by
+ * holders, so the result cannot become stale while the caller holds one. */
+static inline bool shared_baggage_is_unique(jaeger_shared_baggage* baggage)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    return __atomic_load_n(&baggage->ref_count, __ATOMIC_ACQUIRE) == 1;
+#else
+    jaeger_mutex_lock(&baggage->mutex);
+    const int ref_count = baggage->ref_count;
+    jaeger_mutex_unlock(&baggage->mutex);
+    return ref_count == 1;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+static void shared_baggage_release(jaeger_shared_baggage* baggage)
+{
+    if (baggage == NULL) {
+        return;
+    }
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    const int ref_count =
+        __atomic_sub_fetch(&baggage->ref_count, 1, __ATOMIC_ACQ_REL);
+#else
+    jaeger_mutex_lock(&baggage->mutex);
+    const int ref_count = --baggage->ref_count;
+    jaeger_mutex_unlock(&baggage->mutex);
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+    if (ref_count > 0) {
+        return;
+    }
+    jaeger_hashtable_destroy(&baggage->items);
+#ifndef JAEGERTRACINGC_HAVE_ATOMICS
+    jaeger_mutex_destroy(&baggage->mutex);
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+    jaeger_free(baggage);
+}
+
 void jaeger_span_context_destroy(jaeger_destructible* d)
 {
     if (d == NULL) {
         return;
     }
     jaeger_span_context* ctx = (jaeger_span_context*) d;
-    jaeger_hashtable_destroy(&ctx->baggage);
+    shared_baggage_release(ctx->baggage);
+    ctx->baggage = NULL;
     if (ctx->debug_id != NULL) {
         jaeger_free(ctx->debug_id);
         ctx->debug_id = NULL;
@@ -38,8 +102,9 @@ void jaeger_span_context_foreach_baggage_item(
     jaeger_span_context* ctx = (jaeger_span_context*) span_context;
     jaeger_mutex_lock(&ctx->mutex);
 
-    jaeger_hashtable* baggage = &((jaeger_span_context*) span_context)->baggage;
-    for (size_t i = 0, len = 1u << baggage->order; i < len; i++) {
+    const jaeger_hashtable* baggage = jaeger_span_context_baggage(ctx);
+    for (size_t i = 0, len = jaeger_hashtable_bucket_count(baggage); i < len;
+         i++) {
         for (const jaeger_list_node* node = baggage->buckets[i].head;
              node != NULL;
              node = node->next) {
@@ -56,8 +121,21 @@ void jaeger_span_context_foreach_baggage_item(
 bool jaeger_span_context_init(jaeger_span_context* ctx)
 {
     assert(ctx != NULL);
+    /* Baggage buckets are only allocated once an item is added. */
     *ctx = (jaeger_span_context) JAEGERTRACINGC_SPAN_CONTEXT_INIT;
-    return jaeger_hashtable_init(&ctx->baggage);
+    return true;
+}
+
+/* Copies the identity and baggage of src into a context no other thread can
+ * see yet. Caller must hold the mutex of src. */
+static void
+span_context_copy_no_locking(jaeger_span_context* restrict dst,
+                             const jaeger_span_context* restrict src)
+{
+    jaeger_span_context_share_baggage(dst, src);
+    dst->trace_id = src->trace_id;
+    dst->span_id = src->span_id;
+    dst->flags = src->flags;
 }
 
 bool jaeger_span_context_copy(jaeger_span_context* restrict dst,
@@ -66,21 +144,64 @@ bool jaeger_span_context_copy(jaeger_span_context* restrict dst,
     assert(dst != NULL);
     assert(src != NULL);
     *dst = (jaeger_span_context) JAEGERTRACINGC_SPAN_CONTEXT_INIT;
-    jaeger_lock((jaeger_mutex*) &src->mutex, &dst->mutex);
-    if (!jaeger_hashtable_copy(&dst->baggage, &src->baggage)) {
-        jaeger_mutex_unlock((jaeger_mutex*) &src->mutex);
-        jaeger_mutex_unlock(&dst->mutex);
-        jaeger_span_context_destroy((jaeger_destructible*) dst);
-        return false;
-    }
-    dst->trace_id = src->trace_id;
-    dst->span_id = src->span_id;
-    dst->flags = src->flags;
+    jaeger_mutex_lock((jaeger_mutex*) &src->mutex);
+    span_context_copy_no_locking(dst, src);
     jaeger_mutex_unlock((jaeger_mutex*) &src->mutex);
-    jaeger_mutex_unlock(&dst->mutex);
     return true;
 }
 
+const jaeger_hashtable*
+jaeger_span_context_baggage(const jaeger_span_context* ctx)
+{
+    static const jaeger_hashtable empty = JAEGERTRACINGC_HASHTABLE_INIT;
+    assert(ctx != NULL);
+    return ctx->baggage != NULL ? &ctx->baggage->items : &empty;
+}
+
+jaeger_hashtable* jaeger_span_context_mutable_baggage(jaeger_span_context* ctx)
+{
+    assert(ctx != NULL);
+    if (ctx->baggage != NULL && shared_baggage_is_unique(ctx->baggage)) {
+        return &ctx->baggage->items;
+    }
+    jaeger_shared_baggage* baggage = shared_baggage_new();
+    if (baggage == NULL) {
+        return NULL;
+    }
+    if (ctx->baggage != NULL) {
+        if (!jaeger_hashtable_copy(&baggage->items, &ctx->baggage->items)) {
+            shared_baggage_release(baggage);
+            return NULL;
+        }
+        shared_baggage_release(ctx->baggage);
+    }
+    ctx->baggage = baggage;
+    return &baggage->items;
+}
+
+bool jaeger_span_context_set_baggage_item(jaeger_span_context* ctx,
+                                          const char* key,
+                                          const char* value)
+{
+    jaeger_hashtable* baggage = jaeger_span_context_mutable_baggage(ctx);
+    return baggage != NULL && jaeger_hashtable_put(baggage, key, value);
+}
+
+void jaeger_span_context_share_baggage(jaeger_span_context* restrict dst,
+                                       const jaeger_span_context* restrict src)
+{
+    assert(dst != NULL);
+    assert(src != NULL);
+    if (dst->baggage == src->baggage) {
+        return;
+    }
+    if (src->baggage != NULL) {
+        shared_baggage_ref(src->baggage);
+    }
+    shared_baggage_release(dst->baggage);
+    dst->baggage = src->baggage;
+}
+
 bool jaeger_span_context_is_valid(const jaeger_span_context* ctx)
 {
     assert(ctx != NULL);
@@ -170,16 +291,50 @@ bool jaeger_span_ref_to_protobuf(Jaeger__Model__SpanRef* restrict dst,
         return false;
     }
 
-    jaeger_mutex_lock((jaeger_mutex*) &src->context.mutex);
+    /* References are only reachable through their span, which is finished
+     * when it is converted, so their IDs cannot change. */
     jaeger_trace_id_to_protobuf(&dst->trace_id, &src->context.trace_id);
     memcpy(
         dst->span_id.data, &src->context.span_id, sizeof(src->context.span_id));
     dst->span_id.len = sizeof(src->context.span_id);
-    jaeger_mutex_unlock((jaeger_mutex*) &src->context.mutex);
-    dst->ref_type = (Jaeger__Model__SpanRefType) src->type;
+    /* Opentracing reference types start at one, protobuf enum at zero. */
+    dst->ref_type = (src->type == opentracing_span_reference_follows_from)
+                        ? JAEGER__MODEL__SPAN_REF_TYPE__FOLLOWS_FROM
+                        : JAEGER__MODEL__SPAN_REF_TYPE__CHILD_OF;
     return true;
 }
 
+/* Destroys operation name, tags, logs and references. Tags and log fields
+ * may have been allocated from the span's arena or, like copies of spans and
+ * tags added by the sampler, by the installed allocator. Freeing through the
+ * arena handles both. */
+static void span_destroy_members(jaeger_span* span)
+{
+    jaeger_allocator* alloc = (jaeger_allocator*) &span->arena;
+    if (span->operation_name != NULL &&
+        span->interned_operation_name == NULL) {
+        alloc->free(alloc, span->operation_name);
+    }
+    span->operation_name = NULL;
+    span->interned_operation_name = NULL;
+    const int num_borrow_flags = jaeger_vector_length(&span->tag_borrow_flags);
+    for (int i = 0, len = jaeger_vector_length(&span->tags); i < len; i++) {
+        const int borrow_flags =
+            (i < num_borrow_flags)
+                ? *(uint8_t*) jaeger_vector_offset(&span->tag_borrow_flags, i)
+                : jaeger_tag_borrow_none;
+        jaeger_tag_destroy_borrowed_with_allocator(
+            jaeger_vector_offset(&span->tags, i), borrow_flags, alloc);
+    }
+    jaeger_vector_clear(&span->tag_borrow_flags);
+    for (int i = 0, len = jaeger_vector_length(&span->logs); i < len; i++) {
+        jaeger_log_record_destroy_with_allocator(
+            jaeger_vector_offset(&span->logs, i), alloc);
+    }
+    JAEGERTRACINGC_VECTOR_FOR_EACH(
+        &span->refs, jaeger_span_ref_destroy, jaeger_span_ref);
+}
+
 void jaeger_span_destroy(jaeger_destructible* d)
 {
     if (d == NULL) {
@@ -190,34 +345,48 @@ void jaeger_span_destroy(jaeger_destructible* d)
     if (span->tracer != NULL) {
         span->tracer = NULL;
     }
-    if (span->operation_name != NULL) {
-        jaeger_free(span->operation_name);
-        span->operation_name = NULL;
-    }
-    JAEGERTRACINGC_VECTOR_FOR_EACH(&span->tags, jaeger_tag_destroy, jaeger_tag);
-    JAEGERTRACINGC_VECTOR_FOR_EACH(
-        &span->logs, jaeger_log_record_destroy, jaeger_log_record);
-    JAEGERTRACINGC_VECTOR_FOR_EACH(
-        &span->refs, jaeger_span_ref_destroy, jaeger_span_ref);
+    span_destroy_members(span);
     jaeger_span_context_destroy((jaeger_destructible*) &span->context);
     jaeger_vector_destroy(&span->tags);
+    jaeger_vector_destroy(&span->tag_borrow_flags);
     jaeger_vector_destroy(&span->logs);
     jaeger_vector_destroy(&span->refs);
-    jaeger_mutex_destroy(&span->mutex);
+    jaeger_arena_destroy(&span->arena);
 }
 
 bool jaeger_span_init_vectors(jaeger_span* span)
 {
-    if (!jaeger_vector_init(&span->tags, sizeof(jaeger_tag))) {
-        return false;
-    }
-    if (!jaeger_vector_init(&span->logs, sizeof(jaeger_log_record))) {
-        return false;
+    jaeger_vector_init_inline(&span->tags,
+                              sizeof(jaeger_tag),
+                              span->tags_storage,
+                              JAEGERTRACINGC_SPAN_INLINE_TAGS);
+    jaeger_vector_init_inline(&span->logs,
+                              sizeof(jaeger_log_record),
+                              span->logs_storage,
+                              JAEGERTRACINGC_SPAN_INLINE_LOGS);
+    jaeger_vector_init_inline(&span->refs,
+                              sizeof(jaeger_span_ref),
+                              span->refs_storage,
+                              JAEGERTRACINGC_SPAN_INLINE_REFS);
+    return true;
+}
+
+/* Locks the span unless it is single-owner, in which case it only checks that
+ * the caller is the thread that started it. */
+static inline void span_lock(const jaeger_span* span)
+{
+    if (span->single_owner) {
+        assert(jaeger_thread_equal(span->owner, jaeger_thread_self()));
+        return;
     }
-    if (!jaeger_vector_init(&span->refs, sizeof(jaeger_span_ref))) {
-        return false;
+    jaeger_mutex_lock((jaeger_mutex*) &span->context.mutex);
+}
+
+static inline void span_unlock(const jaeger_span* span)
+{
+    if (!span->single_owner) {
+        jaeger_mutex_unlock((jaeger_mutex*) &span->context.mutex);
     }
-    return true;
 }
 
 bool jaeger_span_is_sampled_no_locking(const jaeger_span* span)
@@ -235,7 +404,8 @@ void jaeger_span_log_no_locking(jaeger_span* span,
         return;
     }
     *log_record_copy = (jaeger_log_record) JAEGERTRACINGC_LOG_RECORD_INIT;
-    if (!jaeger_log_record_from_opentracing(log_record_copy, log_record)) {
+    if (!jaeger_log_record_from_opentracing_with_allocator(
+            log_record_copy, log_record, (jaeger_allocator*) &span->arena)) {
         goto cleanup;
     }
     return;
@@ -255,7 +425,11 @@ void jaeger_span_finish_with_options(
         jaeger_span_finish_with_options(s, &default_finish_options);
         return;
     }
-    jaeger_mutex_lock(&span->mutex);
+    span_lock(span);
+    if (span->finished) {
+        span_unlock(span);
+        return;
+    }
     if (jaeger_span_is_sampled_no_locking(span)) {
         jaeger_duration finish_time = options->finish_time;
         if (finish_time.value.tv_sec == 0 && finish_time.value.tv_nsec == 0) {
@@ -272,7 +446,10 @@ void jaeger_span_finish_with_options(
             jaeger_span_log_no_locking(span, &options->log_records[i]);
         }
     }
-    jaeger_mutex_unlock(&span->mutex);
+    /* Unlocking publishes the final state to the reporter, which reads the
+     * span without locking from here on. */
+    span->finished = true;
+    span_unlock(span);
 
     /* Call jaeger_tracer_report_span even for non-sampled traces, in case
      * we need to return the span to a pool.
@@ -288,12 +465,16 @@ void jaeger_span_finish(opentracing_span* span)
 bool jaeger_span_is_sampled(const jaeger_span* span)
 {
     assert(span != NULL);
-    jaeger_lock((jaeger_mutex*) &span->mutex,
-                (jaeger_mutex*) &span->context.mutex);
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    const uint8_t flags =
+        __atomic_load_n(&span->context.flags, __ATOMIC_RELAXED);
+    return (flags & ((uint8_t) jaeger_sampling_flag_sampled)) != 0;
+#else
+    span_lock(span);
     const bool result = jaeger_span_is_sampled_no_locking(span);
-    jaeger_mutex_unlock((jaeger_mutex*) &span->mutex);
-    jaeger_mutex_unlock((jaeger_mutex*) &span->context.mutex);
+    span_unlock(span);
     return result;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
 }
 
 void jaeger_span_set_operation_name(opentracing_span* s,
@@ -302,24 +483,36 @@ void jaeger_span_set_operation_name(opentracing_span* s,
     assert(s != NULL);
     assert(operation_name != NULL);
     jaeger_span* span = (jaeger_span*) s;
-    jaeger_mutex_lock(&span->mutex);
-    if (!jaeger_span_is_sampled_no_locking(span)) {
-        goto cleanup;
+    span_lock(span);
+    if (!span->finished && jaeger_span_is_sampled_no_locking(span)) {
+        jaeger_span_set_operation_name_no_locking(span, operation_name);
     }
+    span_unlock(span);
+}
 
-    char* operation_name_copy = jaeger_strdup(operation_name);
+bool jaeger_span_set_operation_name_no_locking(jaeger_span* span,
+                                               const char* operation_name)
+{
+    assert(span != NULL);
+    assert(operation_name != NULL);
+    jaeger_allocator* alloc = (jaeger_allocator*) &span->arena;
+    const jaeger_interned_string* interned_operation_name =
+        jaeger_intern_operation_name(operation_name);
+    char* operation_name_copy =
+        (interned_operation_name != NULL)
+            ? (char*) interned_operation_name->str
+            : jaeger_allocator_strdup(alloc, operation_name);
     if (operation_name_copy == NULL) {
-        goto cleanup;
+        return false;
     }
 
-    if (span->operation_name != NULL) {
-        jaeger_free(span->operation_name);
+    if (span->operation_name != NULL &&
+        span->interned_operation_name == NULL) {
+        alloc->free(alloc, span->operation_name);
     }
     span->operation_name = operation_name_copy;
-    goto cleanup;
-
-cleanup:
-    jaeger_mutex_unlock(&span->mutex);
+    span->interned_operation_name = interned_operation_name;
+    return true;
 }
 
 void jaeger_span_set_baggage_item(opentracing_span* span,
@@ -327,22 +520,23 @@ void jaeger_span_set_baggage_item(opentracing_span* span,
                                   const char* value)
 {
     jaeger_span* s = (jaeger_span*) span;
-    jaeger_lock(&s->mutex, &s->context.mutex);
+    span_lock(s);
     /* TODO: Use baggage setter for validation once implemented. */
-    jaeger_hashtable_put(&s->context.baggage, key, value);
-    jaeger_mutex_unlock(&s->mutex);
-    jaeger_mutex_unlock(&s->context.mutex);
+    if (!s->finished) {
+        jaeger_span_context_set_baggage_item(&s->context, key, value);
+    }
+    span_unlock(s);
 }
 
 const char* jaeger_span_baggage_item(const opentracing_span* span,
                                      const char* key)
 {
     const jaeger_span* s = (const jaeger_span*) span;
-    jaeger_lock((jaeger_mutex*) &s->mutex, (jaeger_mutex*) &s->context.mutex);
+    span_lock(s);
     const jaeger_key_value* kv =
-        jaeger_hashtable_find((jaeger_hashtable*) &s->context.baggage, key);
-    jaeger_mutex_unlock((jaeger_mutex*) &s->mutex);
-    jaeger_mutex_unlock((jaeger_mutex*) &s->context.mutex);
+        jaeger_hashtable_find(
+            (jaeger_hashtable*) jaeger_span_context_baggage(&s->context), key);
+    span_unlock(s);
     if (kv == NULL) {
         return NULL;
     }
@@ -353,13 +547,88 @@ void jaeger_span_set_tag_no_locking(jaeger_span* span,
                                     const char* key,
                                     const opentracing_value* value)
 {
+    jaeger_span_set_borrowed_tag_no_locking(
+        span, key, value, jaeger_tag_borrow_none);
+}
+
+/* Records the borrow flags of the tag at index, which must be the last tag
+ * or the one about to be appended. */
+static bool
+span_set_tag_borrow_flags(jaeger_span* span, int index, int borrow_flags)
+{
+    jaeger_vector* flags = &span->tag_borrow_flags;
+    if (flags->data == NULL &&
+        !jaeger_vector_init(flags, sizeof(uint8_t))) {
+        return false;
+    }
+    const int len = jaeger_vector_length(flags);
+    assert(index >= len);
+    uint8_t* new_flags = jaeger_vector_extend(flags, len, index + 1 - len);
+    if (new_flags == NULL) {
+        return false;
+    }
+    memset(new_flags, jaeger_tag_borrow_none, index - len);
+    new_flags[index - len] = (uint8_t) borrow_flags;
+    return true;
+}
+
+void jaeger_span_set_borrowed_tag_no_locking(jaeger_span* span,
+                                             const char* key,
+                                             const opentracing_value* value,
+                                             int borrow_flags)
+{
+    const int index = jaeger_vector_length(&span->tags);
+    if (borrow_flags != jaeger_tag_borrow_none &&
+        !span_set_tag_borrow_flags(span, index, borrow_flags)) {
+        /* Copy the tag rather than lose track of what it borrows. */
+        borrow_flags = jaeger_tag_borrow_none;
+    }
     jaeger_tag* tag_copy = (jaeger_tag*) jaeger_vector_append(&span->tags);
-    if (tag_copy == NULL) {
-        return;
+    if (tag_copy == NULL ||
+        !jaeger_tag_from_key_value_borrowed_with_allocator(
+            tag_copy,
+            key,
+            value,
+            borrow_flags,
+            (jaeger_allocator*) &span->arena)) {
+        span->tags.len = index;
+        if (jaeger_vector_length(&span->tag_borrow_flags) > index) {
+            span->tag_borrow_flags.len = index;
+        }
     }
-    if (!jaeger_tag_from_key_value(tag_copy, key, value)) {
-        span->tags.len--;
+}
+
+/* Stores flags that jaeger_span_is_sampled may read without locking. Caller
+ * must hold the span context mutex. */
+static inline void span_context_store_flags(jaeger_span_context* ctx,
+                                            uint8_t flags)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    __atomic_store_n(&ctx->flags, flags, __ATOMIC_RELAXED);
+#else
+    ctx->flags = flags;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+/* Applies an integer sampling.priority value to the flags of a span context.
+ * Caller must hold the span context mutex. */
+static bool span_context_set_sampling_priority(jaeger_span_context* ctx,
+                                               const opentracing_value* value)
+{
+    if ((value->type == opentracing_value_int64 && value->value.int64_value) ||
+        (value->type == opentracing_value_uint64 &&
+         value->value.uint64_value)) {
+        span_context_store_flags(
+            ctx,
+            (uint8_t)(ctx->flags | ((uint8_t) jaeger_sampling_flag_debug)) |
+                ((uint8_t) jaeger_sampling_flag_sampled));
+        return true;
     }
+    span_context_store_flags(
+        ctx,
+        (uint8_t)(ctx->flags &
+                  ((uint8_t) ~(uint8_t) jaeger_sampling_flag_sampled)));
+    return false;
 }
 
 bool jaeger_span_set_sampling_priority(jaeger_span* span,
@@ -376,44 +645,43 @@ bool jaeger_span_set_sampling_priority(jaeger_span* span,
         return false;
     }
 
-    bool success = false;
-    jaeger_lock(&span->mutex, &span->context.mutex);
-    if ((value->type == opentracing_value_int64 && value->value.int64_value) ||
-        (value->type == opentracing_value_uint64 &&
-         value->value.uint64_value)) {
-        span->context.flags =
-            (uint8_t)(span->context.flags |
-                      ((uint8_t) jaeger_sampling_flag_debug)) |
-            ((uint8_t) jaeger_sampling_flag_sampled);
-        success = true;
-    }
-    else {
-        span->context.flags =
-            (uint8_t)(span->context.flags &
-                      ((uint8_t) ~(uint8_t) jaeger_sampling_flag_sampled));
-    }
-    jaeger_mutex_unlock(&span->mutex);
-    jaeger_mutex_unlock(&span->context.mutex);
+    span_lock(span);
+    const bool success =
+        !span->finished &&
+        span_context_set_sampling_priority(&span->context, value);
+    span_unlock(span);
     return success;
 }
 
 void jaeger_span_set_tag(opentracing_span* span,
                          const char* key,
                          const opentracing_value* value)
+{
+    jaeger_span_set_borrowed_tag(span, key, value, jaeger_tag_borrow_none);
+}
+
+void jaeger_span_set_borrowed_tag(opentracing_span* span,
+                                  const char* key,
+                                  const opentracing_value* value,
+                                  int borrow_flags)
 {
     assert(span != NULL);
     assert(key != NULL);
     assert(value != NULL);
+    if (span->set_tag != &jaeger_span_set_tag) {
+        span->set_tag(span, key, value);
+        return;
+    }
     jaeger_span* s = (jaeger_span*) span;
     if (strcmp(key, JAEGERTRACINGC_SAMPLING_PRIORITY) == 0 &&
         !jaeger_span_set_sampling_priority(s, value)) {
         return;
     }
-    jaeger_mutex_lock(&s->mutex);
-    if (jaeger_span_is_sampled_no_locking(s)) {
-        jaeger_span_set_tag_no_locking(s, key, value);
+    span_lock(s);
+    if (!s->finished && jaeger_span_is_sampled_no_locking(s)) {
+        jaeger_span_set_borrowed_tag_no_locking(s, key, value, borrow_flags);
     }
-    jaeger_mutex_unlock(&s->mutex);
+    span_unlock(s);
 }
 
 void jaeger_span_log(opentracing_span* span,
@@ -429,11 +697,11 @@ void jaeger_span_log(opentracing_span* span,
         .num_fields = num_fields,
         .timestamp = timestamp};
     jaeger_span* s = (jaeger_span*) span;
-    jaeger_mutex_lock(&s->mutex);
-    if (jaeger_span_is_sampled_no_locking(s)) {
+    span_lock(s);
+    if (!s->finished && jaeger_span_is_sampled_no_locking(s)) {
         jaeger_span_log_no_locking(s, &log_record);
     }
-    jaeger_mutex_unlock(&s->mutex);
+    span_unlock(s);
 }
 
 bool jaeger_span_init(jaeger_span* span)
@@ -453,6 +721,147 @@ cleanup:
     return false;
 }
 
+/* Clears a span context for reuse, keeping the storage of its baggage unless
+ * it is shared with another context. */
+static void span_context_reset(jaeger_span_context* ctx)
+{
+    ctx->trace_id = (jaeger_trace_id) JAEGERTRACINGC_TRACE_ID_INIT;
+    ctx->span_id = 0;
+    ctx->flags = 0;
+    if (ctx->baggage != NULL && shared_baggage_is_unique(ctx->baggage)) {
+        jaeger_hashtable_clear(&ctx->baggage->items);
+    }
+    else {
+        shared_baggage_release(ctx->baggage);
+        ctx->baggage = NULL;
+    }
+    if (ctx->debug_id != NULL) {
+        jaeger_free(ctx->debug_id);
+        ctx->debug_id = NULL;
+    }
+}
+
+void jaeger_span_reset(jaeger_span* span)
+{
+    assert(span != NULL);
+    span->tracer = NULL;
+    span->start_time_system = (jaeger_timestamp) JAEGERTRACINGC_TIMESTAMP_INIT;
+    span->start_time_steady = (jaeger_duration) JAEGERTRACINGC_DURATION_INIT;
+    span->duration = (jaeger_duration) JAEGERTRACINGC_DURATION_INIT;
+    span->finished = false;
+    span->single_owner = false;
+    span_destroy_members(span);
+    jaeger_vector_clear(&span->tags);
+    jaeger_vector_clear(&span->logs);
+    jaeger_vector_clear(&span->refs);
+    jaeger_arena_reset(&span->arena);
+    span_context_reset(&span->context);
+}
+
+void jaeger_noop_span_destroy(jaeger_destructible* d)
+{
+    if (d == NULL) {
+        return;
+    }
+
+    jaeger_noop_span* span = (jaeger_noop_span*) d;
+    span->tracer = NULL;
+    jaeger_span_context_destroy((jaeger_destructible*) &span->context);
+}
+
+void jaeger_noop_span_finish_with_options(
+    opentracing_span* span, const opentracing_finish_span_options* options)
+{
+    assert(span != NULL);
+    (void) options;
+    jaeger_noop_span* s = (jaeger_noop_span*) span;
+    jaeger_tracer_report_noop_span(s->tracer, s);
+}
+
+void jaeger_noop_span_finish(opentracing_span* span)
+{
+    jaeger_noop_span_finish_with_options(span, NULL);
+}
+
+void jaeger_noop_span_set_operation_name(opentracing_span* span,
+                                         const char* operation_name)
+{
+    (void) span;
+    (void) operation_name;
+}
+
+void jaeger_noop_span_set_tag(opentracing_span* span,
+                              const char* key,
+                              const opentracing_value* value)
+{
+    assert(span != NULL);
+    assert(key != NULL);
+    assert(value != NULL);
+    if (strcmp(key, JAEGERTRACINGC_SAMPLING_PRIORITY) != 0) {
+        return;
+    }
+    switch (value->type) {
+    case opentracing_value_int64:
+        break;
+    case opentracing_value_uint64:
+        break;
+    default:
+        return;
+    }
+
+    jaeger_noop_span* s = (jaeger_noop_span*) span;
+    jaeger_mutex_lock(&s->context.mutex);
+    span_context_set_sampling_priority(&s->context, value);
+    jaeger_mutex_unlock(&s->context.mutex);
+}
+
+void jaeger_noop_span_log(opentracing_span* span,
+                          const opentracing_log_field* fields,
+                          int num_fields)
+{
+    (void) span;
+    (void) fields;
+    (void) num_fields;
+}
+
+void jaeger_noop_span_set_baggage_item(opentracing_span* span,
+                                       const char* key,
+                                       const char* value)
+{
+    jaeger_noop_span* s = (jaeger_noop_span*) span;
+    jaeger_mutex_lock(&s->context.mutex);
+    jaeger_span_context_set_baggage_item(&s->context, key, value);
+    jaeger_mutex_unlock(&s->context.mutex);
+}
+
+const char* jaeger_noop_span_baggage_item(const opentracing_span* span,
+                                          const char* key)
+{
+    const jaeger_noop_span* s = (const jaeger_noop_span*) span;
+    jaeger_mutex_lock((jaeger_mutex*) &s->context.mutex);
+    const jaeger_key_value* kv =
+        jaeger_hashtable_find(
+            (jaeger_hashtable*) jaeger_span_context_baggage(&s->context), key);
+    jaeger_mutex_unlock((jaeger_mutex*) &s->context.mutex);
+    if (kv == NULL) {
+        return NULL;
+    }
+    return kv->value;
+}
+
+void jaeger_noop_span_init(jaeger_noop_span* span)
+{
+    assert(span != NULL);
+    *span = (jaeger_noop_span) JAEGERTRACINGC_NOOP_SPAN_INIT;
+}
+
+void jaeger_noop_span_reset(jaeger_noop_span* span)
+{
+    assert(span != NULL);
+    span->tracer = NULL;
+    span_context_reset(&span->context);
+}
+
 bool jaeger_span_copy(jaeger_span* restrict dst,
                       const jaeger_span* restrict src)
 {
@@ -462,14 +871,16 @@ bool jaeger_span_copy(jaeger_span* restrict dst,
     if (!jaeger_span_init_vectors(dst)) {
         return false;
     }
-    jaeger_lock(&dst->mutex, (jaeger_mutex*) &src->mutex);
+    jaeger_mutex_lock((jaeger_mutex*) &src->context.mutex);
     dst->start_time_system = src->start_time_system;
     dst->start_time_steady = src->start_time_steady;
     dst->duration = src->duration;
-    dst->operation_name = jaeger_strdup(src->operation_name);
-    if (!jaeger_span_context_copy(&dst->context, &src->context)) {
-        goto cleanup;
-    }
+    dst->interned_operation_name = src->interned_operation_name;
+    dst->operation_name = (src->interned_operation_name != NULL)
+                              ? src->operation_name
+                              : jaeger_strdup(src->operation_name);
+    dst->finished = src->finished;
+    span_context_copy_no_locking(&dst->context, &src->context);
     if (dst->operation_name == NULL) {
         goto cleanup;
     }
@@ -490,13 +901,11 @@ bool jaeger_span_copy(jaeger_span* restrict dst,
         goto cleanup;
     }
 
-    jaeger_mutex_unlock(&dst->mutex);
-    jaeger_mutex_unlock((jaeger_mutex*) &src->mutex);
+    jaeger_mutex_unlock((jaeger_mutex*) &src->context.mutex);
     return true;
 
 cleanup:
-    jaeger_mutex_unlock((jaeger_mutex*) &src->mutex);
-    jaeger_mutex_unlock(&dst->mutex);
+    jaeger_mutex_unlock((jaeger_mutex*) &src->context.mutex);
     jaeger_span_destroy((jaeger_destructible*) dst);
     return false;
 }
@@ -561,8 +970,6 @@ bool jaeger_span_to_protobuf(Jaeger__Model__Span* restrict dst,
     if (dst->span_id.data == NULL) {
         goto cleanup;
     }
-    jaeger_lock((jaeger_mutex*) &src->mutex,
-                (jaeger_mutex*) &src->context.mutex);
     jaeger_trace_id_to_protobuf(&dst->trace_id, &src->context.trace_id);
     memcpy(
         dst->span_id.data, &src->context.span_id, sizeof(src->context.span_id));
@@ -602,13 +1009,9 @@ bool jaeger_span_to_protobuf(Jaeger__Model__Span* restrict dst,
                                      NULL)) {
         goto cleanup;
     }
-    jaeger_mutex_unlock((jaeger_mutex*) &src->mutex);
-    jaeger_mutex_unlock((jaeger_mutex*) &src->context.mutex);
     return true;
 
 cleanup:
-    jaeger_mutex_unlock((jaeger_mutex*) &src->mutex);
-    jaeger_mutex_unlock((jaeger_mutex*) &src->context.mutex);
     jaeger_span_protobuf_destroy(dst);
     *dst = (Jaeger__Model__Span) JAEGER__MODEL__SPAN__INIT;
     return false;
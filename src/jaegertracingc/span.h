@@ -22,9 +22,11 @@
 #ifndef JAEGERTRACINGC_SPAN_H
 #define JAEGERTRACINGC_SPAN_H
 
+#include "jaegertracingc/alloc.h"
 #include "jaegertracingc/clock.h"
 #include "jaegertracingc/common.h"
 #include "jaegertracingc/hashtable.h"
+#include "jaegertracingc/intern.h"
 #include "jaegertracingc/key_value.h"
 #include "jaegertracingc/log_record.h"
 #include "jaegertracingc/tag.h"
@@ -47,11 +49,38 @@ extern "C" {
 
 #define JAEGERTRACINGC_SAMPLING_PRIORITY "sampling.priority"
 
+/** Number of tags stored inline in a span. */
+#define JAEGERTRACINGC_SPAN_INLINE_TAGS 8
+
+/** Number of log records stored inline in a span. */
+#define JAEGERTRACINGC_SPAN_INLINE_LOGS 2
+
+/** Number of references stored inline in a span. */
+#define JAEGERTRACINGC_SPAN_INLINE_REFS 1
+
 enum {
     jaeger_sampling_flag_sampled = 1u,
     jaeger_sampling_flag_debug = (1u << 1u)
 };
 
+/**
+ * Baggage items shared by span contexts. A child span context shares the
+ * baggage of its parent until either of them modifies it, so the items are
+ * immutable while more than one context holds a reference.
+ */
+typedef struct jaeger_shared_baggage {
+    /** Key-value pairs that are propagated along with the span. */
+    jaeger_hashtable items;
+
+    /** Number of span contexts referencing this instance. */
+    int ref_count;
+
+#ifndef JAEGERTRACINGC_HAVE_ATOMICS
+    /** Lock to protect ref_count. */
+    jaeger_mutex mutex;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+} jaeger_shared_baggage;
+
 /**
  * Span context represents propagated span identity and state.
  */
@@ -71,8 +100,13 @@ typedef struct jaeger_span_context {
     /** Sampling flags. */
     uint8_t flags;
 
-    /** Key-value pairs that are propagated along with the span. */
-    jaeger_hashtable baggage;
+    /**
+     * Baggage items, possibly shared with other span contexts. NULL if no
+     * items were added yet.
+     * @see jaeger_span_context_baggage
+     * @see jaeger_span_context_mutable_baggage
+     */
+    jaeger_shared_baggage* baggage;
 
     /**
      * Can be set to correlation ID when the context is being extracted from a
@@ -101,7 +135,7 @@ static const int jaeger_span_context_type_descriptor_length =
                  .type_descriptor_length =                                  \
                      jaeger_span_context_type_descriptor_length},           \
         .trace_id = JAEGERTRACINGC_TRACE_ID_INIT, .span_id = 0, .flags = 0, \
-        .baggage = JAEGERTRACINGC_HASHTABLE_INIT, .debug_id = NULL,         \
+        .baggage = NULL, .debug_id = NULL,                                  \
         .mutex = JAEGERTRACINGC_MUTEX_INIT                                  \
     }
 
@@ -117,6 +151,49 @@ bool jaeger_span_context_init(jaeger_span_context* ctx);
 bool jaeger_span_context_copy(jaeger_span_context* restrict dst,
                               const jaeger_span_context* restrict src);
 
+/**
+ * @internal
+ * Returns the baggage items of a span context. Caller must hold the context's
+ * mutex for the lifetime of the result.
+ * @param ctx Span context instance. May not be NULL.
+ * @return Baggage items, an empty table if the context has none.
+ */
+const jaeger_hashtable*
+jaeger_span_context_baggage(const jaeger_span_context* ctx);
+
+/**
+ * @internal
+ * Returns baggage items of a span context that may be modified, copying
+ * them first if they are shared with another context. Caller must hold the
+ * context's mutex.
+ * @param ctx Span context instance. May not be NULL.
+ * @return Baggage items owned by ctx, NULL if allocation failed.
+ */
+jaeger_hashtable* jaeger_span_context_mutable_baggage(jaeger_span_context* ctx);
+
+/**
+ * @internal
+ * Sets a baggage item, copying the baggage first if it is shared. Caller must
+ * hold the context's mutex.
+ * @param ctx Span context instance. May not be NULL.
+ * @param key Baggage key. May not be NULL.
+ * @param value Baggage value. May not be NULL.
+ * @return True on success, false otherwise.
+ */
+bool jaeger_span_context_set_baggage_item(jaeger_span_context* ctx,
+                                          const char* key,
+                                          const char* value);
+
+/**
+ * @internal
+ * Makes dst share the baggage of src, releasing the baggage dst held before.
+ * Caller must hold the mutexes of both contexts.
+ * @param dst Span context that takes a reference. May not be NULL.
+ * @param src Span context that owns the baggage. May not be NULL.
+ */
+void jaeger_span_context_share_baggage(jaeger_span_context* restrict dst,
+                                       const jaeger_span_context* restrict src);
+
 /**
  * @internal
  * Returns whether or not the span context is valid.
@@ -170,6 +247,17 @@ JAEGERTRACINGC_WRAP_COPY(jaeger_span_ref_to_protobuf,
 /* Forward declaration */
 struct jaeger_tracer;
 
+/** Flags to start a span with. */
+enum jaeger_span_start_flag {
+    jaeger_span_start_flag_none = 0,
+    /**
+     * Only the thread that starts the span uses it until it is finished, so
+     * the span is modified without locking. Debug builds assert that no
+     * other thread modifies the span. Ignored by noop spans.
+     */
+    jaeger_span_start_flag_single_owner = 1u
+};
+
 typedef struct jaeger_span {
     /** Base class member. */
     opentracing_span base;
@@ -179,6 +267,11 @@ typedef struct jaeger_span {
     jaeger_span_context context;
     /** Operation represented by this span. */
     char* operation_name;
+    /**
+     * Interned operation name. If set, operation_name points at its string
+     * and is not owned by the span.
+     */
+    const jaeger_interned_string* interned_operation_name;
     /** Start time using system clock. */
     jaeger_timestamp start_time_system;
     /** Start time using monotonic/steady clock. */
@@ -186,13 +279,44 @@ typedef struct jaeger_span {
     /** Overall duration of span (set on span finish). */
     jaeger_duration duration;
     /** Span tags. */
-    jaeger_vector tags;
+    JAEGERTRACINGC_INLINE_VECTOR(jaeger_tag,
+                                 tags,
+                                 JAEGERTRACINGC_SPAN_INLINE_TAGS);
+    /**
+     * Borrow flags of the tags with the same index. Tags past its end own
+     * their members. Allocated when the first borrowed tag is added.
+     */
+    jaeger_vector tag_borrow_flags;
     /** Span log records. */
-    jaeger_vector logs;
+    JAEGERTRACINGC_INLINE_VECTOR(jaeger_log_record,
+                                 logs,
+                                 JAEGERTRACINGC_SPAN_INLINE_LOGS);
     /** Span context references (i.e. CHILD_OF and/or FOLLOWS_FROM). */
-    jaeger_vector refs;
-    /** Mutex to guard mutable members. */
-    jaeger_mutex mutex;
+    JAEGERTRACINGC_INLINE_VECTOR(jaeger_span_ref,
+                                 refs,
+                                 JAEGERTRACINGC_SPAN_INLINE_REFS);
+    /**
+     * Serves the operation name and the keys and values of tags and log
+     * fields, which are all released at once when the span is destroyed or
+     * reset.
+     */
+    jaeger_arena arena;
+    /**
+     * Set once the span is finished. A finished span is no longer modified,
+     * so reporters may read it without locking. Until then, mutable members
+     * are guarded by the context's mutex.
+     */
+    bool finished;
+    /**
+     * Whether the span is only used by the thread that started it, in which
+     * case it is not locked.
+     * @see jaeger_span_start_flag_single_owner
+     */
+    bool single_owner;
+#ifndef NDEBUG
+    /** Thread that started a single-owner span. */
+    jaeger_thread owner;
+#endif /* NDEBUG */
 } jaeger_span;
 
 /* Forward declaration. */
@@ -241,7 +365,8 @@ void jaeger_span_finish_with_options(
 void jaeger_span_finish(opentracing_span* span);
 
 /**
- * Get the sampling status of the span. Uses lock to protect flags.
+ * Get the sampling status of the span. Reads the flags atomically if atomics
+ * are available, otherwise under the span context's lock.
  * @param span The span instance.
  * @return True if sampled, false otherwise.
  */
@@ -256,6 +381,17 @@ bool jaeger_span_is_sampled(const jaeger_span* span);
 void jaeger_span_set_operation_name(opentracing_span* s,
                                     const char* operation_name);
 
+/**
+ * @internal
+ * Set operation name of span without locking. Uses the interned operation
+ * name if possible, otherwise copies it into the span's arena.
+ * @param span The span instance.
+ * @param operation_name The new operation name.
+ * @return True on success, false otherwise.
+ */
+bool jaeger_span_set_operation_name_no_locking(jaeger_span* span,
+                                               const char* operation_name);
+
 /**
  * Set baggage item.
  * @param span Span instance.
@@ -287,6 +423,20 @@ void jaeger_span_set_tag_no_locking(jaeger_span* span,
                                     const char* key,
                                     const opentracing_value* value);
 
+/**
+ * Add tag that may borrow its key and string value to span without locking.
+ * @param span The span instance.
+ * @param key The tag key.
+ * @param value The tag value.
+ * @param borrow_flags Bitwise OR of jaeger_tag_borrow_flag values marking
+ *                     the members that are stored without copying.
+ * @see jaeger_span_set_borrowed_tag()
+ */
+void jaeger_span_set_borrowed_tag_no_locking(jaeger_span* span,
+                                             const char* key,
+                                             const opentracing_value* value,
+                                             int borrow_flags);
+
 /**
  * Set sampling flag on span.
  * @internal
@@ -307,6 +457,20 @@ void jaeger_span_set_tag(opentracing_span* span,
                          const char* key,
                          const opentracing_value* value);
 
+/**
+ * Add tag to span without copying the members marked by borrow_flags, which
+ * must outlive the span, e.g. string literals such as "http.method". Spans
+ * other than jaeger_span copy the tag as usual.
+ * @param span The span instance.
+ * @param key The tag key.
+ * @param value The tag value.
+ * @param borrow_flags Bitwise OR of jaeger_tag_borrow_flag values.
+ */
+void jaeger_span_set_borrowed_tag(opentracing_span* span,
+                                  const char* key,
+                                  const opentracing_value* value,
+                                  int borrow_flags);
+
 /**
  * Append to span logs.
  * @param span The span instance.
@@ -319,24 +483,27 @@ void jaeger_span_log(opentracing_span* span,
                      int num_fields);
 
 /* Static initializer for span. */
-#define JAEGERTRACINGC_SPAN_INIT                                               \
-    {                                                                          \
-        .base = {.base = {.destroy = &jaeger_span_destroy},                    \
-                 .finish = &jaeger_span_finish,                                \
-                 .finish_with_options = &jaeger_span_finish_with_options,      \
-                 .set_operation_name = &jaeger_span_set_operation_name,        \
-                 .set_tag = &jaeger_span_set_tag,                              \
-                 .log_fields = &jaeger_span_log,                               \
-                 .set_baggage_item = &jaeger_span_set_baggage_item,            \
-                 .baggage_item = &jaeger_span_baggage_item},                   \
-        .tracer = NULL, .context = JAEGERTRACINGC_SPAN_CONTEXT_INIT,           \
-        .operation_name = NULL,                                                \
-        .start_time_system = JAEGERTRACINGC_TIMESTAMP_INIT,                    \
-        .start_time_steady = JAEGERTRACINGC_DURATION_INIT,                     \
-        .duration = JAEGERTRACINGC_DURATION_INIT,                              \
-        .tags = JAEGERTRACINGC_VECTOR_INIT,                                    \
-        .logs = JAEGERTRACINGC_VECTOR_INIT,                                    \
-        .refs = JAEGERTRACINGC_VECTOR_INIT, .mutex = JAEGERTRACINGC_MUTEX_INIT \
+#define JAEGERTRACINGC_SPAN_INIT                                          \
+    {                                                                     \
+        .base = {.base = {.destroy = &jaeger_span_destroy},               \
+                 .finish = &jaeger_span_finish,                           \
+                 .finish_with_options = &jaeger_span_finish_with_options, \
+                 .set_operation_name = &jaeger_span_set_operation_name,   \
+                 .set_tag = &jaeger_span_set_tag,                         \
+                 .log_fields = &jaeger_span_log,                          \
+                 .set_baggage_item = &jaeger_span_set_baggage_item,       \
+                 .baggage_item = &jaeger_span_baggage_item},              \
+        .tracer = NULL, .context = JAEGERTRACINGC_SPAN_CONTEXT_INIT,      \
+        .operation_name = NULL, .interned_operation_name = NULL,          \
+        .start_time_system = JAEGERTRACINGC_TIMESTAMP_INIT,               \
+        .start_time_steady = JAEGERTRACINGC_DURATION_INIT,                \
+        .duration = JAEGERTRACINGC_DURATION_INIT,                         \
+        .tags = JAEGERTRACINGC_VECTOR_INIT,                               \
+        .tag_borrow_flags = JAEGERTRACINGC_VECTOR_INIT,                   \
+        .logs = JAEGERTRACINGC_VECTOR_INIT,                               \
+        .refs = JAEGERTRACINGC_VECTOR_INIT,                               \
+        .arena = JAEGERTRACINGC_ARENA_INIT, .finished = false,            \
+        .single_owner = false                                             \
     }
 
 /**
@@ -349,6 +516,92 @@ void jaeger_span_log(opentracing_span* span,
  */
 bool jaeger_span_init(jaeger_span* span);
 
+/**
+ * @internal
+ * Return a finished span to the state left by jaeger_span_init, keeping the
+ * storage of its tags, logs, references, baggage and a block of its arena so
+ * the tracer can reuse it for a new span.
+ * @param span Initialized span. May not be NULL.
+ */
+void jaeger_span_reset(jaeger_span* span);
+
+/**
+ * Span of a trace that is not sampled. Only carries the span context so the
+ * trace can still be propagated. Operation name, tags and logs are ignored,
+ * and finishing the span never reports it. Setting a non-zero
+ * sampling.priority tag marks the context as sampled and debug, so spans
+ * started from it downstream are sampled, but this span is still not
+ * recorded.
+ * @see jaeger_tracer_options
+ */
+typedef struct jaeger_noop_span {
+    /** Base class member. */
+    opentracing_span base;
+    /** Tracer that creates this span. */
+    struct jaeger_tracer* tracer;
+    /** Span context. */
+    jaeger_span_context context;
+} jaeger_noop_span;
+
+/* Forward declaration. */
+void jaeger_tracer_report_noop_span(struct jaeger_tracer* tracer,
+                                    jaeger_noop_span* span);
+
+void jaeger_noop_span_destroy(jaeger_destructible* d);
+
+void jaeger_noop_span_finish_with_options(
+    opentracing_span* span, const opentracing_finish_span_options* options);
+
+void jaeger_noop_span_finish(opentracing_span* span);
+
+void jaeger_noop_span_set_operation_name(opentracing_span* span,
+                                         const char* operation_name);
+
+void jaeger_noop_span_set_tag(opentracing_span* span,
+                              const char* key,
+                              const opentracing_value* value);
+
+void jaeger_noop_span_log(opentracing_span* span,
+                          const opentracing_log_field* fields,
+                          int num_fields);
+
+void jaeger_noop_span_set_baggage_item(opentracing_span* span,
+                                       const char* key,
+                                       const char* value);
+
+const char* jaeger_noop_span_baggage_item(const opentracing_span* span,
+                                          const char* key);
+
+/* Static initializer for noop span. */
+#define JAEGERTRACINGC_NOOP_SPAN_INIT                                          \
+    {                                                                          \
+        .base = {.base = {.destroy = &jaeger_noop_span_destroy},               \
+                 .finish = &jaeger_noop_span_finish,                           \
+                 .finish_with_options = &jaeger_noop_span_finish_with_options, \
+                 .set_operation_name = &jaeger_noop_span_set_operation_name,   \
+                 .set_tag = &jaeger_noop_span_set_tag,                         \
+                 .log_fields = &jaeger_noop_span_log,                          \
+                 .set_baggage_item = &jaeger_noop_span_set_baggage_item,       \
+                 .baggage_item = &jaeger_noop_span_baggage_item},              \
+        .tracer = NULL, .context = JAEGERTRACINGC_SPAN_CONTEXT_INIT            \
+    }
+
+/**
+ * @internal
+ * Initialize a noop span. Allocates nothing, the baggage is only allocated
+ * once an item is added.
+ * @param span Span to initialize. May not be NULL.
+ */
+void jaeger_noop_span_init(jaeger_noop_span* span);
+
+/**
+ * @internal
+ * Return a finished noop span to the state left by jaeger_noop_span_init,
+ * keeping the storage of its baggage.
+ * @param span Initialized span. May not be NULL.
+ */
+void jaeger_noop_span_reset(jaeger_noop_span* span);
+
 bool jaeger_span_copy(jaeger_span* restrict dst,
                       const jaeger_span* restrict src);
 
@@ -356,6 +609,13 @@ void jaeger_protobuf_list_destroy(void** data, int num, void (*destroy)(void*));
 
 void jaeger_span_protobuf_destroy(Jaeger__Model__Span* span);
 
+/**
+ * Convert a span to its protobuf representation. Does not lock the span, so
+ * it must be finished or otherwise not be modified concurrently.
+ * @param dst Protobuf span to initialize. May not be NULL.
+ * @param src Span to convert. May not be NULL.
+ * @return True on success, false otherwise.
+ */
 bool jaeger_span_to_protobuf(Jaeger__Model__Span* restrict dst,
                              const jaeger_span* restrict src);
 
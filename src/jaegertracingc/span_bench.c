@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2018 The Jaeger Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Counts the allocations made for a typical child span: a reference to its
+ * parent, four tags and a log record with two fields.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "jaegertracingc/clock.h"
+#include "jaegertracingc/reporter.h"
+#include "jaegertracingc/sampler.h"
+#include "jaegertracingc/tracer.h"
+
+enum { num_spans = 100000, num_pooled_spans = 64 };
+
+typedef struct counting_allocator {
+    jaeger_allocator base;
+    jaeger_allocator* delegate;
+    long num_allocations;
+} counting_allocator;
+
+static void* counting_malloc(jaeger_allocator* alloc, size_t sz)
+{
+    counting_allocator* a = (counting_allocator*) alloc;
+    a->num_allocations++;
+    return a->delegate->malloc(a->delegate, sz);
+}
+
+static void* counting_realloc(jaeger_allocator* alloc, void* ptr, size_t sz)
+{
+    counting_allocator* a = (counting_allocator*) alloc;
+    a->num_allocations++;
+    return a->delegate->realloc(a->delegate, ptr, sz);
+}
+
+static void counting_free(jaeger_allocator* alloc, void* ptr)
+{
+    counting_allocator* a = (counting_allocator*) alloc;
+    a->delegate->free(a->delegate, ptr);
+}
+
+static counting_allocator allocator = {.base = {.malloc = &counting_malloc,
+                                                .realloc = &counting_realloc,
+                                                .free = &counting_free},
+                                       .delegate = NULL,
+                                       .num_allocations = 0};
+
+static void start_and_finish_child(opentracing_tracer* tracer,
+                                   const opentracing_span_context* parent)
+{
+    const opentracing_span_reference ref = {
+        .type = opentracing_span_reference_child_of,
+        .referenced_context = parent};
+    const opentracing_start_span_options options = {
+        .references = &ref, .num_references = 1, .tags = NULL, .num_tags = 0};
+    opentracing_span* span =
+        tracer->start_span_with_options(tracer, "child", &options);
+    if (span == NULL) {
+        fprintf(stderr, "Cannot start span\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const opentracing_value method = {.type = opentracing_value_string,
+                                      .value.string_value = "GET"};
+    const opentracing_value status = {.type = opentracing_value_int64,
+                                      .value.int64_value = 200};
+    const opentracing_value url = {.type = opentracing_value_string,
+                                   .value.string_value = "/api/v1/spans"};
+    const opentracing_value error = {.type = opentracing_value_bool,
+                                     .value.bool_value = opentracing_false};
+    span->set_tag(span, "http.method", &method);
+    span->set_tag(span, "http.status_code", &status);
+    span->set_tag(span, "http.url", &url);
+    span->set_tag(span, "error", &error);
+
+    const opentracing_log_field fields[] = {
+        {.key = "event", .value = method}, {.key = "message", .value = url}};
+    span->log_fields(span, fields, sizeof(fields) / sizeof(fields[0]));
+    span->finish(span);
+    if (!((jaeger_tracer*) tracer)->pool_spans) {
+        ((opentracing_destructible*) span)
+            ->destroy((opentracing_destructible*) span);
+        jaeger_free(span);
+    }
+}
+
+static void run(int span_pool_size)
+{
+    jaeger_const_sampler sampler;
+    jaeger_const_sampler_init(&sampler, true);
+    jaeger_metrics metrics;
+    if (!jaeger_default_metrics_init(&metrics)) {
+        fprintf(stderr, "Cannot initialize metrics\n");
+        exit(EXIT_FAILURE);
+    }
+    jaeger_tracer_options options = JAEGER_TRACER_OPTIONS_INIT;
+    options.span_pool_size = span_pool_size;
+    jaeger_tracer tracer = JAEGERTRACINGC_TRACER_INIT;
+    if (!jaeger_tracer_init(&tracer,
+                            "span-bench",
+                            (jaeger_sampler*) &sampler,
+                            jaeger_null_reporter(),
+                            &metrics,
+                            &options,
+                            NULL)) {
+        fprintf(stderr, "Cannot initialize tracer\n");
+        exit(EXIT_FAILURE);
+    }
+    opentracing_tracer* t = (opentracing_tracer*) &tracer;
+    opentracing_span* parent = t->start_span(t, "parent");
+    if (parent == NULL) {
+        fprintf(stderr, "Cannot start span\n");
+        exit(EXIT_FAILURE);
+    }
+    const opentracing_span_context* parent_context =
+        (const opentracing_span_context*) &((jaeger_span*) parent)->context;
+
+    /* Warm up pools and lazily initialized state. */
+    start_and_finish_child(t, parent_context);
+
+    const long num_allocations = allocator.num_allocations;
+    jaeger_duration start;
+    jaeger_duration_now(&start);
+    for (int i = 0; i < num_spans; i++) {
+        start_and_finish_child(t, parent_context);
+    }
+    jaeger_duration end;
+    jaeger_duration_now(&end);
+    opentracing_time_value elapsed;
+    jaeger_time_subtract(end.value, start.value, &elapsed);
+    const double elapsed_ns = elapsed.tv_sec * 1e9 + elapsed.tv_nsec;
+    printf("span pool size = %d: %.2f allocations/span, %.0f ns/span\n",
+           span_pool_size,
+           (double) (allocator.num_allocations - num_allocations) / num_spans,
+           elapsed_ns / num_spans);
+
+    parent->finish(parent);
+    if (!tracer.pool_spans) {
+        ((opentracing_destructible*) parent)
+            ->destroy((opentracing_destructible*) parent);
+        jaeger_free(parent);
+    }
+    ((opentracing_destructible*) &tracer)
+        ->destroy((opentracing_destructible*) &tracer);
+}
+
+int main()
+{
+    allocator.delegate = jaeger_built_in_allocator();
+    jaeger_set_allocator((jaeger_allocator*) &allocator);
+    run(0);
+    run(num_pooled_spans);
+    return 0;
+}
@@ -76,6 +76,15 @@ void test_span()
     TEST_ASSERT_FALSE(
         jaeger_span_context_is_debug_id_container_only(&span.context));
 
+    /* Baggage is only allocated once an item is set. */
+    TEST_ASSERT_NULL(span.context.baggage);
+    ((opentracing_span_context*) &span.context)
+        ->foreach_baggage_item(
+            ((opentracing_span_context*) &span.context), &visit_baggage, NULL);
+    TEST_ASSERT_NULL(
+        ((opentracing_span*) &span)
+            ->baggage_item(((opentracing_span*) &span), baggage[0].key));
+
     for (int i = 0, len = sizeof(baggage) / sizeof(baggage[0]); i < len; i++) {
         ((opentracing_span*) &span)
             ->set_baggage_item(
@@ -84,6 +93,58 @@ void test_span()
     ((opentracing_span_context*) &span.context)
         ->foreach_baggage_item(
             ((opentracing_span_context*) &span.context), &visit_baggage, NULL);
+
+    /* Copies share baggage until one of them sets an item. */
+    jaeger_span_context ctx_copy;
+    TEST_ASSERT_TRUE(jaeger_span_context_copy(&ctx_copy, &span.context));
+    TEST_ASSERT_EQUAL_PTR(span.context.baggage, ctx_copy.baggage);
+    TEST_ASSERT_TRUE(
+        jaeger_span_context_set_baggage_item(&ctx_copy, "copy-key", "value"));
+    TEST_ASSERT_NOT_EQUAL(span.context.baggage, ctx_copy.baggage);
+    TEST_ASSERT_EQUAL(sizeof(baggage) / sizeof(baggage[0]) + 1,
+                      jaeger_span_context_baggage(&ctx_copy)->size);
+    TEST_ASSERT_NULL(
+        ((opentracing_span*) &span)
+            ->baggage_item(((opentracing_span*) &span), "copy-key"));
+    jaeger_span_context_destroy((jaeger_destructible*) &ctx_copy);
+    ((opentracing_span_context*) &span.context)
+        ->foreach_baggage_item(
+            ((opentracing_span_context*) &span.context), &visit_baggage, NULL);
+
+    /* Borrowed tags are stored as is and not freed with the span. */
+    span.context.flags = jaeger_sampling_flag_sampled;
+    static const char borrowed_key[] = "http.method";
+    static const char borrowed_value[] = "GET";
+    const opentracing_value value = {.type = opentracing_value_string,
+                                     .value.string_value = borrowed_value};
+    ((opentracing_span*) &span)
+        ->set_tag((opentracing_span*) &span, "http.url", &value);
+    jaeger_span_set_borrowed_tag((opentracing_span*) &span,
+                                 borrowed_key,
+                                 &value,
+                                 jaeger_tag_borrow_key |
+                                     jaeger_tag_borrow_value);
+    jaeger_span_set_borrowed_tag((opentracing_span*) &span,
+                                 "http.path",
+                                 &value,
+                                 jaeger_tag_borrow_value);
+    TEST_ASSERT_EQUAL(3, jaeger_vector_length(&span.tags));
+    const jaeger_tag* tag = jaeger_vector_get(&span.tags, 1);
+    TEST_ASSERT_EQUAL_PTR(borrowed_key, tag->key);
+    TEST_ASSERT_EQUAL_PTR(borrowed_value, tag->v_str);
+    tag = jaeger_vector_get(&span.tags, 2);
+    TEST_ASSERT_EQUAL_STRING("http.path", tag->key);
+    TEST_ASSERT_EQUAL_PTR(borrowed_value, tag->v_str);
+
+    ((opentracing_span*) &span)
+        ->set_operation_name((opentracing_span*) &span, "test-operation");
+    jaeger_span span_copy;
+    TEST_ASSERT_TRUE(jaeger_span_copy(&span_copy, &span));
+    tag = jaeger_vector_get(&span_copy.tags, 1);
+    TEST_ASSERT_EQUAL_STRING(borrowed_key, tag->key);
+    ((opentracing_destructible*) &span_copy)
+        ->destroy((opentracing_destructible*) &span_copy);
+
     ((opentracing_destructible*) &span)
         ->destroy((opentracing_destructible*) &span);
 }
@@ -17,26 +17,45 @@
 #include "jaegertracingc/tag.h"
 
 void jaeger_tag_destroy(jaeger_tag* tag)
+{
+    jaeger_tag_destroy_with_allocator(tag, jaeger_get_allocator());
+}
+
+void jaeger_tag_destroy_with_allocator(jaeger_tag* tag,
+                                       jaeger_allocator* alloc)
+{
+    jaeger_tag_destroy_borrowed_with_allocator(
+        tag, jaeger_tag_borrow_none, alloc);
+}
+
+void jaeger_tag_destroy_borrowed_with_allocator(jaeger_tag* tag,
+                                                int borrow_flags,
+                                                jaeger_allocator* alloc)
 {
     if (tag == NULL) {
         return;
     }
 
     if (tag->key != NULL) {
-        jaeger_free(tag->key);
+        if ((borrow_flags & jaeger_tag_borrow_key) == 0) {
+            alloc->free(alloc, tag->key);
+        }
         tag->key = NULL;
     }
 
+    const bool owns_value = (borrow_flags & jaeger_tag_borrow_value) == 0;
     switch (tag->v_type) {
     case JAEGER__MODEL__VALUE_TYPE__STRING: {
         if (tag->v_str != NULL) {
-            jaeger_free(tag->v_str);
+            if (owns_value) {
+                alloc->free(alloc, tag->v_str);
+            }
             tag->v_str = NULL;
         }
     } break;
     case JAEGER__MODEL__VALUE_TYPE__BINARY: {
         if (tag->v_binary.data != NULL) {
-            jaeger_free(tag->v_binary.data);
+            alloc->free(alloc, tag->v_binary.data);
             tag->v_binary.data = NULL;
         }
     } break;
@@ -46,11 +65,18 @@ void jaeger_tag_destroy(jaeger_tag* tag)
 }
 
 bool jaeger_tag_init(jaeger_tag* tag, const char* key)
+{
+    return jaeger_tag_init_with_allocator(tag, key, jaeger_get_allocator());
+}
+
+bool jaeger_tag_init_with_allocator(jaeger_tag* tag,
+                                    const char* key,
+                                    jaeger_allocator* alloc)
 {
     assert(tag != NULL);
     assert(key != NULL);
 
-    tag->key = jaeger_strdup(key);
+    tag->key = jaeger_allocator_strdup(alloc, key);
     if (tag->key == NULL) {
         return false;
     }
@@ -58,11 +84,19 @@ bool jaeger_tag_init(jaeger_tag* tag, const char* key)
 }
 
 bool jaeger_tag_copy(jaeger_tag* dst, const jaeger_tag* src)
+{
+    return jaeger_tag_copy_with_allocator(dst, src, jaeger_get_allocator());
+}
+
+bool jaeger_tag_copy_with_allocator(jaeger_tag* dst,
+                                    const jaeger_tag* src,
+                                    jaeger_allocator* alloc)
 {
     assert(dst != NULL);
     assert(src != NULL);
+    assert(alloc != NULL);
     *dst = (jaeger_tag) JAEGERTRACINGC_TAG_INIT;
-    if (!jaeger_tag_init(dst, src->key)) {
+    if (!jaeger_tag_init_with_allocator(dst, src->key, alloc)) {
         return false;
     }
 
@@ -70,7 +104,7 @@ bool jaeger_tag_copy(jaeger_tag* dst, const jaeger_tag* src)
     switch (src->v_type) {
     case JAEGER__MODEL__VALUE_TYPE__STRING: {
         if (src->v_str != NULL) {
-            dst->v_str = jaeger_strdup(src->v_str);
+            dst->v_str = jaeger_allocator_strdup(alloc, src->v_str);
             if (dst->v_str == NULL) {
                 goto cleanup;
             }
@@ -78,11 +112,13 @@ bool jaeger_tag_copy(jaeger_tag* dst, const jaeger_tag* src)
     } break;
     case JAEGER__MODEL__VALUE_TYPE__BINARY: {
         if (src->v_binary.len > 0 && src->v_binary.data != NULL) {
-            dst->v_binary.data = (uint8_t*) jaeger_malloc(src->v_binary.len);
+            dst->v_binary.data =
+                (uint8_t*) alloc->malloc(alloc, src->v_binary.len);
             if (dst->v_binary.data == NULL) {
                 goto cleanup;
             }
             memcpy(dst->v_binary.data, src->v_binary.data, src->v_binary.len);
+            dst->v_binary.len = src->v_binary.len;
         }
     } break;
     case JAEGER__MODEL__VALUE_TYPE__FLOAT64: {
@@ -100,7 +136,7 @@ bool jaeger_tag_copy(jaeger_tag* dst, const jaeger_tag* src)
     return true;
 
 cleanup:
-    jaeger_tag_destroy(dst);
+    jaeger_tag_destroy_with_allocator(dst, alloc);
     *dst = (jaeger_tag) JAEGERTRACINGC_TAG_INIT;
     return false;
 }
@@ -109,6 +145,28 @@ bool jaeger_tag_from_key_value(jaeger_tag* restrict dst,
                                const char* key,
                                const opentracing_value* value)
 {
+    return jaeger_tag_from_key_value_with_allocator(
+        dst, key, value, jaeger_get_allocator());
+}
+
+bool jaeger_tag_from_key_value_with_allocator(jaeger_tag* restrict dst,
+                                              const char* key,
+                                              const opentracing_value* value,
+                                              jaeger_allocator* alloc)
+{
+    return jaeger_tag_from_key_value_borrowed_with_allocator(
+        dst, key, value, jaeger_tag_borrow_none, alloc);
+}
+
+bool jaeger_tag_from_key_value_borrowed_with_allocator(
+    jaeger_tag* restrict dst,
+    const char* key,
+    const opentracing_value* value,
+    int borrow_flags,
+    jaeger_allocator* alloc)
+{
+    assert(dst != NULL);
+    assert(alloc != NULL);
     jaeger_tag src = JAEGERTRACINGC_TAG_INIT;
     src.key = (char*) key;
     if (src.key == NULL) {
@@ -135,7 +193,8 @@ bool jaeger_tag_from_key_value(jaeger_tag* restrict dst,
         break;
     case opentracing_value_string:
         src.v_type = JAEGER__MODEL__VALUE_TYPE__STRING;
-        src.v_str = jaeger_strdup(value->value.string_value);
+        /* Copied below unless borrowed. */
+        src.v_str = (char*) value->value.string_value;
         if (src.v_str == NULL) {
             return false;
         }
@@ -144,7 +203,28 @@ bool jaeger_tag_from_key_value(jaeger_tag* restrict dst,
         return false;
     }
 
-    return jaeger_tag_copy(dst, &src);
+    *dst = src;
+    if ((borrow_flags & jaeger_tag_borrow_key) == 0) {
+        dst->key = jaeger_allocator_strdup(alloc, key);
+        if (dst->key == NULL) {
+            goto cleanup;
+        }
+    }
+    if (dst->v_type == JAEGER__MODEL__VALUE_TYPE__STRING &&
+        (borrow_flags & jaeger_tag_borrow_value) == 0) {
+        dst->v_str = jaeger_allocator_strdup(alloc, src.v_str);
+        if (dst->v_str == NULL) {
+            goto cleanup;
+        }
+    }
+    return true;
+
+cleanup:
+    if ((borrow_flags & jaeger_tag_borrow_key) == 0 && dst->key != NULL) {
+        alloc->free(alloc, dst->key);
+    }
+    *dst = (jaeger_tag) JAEGERTRACINGC_TAG_INIT;
+    return false;
 }
 
 bool jaeger_tag_vector_append(jaeger_vector* vec, const jaeger_tag* tag)
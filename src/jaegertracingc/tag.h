@@ -37,8 +37,38 @@ typedef Jaeger__Model__KeyValue jaeger_tag;
 
 #define JAEGERTRACINGC_TAG_TYPE(type) JAEGER__MODEL__VALUE_TYPE__##type
 
+/**
+ * Flags marking the members a tag borrows instead of owning. Borrowed
+ * members are neither copied nor freed, so they must outlive the tag, like
+ * string literals do. Only string values can be borrowed.
+ */
+typedef enum jaeger_tag_borrow_flag {
+    jaeger_tag_borrow_none = 0,
+    jaeger_tag_borrow_key = 1u,
+    jaeger_tag_borrow_value = 1u << 1,
+} jaeger_tag_borrow_flag;
+
 void jaeger_tag_destroy(jaeger_tag* tag);
 
+/**
+ * Destroy tag whose members were allocated from alloc. The *_with_allocator
+ * variants behave like the plain functions, which use the installed
+ * allocator.
+ */
+void jaeger_tag_destroy_with_allocator(jaeger_tag* tag,
+                                       jaeger_allocator* alloc);
+
+/**
+ * Destroy tag whose owned members were allocated from alloc.
+ * @param tag The tag instance.
+ * @param borrow_flags Bitwise OR of jaeger_tag_borrow_flag values marking
+ *                     the members that are not freed.
+ * @param alloc Allocator of the owned members.
+ */
+void jaeger_tag_destroy_borrowed_with_allocator(jaeger_tag* tag,
+                                                int borrow_flags,
+                                                jaeger_allocator* alloc);
+
 JAEGERTRACINGC_WRAP_DESTROY(jaeger_tag_destroy, jaeger_tag)
 
 /** Initialize a tag with no value.
@@ -48,12 +78,42 @@ JAEGERTRACINGC_WRAP_DESTROY(jaeger_tag_destroy, jaeger_tag)
  */
 bool jaeger_tag_init(jaeger_tag* tag, const char* key);
 
+bool jaeger_tag_init_with_allocator(jaeger_tag* tag,
+                                    const char* key,
+                                    jaeger_allocator* alloc);
+
 bool jaeger_tag_copy(jaeger_tag* dst, const jaeger_tag* src);
 
+bool jaeger_tag_copy_with_allocator(jaeger_tag* dst,
+                                    const jaeger_tag* src,
+                                    jaeger_allocator* alloc);
+
 bool jaeger_tag_from_key_value(jaeger_tag* restrict dst,
                                const char* key,
                                const opentracing_value* value);
 
+bool jaeger_tag_from_key_value_with_allocator(jaeger_tag* restrict dst,
+                                              const char* key,
+                                              const opentracing_value* value,
+                                              jaeger_allocator* alloc);
+
+/**
+ * Initialize a tag from a key and an OpenTracing value, storing the members
+ * marked by borrow_flags as is and copying the others.
+ * @param dst The tag instance.
+ * @param key The tag key.
+ * @param value The tag value.
+ * @param borrow_flags Bitwise OR of jaeger_tag_borrow_flag values.
+ * @param alloc Allocator for the copied members.
+ * @return True on success, false otherwise.
+ */
+bool jaeger_tag_from_key_value_borrowed_with_allocator(
+    jaeger_tag* restrict dst,
+    const char* key,
+    const opentracing_value* value,
+    int borrow_flags,
+    jaeger_allocator* alloc);
+
 JAEGERTRACINGC_WRAP_COPY(jaeger_tag_copy, jaeger_tag, jaeger_tag)
 
 bool jaeger_tag_vector_append(jaeger_vector* vec, const jaeger_tag* tag);
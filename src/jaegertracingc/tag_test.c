@@ -76,4 +76,42 @@ void test_tag()
     jaeger_vector_destroy(&list);
 
     jaeger_tag_destroy(NULL);
+
+    static const char key[] = "http.method";
+    static const char value[] = "GET";
+    const opentracing_value string_value = {
+        .type = opentracing_value_string, .value.string_value = value};
+    jaeger_tag tag = JAEGERTRACINGC_TAG_INIT;
+    TEST_ASSERT_TRUE(jaeger_tag_from_key_value_borrowed_with_allocator(
+        &tag,
+        key,
+        &string_value,
+        jaeger_tag_borrow_key | jaeger_tag_borrow_value,
+        jaeger_null_allocator()));
+    TEST_ASSERT_EQUAL_PTR(key, tag.key);
+    TEST_ASSERT_EQUAL_PTR(value, tag.v_str);
+    jaeger_tag_destroy_borrowed_with_allocator(
+        &tag,
+        jaeger_tag_borrow_key | jaeger_tag_borrow_value,
+        jaeger_null_allocator());
+    TEST_ASSERT_NULL(tag.key);
+
+    TEST_ASSERT_TRUE(jaeger_tag_from_key_value_borrowed_with_allocator(
+        &tag,
+        key,
+        &string_value,
+        jaeger_tag_borrow_key,
+        jaeger_get_allocator()));
+    TEST_ASSERT_EQUAL_PTR(key, tag.key);
+    TEST_ASSERT_NOT_EQUAL(value, tag.v_str);
+    TEST_ASSERT_EQUAL_STRING(value, tag.v_str);
+    jaeger_tag_destroy_borrowed_with_allocator(
+        &tag, jaeger_tag_borrow_key, jaeger_get_allocator());
+
+    TEST_ASSERT_FALSE(jaeger_tag_from_key_value_borrowed_with_allocator(
+        &tag,
+        key,
+        &string_value,
+        jaeger_tag_borrow_key,
+        jaeger_null_allocator()));
 }
@@ -16,6 +16,8 @@
 
 #include "jaegertracingc/threading.h"
 
+#include <errno.h>
+
 #ifdef JAEGERTRACINGC_MT
 
 int jaeger_thread_init(jaeger_thread* thread,
@@ -30,6 +32,16 @@ int jaeger_thread_join(jaeger_thread thread, void** return_value)
     return pthread_join(thread, return_value);
 }
 
+jaeger_thread jaeger_thread_self(void)
+{
+    return pthread_self();
+}
+
+bool jaeger_thread_equal(jaeger_thread thread0, jaeger_thread thread1)
+{
+    return pthread_equal(thread0, thread1) != 0;
+}
+
 int jaeger_yield(void)
 {
     return sched_yield();
@@ -70,6 +82,13 @@ int jaeger_cond_wait(jaeger_cond* restrict cond, jaeger_mutex* restrict mutex)
     return pthread_cond_wait(cond, mutex);
 }
 
+int jaeger_cond_timed_wait(jaeger_cond* restrict cond,
+                           jaeger_mutex* restrict mutex,
+                           const struct timespec* abs_time)
+{
+    return pthread_cond_timedwait(cond, mutex, abs_time);
+}
+
 int jaeger_do_once(jaeger_once* once, void (*init_routine)(void))
 {
     return pthread_once(once, init_routine);
@@ -164,6 +183,19 @@ int jaeger_thread_join(jaeger_thread thread, void** return_value)
     return 0;
 }
 
+jaeger_thread jaeger_thread_self(void)
+{
+    return (jaeger_thread){.return_value = NULL};
+}
+
+bool jaeger_thread_equal(jaeger_thread thread0, jaeger_thread thread1)
+{
+    /* There is only one thread in single-threaded environment. */
+    (void) thread0;
+    (void) thread1;
+    return true;
+}
+
 int jaeger_yield(void)
 {
     return 0;
@@ -227,6 +259,21 @@ int jaeger_cond_wait(jaeger_cond* restrict cond, jaeger_mutex* restrict mutex)
     mutex->locked = true;
 }
 
+int jaeger_cond_timed_wait(jaeger_cond* restrict cond,
+                           jaeger_mutex* restrict mutex,
+                           const struct timespec* abs_time)
+{
+    (void) abs_time;
+    assert(mutex->locked);
+    /* Nothing else can signal the condition in a single-threaded
+     * environment, so report a timeout rather than spinning forever. */
+    if (cond->signal) {
+        cond->signal = false;
+        return 0;
+    }
+    return ETIMEDOUT;
+}
+
 int jaeger_do_once(jaeger_once* once, void (*init_routine)(void))
 {
     assert(once != NULL);
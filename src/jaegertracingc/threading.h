@@ -87,6 +87,12 @@ int jaeger_thread_init(jaeger_thread* thread,
 
 int jaeger_thread_join(jaeger_thread thread, void** return_value);
 
+/** Returns the calling thread. */
+jaeger_thread jaeger_thread_self(void);
+
+/** Returns whether two threads are the same thread. */
+bool jaeger_thread_equal(jaeger_thread thread0, jaeger_thread thread1);
+
 int jaeger_yield(void);
 
 int jaeger_mutex_lock(jaeger_mutex* mutex);
@@ -103,6 +109,18 @@ int jaeger_cond_signal(jaeger_cond* cond);
 
 int jaeger_cond_wait(jaeger_cond* restrict cond, jaeger_mutex* restrict mutex);
 
+/**
+ * Wait on condition variable until signaled or the absolute deadline passes.
+ * @param cond Condition variable.
+ * @param mutex Mutex held by caller.
+ * @param abs_time Deadline measured against CLOCK_REALTIME.
+ * @return Zero if signaled, ETIMEDOUT if the deadline passed, other error
+ *         code otherwise.
+ */
+int jaeger_cond_timed_wait(jaeger_cond* restrict cond,
+                           jaeger_mutex* restrict mutex,
+                           const struct timespec* abs_time);
+
 int jaeger_do_once(jaeger_once* once, void (*init_routine)(void));
 
 void jaeger_thread_local_destroy(jaeger_thread_local* local);
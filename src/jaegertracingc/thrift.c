@@ -0,0 +1,607 @@
+/*
+ * Copyright (c) 2018 The Jaeger Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jaegertracingc/thrift.h"
+#include "jaegertracingc/clock.h"
+
+/* Compact protocol type ids. Booleans store their value in the type. */
+enum {
+    compact_type_stop = 0,
+    compact_type_boolean_true = 1,
+    compact_type_boolean_false = 2,
+    compact_type_i32 = 5,
+    compact_type_i64 = 6,
+    compact_type_double = 7,
+    compact_type_binary = 8,
+    compact_type_list = 9,
+    compact_type_struct = 12
+};
+
+#define COMPACT_PROTOCOL_ID 0x82
+#define COMPACT_VERSION 1
+#define COMPACT_MESSAGE_TYPE_SHIFT 5
+#define MESSAGE_TYPE_ONEWAY 4
+
+/* Field ids from jaeger.thrift and agent.thrift. */
+enum {
+    tag_key_field = 1,
+    tag_v_type_field = 2,
+    tag_v_str_field = 3,
+    tag_v_double_field = 4,
+    tag_v_bool_field = 5,
+    tag_v_long_field = 6,
+    tag_v_binary_field = 7
+};
+
+enum { log_timestamp_field = 1, log_fields_field = 2 };
+
+enum {
+    span_ref_ref_type_field = 1,
+    span_ref_trace_id_low_field = 2,
+    span_ref_trace_id_high_field = 3,
+    span_ref_span_id_field = 4
+};
+
+enum {
+    span_trace_id_low_field = 1,
+    span_trace_id_high_field = 2,
+    span_span_id_field = 3,
+    span_parent_span_id_field = 4,
+    span_operation_name_field = 5,
+    span_references_field = 6,
+    span_flags_field = 7,
+    span_start_time_field = 8,
+    span_duration_field = 9,
+    span_tags_field = 10,
+    span_logs_field = 11
+};
+
+enum { process_service_name_field = 1, process_tags_field = 2 };
+
+enum { batch_process_field = 1, batch_spans_field = 2 };
+
+enum { emit_batch_batch_field = 1 };
+
+/* jaeger.thrift TagType and SpanRefType values. */
+enum {
+    tag_type_string = 0,
+    tag_type_double = 1,
+    tag_type_bool = 2,
+    tag_type_long = 3,
+    tag_type_binary = 4
+};
+
+enum { span_ref_type_child_of = 0, span_ref_type_follows_from = 1 };
+
+static const char emit_batch_method[] = "emitBatch";
+
+/* Fields are always written in increasing order and no struct skips more
+ * than fifteen ids, so field headers always fit in a single byte. */
+#define FIELD_HEADER_SIZE 1
+#define STOP_SIZE 1
+#define DOUBLE_SIZE sizeof(uint64_t)
+
+const uint8_t jaeger_thrift_emit_batch_trailer[] = {compact_type_stop,
+                                                    compact_type_stop};
+
+size_t jaeger_thrift_varint_size(uint64_t value)
+{
+    size_t size = 1;
+    for (; value >= 0x80; value >>= 7) {
+        size++;
+    }
+    return size;
+}
+
+static inline uint8_t* write_varint(uint8_t* out, uint64_t value)
+{
+    for (; value >= 0x80; value >>= 7) {
+        *out++ = (uint8_t)(value | 0x80);
+    }
+    *out++ = (uint8_t) value;
+    return out;
+}
+
+static inline uint64_t zigzag_i64(int64_t value)
+{
+    return ((uint64_t) value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline uint64_t zigzag_i32(int32_t value)
+{
+    return (uint32_t)(((uint32_t) value << 1) ^ (uint32_t)(value >> 31));
+}
+
+static inline uint8_t*
+write_field_header(uint8_t* out, int* last_field, int field, int type)
+{
+    assert(field > *last_field && field - *last_field <= 15);
+    *out++ = (uint8_t)(((field - *last_field) << 4) | type);
+    *last_field = field;
+    return out;
+}
+
+static inline uint8_t* write_stop(uint8_t* out)
+{
+    *out++ = compact_type_stop;
+    return out;
+}
+
+static inline size_t i64_field_size(int64_t value)
+{
+    return FIELD_HEADER_SIZE + jaeger_thrift_varint_size(zigzag_i64(value));
+}
+
+static inline uint8_t*
+write_i64_field(uint8_t* out, int* last_field, int field, int64_t value)
+{
+    out = write_field_header(out, last_field, field, compact_type_i64);
+    return write_varint(out, zigzag_i64(value));
+}
+
+static inline size_t i32_field_size(int32_t value)
+{
+    return FIELD_HEADER_SIZE + jaeger_thrift_varint_size(zigzag_i32(value));
+}
+
+static inline uint8_t*
+write_i32_field(uint8_t* out, int* last_field, int field, int32_t value)
+{
+    out = write_field_header(out, last_field, field, compact_type_i32);
+    return write_varint(out, zigzag_i32(value));
+}
+
+static inline size_t binary_field_size(size_t len)
+{
+    return FIELD_HEADER_SIZE + jaeger_thrift_varint_size(len) + len;
+}
+
+static inline uint8_t* write_binary_field(
+    uint8_t* out, int* last_field, int field, const void* data, size_t len)
+{
+    out = write_field_header(out, last_field, field, compact_type_binary);
+    out = write_varint(out, len);
+    if (len > 0) {
+        memcpy(out, data, len);
+    }
+    return out + len;
+}
+
+static inline size_t string_length(const char* str)
+{
+    return (str != NULL) ? strlen(str) : 0;
+}
+
+static inline size_t list_header_size(size_t num_elements)
+{
+    return (num_elements < 15)
+               ? 1
+               : 1 + jaeger_thrift_varint_size(num_elements);
+}
+
+static inline uint8_t*
+write_list_header(uint8_t* out, size_t num_elements, int element_type)
+{
+    if (num_elements < 15) {
+        *out++ = (uint8_t)((num_elements << 4) | element_type);
+        return out;
+    }
+    *out++ = (uint8_t)(0xf0 | element_type);
+    return write_varint(out, num_elements);
+}
+
+static inline int64_t
+time_value_microseconds(const opentracing_time_value* value)
+{
+    return (int64_t) value->tv_sec * JAEGERTRACINGC_MICROSECONDS_PER_SECOND +
+           value->tv_nsec / JAEGERTRACINGC_NANOSECONDS_PER_MICROSECOND;
+}
+
+static inline int tag_type_to_thrift(Jaeger__Model__ValueType type)
+{
+    switch (type) {
+    case JAEGER__MODEL__VALUE_TYPE__BOOL:
+        return tag_type_bool;
+    case JAEGER__MODEL__VALUE_TYPE__INT64:
+        return tag_type_long;
+    case JAEGER__MODEL__VALUE_TYPE__FLOAT64:
+        return tag_type_double;
+    case JAEGER__MODEL__VALUE_TYPE__BINARY:
+        return tag_type_binary;
+    default:
+        return tag_type_string;
+    }
+}
+
+static inline int span_ref_type_to_thrift(jaeger_span_ref_type type)
+{
+    return (type == opentracing_span_reference_follows_from)
+               ? span_ref_type_follows_from
+               : span_ref_type_child_of;
+}
+
+size_t jaeger_tag_thrift_packed_size(const jaeger_tag* tag)
+{
+    assert(tag != NULL);
+    const int type = tag_type_to_thrift(tag->v_type);
+    size_t size = binary_field_size(string_length(tag->key)) +
+                  i32_field_size(type) + STOP_SIZE;
+    switch (type) {
+    case tag_type_double:
+        size += FIELD_HEADER_SIZE + DOUBLE_SIZE;
+        break;
+    case tag_type_bool:
+        size += FIELD_HEADER_SIZE;
+        break;
+    case tag_type_long:
+        size += i64_field_size(tag->v_int64);
+        break;
+    case tag_type_binary:
+        size += binary_field_size(tag->v_binary.len);
+        break;
+    default:
+        size += binary_field_size(string_length(tag->v_str));
+        break;
+    }
+    return size;
+}
+
+size_t jaeger_tag_thrift_pack(const jaeger_tag* tag, uint8_t* out)
+{
+    assert(tag != NULL);
+    assert(out != NULL);
+    uint8_t* const start = out;
+    int last_field = 0;
+    const int type = tag_type_to_thrift(tag->v_type);
+    out = write_binary_field(
+        out, &last_field, tag_key_field, tag->key, string_length(tag->key));
+    out = write_i32_field(out, &last_field, tag_v_type_field, type);
+    switch (type) {
+    case tag_type_double: {
+        /* Compact protocol writes doubles little-endian. */
+        uint64_t bits;
+        memcpy(&bits, &tag->v_float64, sizeof(bits));
+        out = write_field_header(
+            out, &last_field, tag_v_double_field, compact_type_double);
+        for (int i = 0; i < (int) sizeof(bits); i++) {
+            *out++ = (uint8_t)(bits >> (i * 8));
+        }
+    } break;
+    case tag_type_bool:
+        out = write_field_header(out,
+                                 &last_field,
+                                 tag_v_bool_field,
+                                 tag->v_bool ? compact_type_boolean_true
+                                             : compact_type_boolean_false);
+        break;
+    case tag_type_long:
+        out = write_i64_field(out, &last_field, tag_v_long_field, tag->v_int64);
+        break;
+    case tag_type_binary:
+        out = write_binary_field(out,
+                                 &last_field,
+                                 tag_v_binary_field,
+                                 tag->v_binary.data,
+                                 tag->v_binary.len);
+        break;
+    default:
+        out = write_binary_field(out,
+                                 &last_field,
+                                 tag_v_str_field,
+                                 tag->v_str,
+                                 string_length(tag->v_str));
+        break;
+    }
+    return write_stop(out) - start;
+}
+
+size_t jaeger_log_record_thrift_packed_size(
+    const jaeger_log_record* log_record)
+{
+    assert(log_record != NULL);
+    const int num_fields = jaeger_vector_length(&log_record->fields);
+    size_t size =
+        i64_field_size(time_value_microseconds(&log_record->timestamp.value)) +
+        FIELD_HEADER_SIZE + list_header_size(num_fields) + STOP_SIZE;
+    for (int i = 0; i < num_fields; i++) {
+        const jaeger_tag* field =
+            jaeger_vector_offset((jaeger_vector*) &log_record->fields, i);
+        size += jaeger_tag_thrift_packed_size(field);
+    }
+    return size;
+}
+
+size_t jaeger_log_record_thrift_pack(const jaeger_log_record* log_record,
+                                     uint8_t* out)
+{
+    assert(log_record != NULL);
+    assert(out != NULL);
+    uint8_t* const start = out;
+    int last_field = 0;
+    const int num_fields = jaeger_vector_length(&log_record->fields);
+    out = write_i64_field(
+        out,
+        &last_field,
+        log_timestamp_field,
+        time_value_microseconds(&log_record->timestamp.value));
+    out = write_field_header(
+        out, &last_field, log_fields_field, compact_type_list);
+    out = write_list_header(out, num_fields, compact_type_struct);
+    for (int i = 0; i < num_fields; i++) {
+        const jaeger_tag* field =
+            jaeger_vector_offset((jaeger_vector*) &log_record->fields, i);
+        out += jaeger_tag_thrift_pack(field, out);
+    }
+    return write_stop(out) - start;
+}
+
+size_t jaeger_span_ref_thrift_packed_size(const jaeger_span_ref* span_ref)
+{
+    assert(span_ref != NULL);
+    const jaeger_span_context* context = &span_ref->context;
+    return i32_field_size(span_ref_type_to_thrift(span_ref->type)) +
+           i64_field_size(context->trace_id.low) +
+           i64_field_size(context->trace_id.high) +
+           i64_field_size(context->span_id) + STOP_SIZE;
+}
+
+size_t jaeger_span_ref_thrift_pack(const jaeger_span_ref* span_ref,
+                                   uint8_t* out)
+{
+    assert(span_ref != NULL);
+    assert(out != NULL);
+    uint8_t* const start = out;
+    int last_field = 0;
+    /* Referenced context is copied when the span starts and never modified
+     * afterward, so no need to lock it here. */
+    const jaeger_span_context* context = &span_ref->context;
+    out = write_i32_field(out,
+                          &last_field,
+                          span_ref_ref_type_field,
+                          span_ref_type_to_thrift(span_ref->type));
+    out = write_i64_field(
+        out, &last_field, span_ref_trace_id_low_field, context->trace_id.low);
+    out = write_i64_field(out,
+                          &last_field,
+                          span_ref_trace_id_high_field,
+                          context->trace_id.high);
+    out = write_i64_field(
+        out, &last_field, span_ref_span_id_field, context->span_id);
+    return write_stop(out) - start;
+}
+
+static inline uint64_t parent_span_id(const jaeger_span* span)
+{
+    for (int i = 0, len = jaeger_vector_length(&span->refs); i < len; i++) {
+        const jaeger_span_ref* span_ref =
+            jaeger_vector_offset((jaeger_vector*) &span->refs, i);
+        if (span_ref->type == opentracing_span_reference_child_of) {
+            return span_ref->context.span_id;
+        }
+    }
+    return 0;
+}
+
+size_t jaeger_span_thrift_packed_size(const jaeger_span* span)
+{
+    assert(span != NULL);
+    const jaeger_span_context* context = &span->context;
+    const int64_t start_time =
+        time_value_microseconds(&span->start_time_system.value);
+    const int64_t duration = time_value_microseconds(&span->duration.value);
+    size_t size = i64_field_size(context->trace_id.low) +
+                  i64_field_size(context->trace_id.high) +
+                  i64_field_size(context->span_id) +
+                  i64_field_size(parent_span_id(span)) +
+                  binary_field_size(string_length(span->operation_name)) +
+                  i32_field_size(context->flags) + i64_field_size(start_time) +
+                  i64_field_size(duration) + STOP_SIZE;
+    const int num_refs = jaeger_vector_length(&span->refs);
+    if (num_refs > 0) {
+        size += FIELD_HEADER_SIZE + list_header_size(num_refs);
+        for (int i = 0; i < num_refs; i++) {
+            const jaeger_span_ref* span_ref =
+                jaeger_vector_offset((jaeger_vector*) &span->refs, i);
+            size += jaeger_span_ref_thrift_packed_size(span_ref);
+        }
+    }
+    const int num_tags = jaeger_vector_length(&span->tags);
+    if (num_tags > 0) {
+        size += FIELD_HEADER_SIZE + list_header_size(num_tags);
+        for (int i = 0; i < num_tags; i++) {
+            const jaeger_tag* tag =
+                jaeger_vector_offset((jaeger_vector*) &span->tags, i);
+            size += jaeger_tag_thrift_packed_size(tag);
+        }
+    }
+    const int num_logs = jaeger_vector_length(&span->logs);
+    if (num_logs > 0) {
+        size += FIELD_HEADER_SIZE + list_header_size(num_logs);
+        for (int i = 0; i < num_logs; i++) {
+            const jaeger_log_record* log_record =
+                jaeger_vector_offset((jaeger_vector*) &span->logs, i);
+            size += jaeger_log_record_thrift_packed_size(log_record);
+        }
+    }
+    return size;
+}
+
+size_t jaeger_span_thrift_pack(const jaeger_span* span, uint8_t* out)
+{
+    assert(span != NULL);
+    assert(out != NULL);
+    uint8_t* const start = out;
+    int last_field = 0;
+    const jaeger_span_context* context = &span->context;
+    out = write_i64_field(
+        out, &last_field, span_trace_id_low_field, context->trace_id.low);
+    out = write_i64_field(
+        out, &last_field, span_trace_id_high_field, context->trace_id.high);
+    out = write_i64_field(
+        out, &last_field, span_span_id_field, context->span_id);
+    out = write_i64_field(
+        out, &last_field, span_parent_span_id_field, parent_span_id(span));
+    out = write_binary_field(out,
+                             &last_field,
+                             span_operation_name_field,
+                             span->operation_name,
+                             string_length(span->operation_name));
+    const int num_refs = jaeger_vector_length(&span->refs);
+    if (num_refs > 0) {
+        out = write_field_header(
+            out, &last_field, span_references_field, compact_type_list);
+        out = write_list_header(out, num_refs, compact_type_struct);
+        for (int i = 0; i < num_refs; i++) {
+            const jaeger_span_ref* span_ref =
+                jaeger_vector_offset((jaeger_vector*) &span->refs, i);
+            out += jaeger_span_ref_thrift_pack(span_ref, out);
+        }
+    }
+    out = write_i32_field(out, &last_field, span_flags_field, context->flags);
+    out = write_i64_field(
+        out,
+        &last_field,
+        span_start_time_field,
+        time_value_microseconds(&span->start_time_system.value));
+    out = write_i64_field(out,
+                          &last_field,
+                          span_duration_field,
+                          time_value_microseconds(&span->duration.value));
+    const int num_tags = jaeger_vector_length(&span->tags);
+    if (num_tags > 0) {
+        out = write_field_header(
+            out, &last_field, span_tags_field, compact_type_list);
+        out = write_list_header(out, num_tags, compact_type_struct);
+        for (int i = 0; i < num_tags; i++) {
+            const jaeger_tag* tag =
+                jaeger_vector_offset((jaeger_vector*) &span->tags, i);
+            out += jaeger_tag_thrift_pack(tag, out);
+        }
+    }
+    const int num_logs = jaeger_vector_length(&span->logs);
+    if (num_logs > 0) {
+        out = write_field_header(
+            out, &last_field, span_logs_field, compact_type_list);
+        out = write_list_header(out, num_logs, compact_type_struct);
+        for (int i = 0; i < num_logs; i++) {
+            const jaeger_log_record* log_record =
+                jaeger_vector_offset((jaeger_vector*) &span->logs, i);
+            out += jaeger_log_record_thrift_pack(log_record, out);
+        }
+    }
+    return write_stop(out) - start;
+}
+
+static inline size_t
+process_packed_size(const Jaeger__Model__Process* process)
+{
+    size_t size =
+        binary_field_size(string_length(process->service_name)) + STOP_SIZE;
+    if (process->n_tags > 0) {
+        size += FIELD_HEADER_SIZE + list_header_size(process->n_tags);
+        for (int i = 0; i < (int) process->n_tags; i++) {
+            size += jaeger_tag_thrift_packed_size(process->tags[i]);
+        }
+    }
+    return size;
+}
+
+static inline uint8_t* write_process(uint8_t* out,
+                                     const Jaeger__Model__Process* process)
+{
+    int last_field = 0;
+    out = write_binary_field(out,
+                             &last_field,
+                             process_service_name_field,
+                             process->service_name,
+                             string_length(process->service_name));
+    if (process->n_tags > 0) {
+        out = write_field_header(
+            out, &last_field, process_tags_field, compact_type_list);
+        out = write_list_header(out, process->n_tags, compact_type_struct);
+        for (int i = 0; i < (int) process->n_tags; i++) {
+            out += jaeger_tag_thrift_pack(process->tags[i], out);
+        }
+    }
+    return write_stop(out);
+}
+
+size_t
+jaeger_thrift_emit_batch_header_size(const Jaeger__Model__Process* process)
+{
+    assert(process != NULL);
+    /* Protocol id, version and type, sequence id zero, method name, then the
+     * Batch argument and process field headers. */
+    const size_t method_len = sizeof(emit_batch_method) - 1;
+    return 2 + 1 + jaeger_thrift_varint_size(method_len) + method_len +
+           2 * FIELD_HEADER_SIZE + process_packed_size(process);
+}
+
+size_t jaeger_thrift_pack_emit_batch_header(
+    const Jaeger__Model__Process* process, uint8_t* out)
+{
+    assert(process != NULL);
+    assert(out != NULL);
+    uint8_t* const start = out;
+    const size_t method_len = sizeof(emit_batch_method) - 1;
+    *out++ = COMPACT_PROTOCOL_ID;
+    *out++ = (uint8_t)(COMPACT_VERSION |
+                       (MESSAGE_TYPE_ONEWAY << COMPACT_MESSAGE_TYPE_SHIFT));
+    out = write_varint(out, 0);
+    out = write_varint(out, method_len);
+    memcpy(out, emit_batch_method, method_len);
+    out += method_len;
+
+    int last_field = 0;
+    out = write_field_header(
+        out, &last_field, emit_batch_batch_field, compact_type_struct);
+    last_field = 0;
+    out = write_field_header(
+        out, &last_field, batch_process_field, compact_type_struct);
+    return write_process(out, process) - start;
+}
+
+size_t jaeger_thrift_spans_header_size(size_t num_spans)
+{
+    return FIELD_HEADER_SIZE + list_header_size(num_spans);
+}
+
+size_t jaeger_thrift_pack_spans_header(size_t num_spans, uint8_t* out)
+{
+    assert(out != NULL);
+    uint8_t* const start = out;
+    int last_field = batch_process_field;
+    out = write_field_header(
+        out, &last_field, batch_spans_field, compact_type_list);
+    return write_list_header(out, num_spans, compact_type_struct) - start;
+}
+
+void jaeger_thrift_pack_padding_header(size_t padding_size, uint8_t* out)
+{
+    assert(out != NULL);
+    assert(padding_size >= JAEGERTRACINGC_THRIFT_PADDING_HEADER_SIZE);
+    const size_t len = padding_size - JAEGERTRACINGC_THRIFT_PADDING_HEADER_SIZE;
+    assert(len < (1u << 21));
+    int last_field = batch_spans_field;
+    out = write_field_header(out,
+                             &last_field,
+                             JAEGERTRACINGC_THRIFT_PADDING_FIELD,
+                             compact_type_binary);
+    /* Decoders accept varints with redundant continuation bytes. */
+    out[0] = (uint8_t)(len | 0x80);
+    out[1] = (uint8_t)((len >> 7) | 0x80);
+    out[2] = (uint8_t)((len >> 14) & 0x7f);
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2018 The Jaeger Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file
+ * @internal
+ * Streaming encoder for the Thrift compact protocol form of the jaeger.thrift
+ * model, as accepted by the emitBatch UDP port of jaeger-agent. Like the
+ * protobuf encoder, writes spans directly into a caller-supplied buffer.
+ *
+ * An emitBatch message is laid out as the header written by
+ * jaeger_thrift_pack_emit_batch_header, the spans list header, the encoded
+ * spans, optionally a padding field, and finally
+ * jaeger_thrift_emit_batch_trailer.
+ */
+
+#ifndef JAEGERTRACINGC_THRIFT_H
+#define JAEGERTRACINGC_THRIFT_H
+
+#include "jaegertracingc/common.h"
+#include "jaegertracingc/log_record.h"
+#include "jaegertracingc/span.h"
+#include "jaegertracingc/tag.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** Maximum size of the header written by jaeger_thrift_pack_spans_header. */
+#define JAEGERTRACINGC_THRIFT_MAX_SPANS_HEADER_SIZE 7
+
+/** Size of jaeger_thrift_emit_batch_trailer. */
+#define JAEGERTRACINGC_THRIFT_EMIT_BATCH_TRAILER_SIZE 2
+
+/**
+ * Field id not used by jaeger.thrift Batch. Decoders skip unknown fields, so
+ * it can carry padding to grow a packet to a given size.
+ */
+#define JAEGERTRACINGC_THRIFT_PADDING_FIELD 15
+/** Size of the header written by jaeger_thrift_pack_padding_header. */
+#define JAEGERTRACINGC_THRIFT_PADDING_HEADER_SIZE 4
+
+/**
+ * Ends the Batch struct and the emitBatch arguments. Has
+ * JAEGERTRACINGC_THRIFT_EMIT_BATCH_TRAILER_SIZE bytes.
+ */
+extern const uint8_t jaeger_thrift_emit_batch_trailer[];
+
+/**
+ * Number of bytes needed to encode a value as a varint.
+ * @param value Value to encode.
+ * @return Encoded size in bytes.
+ */
+size_t jaeger_thrift_varint_size(uint64_t value);
+
+/**
+ * Size of the emitBatch message header, which includes the encoded process.
+ * @param process Process of the batch.
+ * @return Encoded size in bytes.
+ */
+size_t
+jaeger_thrift_emit_batch_header_size(const Jaeger__Model__Process* process);
+
+/**
+ * Write the emitBatch message header: the oneway call, the Batch argument
+ * and the Batch process field. The Batch spans field must follow.
+ * @param process Process of the batch.
+ * @param out Output buffer, must have room for
+ *            jaeger_thrift_emit_batch_header_size(process) bytes.
+ * @return Number of bytes written.
+ */
+size_t jaeger_thrift_pack_emit_batch_header(
+    const Jaeger__Model__Process* process, uint8_t* out);
+
+/**
+ * Size of the Batch spans field header for a number of spans.
+ * @param num_spans Number of spans in the batch.
+ * @return Encoded size in bytes, at most
+ *         JAEGERTRACINGC_THRIFT_MAX_SPANS_HEADER_SIZE.
+ */
+size_t jaeger_thrift_spans_header_size(size_t num_spans);
+
+/**
+ * Write the Batch spans field header. The encoded spans must follow
+ * immediately after.
+ * @param num_spans Number of spans in the batch.
+ * @param out Output buffer, must have room for
+ *            jaeger_thrift_spans_header_size(num_spans) bytes.
+ * @return Number of bytes written.
+ */
+size_t jaeger_thrift_pack_spans_header(size_t num_spans, uint8_t* out);
+
+/**
+ * Write the header of a padding field. Must directly follow the spans, and
+ * the length is always encoded with three bytes so the header size does not
+ * depend on the padding size.
+ * @param padding_size Total size of the padding field including header. Must
+ *                     be at least JAEGERTRACINGC_THRIFT_PADDING_HEADER_SIZE
+ *                     and less than JAEGERTRACINGC_THRIFT_PADDING_HEADER_SIZE
+ *                     + 2^21.
+ * @param out Output buffer, must have room for
+ *            JAEGERTRACINGC_THRIFT_PADDING_HEADER_SIZE bytes. The header
+ *            must be followed by the remaining padding bytes, which may have
+ *            any value.
+ */
+void jaeger_thrift_pack_padding_header(size_t padding_size, uint8_t* out);
+
+/**
+ * Size of tag encoded as jaeger.thrift Tag.
+ * @param tag Tag to encode.
+ * @return Encoded size in bytes.
+ */
+size_t jaeger_tag_thrift_packed_size(const jaeger_tag* tag);
+
+/**
+ * Encode tag as jaeger.thrift Tag.
+ * @param tag Tag to encode.
+ * @param out Output buffer, must have room for
+ *            jaeger_tag_thrift_packed_size(tag) bytes.
+ * @return Number of bytes written.
+ */
+size_t jaeger_tag_thrift_pack(const jaeger_tag* tag, uint8_t* out);
+
+/**
+ * Size of log record encoded as jaeger.thrift Log.
+ * @param log_record Log record to encode.
+ * @return Encoded size in bytes.
+ */
+size_t jaeger_log_record_thrift_packed_size(
+    const jaeger_log_record* log_record);
+
+/**
+ * Encode log record as jaeger.thrift Log.
+ * @param log_record Log record to encode.
+ * @param out Output buffer, must have room for
+ *            jaeger_log_record_thrift_packed_size(log_record) bytes.
+ * @return Number of bytes written.
+ */
+size_t jaeger_log_record_thrift_pack(const jaeger_log_record* log_record,
+                                     uint8_t* out);
+
+/**
+ * Size of span ref encoded as jaeger.thrift SpanRef.
+ * @param span_ref Span ref to encode.
+ * @return Encoded size in bytes.
+ */
+size_t jaeger_span_ref_thrift_packed_size(const jaeger_span_ref* span_ref);
+
+/**
+ * Encode span ref as jaeger.thrift SpanRef.
+ * @param span_ref Span ref to encode.
+ * @param out Output buffer, must have room for
+ *            jaeger_span_ref_thrift_packed_size(span_ref) bytes.
+ * @return Number of bytes written.
+ */
+size_t jaeger_span_ref_thrift_pack(const jaeger_span_ref* span_ref,
+                                   uint8_t* out);
+
+/**
+ * Size of span encoded as jaeger.thrift Span. Caller must hold span mutex and
+ * span context mutex, and must not modify the span between this call and
+ * jaeger_span_thrift_pack.
+ * @param span Span to encode.
+ * @return Encoded size in bytes.
+ */
+size_t jaeger_span_thrift_packed_size(const jaeger_span* span);
+
+/**
+ * Encode span as jaeger.thrift Span. The parent span ID is taken from the
+ * first child-of reference. Caller must hold span mutex and span context
+ * mutex.
+ * @param span Span to encode.
+ * @param out Output buffer, must have room for
+ *            jaeger_span_thrift_packed_size(span) bytes.
+ * @return Number of bytes written.
+ */
+size_t jaeger_span_thrift_pack(const jaeger_span* span, uint8_t* out);
+
+#ifdef __cplusplus
+} /* extern C */
+#endif /* __cplusplus */
+
+#endif /* JAEGERTRACINGC_THRIFT_H */
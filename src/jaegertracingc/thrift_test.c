@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2018 The Jaeger Authors.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "jaegertracingc/thrift.h"
+#include "jaegertracingc/span.h"
+#include "unity.h"
+
+/* Minimal compact protocol reader, enough to walk the encoded structs. */
+typedef struct reader {
+    const uint8_t* pos;
+    const uint8_t* end;
+} reader;
+
+static uint64_t read_varint(reader* r)
+{
+    uint64_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        TEST_ASSERT_TRUE(r->pos < r->end);
+        const uint8_t byte = *r->pos++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+}
+
+static int64_t read_zigzag(reader* r)
+{
+    const uint64_t value = read_varint(r);
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static void skip_value(reader* r, int type);
+
+static void skip_struct(reader* r)
+{
+    while (true) {
+        TEST_ASSERT_TRUE(r->pos < r->end);
+        const uint8_t header = *r->pos++;
+        if (header == 0) {
+            return;
+        }
+        /* Encoder always writes field id deltas. */
+        TEST_ASSERT_NOT_EQUAL(0, header >> 4);
+        skip_value(r, header & 0x0f);
+    }
+}
+
+static int read_list_header(reader* r, int* element_type)
+{
+    TEST_ASSERT_TRUE(r->pos < r->end);
+    const uint8_t header = *r->pos++;
+    *element_type = header & 0x0f;
+    const int size = header >> 4;
+    return (size == 15) ? (int) read_varint(r) : size;
+}
+
+static void skip_value(reader* r, int type)
+{
+    switch (type) {
+    case 1:
+    case 2:
+        break;
+    case 5:
+    case 6:
+        read_varint(r);
+        break;
+    case 7:
+        TEST_ASSERT_TRUE(r->end - r->pos >= 8);
+        r->pos += 8;
+        break;
+    case 8: {
+        const uint64_t len = read_varint(r);
+        TEST_ASSERT_TRUE((uint64_t)(r->end - r->pos) >= len);
+        r->pos += len;
+    } break;
+    case 9: {
+        int element_type;
+        const int len = read_list_header(r, &element_type);
+        for (int i = 0; i < len; i++) {
+            skip_value(r, element_type);
+        }
+    } break;
+    case 12:
+        skip_struct(r);
+        break;
+    default:
+        TEST_FAIL_MESSAGE("Unexpected compact type");
+        break;
+    }
+}
+
+static void build_span(jaeger_span* span)
+{
+    *span = (jaeger_span) JAEGERTRACINGC_SPAN_INIT;
+    TEST_ASSERT_TRUE(jaeger_span_init(span));
+    span->context.trace_id = (jaeger_trace_id){.high = 1, .low = 2};
+    span->context.span_id = 3;
+    span->context.flags = jaeger_sampling_flag_sampled;
+    span->operation_name = jaeger_strdup("test-operation");
+    TEST_ASSERT_NOT_NULL(span->operation_name);
+    span->start_time_system.value.tv_sec = 1500000000;
+    span->start_time_system.value.tv_nsec = 123000;
+    span->duration.value.tv_sec = 2;
+    span->duration.value.tv_nsec = 456000;
+
+    const opentracing_value values[] = {
+        {.type = opentracing_value_string,
+         .value = {.string_value = "test-value"}},
+        {.type = opentracing_value_bool, .value = {.bool_value = true}},
+        {.type = opentracing_value_int64, .value = {.int64_value = -1}},
+        {.type = opentracing_value_double, .value = {.double_value = 0.5}}};
+    const char* keys[] = {"string", "bool", "int64", "double"};
+    for (int i = 0, len = sizeof(values) / sizeof(values[0]); i < len; i++) {
+        jaeger_span_set_tag_no_locking(span, keys[i], &values[i]);
+    }
+    TEST_ASSERT_EQUAL(4, jaeger_vector_length(&span->tags));
+
+    opentracing_log_field fields[] = {
+        {.key = "event",
+         .value = {.type = opentracing_value_string,
+                   .value = {.string_value = "test-event"}}}};
+    opentracing_log_record log_record = {
+        .fields = fields, .num_fields = sizeof(fields) / sizeof(fields[0])};
+    log_record.timestamp.value.tv_sec = 1500000001;
+    jaeger_span_log_no_locking(span, &log_record);
+    TEST_ASSERT_EQUAL(1, jaeger_vector_length(&span->logs));
+
+    const jaeger_span_ref_type ref_types[] = {
+        opentracing_span_reference_follows_from,
+        opentracing_span_reference_child_of};
+    for (int i = 0, len = sizeof(ref_types) / sizeof(ref_types[0]); i < len;
+         i++) {
+        jaeger_span_ref* span_ref = jaeger_vector_append(&span->refs);
+        TEST_ASSERT_NOT_NULL(span_ref);
+        TEST_ASSERT_TRUE(jaeger_span_ref_init(span_ref));
+        span_ref->context.trace_id = span->context.trace_id;
+        span_ref->context.span_id = 4 + i;
+        span_ref->type = ref_types[i];
+    }
+}
+
+static void test_framing()
+{
+    uint8_t buffer[JAEGERTRACINGC_THRIFT_MAX_SPANS_HEADER_SIZE];
+    TEST_ASSERT_EQUAL(2, jaeger_thrift_spans_header_size(1));
+    TEST_ASSERT_EQUAL(2, jaeger_thrift_pack_spans_header(1, buffer));
+    TEST_ASSERT_EQUAL(0x19, buffer[0]);
+    TEST_ASSERT_EQUAL(0x1c, buffer[1]);
+
+    TEST_ASSERT_EQUAL(3, jaeger_thrift_spans_header_size(100));
+    TEST_ASSERT_EQUAL(3, jaeger_thrift_pack_spans_header(100, buffer));
+    TEST_ASSERT_EQUAL(0x19, buffer[0]);
+    TEST_ASSERT_EQUAL(0xfc, buffer[1]);
+    reader r = {.pos = &buffer[2], .end = &buffer[3]};
+    TEST_ASSERT_EQUAL(100, read_varint(&r));
+
+    TEST_ASSERT_LESS_OR_EQUAL(JAEGERTRACINGC_THRIFT_MAX_SPANS_HEADER_SIZE,
+                              jaeger_thrift_spans_header_size(INT32_MAX));
+
+    /* Padding is a binary field skipped by decoders. */
+    uint8_t padding[JAEGERTRACINGC_THRIFT_PADDING_HEADER_SIZE + 100] = {0};
+    jaeger_thrift_pack_padding_header(sizeof(padding), padding);
+    TEST_ASSERT_EQUAL(
+        ((JAEGERTRACINGC_THRIFT_PADDING_FIELD - 2) << 4) | 8, padding[0]);
+    r = (reader){.pos = &padding[1], .end = &padding[sizeof(padding)]};
+    TEST_ASSERT_EQUAL(100, read_varint(&r));
+    TEST_ASSERT_EQUAL_PTR(&padding[JAEGERTRACINGC_THRIFT_PADDING_HEADER_SIZE],
+                          r.pos);
+
+    TEST_ASSERT_EQUAL(0, jaeger_thrift_emit_batch_trailer[0]);
+    TEST_ASSERT_EQUAL(0, jaeger_thrift_emit_batch_trailer[1]);
+}
+
+static void test_emit_batch_header()
+{
+    Jaeger__Model__KeyValue tag = JAEGER__MODEL__KEY_VALUE__INIT;
+    tag.key = "hostname";
+    tag.v_type = JAEGER__MODEL__VALUE_TYPE__STRING;
+    tag.v_str = "localhost";
+    Jaeger__Model__KeyValue* tags[] = {&tag};
+    Jaeger__Model__Process process = JAEGER__MODEL__PROCESS__INIT;
+    process.service_name = "test-service";
+    process.tags = tags;
+    process.n_tags = 1;
+
+    const size_t size = jaeger_thrift_emit_batch_header_size(&process);
+    uint8_t* buffer = jaeger_malloc(size);
+    TEST_ASSERT_NOT_NULL(buffer);
+    TEST_ASSERT_EQUAL(size,
+                      jaeger_thrift_pack_emit_batch_header(&process, buffer));
+
+    const uint8_t message_header[] = {
+        0x82, 0x81, 0, 9, 'e', 'm', 'i', 't', 'B', 'a', 't', 'c', 'h'};
+    TEST_ASSERT_EQUAL_MEMORY(message_header, buffer, sizeof(message_header));
+    reader r = {.pos = &buffer[sizeof(message_header)], .end = &buffer[size]};
+    /* Batch argument, then Batch.process. */
+    TEST_ASSERT_EQUAL(0x1c, *r.pos++);
+    TEST_ASSERT_EQUAL(0x1c, *r.pos++);
+    TEST_ASSERT_EQUAL(0x18, *r.pos++);
+    TEST_ASSERT_EQUAL(strlen(process.service_name), read_varint(&r));
+    TEST_ASSERT_EQUAL_MEMORY(
+        process.service_name, r.pos, strlen(process.service_name));
+    r.pos += strlen(process.service_name);
+    TEST_ASSERT_EQUAL(0x19, *r.pos++);
+    int element_type;
+    TEST_ASSERT_EQUAL(1, read_list_header(&r, &element_type));
+    TEST_ASSERT_EQUAL(12, element_type);
+    skip_struct(&r);
+    TEST_ASSERT_EQUAL(0, *r.pos++);
+    TEST_ASSERT_EQUAL_PTR(r.end, r.pos);
+    jaeger_free(buffer);
+}
+
+void test_thrift()
+{
+    TEST_ASSERT_EQUAL(1, jaeger_thrift_varint_size(0));
+    TEST_ASSERT_EQUAL(1, jaeger_thrift_varint_size(127));
+    TEST_ASSERT_EQUAL(2, jaeger_thrift_varint_size(128));
+    TEST_ASSERT_EQUAL(10, jaeger_thrift_varint_size(UINT64_MAX));
+
+    test_framing();
+    test_emit_batch_header();
+
+    jaeger_span span;
+    build_span(&span);
+
+    const size_t size = jaeger_span_thrift_packed_size(&span);
+    uint8_t* buffer = jaeger_malloc(size);
+    TEST_ASSERT_NOT_NULL(buffer);
+    TEST_ASSERT_EQUAL(size, jaeger_span_thrift_pack(&span, buffer));
+
+    /* Walk the top-level fields of the span. */
+    reader r = {.pos = buffer, .end = &buffer[size]};
+    int64_t values[12] = {0};
+    int list_sizes[12] = {0};
+    int field = 0;
+    while (true) {
+        TEST_ASSERT_TRUE(r.pos < r.end);
+        const uint8_t header = *r.pos++;
+        if (header == 0) {
+            break;
+        }
+        field += header >> 4;
+        TEST_ASSERT_LESS_THAN(12, field);
+        const int type = header & 0x0f;
+        if (type == 5 || type == 6) {
+            values[field] = read_zigzag(&r);
+        }
+        else if (type == 8) {
+            const int len = read_varint(&r);
+            TEST_ASSERT_EQUAL_MEMORY(span.operation_name, r.pos, len);
+            TEST_ASSERT_EQUAL(strlen(span.operation_name), len);
+            r.pos += len;
+        }
+        else {
+            TEST_ASSERT_EQUAL(9, type);
+            int element_type;
+            list_sizes[field] = read_list_header(&r, &element_type);
+            TEST_ASSERT_EQUAL(12, element_type);
+            for (int i = 0; i < list_sizes[field]; i++) {
+                skip_struct(&r);
+            }
+        }
+    }
+    TEST_ASSERT_EQUAL_PTR(r.end, r.pos);
+    TEST_ASSERT_EQUAL(span.context.trace_id.low, values[1]);
+    TEST_ASSERT_EQUAL(span.context.trace_id.high, values[2]);
+    TEST_ASSERT_EQUAL(span.context.span_id, values[3]);
+    /* Parent is the child-of reference, not the first reference. */
+    TEST_ASSERT_EQUAL(5, values[4]);
+    TEST_ASSERT_EQUAL(2, list_sizes[6]);
+    TEST_ASSERT_EQUAL(span.context.flags, values[7]);
+    TEST_ASSERT_EQUAL(1500000000000123LL, values[8]);
+    TEST_ASSERT_EQUAL(2000456, values[9]);
+    TEST_ASSERT_EQUAL(jaeger_vector_length(&span.tags), list_sizes[10]);
+    TEST_ASSERT_EQUAL(jaeger_vector_length(&span.logs), list_sizes[11]);
+
+    /* Tags encode their values in the field matching their type. */
+    for (int i = 0, len = jaeger_vector_length(&span.tags); i < len; i++) {
+        const jaeger_tag* tag = jaeger_vector_offset(&span.tags, i);
+        const size_t tag_size = jaeger_tag_thrift_packed_size(tag);
+        TEST_ASSERT_EQUAL(tag_size, jaeger_tag_thrift_pack(tag, buffer));
+        r = (reader){.pos = buffer, .end = &buffer[tag_size]};
+        skip_struct(&r);
+        TEST_ASSERT_EQUAL_PTR(r.end, r.pos);
+    }
+    const jaeger_tag* bool_tag = jaeger_vector_offset(&span.tags, 1);
+    jaeger_tag_thrift_pack(bool_tag, buffer);
+    /* Key, type, then bool field with value in the type nibble. */
+    TEST_ASSERT_EQUAL(0x18, buffer[0]);
+    TEST_ASSERT_EQUAL(0x15, buffer[2 + strlen(bool_tag->key)]);
+    TEST_ASSERT_EQUAL(0x31, buffer[4 + strlen(bool_tag->key)]);
+
+    jaeger_free(buffer);
+    jaeger_span_destroy((jaeger_destructible*) &span);
+}
@@ -16,38 +16,168 @@
 
 #include "jaegertracingc/token_bucket.h"
 
-void jaeger_token_bucket_init(jaeger_token_bucket* tok,
+/* Bounds the bucket's capacity so that timestamps minus the capacity never
+ * overflow. Low rates are rounded up to fit, a rate of zero credits per second
+ * refills a full bucket in a few decades. */
+#define MAX_NANOS (INT64_MAX / 4)
+
+static inline int64_t now_nanos(bool coarse_clock)
+{
+    struct timespec t;
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(coarse_clock ? CLOCK_MONOTONIC_COARSE : CLOCK_MONOTONIC, &t);
+#else
+    (void) coarse_clock;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+#endif /* CLOCK_MONOTONIC_COARSE */
+    return (int64_t) t.tv_sec * JAEGERTRACINGC_NANOSECONDS_PER_SECOND +
+           t.tv_nsec;
+}
+
+static inline int64_t load_nanos(const int64_t* nanos)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    return __atomic_load_n(nanos, __ATOMIC_RELAXED);
+#else
+    return *nanos;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+static inline void store_nanos(int64_t* nanos, int64_t value)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    __atomic_store_n(nanos, value, __ATOMIC_RELAXED);
+#else
+    *nanos = value;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+/* Replaces *empty_time with new_empty_time unless another thread changed it
+ * from *old_empty_time, in which case *old_empty_time is set to the current
+ * value. */
+static inline bool swap_empty_time(jaeger_token_bucket* tok,
+                                   int64_t* old_empty_time,
+                                   int64_t new_empty_time)
+{
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    return __atomic_compare_exchange_n(&tok->empty_time,
+                                       old_empty_time,
+                                       new_empty_time,
+                                       false,
+                                       __ATOMIC_RELAXED,
+                                       __ATOMIC_RELAXED);
+#else
+    (void) old_empty_time;
+    tok->empty_time = new_empty_time;
+    return true;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+/* Converts credits to nanoseconds, exactly for whole numbers of credits. The
+ * result must not exceed 2 * MAX_NANOS. */
+static inline int64_t credits_to_nanos(double credits, int64_t credit_nanos)
+{
+    const int64_t whole_credits = (int64_t) credits;
+    return whole_credits * credit_nanos +
+           (int64_t)((credits - whole_credits) * credit_nanos);
+}
+
+static inline void store_rate(jaeger_token_bucket* tok,
                               double credits_per_second,
                               double max_balance)
+{
+    max_balance = JAEGERTRACINGC_CLAMP(max_balance, 0, MAX_NANOS);
+    const int64_t max_credit_nanos = MAX_NANOS / ((int64_t) max_balance + 1);
+    const int64_t credit_nanos =
+        (credits_per_second > 0)
+            ? (int64_t) JAEGERTRACINGC_CLAMP(
+                  JAEGERTRACINGC_NANOSECONDS_PER_SECOND / credits_per_second,
+                  1,
+                  max_credit_nanos)
+            : max_credit_nanos;
+    store_nanos(&tok->credit_nanos, credit_nanos);
+    store_nanos(&tok->capacity_nanos,
+                JAEGERTRACINGC_MIN(credits_to_nanos(max_balance, credit_nanos),
+                                   MAX_NANOS));
+}
+
+void jaeger_token_bucket_init(jaeger_token_bucket* tok,
+                              double credits_per_second,
+                              double max_balance,
+                              bool coarse_clock)
 {
     assert(tok != NULL);
-    tok->balance = max_balance;
-    tok->credits_per_second = credits_per_second;
-    tok->max_balance = max_balance;
-    jaeger_duration_now(&tok->last_tick);
+    tok->coarse_clock = coarse_clock;
+#ifndef JAEGERTRACINGC_HAVE_ATOMICS
+    tok->mutex = (jaeger_mutex) JAEGERTRACINGC_MUTEX_INIT;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+    store_rate(tok, credits_per_second, max_balance);
+    tok->empty_time = now_nanos(coarse_clock) - tok->capacity_nanos;
 }
 
-bool jaeger_token_bucket_check_credit(jaeger_token_bucket* tok, double cost)
+void jaeger_token_bucket_destroy(jaeger_token_bucket* tok)
+{
+    if (tok == NULL) {
+        return;
+    }
+#ifndef JAEGERTRACINGC_HAVE_ATOMICS
+    jaeger_mutex_destroy(&tok->mutex);
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+void jaeger_token_bucket_update(jaeger_token_bucket* tok,
+                                double credits_per_second,
+                                double max_balance)
 {
     assert(tok != NULL);
-    jaeger_duration current_time;
-    jaeger_duration_now(&current_time);
-    jaeger_duration interval;
-    const bool result = jaeger_time_subtract(
-        current_time.value, tok->last_tick.value, &interval.value);
-    (void) result;
-    assert(result);
-    const double diff = (((double) interval.value.tv_nsec) /
-                             JAEGERTRACINGC_NANOSECONDS_PER_SECOND +
-                         interval.value.tv_sec) *
-                        tok->credits_per_second;
-    const double new_balance = tok->balance + diff;
-    tok->balance =
-        (tok->max_balance < new_balance) ? tok->max_balance : new_balance;
-    tok->last_tick = current_time;
-    if (tok->balance < cost) {
-        return 0;
+#ifndef JAEGERTRACINGC_HAVE_ATOMICS
+    jaeger_mutex_lock(&tok->mutex);
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+    store_rate(tok, credits_per_second, max_balance);
+    store_nanos(&tok->empty_time,
+                now_nanos(tok->coarse_clock) -
+                    load_nanos(&tok->capacity_nanos));
+#ifndef JAEGERTRACINGC_HAVE_ATOMICS
+    jaeger_mutex_unlock(&tok->mutex);
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
+}
+
+static inline bool check_credit(jaeger_token_bucket* tok, double cost)
+{
+    const int64_t credit_nanos = load_nanos(&tok->credit_nanos);
+    const int64_t capacity_nanos = load_nanos(&tok->capacity_nanos);
+    /* Avoids overflowing the cost, the capacity is at most MAX_NANOS. */
+    if (cost * credit_nanos > 2.0 * MAX_NANOS) {
+        return false;
+    }
+    const int64_t cost_nanos = credits_to_nanos(cost, credit_nanos);
+    if (cost_nanos > capacity_nanos) {
+        return false;
     }
-    tok->balance -= cost;
-    return 1;
+    const int64_t now = now_nanos(tok->coarse_clock);
+    int64_t empty_time = load_nanos(&tok->empty_time);
+    while (true) {
+        /* Credits earned beyond the capacity are lost. */
+        const int64_t start =
+            JAEGERTRACINGC_MAX(empty_time, now - capacity_nanos);
+        if (now - start < cost_nanos) {
+            return false;
+        }
+        if (swap_empty_time(tok, &empty_time, start + cost_nanos)) {
+            return true;
+        }
+    }
+}
+
+bool jaeger_token_bucket_check_credit(jaeger_token_bucket* tok, double cost)
+{
+    assert(tok != NULL);
+#ifdef JAEGERTRACINGC_HAVE_ATOMICS
+    return check_credit(tok, cost);
+#else
+    jaeger_mutex_lock(&tok->mutex);
+    const bool result = check_credit(tok, cost);
+    jaeger_mutex_unlock(&tok->mutex);
+    return result;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
 }
@@ -25,21 +25,59 @@
 
 #include "jaegertracingc/clock.h"
 #include "jaegertracingc/common.h"
+#include "jaegertracingc/threading.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
 
+/**
+ * Token bucket that keeps its balance as a timestamp, so that checking credit
+ * is a single compare-and-swap on an integer. May be shared between threads.
+ * Without atomics, the bucket is guarded by a mutex instead.
+ */
 typedef struct jaeger_token_bucket {
-    double credits_per_second;
-    double max_balance;
-    double balance;
-    jaeger_duration last_tick;
+    /** Nanoseconds it takes to earn one credit. */
+    int64_t credit_nanos;
+    /** Nanoseconds it takes to fill an empty bucket. */
+    int64_t capacity_nanos;
+    /**
+     * Time at which the balance was zero, in nanoseconds of the bucket's
+     * monotonic clock. The balance at time t is
+     * min(t - empty_time, capacity_nanos) / credit_nanos.
+     */
+    int64_t empty_time;
+    /** Whether to read the cheaper, millisecond resolution coarse clock. */
+    bool coarse_clock;
+#ifndef JAEGERTRACINGC_HAVE_ATOMICS
+    jaeger_mutex mutex;
+#endif /* JAEGERTRACINGC_HAVE_ATOMICS */
 } jaeger_token_bucket;
 
+/**
+ * Initializes a full token bucket.
+ * @param tok Token bucket to initialize.
+ * @param credits_per_second Rate at which credits are earned.
+ * @param max_balance Maximum number of credits the bucket holds.
+ * @param coarse_clock Whether to use a coarse clock if the platform has one.
+ * Coarse clocks are cheaper to read, but only advance every few milliseconds,
+ * which is precise enough for rates of up to a few hundred credits per second.
+ */
 void jaeger_token_bucket_init(jaeger_token_bucket* tok,
                               double credits_per_second,
-                              double max_balance);
+                              double max_balance,
+                              bool coarse_clock);
+
+void jaeger_token_bucket_destroy(jaeger_token_bucket* tok);
+
+/**
+ * Changes the rate and maximum balance of a token bucket, refilling it.
+ * May be called while other threads check credit, which briefly may see the
+ * old rate with the new maximum balance.
+ */
+void jaeger_token_bucket_update(jaeger_token_bucket* tok,
+                                double credits_per_second,
+                                double max_balance);
 
 bool jaeger_token_bucket_check_credit(jaeger_token_bucket* tok, double cost);
 
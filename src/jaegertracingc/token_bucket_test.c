@@ -17,17 +17,37 @@
 #include <time.h>
 #include "jaegertracingc/alloc.h"
 #include "jaegertracingc/clock.h"
+#include "jaegertracingc/threading.h"
 #include "jaegertracingc/token_bucket.h"
 #include "unity.h"
 
 #define NS_PER_S JAEGERTRACINGC_NANOSECONDS_PER_SECOND
+#define NUM_THREADS 4
+#define NUM_CHECKS_PER_THREAD 1000
+
+typedef struct check_credit_arg {
+    jaeger_token_bucket* tok;
+    int num_credits;
+} check_credit_arg;
+
+static void* check_credit(void* arg)
+{
+    TEST_ASSERT_NOT_NULL(arg);
+    check_credit_arg* checker = (check_credit_arg*) arg;
+    for (int i = 0; i < NUM_CHECKS_PER_THREAD; i++) {
+        if (jaeger_token_bucket_check_credit(checker->tok, 1)) {
+            checker->num_credits++;
+        }
+    }
+    return NULL;
+}
 
 void test_token_bucket()
 {
     const double credits_per_second = 10;
     const double max_balance = 3;
     jaeger_token_bucket tok;
-    jaeger_token_bucket_init(&tok, credits_per_second, max_balance);
+    jaeger_token_bucket_init(&tok, credits_per_second, max_balance, false);
     bool result = jaeger_token_bucket_check_credit(&tok, max_balance);
     TEST_ASSERT_TRUE(result);
     struct timespec sleep_time = {.tv_sec = 0, .tv_nsec = NS_PER_S * 0.01};
@@ -46,4 +66,42 @@ void test_token_bucket()
     TEST_ASSERT_TRUE(result);
     result = jaeger_token_bucket_check_credit(&tok, expected_credits);
     TEST_ASSERT_FALSE(result);
+    TEST_ASSERT_FALSE(jaeger_token_bucket_check_credit(&tok, max_balance + 1));
+
+    /* Updating refills the bucket. A rate of zero never refills it again. */
+    jaeger_token_bucket_update(&tok, 0, max_balance);
+    TEST_ASSERT_TRUE(jaeger_token_bucket_check_credit(&tok, max_balance));
+    TEST_ASSERT_FALSE(jaeger_token_bucket_check_credit(&tok, 1));
+    jaeger_token_bucket_destroy(&tok);
+
+    jaeger_token_bucket_init(&tok, 0, 1, true);
+    TEST_ASSERT_TRUE(jaeger_token_bucket_check_credit(&tok, 1));
+    TEST_ASSERT_FALSE(jaeger_token_bucket_check_credit(&tok, 1));
+    jaeger_token_bucket_destroy(&tok);
+
+    /* Concurrent checks must not spend any credit twice. */
+    const int num_credits = NUM_THREADS * NUM_CHECKS_PER_THREAD / 2;
+    jaeger_token_bucket_init(&tok, 0, num_credits, true);
+#ifdef JAEGERTRACINGC_MT
+    jaeger_thread threads[NUM_THREADS];
+    check_credit_arg args[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; i++) {
+        args[i] = (check_credit_arg){.tok = &tok, .num_credits = 0};
+        TEST_ASSERT_EQUAL(
+            0, jaeger_thread_init(&threads[i], &check_credit, &args[i]));
+    }
+    int total_credits = 0;
+    for (int i = 0; i < NUM_THREADS; i++) {
+        jaeger_thread_join(threads[i], NULL);
+        total_credits += args[i].num_credits;
+    }
+#else
+    check_credit_arg arg = {.tok = &tok, .num_credits = 0};
+    for (int i = 0; i < NUM_THREADS; i++) {
+        check_credit(&arg);
+    }
+    const int total_credits = arg.num_credits;
+#endif /* JAEGERTRACINGC_MT */
+    TEST_ASSERT_EQUAL(num_credits, total_credits);
+    jaeger_token_bucket_destroy(&tok);
 }
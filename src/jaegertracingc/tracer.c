@@ -36,6 +36,9 @@
 
 #define SAMPLING_PRIORITY_TAG_KEY "sampling.priority"
 
+/* Samplers describe their decision with a type and a parameter tag. */
+#define SAMPLER_INLINE_TAGS 2
+
 static inline char* hostname()
 {
     char hostname[HOST_NAME_MAX_LEN] = {'\0'};
@@ -173,7 +176,7 @@ static inline jaeger_sampler* default_sampler(const char* service_name,
         return NULL;
     }
     if (!jaeger_remotely_controlled_sampler_init(
-            remote_sampler, service_name, NULL, NULL, 0, metrics)) {
+            remote_sampler, service_name, NULL, NULL, 0, metrics, NULL)) {
         jaeger_log_error("Cannot initialize default sampler");
         jaeger_free(remote_sampler);
         return NULL;
@@ -189,7 +192,7 @@ static inline jaeger_reporter* default_reporter(jaeger_metrics* metrics)
         jaeger_log_error("Cannot allocate default reporter");
         return NULL;
     }
-    if (!jaeger_remote_reporter_init(reporter, NULL, 0, metrics)) {
+    if (!jaeger_remote_reporter_init(reporter, NULL, 0, metrics, NULL)) {
         jaeger_log_error("Cannot initialize default reporter");
         jaeger_free(reporter);
         return NULL;
@@ -197,6 +200,220 @@ static inline jaeger_reporter* default_reporter(jaeger_metrics* metrics)
     return (jaeger_reporter*) reporter;
 }
 
+#if defined(JAEGERTRACINGC_MT) && defined(JAEGERTRACINGC_HAVE_ATOMICS)
+#define HAVE_SPAN_POOL
+#endif /* JAEGERTRACINGC_MT && JAEGERTRACINGC_HAVE_ATOMICS */
+
+#ifdef HAVE_SPAN_POOL
+
+/* Finished spans kept by one application thread. Only that thread touches
+ * the spans, so taking and returning them needs no lock. */
+typedef struct jaeger_span_cache {
+    /* Thread local value, destroyed when the thread exits. */
+    jaeger_destructible base;
+    /* Array of jaeger_span pointers. */
+    jaeger_vector spans;
+    /* Array of jaeger_noop_span pointers. */
+    jaeger_vector noop_spans;
+    jaeger_tracer* tracer;
+    jaeger_thread owner;
+    /* Next cache in the list of all caches. */
+    struct jaeger_span_cache* next;
+} span_cache;
+
+/* Caches of all tracers. A thread may exit while its tracer is being
+ * destroyed, so the lock deciding which of the two frees the cache cannot
+ * live in the tracer. */
+static span_cache* span_caches = NULL;
+static jaeger_mutex span_cache_mutex = JAEGERTRACINGC_MUTEX_INIT;
+
+static void span_cache_free_spans(span_cache* cache)
+{
+    for (int i = 0, len = jaeger_vector_length(&cache->spans); i < len; i++) {
+        jaeger_span* span =
+            *(jaeger_span**) jaeger_vector_offset(&cache->spans, i);
+        jaeger_span_destroy((jaeger_destructible*) span);
+        jaeger_free(span);
+    }
+    jaeger_vector_destroy(&cache->spans);
+    for (int i = 0, len = jaeger_vector_length(&cache->noop_spans); i < len;
+         i++) {
+        jaeger_noop_span* span =
+            *(jaeger_noop_span**) jaeger_vector_offset(&cache->noop_spans, i);
+        jaeger_noop_span_destroy((jaeger_destructible*) span);
+        jaeger_free(span);
+    }
+    jaeger_vector_destroy(&cache->noop_spans);
+}
+
+static void span_cache_orphan(jaeger_destructible* destructible)
+{
+    span_cache* cache = (span_cache*) destructible;
+    const jaeger_thread self = jaeger_thread_self();
+    jaeger_mutex_lock(&span_cache_mutex);
+    /* If the tracer destroyed the cache first, it is no longer listed and
+     * its address may even belong to another thread's cache by now. */
+    span_cache** link = &span_caches;
+    while (*link != NULL &&
+           !(*link == cache && jaeger_thread_equal(cache->owner, self))) {
+        link = &(*link)->next;
+    }
+    if (*link != NULL) {
+        *link = cache->next;
+        __atomic_sub_fetch(&cache->tracer->num_pooled_spans,
+                           jaeger_vector_length(&cache->spans) +
+                               jaeger_vector_length(&cache->noop_spans),
+                           __ATOMIC_RELAXED);
+        span_cache_free_spans(cache);
+        jaeger_free(cache);
+    }
+    jaeger_mutex_unlock(&span_cache_mutex);
+}
+
+/* Returns the span cache of the calling thread, creating it on first use. */
+static span_cache* tracer_thread_span_cache(jaeger_tracer* tracer)
+{
+    span_cache* cache =
+        (span_cache*) jaeger_thread_local_get_value(&tracer->span_cache_key);
+    if (cache != NULL) {
+        return cache;
+    }
+    cache = jaeger_malloc(sizeof(span_cache));
+    if (cache == NULL) {
+        jaeger_log_error("Cannot allocate span cache");
+        return NULL;
+    }
+    cache->base.destroy = &span_cache_orphan;
+    cache->tracer = tracer;
+    cache->owner = jaeger_thread_self();
+    if (!jaeger_vector_init(&cache->spans, sizeof(jaeger_span*))) {
+        jaeger_free(cache);
+        return NULL;
+    }
+    if (!jaeger_vector_init(&cache->noop_spans, sizeof(jaeger_noop_span*))) {
+        jaeger_vector_destroy(&cache->spans);
+        jaeger_free(cache);
+        return NULL;
+    }
+    if (!jaeger_thread_local_set_value(&tracer->span_cache_key,
+                                       (jaeger_destructible*) cache)) {
+        jaeger_vector_destroy(&cache->spans);
+        jaeger_vector_destroy(&cache->noop_spans);
+        jaeger_free(cache);
+        return NULL;
+    }
+
+    jaeger_mutex_lock(&span_cache_mutex);
+    cache->next = span_caches;
+    span_caches = cache;
+    jaeger_mutex_unlock(&span_cache_mutex);
+    return cache;
+}
+
+/* Takes a span from the calling thread's cache, or returns NULL if it is
+ * empty. Noop spans are kept in a list of their own. */
+static void* tracer_take_pooled_span(jaeger_tracer* tracer, bool noop)
+{
+    span_cache* cache = tracer_thread_span_cache(tracer);
+    if (cache == NULL) {
+        return NULL;
+    }
+    jaeger_vector* spans = noop ? &cache->noop_spans : &cache->spans;
+    if (jaeger_vector_length(spans) == 0) {
+        return NULL;
+    }
+    void* span =
+        *(void**) jaeger_vector_offset(spans, jaeger_vector_length(spans) - 1);
+    spans->len--;
+    __atomic_sub_fetch(&tracer->num_pooled_spans, 1, __ATOMIC_RELAXED);
+    return span;
+}
+
+/* Resets a finished span and adds it to the calling thread's cache. Returns
+ * false if the pool is full, in which case the caller keeps the span. */
+static bool tracer_pool_span(jaeger_tracer* tracer, void* span, bool noop)
+{
+    span_cache* cache = tracer_thread_span_cache(tracer);
+    if (cache == NULL) {
+        return false;
+    }
+    if (__atomic_add_fetch(&tracer->num_pooled_spans, 1, __ATOMIC_RELAXED) >
+        tracer->options.span_pool_size) {
+        __atomic_sub_fetch(&tracer->num_pooled_spans, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    void** span_ptr =
+        jaeger_vector_append(noop ? &cache->noop_spans : &cache->spans);
+    if (span_ptr == NULL) {
+        __atomic_sub_fetch(&tracer->num_pooled_spans, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    if (noop) {
+        jaeger_noop_span_reset((jaeger_noop_span*) span);
+    }
+    else {
+        jaeger_span_reset((jaeger_span*) span);
+    }
+    *span_ptr = span;
+    return true;
+}
+
+/* Counts a pool hit or miss depending on whether a span was taken. */
+static void tracer_count_pooled_span(jaeger_tracer* tracer, const void* span)
+{
+    jaeger_counter* counter = (span != NULL)
+                                  ? tracer->metrics->span_pool_hits
+                                  : tracer->metrics->span_pool_misses;
+    counter->inc(counter, 1);
+}
+
+#endif /* HAVE_SPAN_POOL */
+
+/* Returns an initialized span, reusing a pooled one when possible. */
+static jaeger_span* tracer_acquire_span(jaeger_tracer* tracer)
+{
+#ifdef HAVE_SPAN_POOL
+    if (tracer->pool_spans) {
+        jaeger_span* span = tracer_take_pooled_span(tracer, false);
+        tracer_count_pooled_span(tracer, span);
+        if (span != NULL) {
+            return span;
+        }
+    }
+#endif /* HAVE_SPAN_POOL */
+
+    jaeger_span* span = jaeger_malloc(sizeof(jaeger_span));
+    if (span == NULL) {
+        return NULL;
+    }
+    if (!jaeger_span_init(span)) {
+        jaeger_free(span);
+        return NULL;
+    }
+    return span;
+}
+
+/* Returns an initialized noop span, reusing a pooled one when possible. */
+static jaeger_noop_span* tracer_acquire_noop_span(jaeger_tracer* tracer)
+{
+#ifdef HAVE_SPAN_POOL
+    if (tracer->pool_spans) {
+        jaeger_noop_span* span = tracer_take_pooled_span(tracer, true);
+        tracer_count_pooled_span(tracer, span);
+        if (span != NULL) {
+            return span;
+        }
+    }
+#endif /* HAVE_SPAN_POOL */
+
+    jaeger_noop_span* span = jaeger_malloc(sizeof(jaeger_noop_span));
+    if (span == NULL) {
+        return NULL;
+    }
+    jaeger_noop_span_init(span);
+    return span;
+}
+
 opentracing_span* jaeger_tracer_start_span(opentracing_tracer* tracer,
                                            const char* operation_name)
 {
@@ -216,6 +433,32 @@ void jaeger_tracer_destroy(jaeger_destructible* d)
 
     jaeger_tracer* tracer = (jaeger_tracer*) d;
     ((opentracing_tracer*) tracer)->close(((opentracing_tracer*) tracer));
+#ifdef HAVE_SPAN_POOL
+    if (tracer->pool_spans) {
+        /* Threads that have not exited still point at their cache, but
+         * deleting the key means it is never destroyed on their exit. */
+        jaeger_thread_local_destroy(&tracer->span_cache_key);
+        tracer->pool_spans = false;
+
+        /* A thread exiting concurrently waits for this and then finds its
+         * cache gone, or has already freed it. */
+        jaeger_mutex_lock(&span_cache_mutex);
+        span_cache** link = &span_caches;
+        while (*link != NULL) {
+            span_cache* cache = *link;
+            if (cache->tracer == tracer) {
+                *link = cache->next;
+                span_cache_free_spans(cache);
+                jaeger_free(cache);
+                continue;
+            }
+            link = &cache->next;
+        }
+        jaeger_mutex_unlock(&span_cache_mutex);
+    }
+    tracer->num_pooled_spans = 0;
+#endif /* HAVE_SPAN_POOL */
+
     if (tracer->service_name != NULL) {
         jaeger_free(tracer->service_name);
         tracer->service_name = NULL;
@@ -310,6 +553,15 @@ bool jaeger_tracer_init(jaeger_tracer* tracer,
         tracer->options = *options;
     }
 
+#ifdef HAVE_SPAN_POOL
+    if (tracer->options.span_pool_size > 0) {
+        if (!jaeger_thread_local_init(&tracer->span_cache_key)) {
+            goto cleanup;
+        }
+        tracer->pool_spans = true;
+    }
+#endif /* HAVE_SPAN_POOL */
+
     if (headers != NULL) {
         tracer->headers = *headers;
     }
@@ -349,104 +601,150 @@ cleanup:
     return false;
 }
 
-static inline bool
-span_inherit_from_parent(jaeger_tracer* tracer,
-                         jaeger_span* span,
-                         const opentracing_span_reference* span_refs,
-                         int num_span_refs,
-                         bool* has_parent)
+/* Whether a referenced context is kept by a new span. It must identify a
+ * span, or at least carry a debug ID or baggage. */
+static inline bool span_ref_is_usable(const jaeger_span_context* ctx)
 {
-    assert(tracer != NULL);
-    assert(span != NULL);
-    assert(span_refs != NULL);
-    const jaeger_span_context* parent = NULL;
+    jaeger_mutex_lock((jaeger_mutex*) &ctx->mutex);
+    const int num_baggage_items = jaeger_span_context_baggage(ctx)->size;
+    jaeger_mutex_unlock((jaeger_mutex*) &ctx->mutex);
+    return jaeger_span_context_is_valid(ctx) ||
+           jaeger_span_context_is_debug_id_container_only(ctx) ||
+           num_baggage_items > 0;
+}
+
+/* Returns the first usable referenced context, or NULL if there is none.
+ * has_parent is set if the new span is a child of that context. */
+static inline const jaeger_span_context*
+span_find_parent(const opentracing_span_reference* span_refs,
+                 int num_span_refs,
+                 bool* has_parent)
+{
+    assert(span_refs != NULL || num_span_refs == 0);
     *has_parent = false;
     for (int i = 0; i < num_span_refs; i++) {
         const opentracing_span_reference* span_ref = &span_refs[i];
         const jaeger_span_context* ctx =
             (const jaeger_span_context*) span_ref->referenced_context;
-        jaeger_mutex_lock((jaeger_mutex*) &ctx->mutex);
-        const int num_baggage_items = ctx->baggage.size;
-        jaeger_mutex_unlock((jaeger_mutex*) &ctx->mutex);
-        if (!jaeger_span_context_is_valid(ctx) &&
-            !jaeger_span_context_is_debug_id_container_only(ctx) &&
-            num_baggage_items == 0) {
+        if (!span_ref_is_usable(ctx)) {
+            continue;
+        }
+        *has_parent =
+            (span_ref->type == opentracing_span_reference_child_of) ||
+            jaeger_span_context_is_valid(ctx);
+        return ctx;
+    }
+    return NULL;
+}
+
+static inline bool span_copy_refs(jaeger_span* span,
+                                  const opentracing_span_reference* span_refs,
+                                  int num_span_refs)
+{
+    assert(span != NULL);
+    assert(span_refs != NULL || num_span_refs == 0);
+    for (int i = 0; i < num_span_refs; i++) {
+        const opentracing_span_reference* span_ref = &span_refs[i];
+        const jaeger_span_context* ctx =
+            (const jaeger_span_context*) span_ref->referenced_context;
+        if (!span_ref_is_usable(ctx)) {
             continue;
         }
         jaeger_span_ref* span_ref_copy = jaeger_vector_append(&span->refs);
         if (span_ref_copy == NULL) {
             return false;
         }
-        if (!jaeger_span_ref_copy(
-                NULL, (void*) span_ref_copy, (const void*) span_ref)) {
+        if (!jaeger_span_context_copy(&span_ref_copy->context, ctx)) {
             span->refs.len--;
             return false;
         }
-        if (parent == NULL) {
-            parent = ctx;
-            *has_parent =
-                (span_ref->type == opentracing_span_reference_child_of);
-        }
-    }
-
-    if (!*has_parent && parent != NULL &&
-        jaeger_span_context_is_valid(parent)) {
-        *has_parent = true;
+        span_ref_copy->type = span_ref->type;
     }
+    return true;
+}
 
-    if (!*has_parent || parent == NULL ||
-        !jaeger_span_context_is_valid(parent)) {
-        span->context.trace_id.low = jaeger_random64();
+/* Generates the IDs of a new span's context and decides whether it is
+ * sampled. Tags describing the sampling decision are appended to tags. */
+static inline void span_context_start(jaeger_tracer* tracer,
+                                      jaeger_span_context* ctx,
+                                      const jaeger_span_context* parent,
+                                      bool has_parent,
+                                      const char* operation_name,
+                                      jaeger_vector* tags)
+{
+    assert(tracer != NULL);
+    assert(ctx != NULL);
+    assert(parent != NULL || !has_parent);
+    if (!has_parent || !jaeger_span_context_is_valid(parent)) {
+        ctx->trace_id.low = jaeger_random64();
         if (tracer->options.gen_128_bit) {
-            span->context.trace_id.high = jaeger_random64();
+            ctx->trace_id.high = jaeger_random64();
         }
-        span->context.span_id = span->context.trace_id.low;
-        span->context.flags = 0;
-        if (*has_parent &&
+        ctx->span_id = ctx->trace_id.low;
+        ctx->flags = 0;
+        if (has_parent &&
             jaeger_span_context_is_debug_id_container_only(parent)) {
-            span->context.flags |= (unsigned) jaeger_sampling_flag_sampled |
-                                   (unsigned) jaeger_sampling_flag_debug;
-            append_tag(
-                &span->tags, JAEGERTRACINGC_DEBUG_HEADER, parent->debug_id);
+            ctx->flags |= (unsigned) jaeger_sampling_flag_sampled |
+                          (unsigned) jaeger_sampling_flag_debug;
+            append_tag(tags,
+                       JAEGERTRACINGC_DEBUG_HEADER,
+                       jaeger_strdup(parent->debug_id));
         }
-        else if (tracer->sampler->is_sampled(tracer->sampler,
-                                             &span->context.trace_id,
-                                             span->operation_name,
-                                             &span->tags)) {
-            span->context.flags |= (unsigned) jaeger_sampling_flag_sampled;
+        else if (tracer->sampler->is_sampled(
+                     tracer->sampler, &ctx->trace_id, operation_name, tags)) {
+            ctx->flags |= (unsigned) jaeger_sampling_flag_sampled;
         }
     }
     else {
-        span->context.trace_id = parent->trace_id;
-        span->context.span_id = jaeger_random64();
-        span->context.flags = parent->flags;
+        ctx->trace_id = parent->trace_id;
+        ctx->span_id = jaeger_random64();
+        ctx->flags = parent->flags;
     }
+}
 
-    if (*has_parent) {
-        assert(parent != NULL);
-        if (!jaeger_hashtable_copy(&span->context.baggage, &parent->baggage)) {
-            return false;
-        }
+/* Shares the parent's baggage with ctx until either of them modifies it. A
+ * pooled span keeps its own empty table if the parent has no baggage. */
+static inline void span_context_inherit_baggage(
+    jaeger_span_context* ctx, const jaeger_span_context* parent)
+{
+    jaeger_mutex_lock((jaeger_mutex*) &parent->mutex);
+    if (jaeger_span_context_baggage(parent)->size > 0) {
+        jaeger_span_context_share_baggage(ctx, parent);
     }
+    jaeger_mutex_unlock((jaeger_mutex*) &parent->mutex);
+}
 
-    return true;
+/* Whether the start tags set a non-zero sampling priority, which makes the
+ * span sampled whatever the sampler decided. */
+static inline bool
+start_tags_set_sampling_priority(const opentracing_start_span_options* options)
+{
+    for (int i = 0; i < options->num_tags; i++) {
+        const opentracing_tag* tag = &options->tags[i];
+        if (strcmp(tag->key, SAMPLING_PRIORITY_TAG_KEY) != 0) {
+            continue;
+        }
+        if ((tag->value.type == opentracing_value_int64 &&
+             tag->value.value.int64_value) ||
+            (tag->value.type == opentracing_value_uint64 &&
+             tag->value.value.uint64_value)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 static inline void update_metrics_for_new_span(jaeger_metrics* metrics,
-                                               const jaeger_span* span,
+                                               const bool is_sampled,
                                                const bool is_new_trace)
 {
 #define COUNTER_INCREMENT(counter) (counter)->inc((counter), 1)
 
     assert(metrics != NULL);
-    assert(span != NULL);
 
     jaeger_counter* spans_started = metrics->spans_started;
     spans_started->inc(spans_started, 1);
 
-    jaeger_mutex_lock((jaeger_mutex*) &span->mutex);
-    const bool is_sampled = jaeger_span_is_sampled(span);
-    jaeger_mutex_unlock((jaeger_mutex*) &span->mutex);
     if (is_sampled) {
         COUNTER_INCREMENT(metrics->spans_sampled);
         if (is_new_trace) {
@@ -454,7 +752,7 @@ static inline void update_metrics_for_new_span(jaeger_metrics* metrics,
         }
     }
     else {
-        COUNTER_INCREMENT(metrics->spans_sampled);
+        COUNTER_INCREMENT(metrics->spans_not_sampled);
         if (is_new_trace) {
             COUNTER_INCREMENT(metrics->traces_started_not_sampled);
         }
@@ -463,10 +761,44 @@ static inline void update_metrics_for_new_span(jaeger_metrics* metrics,
 #undef COUNTER_INCREMENT
 }
 
+/* Starts a noop span with the IDs and flags of ctx, inheriting the baggage
+ * of parent. */
+static opentracing_span*
+tracer_start_noop_span(jaeger_tracer* tracer,
+                       const jaeger_span_context* ctx,
+                       const jaeger_span_context* parent,
+                       bool has_parent)
+{
+    jaeger_noop_span* span = tracer_acquire_noop_span(tracer);
+    if (span == NULL) {
+        jaeger_log_error("Cannot allocate noop span");
+        return NULL;
+    }
+    span->tracer = tracer;
+    span->context.trace_id = ctx->trace_id;
+    span->context.span_id = ctx->span_id;
+    span->context.flags = ctx->flags;
+    if (has_parent) {
+        span_context_inherit_baggage(&span->context, parent);
+    }
+    update_metrics_for_new_span(tracer->metrics, false, !has_parent);
+    return (opentracing_span*) span;
+}
+
 opentracing_span* jaeger_tracer_start_span_with_options(
     opentracing_tracer* tracer,
     const char* operation_name,
     const opentracing_start_span_options* options)
+{
+    return jaeger_tracer_start_span_with_flags(
+        tracer, operation_name, options, jaeger_span_start_flag_none);
+}
+
+opentracing_span* jaeger_tracer_start_span_with_flags(
+    opentracing_tracer* tracer,
+    const char* operation_name,
+    const opentracing_start_span_options* options,
+    int flags)
 {
     assert(tracer != NULL);
     assert(operation_name != NULL);
@@ -478,54 +810,109 @@ opentracing_span* jaeger_tracer_start_span_with_options(
                                                .num_tags = 0};
         jaeger_duration_now(&opts.start_time_steady);
         jaeger_timestamp_now(&opts.start_time_system);
-        return jaeger_tracer_start_span_with_options(
-            tracer, operation_name, &opts);
+        return jaeger_tracer_start_span_with_flags(
+            tracer, operation_name, &opts, flags);
     }
 
     assert(options != NULL);
     assert(options->num_references >= 0);
-    assert(options->references == NULL || options->num_references == 0);
+    assert(options->references != NULL || options->num_references == 0);
     assert(options->num_tags >= 0);
-    assert(options->tags == NULL || options->num_tags == 0);
+    assert(options->tags != NULL || options->num_tags == 0);
 
     jaeger_tracer* t = (jaeger_tracer*) tracer;
-    jaeger_span* span = jaeger_malloc(sizeof(jaeger_span));
-    if (span == NULL) {
-        jaeger_log_error("Cannot allocate span, operation name = %s",
-                         operation_name);
-        return NULL;
-    }
     bool has_parent;
-    if (!jaeger_span_init(span) ||
-        !span_inherit_from_parent(t,
-                                  span,
-                                  options->references,
-                                  options->num_references,
-                                  &has_parent)) {
+    const jaeger_span_context* parent = span_find_parent(
+        options->references, options->num_references, &has_parent);
+    jaeger_span_context context = JAEGERTRACINGC_SPAN_CONTEXT_INIT;
+    jaeger_span* span = NULL;
+    if (!t->options.noop_unsampled_spans) {
+        span = tracer_acquire_span(t);
+        if (span == NULL) {
+            goto allocation_error;
+        }
+        span_context_start(
+            t, &context, parent, has_parent, operation_name, &span->tags);
+    }
+    else {
+        /* Sampler tags of new traces are moved to the span if the trace
+         * turns out to be sampled. */
+        struct {
+            JAEGERTRACINGC_INLINE_VECTOR(jaeger_tag,
+                                         tags,
+                                         SAMPLER_INLINE_TAGS);
+        } sampler;
+        jaeger_vector_init_inline(&sampler.tags,
+                                  sizeof(jaeger_tag),
+                                  sampler.tags_storage,
+                                  SAMPLER_INLINE_TAGS);
+        span_context_start(
+            t, &context, parent, has_parent, operation_name, &sampler.tags);
+        if ((context.flags & (uint8_t) jaeger_sampling_flag_sampled) == 0 &&
+            !start_tags_set_sampling_priority(options)) {
+            JAEGERTRACINGC_VECTOR_FOR_EACH(
+                &sampler.tags, jaeger_tag_destroy, jaeger_tag);
+            jaeger_vector_destroy(&sampler.tags);
+            return tracer_start_noop_span(t, &context, parent, has_parent);
+        }
+        span = tracer_acquire_span(t);
+        const int num_sampler_tags = jaeger_vector_length(&sampler.tags);
+        /* A newly acquired span has no tags, the tags are moved as is. A
+         * sampled span must not start without its sampler tags. */
+        jaeger_tag* tags = NULL;
+        if (span != NULL && num_sampler_tags > 0) {
+            tags = jaeger_vector_extend(&span->tags, 0, num_sampler_tags);
+            if (tags == NULL) {
+                jaeger_span_destroy((jaeger_destructible*) span);
+                jaeger_free(span);
+                span = NULL;
+            }
+        }
+        if (tags != NULL) {
+            memcpy(tags,
+                   jaeger_vector_offset(&sampler.tags, 0),
+                   sizeof(jaeger_tag) * num_sampler_tags);
+        }
+        else {
+            JAEGERTRACINGC_VECTOR_FOR_EACH(
+                &sampler.tags, jaeger_tag_destroy, jaeger_tag);
+        }
+        jaeger_vector_destroy(&sampler.tags);
+        if (span == NULL) {
+            goto allocation_error;
+        }
+    }
+    span->context.trace_id = context.trace_id;
+    span->context.span_id = context.span_id;
+    span->context.flags = context.flags;
+    if ((flags & jaeger_span_start_flag_single_owner) != 0) {
+        span->single_owner = true;
+#ifndef NDEBUG
+        span->owner = jaeger_thread_self();
+#endif /* NDEBUG */
+    }
+
+    if (!span_copy_refs(span, options->references, options->num_references)) {
         goto cleanup;
     }
+    if (has_parent) {
+        span_context_inherit_baggage(&span->context, parent);
+    }
 
     for (int i = 0; i < options->num_tags; i++) {
         assert(options->tags != NULL);
-        jaeger_tag src_tag = JAEGERTRACINGC_TAG_INIT;
-        jaeger_tag_from_key_value(
-            &src_tag, options->tags[i].key, &options->tags[i].value);
-        assert(src_tag.key != NULL);
-        const opentracing_value value = {};
-
-        if (strcmp(src_tag.key, SAMPLING_PRIORITY_TAG_KEY) == 0 &&
-            src_tag.v_type == JAEGER__MODEL__VALUE_TYPE__INT64) {
-            if (jaeger_span_set_sampling_priority(span, &value)) {
-                continue;
-            }
+        const opentracing_tag* tag = &options->tags[i];
+        assert(tag->key != NULL);
+        /* Tags are copied straight into the span's arena. */
+        if (strcmp(tag->key, SAMPLING_PRIORITY_TAG_KEY) == 0 &&
+            jaeger_span_set_sampling_priority(span, &tag->value)) {
+            continue;
         }
-
-        jaeger_span_set_tag_no_locking(span, src_tag.key, &value);
+        jaeger_span_set_tag_no_locking(span, tag->key, &tag->value);
     }
 
     span->tracer = t;
-    span->operation_name = jaeger_strdup(operation_name);
-    if (span->operation_name == NULL) {
+    if (!jaeger_span_set_operation_name_no_locking(span, operation_name)) {
         goto cleanup;
     }
     span->duration = (jaeger_duration) JAEGERTRACINGC_DURATION_INIT;
@@ -546,7 +933,8 @@ opentracing_span* jaeger_tracer_start_span_with_options(
         span->start_time_steady = options->start_time_steady;
     }
 
-    update_metrics_for_new_span(t->metrics, span, !has_parent);
+    update_metrics_for_new_span(
+        t->metrics, jaeger_span_is_sampled(span), !has_parent);
 
     return (opentracing_span*) span;
 
@@ -554,6 +942,11 @@ cleanup:
     jaeger_span_destroy((jaeger_destructible*) span);
     jaeger_free(span);
     return NULL;
+
+allocation_error:
+    jaeger_log_error("Cannot allocate span, operation name = %s",
+                     operation_name);
+    return NULL;
 }
 
 bool jaeger_tracer_flush(jaeger_tracer* tracer)
@@ -569,7 +962,25 @@ void jaeger_tracer_report_span(jaeger_tracer* tracer, jaeger_span* span)
     if (jaeger_span_is_sampled(span)) {
         tracer->reporter->report(tracer->reporter, span);
     }
-    /* TODO: pooling? */
+#ifdef HAVE_SPAN_POOL
+    if (tracer->pool_spans && !tracer_pool_span(tracer, span, false)) {
+        jaeger_span_destroy((jaeger_destructible*) span);
+        jaeger_free(span);
+    }
+#endif /* HAVE_SPAN_POOL */
+}
+
+void jaeger_tracer_report_noop_span(jaeger_tracer* tracer,
+                                    jaeger_noop_span* span)
+{
+    jaeger_counter* spans_finished = tracer->metrics->spans_finished;
+    spans_finished->inc(spans_finished, 1);
+#ifdef HAVE_SPAN_POOL
+    if (tracer->pool_spans && !tracer_pool_span(tracer, span, true)) {
+        jaeger_noop_span_destroy((jaeger_destructible*) span);
+        jaeger_free(span);
+    }
+#endif /* HAVE_SPAN_POOL */
 }
 
 #define CHECK_SPAN_CONTEXT(ctx)                                             \
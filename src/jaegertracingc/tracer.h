@@ -29,13 +29,14 @@
 #include "jaegertracingc/reporter.h"
 #include "jaegertracingc/sampler.h"
 #include "jaegertracingc/tag.h"
+#include "jaegertracingc/threading.h"
 #include "jaegertracingc/vector.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
 
-/* Forward declaration. */
+/* Forward declarations. */
 struct jaeger_span;
 
 /**
@@ -47,11 +48,29 @@ typedef struct jaeger_tracer_options {
      * @see jaeger_trace_id
      */
     bool gen_128_bit;
+    /**
+     * Maximum number of finished spans kept for reuse by new spans, shared by
+     * all threads. Each thread keeps its own free list, so starting a span
+     * takes no lock. Zero disables pooling. When pooling, the tracer takes
+     * ownership of a span once it finishes, so the span must not be accessed
+     * after that. Only supported in multithreaded builds with atomics.
+     */
+    int span_pool_size;
+    /**
+     * Whether spans of traces that are not sampled are started as
+     * jaeger_noop_span, which only carries the span context. Such spans
+     * ignore tags and logs and are never reported, even if a
+     * sampling.priority tag is set after they start. The operation name of a
+     * noop span is not kept. Noop spans are pooled along with other spans.
+     * @see jaeger_noop_span
+     */
+    bool noop_unsampled_spans;
 } jaeger_tracer_options;
 
-#define JAEGER_TRACER_OPTIONS_INIT \
-    {                              \
-        .gen_128_bit = false       \
+#define JAEGER_TRACER_OPTIONS_INIT                 \
+    {                                              \
+        .gen_128_bit = false, .span_pool_size = 0, \
+        .noop_unsampled_spans = false              \
     }
 
 /**
@@ -101,6 +120,13 @@ typedef struct jaeger_tracer {
      */
     jaeger_vector tags;
 
+    /** Whether finished spans are pooled. */
+    bool pool_spans;
+    /** Span cache of each application thread. */
+    jaeger_thread_local span_cache_key;
+    /** Number of spans held by all span caches. */
+    int num_pooled_spans;
+
     /**
      * Flags to keep track of the members that were heap-allocated and must be
      * freed by the tracer.
@@ -140,7 +166,8 @@ typedef struct jaeger_tracer {
         .service_name = NULL, .metrics = NULL, .sampler = NULL,               \
         .reporter = NULL, .options = JAEGER_TRACER_OPTIONS_INIT,              \
         .headers = JAEGERTRACINGC_HEADERS_CONFIG_INIT,                        \
-        .tags = JAEGERTRACINGC_VECTOR_INIT, .allocated = {                    \
+        .tags = JAEGERTRACINGC_VECTOR_INIT, .pool_spans = false,              \
+        .num_pooled_spans = 0, .allocated = {                                 \
             .metrics = false,                                                 \
             .sampler = false,                                                 \
             .reporter = false                                                 \
@@ -187,6 +214,22 @@ opentracing_span* jaeger_tracer_start_span_with_options(
     const char* operation_name,
     const opentracing_start_span_options* options);
 
+/**
+ * Start a new span with Jaeger specific flags.
+ * @param tracer Tracer instance. May not be NULL.
+ * @param operation_name Operation name associated with this span.
+ *                       May not be NULL.
+ * @param options Additional options for starting span. May be NULL.
+ * @param flags Bitwise OR of jaeger_span_start_flag values.
+ * @return New span on success, NULL otherwise.
+ * @see jaeger_span_start_flag
+ */
+opentracing_span* jaeger_tracer_start_span_with_flags(
+    opentracing_tracer* tracer,
+    const char* operation_name,
+    const opentracing_start_span_options* options,
+    int flags);
+
 /**
  * Start a new span with default options.
  * @param span Span instance.
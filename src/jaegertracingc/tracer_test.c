@@ -16,8 +16,421 @@
 
 #include "jaegertracingc/tracer.h"
 
+#include "jaegertracingc/metrics.h"
+#include "jaegertracingc/reporter.h"
+#include "jaegertracingc/sampler.h"
+#include "jaegertracingc/span.h"
+#include "jaegertracingc/threading.h"
 #include "unity.h"
 
+#ifdef JAEGERTRACINGC_MT
+
+#define NUM_POOLED_SPANS 2
+
+static void* start_and_finish_span(void* arg)
+{
+    TEST_ASSERT_NOT_NULL(arg);
+    opentracing_tracer* tracer = (opentracing_tracer*) arg;
+    opentracing_span* span = tracer->start_span(tracer, "thread-operation");
+    TEST_ASSERT_NOT_NULL(span);
+    span->finish(span);
+    return NULL;
+}
+
+static void test_span_pool()
+{
+    jaeger_const_sampler sampler;
+    jaeger_const_sampler_init(&sampler, true);
+    jaeger_in_memory_reporter reporter;
+    TEST_ASSERT_TRUE(jaeger_in_memory_reporter_init(&reporter));
+    jaeger_metrics metrics;
+    TEST_ASSERT_TRUE(jaeger_default_metrics_init(&metrics));
+    jaeger_tracer_options options = JAEGER_TRACER_OPTIONS_INIT;
+    options.span_pool_size = NUM_POOLED_SPANS;
+    jaeger_tracer tracer = JAEGERTRACINGC_TRACER_INIT;
+    TEST_ASSERT_TRUE(jaeger_tracer_init(&tracer,
+                                        "test-service",
+                                        (jaeger_sampler*) &sampler,
+                                        (jaeger_reporter*) &reporter,
+                                        &metrics,
+                                        &options,
+                                        NULL));
+    opentracing_tracer* t = (opentracing_tracer*) &tracer;
+    const jaeger_default_counter* hits =
+        (const jaeger_default_counter*) metrics.span_pool_hits;
+    const jaeger_default_counter* misses =
+        (const jaeger_default_counter*) metrics.span_pool_misses;
+
+    opentracing_span* span = t->start_span(t, "operation");
+    TEST_ASSERT_NOT_NULL(span);
+    /* Sampler tags. */
+    const int num_tags = jaeger_vector_length(&((jaeger_span*) span)->tags);
+    const opentracing_value value = {.type = opentracing_value_bool,
+                                     .value = {.bool_value = true}};
+    span->set_tag(span, "key", &value);
+    span->log_fields(span, NULL, 0);
+    span->set_baggage_item(span, "baggage-key", "baggage-value");
+    span->finish(span);
+    TEST_ASSERT_EQUAL(1, tracer.num_pooled_spans);
+    TEST_ASSERT_EQUAL(1, jaeger_vector_length(&reporter.spans));
+
+    /* Reused span keeps its storage but none of its contents. */
+    opentracing_span* reused = t->start_span(t, "reused-operation");
+    TEST_ASSERT_EQUAL_PTR(span, reused);
+    jaeger_span* s = (jaeger_span*) reused;
+    TEST_ASSERT_EQUAL_STRING("reused-operation", s->operation_name);
+    TEST_ASSERT_EQUAL(num_tags, jaeger_vector_length(&s->tags));
+    TEST_ASSERT_EQUAL(0, jaeger_vector_length(&s->logs));
+    TEST_ASSERT_TRUE(jaeger_vector_is_inline(&s->tags));
+    TEST_ASSERT_EQUAL(0, jaeger_span_context_baggage(&s->context)->size);
+    TEST_ASSERT_NULL(reused->baggage_item(reused, "baggage-key"));
+    TEST_ASSERT_TRUE(jaeger_span_is_sampled(s));
+    TEST_ASSERT_EQUAL(1, hits->total);
+    TEST_ASSERT_EQUAL(1, misses->total);
+
+    /* Spans pooled by a thread are freed when it exits. */
+    jaeger_thread thread;
+    TEST_ASSERT_EQUAL(
+        0, jaeger_thread_init(&thread, &start_and_finish_span, t));
+    TEST_ASSERT_EQUAL(0, jaeger_thread_join(thread, NULL));
+    TEST_ASSERT_EQUAL(0, tracer.num_pooled_spans);
+    TEST_ASSERT_EQUAL(2, misses->total);
+
+    /* Pool keeps at most NUM_POOLED_SPANS spans, the rest are freed. */
+    opentracing_span* spans[NUM_POOLED_SPANS + 1];
+    for (int i = 0; i < NUM_POOLED_SPANS + 1; i++) {
+        spans[i] = t->start_span(t, "operation");
+        TEST_ASSERT_NOT_NULL(spans[i]);
+    }
+    TEST_ASSERT_EQUAL(NUM_POOLED_SPANS + 3, misses->total);
+    reused->finish(reused);
+    for (int i = 0; i < NUM_POOLED_SPANS + 1; i++) {
+        spans[i]->finish(spans[i]);
+    }
+    TEST_ASSERT_EQUAL(NUM_POOLED_SPANS, tracer.num_pooled_spans);
+    TEST_ASSERT_EQUAL(NUM_POOLED_SPANS + 4,
+                      jaeger_vector_length(&reporter.spans));
+
+    jaeger_tracer_destroy((jaeger_destructible*) &tracer);
+}
+
+#define NUM_EXITING_THREADS 8
+
+typedef struct exiting_thread_context {
+    opentracing_tracer* tracer;
+    jaeger_mutex mutex;
+    jaeger_cond cv;
+    int num_finished;
+} exiting_thread_context;
+
+static void* start_and_finish_span_then_exit(void* arg)
+{
+    TEST_ASSERT_NOT_NULL(arg);
+    exiting_thread_context* context = (exiting_thread_context*) arg;
+    start_and_finish_span(context->tracer);
+    jaeger_mutex_lock(&context->mutex);
+    context->num_finished++;
+    jaeger_mutex_unlock(&context->mutex);
+    jaeger_cond_signal(&context->cv);
+    return NULL;
+}
+
+static void test_span_pool_thread_exit()
+{
+    jaeger_const_sampler sampler;
+    jaeger_const_sampler_init(&sampler, true);
+    jaeger_in_memory_reporter reporter;
+    TEST_ASSERT_TRUE(jaeger_in_memory_reporter_init(&reporter));
+    jaeger_metrics metrics;
+    TEST_ASSERT_TRUE(jaeger_default_metrics_init(&metrics));
+    jaeger_tracer_options options = JAEGER_TRACER_OPTIONS_INIT;
+    options.span_pool_size = NUM_EXITING_THREADS;
+    jaeger_tracer tracer = JAEGERTRACINGC_TRACER_INIT;
+    TEST_ASSERT_TRUE(jaeger_tracer_init(&tracer,
+                                        "test-service",
+                                        (jaeger_sampler*) &sampler,
+                                        (jaeger_reporter*) &reporter,
+                                        &metrics,
+                                        &options,
+                                        NULL));
+
+    exiting_thread_context context = {.tracer = (opentracing_tracer*) &tracer,
+                                      .mutex = JAEGERTRACINGC_MUTEX_INIT,
+                                      .cv = JAEGERTRACINGC_COND_INIT,
+                                      .num_finished = 0};
+    jaeger_thread threads[NUM_EXITING_THREADS];
+    for (int i = 0; i < NUM_EXITING_THREADS; i++) {
+        TEST_ASSERT_EQUAL(0,
+                          jaeger_thread_init(&threads[i],
+                                             &start_and_finish_span_then_exit,
+                                             &context));
+    }
+    jaeger_mutex_lock(&context.mutex);
+    while (context.num_finished < NUM_EXITING_THREADS) {
+        jaeger_cond_wait(&context.cv, &context.mutex);
+    }
+    jaeger_mutex_unlock(&context.mutex);
+
+    /* Threads free their span caches on exit while the tracer frees them
+     * too, and each cache must be freed exactly once. */
+    jaeger_tracer_destroy((jaeger_destructible*) &tracer);
+    for (int i = 0; i < NUM_EXITING_THREADS; i++) {
+        TEST_ASSERT_EQUAL(0, jaeger_thread_join(threads[i], NULL));
+    }
+    jaeger_cond_destroy(&context.cv);
+    jaeger_mutex_destroy(&context.mutex);
+}
+
+static void test_noop_span_pool()
+{
+    jaeger_const_sampler sampler;
+    jaeger_const_sampler_init(&sampler, false);
+    jaeger_in_memory_reporter reporter;
+    TEST_ASSERT_TRUE(jaeger_in_memory_reporter_init(&reporter));
+    jaeger_metrics metrics;
+    TEST_ASSERT_TRUE(jaeger_default_metrics_init(&metrics));
+    jaeger_tracer_options options = JAEGER_TRACER_OPTIONS_INIT;
+    options.span_pool_size = NUM_POOLED_SPANS;
+    options.noop_unsampled_spans = true;
+    jaeger_tracer tracer = JAEGERTRACINGC_TRACER_INIT;
+    TEST_ASSERT_TRUE(jaeger_tracer_init(&tracer,
+                                        "test-service",
+                                        (jaeger_sampler*) &sampler,
+                                        (jaeger_reporter*) &reporter,
+                                        &metrics,
+                                        &options,
+                                        NULL));
+    opentracing_tracer* t = (opentracing_tracer*) &tracer;
+    const jaeger_default_counter* hits =
+        (const jaeger_default_counter*) metrics.span_pool_hits;
+
+    opentracing_span* span = t->start_span(t, "operation");
+    TEST_ASSERT_NOT_NULL(span);
+    span->set_baggage_item(span, "baggage-key", "baggage-value");
+    span->finish(span);
+    TEST_ASSERT_EQUAL(1, tracer.num_pooled_spans);
+
+    /* Reused noop span keeps none of its baggage. */
+    opentracing_span* reused = t->start_span(t, "operation");
+    TEST_ASSERT_EQUAL_PTR(span, reused);
+    TEST_ASSERT_EQUAL(1, hits->total);
+    TEST_ASSERT_NULL(reused->baggage_item(reused, "baggage-key"));
+    reused->finish(reused);
+    TEST_ASSERT_EQUAL(0, jaeger_vector_length(&reporter.spans));
+
+    jaeger_tracer_destroy((jaeger_destructible*) &tracer);
+}
+
+#endif /* JAEGERTRACINGC_MT */
+
+static void destroy_span(opentracing_span* span)
+{
+    ((jaeger_destructible*) span)->destroy((jaeger_destructible*) span);
+    jaeger_free(span);
+}
+
+static void test_noop_span()
+{
+    jaeger_const_sampler sampler;
+    jaeger_const_sampler_init(&sampler, false);
+    jaeger_in_memory_reporter reporter;
+    TEST_ASSERT_TRUE(jaeger_in_memory_reporter_init(&reporter));
+    jaeger_metrics metrics;
+    TEST_ASSERT_TRUE(jaeger_default_metrics_init(&metrics));
+    jaeger_tracer_options options = JAEGER_TRACER_OPTIONS_INIT;
+    options.noop_unsampled_spans = true;
+    jaeger_tracer tracer = JAEGERTRACINGC_TRACER_INIT;
+    TEST_ASSERT_TRUE(jaeger_tracer_init(&tracer,
+                                        "test-service",
+                                        (jaeger_sampler*) &sampler,
+                                        (jaeger_reporter*) &reporter,
+                                        &metrics,
+                                        &options,
+                                        NULL));
+    opentracing_tracer* t = (opentracing_tracer*) &tracer;
+
+    opentracing_span* span = t->start_span(t, "operation");
+    TEST_ASSERT_NOT_NULL(span);
+    TEST_ASSERT_EQUAL_PTR(&jaeger_noop_span_finish, span->finish);
+    const jaeger_noop_span* noop_span = (const jaeger_noop_span*) span;
+    TEST_ASSERT_TRUE(jaeger_span_context_is_valid(&noop_span->context));
+    TEST_ASSERT_EQUAL(0, noop_span->context.flags);
+    TEST_ASSERT_NULL(noop_span->context.baggage);
+    const opentracing_value value = {.type = opentracing_value_bool,
+                                     .value = {.bool_value = true}};
+    span->set_tag(span, "key", &value);
+    span->log_fields(span, NULL, 0);
+    span->set_operation_name(span, "new-operation");
+    span->set_baggage_item(span, "baggage-key", "baggage-value");
+    TEST_ASSERT_EQUAL_STRING("baggage-value",
+                             span->baggage_item(span, "baggage-key"));
+
+    /* Children of unsampled spans are noop spans carrying their baggage. */
+    opentracing_span_reference ref = {
+        .type = opentracing_span_reference_child_of,
+        .referenced_context =
+            (opentracing_span_context*) &noop_span->context};
+    opentracing_start_span_options start_options = {
+        .references = &ref, .num_references = 1, .tags = NULL, .num_tags = 0};
+    opentracing_span* child =
+        t->start_span_with_options(t, "child-operation", &start_options);
+    TEST_ASSERT_NOT_NULL(child);
+    TEST_ASSERT_EQUAL_PTR(&jaeger_noop_span_finish, child->finish);
+    const jaeger_noop_span* noop_child = (const jaeger_noop_span*) child;
+    TEST_ASSERT_EQUAL(noop_span->context.trace_id.low,
+                      noop_child->context.trace_id.low);
+    TEST_ASSERT_NOT_EQUAL(noop_span->context.span_id,
+                          noop_child->context.span_id);
+    TEST_ASSERT_EQUAL_STRING("baggage-value",
+                             child->baggage_item(child, "baggage-key"));
+
+    /* The child shares the parent's baggage until it sets an item. */
+    TEST_ASSERT_EQUAL_PTR(noop_span->context.baggage,
+                          noop_child->context.baggage);
+    child->set_baggage_item(child, "child-key", "child-value");
+    TEST_ASSERT_NOT_EQUAL(noop_span->context.baggage,
+                          noop_child->context.baggage);
+    TEST_ASSERT_NULL(span->baggage_item(span, "child-key"));
+    TEST_ASSERT_EQUAL_STRING("baggage-value",
+                             child->baggage_item(child, "baggage-key"));
+
+    /* Sampling priority marks the context for downstream spans. */
+    const opentracing_value priority = {.type = opentracing_value_int64,
+                                        .value = {.int64_value = 1}};
+    child->set_tag(child, JAEGERTRACINGC_SAMPLING_PRIORITY, &priority);
+    TEST_ASSERT_EQUAL(
+        jaeger_sampling_flag_sampled | jaeger_sampling_flag_debug,
+        noop_child->context.flags);
+
+    /* A sampling priority start tag overrides the sampler. */
+    opentracing_tag priority_tag = {.key = JAEGERTRACINGC_SAMPLING_PRIORITY,
+                                    .value = priority};
+    start_options.tags = &priority_tag;
+    start_options.num_tags = 1;
+    opentracing_span* sampled =
+        t->start_span_with_options(t, "sampled-operation", &start_options);
+    TEST_ASSERT_NOT_NULL(sampled);
+    TEST_ASSERT_EQUAL_PTR(&jaeger_span_finish, sampled->finish);
+    TEST_ASSERT_TRUE(jaeger_span_is_sampled((const jaeger_span*) sampled));
+
+    sampled->finish(sampled);
+    child->finish(child);
+    span->finish(span);
+    TEST_ASSERT_EQUAL(1, jaeger_vector_length(&reporter.spans));
+    TEST_ASSERT_EQUAL(
+        3, ((const jaeger_default_counter*) metrics.spans_finished)->total);
+    TEST_ASSERT_EQUAL(
+        2, ((const jaeger_default_counter*) metrics.spans_not_sampled)->total);
+    destroy_span(sampled);
+    destroy_span(child);
+    destroy_span(span);
+
+    jaeger_tracer_destroy((jaeger_destructible*) &tracer);
+}
+
+static void test_finished_span()
+{
+    jaeger_const_sampler sampler;
+    jaeger_const_sampler_init(&sampler, true);
+    jaeger_in_memory_reporter reporter;
+    TEST_ASSERT_TRUE(jaeger_in_memory_reporter_init(&reporter));
+    jaeger_metrics metrics;
+    TEST_ASSERT_TRUE(jaeger_default_metrics_init(&metrics));
+    jaeger_tracer tracer = JAEGERTRACINGC_TRACER_INIT;
+    TEST_ASSERT_TRUE(jaeger_tracer_init(&tracer,
+                                        "test-service",
+                                        (jaeger_sampler*) &sampler,
+                                        (jaeger_reporter*) &reporter,
+                                        &metrics,
+                                        NULL,
+                                        NULL));
+    opentracing_tracer* t = (opentracing_tracer*) &tracer;
+
+    opentracing_span* span = t->start_span(t, "operation");
+    TEST_ASSERT_NOT_NULL(span);
+    const jaeger_span* s = (const jaeger_span*) span;
+    const int num_tags = jaeger_vector_length(&s->tags);
+    span->finish(span);
+    TEST_ASSERT_TRUE(s->finished);
+
+    /* Finished spans are frozen and only reported once. */
+    const opentracing_value value = {.type = opentracing_value_bool,
+                                     .value = {.bool_value = true}};
+    span->set_tag(span, "key", &value);
+    span->log_fields(span, NULL, 0);
+    span->set_operation_name(span, "new-operation");
+    span->set_baggage_item(span, "baggage-key", "baggage-value");
+    span->finish(span);
+    TEST_ASSERT_EQUAL(num_tags, jaeger_vector_length(&s->tags));
+    TEST_ASSERT_EQUAL(0, jaeger_vector_length(&s->logs));
+    TEST_ASSERT_EQUAL_STRING("operation", s->operation_name);
+    TEST_ASSERT_NULL(span->baggage_item(span, "baggage-key"));
+    TEST_ASSERT_EQUAL(1, jaeger_vector_length(&reporter.spans));
+    TEST_ASSERT_EQUAL(
+        1, ((const jaeger_default_counter*) metrics.spans_finished)->total);
+    TEST_ASSERT_TRUE(jaeger_span_is_sampled(s));
+    destroy_span(span);
+
+    jaeger_tracer_destroy((jaeger_destructible*) &tracer);
+}
+
+static void test_single_owner_span()
+{
+    jaeger_const_sampler sampler;
+    jaeger_const_sampler_init(&sampler, true);
+    jaeger_in_memory_reporter reporter;
+    TEST_ASSERT_TRUE(jaeger_in_memory_reporter_init(&reporter));
+    jaeger_metrics metrics;
+    TEST_ASSERT_TRUE(jaeger_default_metrics_init(&metrics));
+    jaeger_tracer tracer = JAEGERTRACINGC_TRACER_INIT;
+    TEST_ASSERT_TRUE(jaeger_tracer_init(&tracer,
+                                        "test-service",
+                                        (jaeger_sampler*) &sampler,
+                                        (jaeger_reporter*) &reporter,
+                                        &metrics,
+                                        NULL,
+                                        NULL));
+    opentracing_tracer* t = (opentracing_tracer*) &tracer;
+
+    opentracing_span* span = jaeger_tracer_start_span_with_flags(
+        t, "operation", NULL, jaeger_span_start_flag_single_owner);
+    TEST_ASSERT_NOT_NULL(span);
+    const jaeger_span* s = (const jaeger_span*) span;
+    TEST_ASSERT_TRUE(s->single_owner);
+    const int num_tags = jaeger_vector_length(&s->tags);
+    const opentracing_value value = {.type = opentracing_value_bool,
+                                     .value = {.bool_value = true}};
+    span->set_tag(span, "key", &value);
+    span->log_fields(span, NULL, 0);
+    span->set_operation_name(span, "new-operation");
+    span->set_baggage_item(span, "baggage-key", "baggage-value");
+    TEST_ASSERT_EQUAL(num_tags + 1, jaeger_vector_length(&s->tags));
+    TEST_ASSERT_EQUAL(1, jaeger_vector_length(&s->logs));
+    TEST_ASSERT_EQUAL_STRING("new-operation", s->operation_name);
+    TEST_ASSERT_EQUAL_STRING("baggage-value",
+                             span->baggage_item(span, "baggage-key"));
+    span->finish(span);
+    TEST_ASSERT_EQUAL(1, jaeger_vector_length(&reporter.spans));
+    destroy_span(span);
+
+    /* Spans are locked by default. */
+    span = t->start_span(t, "operation");
+    TEST_ASSERT_NOT_NULL(span);
+    TEST_ASSERT_FALSE(((const jaeger_span*) span)->single_owner);
+    span->finish(span);
+    destroy_span(span);
+
+    jaeger_tracer_destroy((jaeger_destructible*) &tracer);
+}
+
 void test_tracer()
 {
+#ifdef JAEGERTRACINGC_MT
+    test_span_pool();
+    test_span_pool_thread_exit();
+    test_noop_span_pool();
+#endif /* JAEGERTRACINGC_MT */
+    test_noop_span();
+    test_finished_span();
+    test_single_owner_span();
 }
@@ -22,6 +22,20 @@ int jaeger_vector_length(const jaeger_vector* vec)
     return vec->len;
 }
 
+bool jaeger_vector_is_inline(const jaeger_vector* vec)
+{
+    assert(vec != NULL);
+    return vec->data == NULL && vec->capacity > 0;
+}
+
+/* Inline storage is located relative to the vector instead of pointed to by
+ * data, so owners holding it may be moved as a whole, e.g. by resizing a
+ * vector of them. */
+static inline char* vector_data(const jaeger_vector* vec)
+{
+    return jaeger_vector_is_inline(vec) ? (char*) (vec + 1) : vec->data;
+}
+
 bool jaeger_vector_init(jaeger_vector* vec, int type_size)
 {
     assert(vec != NULL);
@@ -41,10 +55,24 @@ bool jaeger_vector_init(jaeger_vector* vec, int type_size)
     return true;
 }
 
+void jaeger_vector_init_inline(jaeger_vector* vec,
+                               int type_size,
+                               void* storage,
+                               int capacity)
+{
+    assert(vec != NULL);
+    assert(type_size > 0);
+    assert(capacity > 0);
+    assert((char*) storage == (char*) (vec + 1));
+    memset(storage, 0, type_size * capacity);
+    *vec = (jaeger_vector){
+        .data = NULL, .len = 0, .capacity = capacity, .type_size = type_size};
+}
+
 void* jaeger_vector_offset(jaeger_vector* vec, int index)
 {
     assert(vec != NULL);
-    return vec->data + vec->type_size * index;
+    return vector_data(vec) + vec->type_size * index;
 }
 
 void* jaeger_vector_get(jaeger_vector* vec, int index)
@@ -72,8 +100,16 @@ bool jaeger_vector_reserve(jaeger_vector* vec, int new_capacity)
         aligned_capacity *= JAEGERTRACINGC_VECTOR_RESIZE_FACTOR;
     }
 
-    char* new_data =
-        jaeger_realloc(vec->data, vec->type_size * aligned_capacity);
+    char* new_data;
+    if (jaeger_vector_is_inline(vec)) {
+        new_data = jaeger_malloc(vec->type_size * aligned_capacity);
+        if (new_data != NULL) {
+            memcpy(new_data, vector_data(vec), vec->type_size * vec->capacity);
+        }
+    }
+    else {
+        new_data = jaeger_realloc(vec->data, vec->type_size * aligned_capacity);
+    }
     if (new_data == NULL) {
         jaeger_log_error("Failed to allocate memory for vector resize, "
                          "current size = %d, new size = %d",
@@ -160,7 +196,7 @@ void jaeger_vector_destroy(jaeger_vector* vec)
 
 void jaeger_vector_sort(jaeger_vector* vec, jaeger_comparator cmp)
 {
-    qsort(vec->data, jaeger_vector_length(vec), vec->type_size, cmp);
+    qsort(vector_data(vec), jaeger_vector_length(vec), vec->type_size, cmp);
 }
 
 void* jaeger_vector_bsearch(jaeger_vector* vec,
@@ -168,7 +204,7 @@ void* jaeger_vector_bsearch(jaeger_vector* vec,
                             jaeger_comparator cmp)
 {
     return bsearch(
-        key, vec->data, jaeger_vector_length(vec), vec->type_size, cmp);
+        key, vector_data(vec), jaeger_vector_length(vec), vec->type_size, cmp);
 }
 
 int jaeger_vector_lower_bound(jaeger_vector* vec,
@@ -45,6 +45,15 @@ typedef struct jaeger_vector {
         .len = 0, .capacity = 0, .data = NULL, .type_size = 0 \
     }
 
+/**
+ * Declares a vector member followed by inline storage for its first capacity
+ * elements.
+ * @see jaeger_vector_init_inline()
+ */
+#define JAEGERTRACINGC_INLINE_VECTOR(type, name, capacity) \
+    jaeger_vector name;                                    \
+    type name##_storage[capacity]
+
 #define JAEGERTRACINGC_VECTOR_FOR_EACH(vec, op, type)                    \
     do {                                                                 \
         for (int i = 0, len = jaeger_vector_length(vec); i < len; i++) { \
@@ -56,6 +65,28 @@ int jaeger_vector_length(const jaeger_vector* vec);
 
 bool jaeger_vector_init(jaeger_vector* vec, int type_size);
 
+/**
+ * Initialize a vector that keeps its elements in inline storage until they
+ * no longer fit, at which point they move to the heap. The storage must
+ * immediately follow the vector, as declared by JAEGERTRACINGC_INLINE_VECTOR,
+ * and the vector must not be copied or moved apart from it. Does not
+ * allocate.
+ * @param vec Vector to initialize.
+ * @param type_size Size of elements.
+ * @param storage Inline storage following vec.
+ * @param capacity Number of elements that fit in storage. Must be positive.
+ */
+void jaeger_vector_init_inline(jaeger_vector* vec,
+                               int type_size,
+                               void* storage,
+                               int capacity);
+
+/**
+ * @param vec Vector instance.
+ * @return True if vec keeps its elements in inline storage, false otherwise.
+ */
+bool jaeger_vector_is_inline(const jaeger_vector* vec);
+
 void* jaeger_vector_offset(jaeger_vector* vec, int index);
 
 void* jaeger_vector_get(jaeger_vector* vec, int index);
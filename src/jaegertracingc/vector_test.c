@@ -49,4 +49,30 @@ void test_vector()
     TEST_ASSERT_FALSE(jaeger_tag_vector_append(&vec, &tag));
     jaeger_set_allocator(jaeger_built_in_allocator());
     jaeger_vector_destroy(&vec);
+
+    /* Inline vectors only allocate once they outgrow their storage. */
+    enum { inline_capacity = 2 };
+    struct {
+        JAEGERTRACINGC_INLINE_VECTOR(int, ints, inline_capacity);
+    } owner;
+    jaeger_set_allocator(jaeger_null_allocator());
+    jaeger_vector_init_inline(
+        &owner.ints, sizeof(int), owner.ints_storage, inline_capacity);
+    TEST_ASSERT_TRUE(jaeger_vector_is_inline(&owner.ints));
+    for (int i = 0; i < inline_capacity; i++) {
+        int* x = jaeger_vector_append(&owner.ints);
+        TEST_ASSERT_EQUAL_PTR(&owner.ints_storage[i], x);
+        *x = i;
+    }
+    TEST_ASSERT_NULL(jaeger_vector_append(&owner.ints));
+    TEST_ASSERT_TRUE(jaeger_vector_is_inline(&owner.ints));
+    jaeger_set_allocator(jaeger_built_in_allocator());
+    int* x = jaeger_vector_insert(&owner.ints, 0);
+    TEST_ASSERT_NOT_NULL(x);
+    *x = -1;
+    TEST_ASSERT_FALSE(jaeger_vector_is_inline(&owner.ints));
+    for (int i = 0; i <= inline_capacity; i++) {
+        TEST_ASSERT_EQUAL(i - 1, *(int*) jaeger_vector_get(&owner.ints, i));
+    }
+    jaeger_vector_destroy(&owner.ints);
 }